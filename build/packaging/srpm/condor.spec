@@ -1448,6 +1448,7 @@ rm -rf %{buildroot}
 %_mandir/man1/condor_cod.1.gz
 %_mandir/man1/condor_config_val.1.gz
 %_mandir/man1/condor_convert_history.1.gz
+%_mandir/man1/condor_convert_job_queue.1.gz
 %_mandir/man1/condor_dagman.1.gz
 %_mandir/man1/condor_fetchlog.1.gz
 %_mandir/man1/condor_findhost.1.gz
@@ -1579,6 +1580,7 @@ rm -rf %{buildroot}
 %_sbindir/condor_c-gahp_worker_thread
 %_sbindir/condor_collector
 %_sbindir/condor_convert_history
+%_sbindir/condor_convert_job_queue
 %_sbindir/condor_credd
 %_sbindir/condor_fetchlog
 %_sbindir/condor_had
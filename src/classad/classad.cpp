@@ -58,8 +58,8 @@ bool ClassAdGetExpressionCaching()
 // This is probably not the best place to put these. However, 
 // I am reconsidering how we want to do errors, and this may all
 // change in any case. 
-string CondorErrMsg;
-int CondorErrno;
+thread_local string CondorErrMsg;
+thread_local int CondorErrno;
 
 void ClassAdLibraryVersion(int &major, int &minor, int &patch)
 {
@@ -184,10 +184,13 @@ struct ClassadAttrNameHash
 	}
 
 };
-extern std::string       CondorErrMsg;
+	// The error of the last failed parse or evaluation.  Each thread has
+	// its own, so that threads that parse ads at the same time don't
+	// write over each other's errors.
+extern thread_local std::string       CondorErrMsg;
 #endif
 
-extern int 		CondorErrno;
+extern thread_local int 		CondorErrno;
 
 
 } // classad
@@ -62,40 +62,28 @@ extern "C" char* CondorPlatform( void );
 
 CollectorStats CollectorDaemon::collectorStats( false, 0 );
 CollectorEngine CollectorDaemon::collector( &collectorStats );
+QueryCache CollectorDaemon::query_cache;
+std::map<int, CollectorDaemon::query_cache_fill> CollectorDaemon::query_cache_fills;
 int CollectorDaemon::HandleQueryInProcPolicy = HandleQueryInProcSmallTableAndQuery;
 int CollectorDaemon::ClientTimeout;
 int CollectorDaemon::QueryTimeout;
 char* CollectorDaemon::CollectorName = NULL;
 Timeslice CollectorDaemon::view_sock_timeslice;
+int CollectorDaemon::view_forward_interval = 0;
+int CollectorDaemon::view_forward_queue_size = 100000;
+int CollectorDaemon::view_forward_timer_id = -1;
+long CollectorDaemon::view_forward_dropped = 0;
 vector<CollectorDaemon::vc_entry> CollectorDaemon::vc_list;
 
-ClassAd* CollectorDaemon::__query__;
-int CollectorDaemon::__numAds__;
-int CollectorDaemon::__resultLimit__;
-int CollectorDaemon::__failed__;
-List<ClassAd>* CollectorDaemon::__ClassAdResultList__;
-std::string CollectorDaemon::__adType__;
-ExprTree *CollectorDaemon::__filter__;
-
-TrackTotals* CollectorDaemon::normalTotals = NULL;
-int CollectorDaemon::submittorRunningJobs;
-int CollectorDaemon::submittorIdleJobs;
-int CollectorDaemon::submittorNumAds;
-
 CollectorUniverseStats CollectorDaemon::ustatsAccum;
 CollectorUniverseStats CollectorDaemon::ustatsMonthly;
 
-int CollectorDaemon::machinesTotal;
-int CollectorDaemon::machinesUnclaimed;
-int CollectorDaemon::machinesClaimed;
-int CollectorDaemon::machinesOwner;
-int CollectorDaemon::startdNumAds;
-
 ClassAd* CollectorDaemon::ad = NULL;
 CollectorList* CollectorDaemon::collectorsToUpdate = NULL;
 int CollectorDaemon::UpdateTimerId;
 
 OfflineCollectorPlugin CollectorDaemon::offline_plugin_;
+CollectorSubscriptions CollectorDaemon::subscriptions_;
 
 StringList *viewCollectorTypes;
 
@@ -350,6 +338,10 @@ void CollectorDaemon::Init()
 		receive_query_cedar,"receive_query_cedar",READ);
 	daemonCore->Register_CommandWithPayload(QUERY_GENERIC_ADS,"QUERY_GENERIC_ADS",
 		receive_query_cedar,"receive_query_cedar",READ);
+
+	// install command handler for subscriptions to ad changes
+	daemonCore->Register_CommandWithPayload(SUBSCRIBE_ADS,"SUBSCRIBE_ADS",
+		receive_subscription,"receive_subscription",DAEMON);
 	
 	// install command handlers for invalidations
 	daemonCore->Register_CommandWithPayload(INVALIDATE_STARTD_ADS,"INVALIDATE_STARTD_ADS",
@@ -392,6 +384,10 @@ void CollectorDaemon::Init()
 	// install command handlers for updates
 	daemonCore->Register_CommandWithPayload(UPDATE_STARTD_AD,"UPDATE_STARTD_AD",
 		receive_update,"receive_update",ADVERTISE_STARTD_PERM);
+	daemonCore->Register_CommandWithPayload(UPDATE_STARTD_AD_DELTA,"UPDATE_STARTD_AD_DELTA",
+		receive_update,"receive_update",ADVERTISE_STARTD_PERM);
+	daemonCore->Register_CommandWithPayload(UPDATE_STARTD_AD_BULK,"UPDATE_STARTD_AD_BULK",
+		receive_bulk_update,"receive_bulk_update",ADVERTISE_STARTD_PERM);
 	daemonCore->Register_CommandWithPayload(MERGE_STARTD_AD,"MERGE_STARTD_AD",
 		receive_update,"receive_update",NEGOTIATOR);
 	daemonCore->Register_CommandWithPayload(UPDATE_SCHEDD_AD,"UPDATE_SCHEDD_AD",
@@ -501,8 +497,10 @@ int CollectorDaemon::receive_query_cedar(int command,
 	pending_query_entry_t *query_entry = NULL;
 	bool handle_in_proc;
 	bool is_locate;
+	bool is_summary;
 	KnownSubsystemId clientSubsys = SUBSYSTEM_ID_UNKNOWN;
 	AdTypes whichAds;
+	std::string cache_key;
 	ClassAd *cad = new ClassAd();
 	ASSERT(cad);
 
@@ -531,6 +529,7 @@ int CollectorDaemon::receive_query_cedar(int command,
 
 	is_locate = cad->Lookup(ATTR_LOCATION_QUERY) != NULL;
 	if (is_locate) { rt.runtime = &HandleLocate_runtime; }
+	is_summary = ! is_locate && is_summary_query(whichAds, cad);
 
 	// Figure out whether to handle the query inline or to fork.
 	handle_in_proc = false;
@@ -561,6 +560,11 @@ int CollectorDaemon::receive_query_cedar(int command,
 	if ( max_query_workers < 1 ) {
 		handle_in_proc = true;
 	}
+	// A summary is a handful of ads made from counters, so it is cheaper
+	// to send it than to fork.
+	if ( is_summary ) {
+		handle_in_proc = true;
+	}
 
 	// Set a deadline on the query socket if the admin specified one in the config,
 	// but if the socket came to us with a previous (shorter) deadline, honor it.
@@ -581,9 +585,22 @@ int CollectorDaemon::receive_query_cedar(int command,
 	ASSERT(query_entry);
 	query_entry->cad = cad;
 	query_entry->is_locate = is_locate;
+	query_entry->is_summary = is_summary;
 	query_entry->subsys[0] = 0;
 	query_entry->sock = sock;
 	query_entry->whichAds = whichAds;
+	query_entry->cached_result = NULL;
+	query_entry->cache_key = NULL;
+	query_entry->cache_generation = 0;
+	query_entry->cache_pipe = -1;
+
+	if ( ! is_locate && ! is_summary && query_cache.enabled()) {
+		query_entry->cached_result = lookup_query_cache(whichAds, cad, sock, cache_key);
+			// on a miss, keep the result as it is sent
+		if ( ! query_entry->cached_result && ! cache_key.empty()) {
+			query_entry->cache_key = new std::string(cache_key);
+		}
+	}
 
 #ifdef TRACK_QUERIES_BY_SUBSYS
 	if ( want_track_queries_by_subsys ) {
@@ -604,6 +621,8 @@ int CollectorDaemon::receive_query_cedar(int command,
 		// We want to immediately handle the query inline in this process.
 		// So in this case, we simply directly invoke our worker thread function.
 		dprintf(D_FULLDEBUG,"QueryWorker: about to handle query in-process\n");
+
+		query_entry->cache_generation = collector.adSetGeneration(whichAds);
 		return_status = receive_query_cedar_worker_thread((void *)query_entry,sock);
 	} else {
 		// Enqueue the query to ultimately run in a forked process created created with
@@ -699,7 +718,11 @@ int CollectorDaemon::receive_query_cedar(int command,
 END:
     // all done
 	delete cad;
-	free(query_entry);
+	if (query_entry) {
+		delete query_entry->cached_result;
+		delete query_entry->cache_key;
+		free(query_entry);
+	}
 	return return_status;
 }
 
@@ -782,6 +805,8 @@ int CollectorDaemon::QueryReaper(int pid, int /* exit_status */ )
 				// now deallocate everything with this query_entry
 				delete query_entry->sock;
 				delete query_entry->cad;
+				delete query_entry->cached_result;
+				delete query_entry->cache_key;
 				free(query_entry); 
 				query_entry = NULL;  // so we will loop and dequeue another entry
 			}
@@ -797,15 +822,57 @@ int CollectorDaemon::QueryReaper(int pid, int /* exit_status */ )
 	Stream *sock = query_entry->sock;
 	query_entry->sock = NULL;
 	ClassAd *query_classad = query_entry->cad;
+	std::shared_ptr<const QueryCacheResult> *cached_result = query_entry->cached_result;
+	std::string *cache_key = query_entry->cache_key;
+
+	// The worker sees the ads as they are now.  A forked worker sends its
+	// result for the query cache back over a pipe, a thread that runs in
+	// this process adds it to the cache itself.
+	int cache_pipe[2] = { -1, -1 };
+	if (cache_key) {
+		query_entry->cache_generation = collector.adSetGeneration(query_entry->whichAds);
+		if ( ! daemonCore->DoFakeCreateThread()) {
+			if ( ! daemonCore->Create_Pipe(cache_pipe, true) ||
+				daemonCore->Register_Pipe(cache_pipe[0], "QueryCacheResult",
+					&CollectorDaemon::query_cache_pipe_handler, "CollectorDaemon::query_cache_pipe_handler") == -1)
+			{
+				dprintf(D_ALWAYS, "QueryWorker: failed to make a pipe for the query cache, not caching the result\n");
+				if (cache_pipe[0] != -1) { daemonCore->Close_Pipe(cache_pipe[0]); }
+				if (cache_pipe[1] != -1) { daemonCore->Close_Pipe(cache_pipe[1]); }
+				cache_pipe[0] = cache_pipe[1] = -1;
+				query_entry->cache_key = NULL;
+			} else {
+				query_cache_fill & fill = query_cache_fills[cache_pipe[0]];
+				fill.key = *cache_key;
+				fill.generation = query_entry->cache_generation;
+				query_entry->cache_pipe = cache_pipe[1];
+			}
+		}
+	}
+
 	int tid = daemonCore->
 		Create_Thread((ThreadStartFunc)&CollectorDaemon::receive_query_cedar_worker_thread,
 		    (void *)query_entry, sock, ReaperId);
+
+	// only the worker writes to the pipe, so close our end of it now
+	// that it has its own.  the read end sees EOF once the worker exits
+	if (cache_pipe[1] != -1) {
+		daemonCore->Close_Pipe(cache_pipe[1]);
+	}
+	delete cache_key;
+	cache_key = NULL;
+
 	if (tid == FALSE) {
 		dprintf(D_ALWAYS,
 				"ERROR: Create_Thread failed trying to fork a QueryWorker!\n");
+		if (cache_pipe[0] != -1) {
+			query_cache_fills.erase(cache_pipe[0]);
+			daemonCore->Close_Pipe(cache_pipe[0]);
+		}
 		free(query_entry); // daemoncore won't free this if Create_Thread fails
 		delete sock;
 		delete query_classad;
+		delete cached_result;
 		return -1;
 	}
 
@@ -826,6 +893,8 @@ int CollectorDaemon::QueryReaper(int pid, int /* exit_status */ )
 	// now has a copy, or the Create_Thread ran in-proc it has already completed.
 	delete query_classad;
 	query_classad = NULL;
+	delete cached_result;
+	cached_result = NULL;
 
 	dprintf(D_ALWAYS,
 			"QueryWorker: forked new %sworker with id %d ( max %d active %d pending %d )\n",
@@ -840,20 +909,7 @@ int CollectorDaemon::receive_query_cedar_worker_thread(void *in_query_entry, Str
 {
 	int return_status = TRUE;
 	double begin = condor_gettimestamp_double();
-	List<ClassAd> results;
-
-		// If our peer is at least 8.9.3 and has NEGOTIATOR authz, then we'll
-		// trust it to handle our capabilities.
-	bool filter_private_ads = true;
-	auto *verinfo = sock->get_peer_version();
-	if (verinfo && verinfo->built_since_version(8, 9, 3)) {
-		auto addr = static_cast<ReliSock*>(sock)->peer_addr();
-			// Given failure here is non-fatal, do not log at D_ALWAYS.
-		if (static_cast<Sock*>(sock)->isAuthorizationInBoundingSet("NEGOTIATOR") &&
-			(USER_AUTH_SUCCESS == daemonCore->Verify("send private ads", NEGOTIATOR, addr, static_cast<ReliSock*>(sock)->getFullyQualifiedUser(), D_SECURITY|D_FULLDEBUG))) {
-			filter_private_ads = false;
-		}
-	}
+	query_stats_t qstats = { 0, 0, INT_MAX };
 
 	// Pull out relavent state from query_entry
 	pending_query_entry_t *query_entry = (pending_query_entry_t *) in_query_entry;
@@ -861,26 +917,19 @@ int CollectorDaemon::receive_query_cedar_worker_thread(void *in_query_entry, Str
 	bool is_locate = query_entry->is_locate;
 	AdTypes whichAds = query_entry->whichAds;
 
-		// Always send private attributes in private ads.
-	if (whichAds == STARTD_PVT_AD) {
-		filter_private_ads = false;
-	}
+	bool filter_private_ads = ! query_wants_private_ads(whichAds, sock);
 
-	// Perform the query
-
-	if (whichAds != (AdTypes) -1) {
-		process_query_public (whichAds, cad, &results);
+	// on a query cache miss, keep the result as we send it
+	std::unique_ptr<QueryCacheResult> fill_cache;
+	if (query_entry->cache_key || query_entry->cache_pipe != -1) {
+		fill_cache.reset(new QueryCacheResult());
 	}
 
-	double end_query = condor_gettimestamp_double();
-	double end_write = 0.0;
-
-	// send the results via cedar			
+	// set up to send the results via cedar as we find them
 	sock->timeout(QueryTimeout); // set up a network timeout of a longer duration
 	sock->encode();
-	results.Rewind();
-	ClassAd *curr_ad = NULL;
 	int more = 1;
+	bool send_failed = false;
 	
 		// See if query ad asks for server-side projection
 	string projection = "";
@@ -897,7 +946,11 @@ int CollectorDaemon::receive_query_cedar_worker_thread(void *in_query_entry, Str
 		evaluate_projection = true;
 	}
 
-	while ( (curr_ad=results.Next()) )
+		// Each matching ad is written to the socket as soon as it is found,
+		// so we never hold a list of all of the results.  CEDAR buffers the
+		// writes, and blocks (up to QueryTimeout) when the client is slow to
+		// read, which in turn pauses the table walk.
+	auto send_ad = [&](ClassAd *curr_ad) -> bool
 	{
 		// if querying collector ads, and the collectors own ad appears in this list.
 		// then we want to shove in current statistics. we do this by chaining a
@@ -932,29 +985,76 @@ int CollectorDaemon::receive_query_cedar_worker_thread(void *in_query_entry, Str
 			}
 		}
 
-		bool send_failed = (!sock->code(more) || !putClassAd(sock, *curr_ad, filter_private_ads ? PUT_CLASSAD_NO_PRIVATE : 0, proj.empty() ? NULL : &proj));
-        
+		if (fill_cache) {
+			// unparse the ad once, into the cached result, and send that
+			QueryCacheResult & result = *fill_cache;
+			result.add(*curr_ad, proj.empty() ? NULL : &proj);
+			send_failed = (!sock->code(more) || !result.put(sock, result.numAds() - 1));
+		} else {
+			send_failed = (!sock->code(more) || !putClassAd(sock, *curr_ad, filter_private_ads ? PUT_CLASSAD_NO_PRIVATE : 0, proj.empty() ? NULL : &proj));
+		}
+
 		if (stats_ad) {
 			stats_ad->Unchain();
 			delete stats_ad;
 		}
 
 		if (send_failed)
-        {
-            dprintf (D_ALWAYS,
-                    "Error sending query result to client -- aborting\n");
-            return_status = 0;
-			goto END;
-        }
+		{
+			dprintf (D_ALWAYS,
+					"Error sending query result to client -- aborting\n");
+			return false;
+		}
 
 		if (sock->deadline_expired()) {
 			dprintf( D_ALWAYS,
 				"QueryWorker: max_worktime expired while sending query result to client -- aborting\n");
-			return_status = 0;
-			goto END;
+			send_failed = true;
+			return false;
 		}
-
-	} // end of while loop for next result ad to send
+		return true;
+	};
+
+	// Perform the query, sending the results as we go
+
+	if (query_entry->cached_result) {
+		// the parent already has the result of this query, so just send it
+		const QueryCacheResult & result = **query_entry->cached_result;
+		for (size_t ii = 0; ii < result.numAds(); ++ii) {
+			if ( ! sock->code(more) || ! result.put(sock, ii)) {
+				dprintf (D_ALWAYS,
+						"Error sending query result to client -- aborting\n");
+				send_failed = true;
+				break;
+			}
+			if (sock->deadline_expired()) {
+				dprintf( D_ALWAYS,
+					"QueryWorker: max_worktime expired while sending query result to client -- aborting\n");
+				send_failed = true;
+				break;
+			}
+			qstats.matched++;
+		}
+	} else if (query_entry->is_summary) {
+		// the summary ads are sent whole, the projection names the
+		// attributes of the ads that the summary stands for.
+		collector.totals().publishStartdSummary([&](ClassAd *ad) -> bool {
+			if ( ! sock->code(more) || ! putClassAd(sock, *ad)) {
+				dprintf (D_ALWAYS,
+						"Error sending query result to client -- aborting\n");
+				send_failed = true;
+				return false;
+			}
+			qstats.matched++;
+			return true;
+		});
+	} else if (whichAds != (AdTypes) -1) {
+		process_query_public (whichAds, cad, send_ad, qstats);
+	}
+	if (send_failed) {
+		return_status = 0;
+		goto END;
+	}
 
 	// end of query response ...
 	more = 0;
@@ -969,18 +1069,19 @@ int CollectorDaemon::receive_query_cedar_worker_thread(void *in_query_entry, Str
 		dprintf (D_ALWAYS, "Error flushing CEDAR socket\n");
 	}
 
-	end_write = condor_gettimestamp_double();
+	if (fill_cache) {
+		fill_query_cache(query_entry, fill_cache.release());
+	}
 
 	dprintf (D_ALWAYS,
-			 "Query info: matched=%d; skipped=%d; query_time=%f; send_time=%f; type=%s; requirements={%s}; locate=%d; limit=%d; from=%s; peer=%s; projection={%s}; filter_private_ads=%d\n",
-			 __numAds__,
-			 __failed__,
-			 end_query - begin,
-			 end_write - end_query,
+			 "Query info: matched=%d; skipped=%d; query_time=%f; type=%s; requirements={%s}; locate=%d; limit=%d; from=%s; peer=%s; projection={%s}; filter_private_ads=%d\n",
+			 qstats.matched,
+			 qstats.skipped,
+			 condor_gettimestamp_double() - begin,
 			 AdTypeToString(whichAds),
-			 ExprTreeToString(__filter__),
+			 ExprTreeToString(cad->LookupExpr(ATTR_REQUIREMENTS)),
 			 is_locate,
-			 (__resultLimit__ == INT_MAX) ? 0 : __resultLimit__,
+			 (qstats.limit == INT_MAX) ? 0 : qstats.limit,
 			 query_entry->subsys,
 			 sock->peer_description(),
 			 projection.c_str(),
@@ -993,6 +1094,202 @@ END:
 	return return_status;
 }
 
+bool
+CollectorDaemon::query_wants_private_ads(AdTypes whichAds, Stream *sock)
+{
+		// Always send private attributes in private ads.
+	if (whichAds == STARTD_PVT_AD) {
+		return true;
+	}
+
+		// If our peer is at least 8.9.3 and has NEGOTIATOR authz, then we'll
+		// trust it to handle our capabilities.
+	auto *verinfo = sock->get_peer_version();
+	if (verinfo && verinfo->built_since_version(8, 9, 3)) {
+		auto addr = static_cast<ReliSock*>(sock)->peer_addr();
+			// Given failure here is non-fatal, do not log at D_ALWAYS.
+		if (static_cast<Sock*>(sock)->isAuthorizationInBoundingSet("NEGOTIATOR") &&
+			(USER_AUTH_SUCCESS == daemonCore->Verify("send private ads", NEGOTIATOR, addr, static_cast<ReliSock*>(sock)->getFullyQualifiedUser(), D_SECURITY|D_FULLDEBUG))) {
+			return true;
+		}
+	}
+	return false;
+}
+
+bool
+CollectorDaemon::is_summary_query(AdTypes whichAds, ClassAd *query)
+{
+	bool summary_only = false;
+	if (whichAds != STARTD_AD ||
+		! query->LookupBool(ATTR_SUMMARY_ONLY, summary_only) || ! summary_only) {
+		return false;
+	}
+
+		// The totals count every startd ad, so they are only the answer
+		// to a query that matches every ad.  Otherwise, send the ads and
+		// let the client total them.
+	if (filterAbsentAds) {
+		return false;
+	}
+	bool matches_all = false;
+	ExprTree *filter = query->LookupExpr(ATTR_REQUIREMENTS);
+	if ( ! filter || ! ExprTreeIsLiteralBool(filter, matches_all) || ! matches_all) {
+		return false;
+	}
+	return true;
+}
+
+// Add the result of a query that was sent in full to the query cache, and
+// delete it.  A forked worker writes it to the pipe instead, for
+// query_cache_pipe_handler() to add in the collector.
+void
+CollectorDaemon::fill_query_cache(pending_query_entry_t *query_entry, QueryCacheResult *result)
+{
+	std::shared_ptr<const QueryCacheResult> owned(result);
+	if (query_entry->cache_pipe != -1) {
+		std::string buf;
+		if (result->memory() <= query_cache.maxMemory()) {
+			result->serialize(buf);
+		}
+		size_t off = 0;
+		while (off < buf.size()) {
+			int len = (int)MIN(buf.size() - off, (size_t)(1024*1024));
+			int n = daemonCore->Write_Pipe(query_entry->cache_pipe, buf.data() + off, len);
+			if (n <= 0) {
+				dprintf(D_ALWAYS, "QueryWorker: failed to send the query result to the query cache, errno=%d\n", errno);
+				break;
+			}
+			off += n;
+		}
+		daemonCore->Close_Pipe(query_entry->cache_pipe);
+		query_entry->cache_pipe = -1;
+	} else if (query_entry->cache_key) {
+		query_cache.insert(*query_entry->cache_key, owned, query_entry->cache_generation, time(NULL));
+		collectorStats.global.QueryCacheEntries = (int)query_cache.numEntries();
+	}
+}
+
+int
+CollectorDaemon::query_cache_pipe_handler(int pipe_end)
+{
+	auto it = query_cache_fills.find(pipe_end);
+	if (it == query_cache_fills.end()) {
+		daemonCore->Close_Pipe(pipe_end);
+		return 0;
+	}
+
+	char buf[65536];
+	int n = daemonCore->Read_Pipe(pipe_end, buf, sizeof(buf));
+	if (n > 0) {
+		it->second.result.append(buf, n);
+		return 0;
+	}
+	if (n < 0 && errno == EINTR) {
+		return 0;
+	}
+
+	// the worker is done.  it sends nothing if the query failed
+	if (n == 0 && ! it->second.result.empty()) {
+		std::shared_ptr<QueryCacheResult> result(new QueryCacheResult());
+		if (result->deserialize(it->second.result)) {
+			query_cache.insert(it->second.key, result, it->second.generation, time(NULL));
+			collectorStats.global.QueryCacheEntries = (int)query_cache.numEntries();
+		} else {
+			dprintf(D_ALWAYS, "QueryWorker: got a corrupt query result for the query cache\n");
+		}
+	}
+	query_cache_fills.erase(it);
+	daemonCore->Close_Pipe(pipe_end);
+	return 0;
+}
+
+std::shared_ptr<const QueryCacheResult> *
+CollectorDaemon::lookup_query_cache(AdTypes whichAds, ClassAd *query, Stream *sock, std::string &key)
+{
+	key.clear();
+
+		// The collector's own ad gets fresh statistics on every query, and
+		// ads with private attributes are never cached.
+	if (whichAds == (AdTypes) -1 || whichAds == COLLECTOR_AD || query_wants_private_ads(whichAds, sock)) {
+		return NULL;
+	}
+
+		// A projection that must be evaluated against each ad is not cached.
+	classad::ExprTree *projection = query->Lookup(ATTR_PROJECTION);
+	std::string proj_str;
+	if (projection && ! query->LookupString(ATTR_PROJECTION, proj_str)) {
+		return NULL;
+	}
+
+	QueryCache::makeKey(whichAds, *query, key);
+
+	std::shared_ptr<const QueryCacheResult> result = query_cache.lookup(key, collector.adSetGeneration(whichAds), time(NULL));
+	collectorStats.global.QueryCacheEntries = (int)query_cache.numEntries();
+	if ( ! result) {
+		collectorStats.global.QueryCacheMisses += 1;
+		return NULL;
+	}
+	collectorStats.global.QueryCacheHits += 1;
+
+	return new std::shared_ptr<const QueryCacheResult>(result);
+}
+
+int CollectorDaemon::receive_subscription(int /*command*/, Stream* sock)
+{
+	ClassAd *query = new ClassAd();
+
+	sock->decode();
+	sock->timeout(1);
+	if ( ! getClassAd(sock, *query) || ! sock->end_of_message()) {
+		dprintf(D_ALWAYS, "Failed to receive subscription from %s\n", sock->peer_description());
+		delete query;
+		return FALSE;
+	}
+
+	// the ads that match are held for the client until it has read them,
+	// which costs about what a forked query worker does, so a subscription
+	// that is still being synced counts against the same limits.
+	int syncing = subscriptions_.numSyncing();
+	if (max_query_workers > 0 &&
+		active_query_workers + pending_query_workers + syncing >=
+			max_query_workers + max_pending_query_workers - reserved_for_highprio_query_workers)
+	{
+		dprintf(D_ALWAYS, "Refusing subscription from %s due to max pending workers of %d ( max %d reserved %d active %d pending %d syncing %d )\n",
+			sock->peer_description(), max_pending_query_workers, max_query_workers,
+			reserved_for_highprio_query_workers, active_query_workers, pending_query_workers, syncing);
+		collectorStats.global.DroppedQueries += 1;
+		delete query;
+		return FALSE;
+	}
+
+	AdSubscription *sub = subscriptions_.subscribe(static_cast<ReliSock *>(sock), query);
+	if ( ! sub) {
+		return FALSE;
+	}
+	// query is owned by the subscription now
+
+	// queue the ads that match now and then AD_EVENT_SYNCED.  they are
+	// sent without blocking as the client reads them, and events from
+	// here on are queued behind them.
+	query_stats_t qstats;
+	std::string key;
+	process_query_public(ANY_AD, query, [&](ClassAd *ad) -> bool {
+		DCCollectorAdSequences::makeAdKey(*ad, key);
+		sub->syncAd(*ad, key);
+		return true;
+	}, qstats);
+	if ( ! sub->startSync()) {
+		subscriptions_.drop(sub, "failed to send matching ads");
+		return KEEP_STREAM;
+	}
+
+	dprintf(D_ALWAYS, "Subscription from %s syncing %d matching ads\n",
+		sock->peer_description(), qstats.matched);
+
+	// the subscription owns the socket now
+	return KEEP_STREAM;
+}
+
 AdTypes
 CollectorDaemon::receive_query_public( int command )
 {
@@ -1273,6 +1570,16 @@ int CollectorDaemon::receive_update(int command, Stream* sock)
 			// which already does all the necessary logging.
 		}
 
+		if (insert == -5)
+		{
+			// A delta update that we could not apply.  Returning FALSE
+			// closes the update socket, which makes the sender reconnect
+			// and start over with a full ad.
+			dprintf (D_ALWAYS,
+				"Could not apply delta update from %s; closing connection.\n",
+				from.to_sinful().Value());
+		}
+
 		return FALSE;
 
 	}
@@ -1280,13 +1587,21 @@ int CollectorDaemon::receive_update(int command, Stream* sock)
 	CollectorEngine_ru_collect_runtime += rt.tick(rt_last);
 #endif
 
+		// From here on a delta update is just an update of the full ad
+	if (command == UPDATE_STARTD_AD_DELTA) {
+		command = UPDATE_STARTD_AD;
+	}
+
 	/* let the off-line plug-in have at it */
 	offline_plugin_.update ( command, *cad );
+	collector.adChanged ( cad );
 
 #if defined(HAVE_DLOPEN) && !defined(DARWIN)
 	CollectorPluginManager::Update(command, *cad);
 #endif
 
+	subscriptions_.update(*cad);
+
 #ifdef PROFILE_RECEIVE_UPDATE
 	CollectorEngine_ru_plugins_runtime += rt.tick(rt_last);
 #endif
@@ -1316,6 +1631,52 @@ int CollectorDaemon::receive_update(int command, Stream* sock)
 	return TRUE;
 }
 
+int CollectorDaemon::receive_bulk_update(int command, Stream* sock)
+{
+	std::vector<ClassAd*> ads;
+
+	daemonCore->dc_stats.AddToAnyProbe("UpdatesReceived", 1);
+
+	condor_sockaddr from = ((Sock*)sock)->peer_addr();
+
+	if ( ! collector.collectBulk(command, (Sock*)sock, from, ads)) {
+		dprintf (D_ALWAYS,
+			"Rejected bulk update from %s; no slots were updated.\n",
+			from.to_sinful().Value());
+		return FALSE;
+	}
+
+		// From here on each slot is just an UPDATE_STARTD_AD
+	for (auto it = ads.begin(); it != ads.end(); ++it) {
+		ClassAd *cad = *it;
+
+		offline_plugin_.update ( UPDATE_STARTD_AD, *cad );
+		collector.adChanged ( cad );
+
+#if defined(HAVE_DLOPEN) && !defined(DARWIN)
+		CollectorPluginManager::Update(UPDATE_STARTD_AD, *cad);
+#endif
+
+		subscriptions_.update(*cad);
+
+		if (viewCollectorTypes) {
+			forward_classad_to_view_collector(UPDATE_STARTD_AD,
+											  ATTR_MY_TYPE,
+											  cad);
+		} else {
+			send_classad_to_sock(UPDATE_STARTD_AD, cad);
+		}
+	}
+
+	if( sock->type() == Stream::reli_sock ) {
+			// stash this socket for future updates...
+		return stashSocket( (ReliSock *)sock );
+	}
+
+	// let daemon core clean up the socket
+	return TRUE;
+}
+
 int CollectorDaemon::receive_update_expect_ack(int command,
 												Stream *stream )
 {
@@ -1422,13 +1783,19 @@ int CollectorDaemon::receive_update_expect_ack(int command,
     }
 
     /* let the off-line plug-in have at it */
-	if(cad)
-    offline_plugin_.update ( command, *cad );
+	if(cad) {
+		offline_plugin_.update ( command, *cad );
+		collector.adChanged ( cad );
+	}
 
 #if defined(HAVE_DLOPEN) && !defined(DARWIN)
     CollectorPluginManager::Update ( command, *cad );
 #endif
 
+	if (cad) {
+		subscriptions_.update(*cad);
+	}
+
 	if (viewCollectorTypes) {
 		forward_classad_to_view_collector(command,
 										  ATTR_MY_TYPE,
@@ -1476,63 +1843,60 @@ CollectorDaemon::stashSocket( ReliSock* sock )
 	return KEEP_STREAM;
 }
 
-int CollectorDaemon::query_scanFunc (ClassAd *cad)
+// An empty adType means don't check the MyType of the ads.
+// This means either the command indicates we're only checking one
+// type of ad, or the query's TargetType is "Any" (match all ad types).
+static void
+get_query_ad_type(AdTypes whichAds, ClassAd &query, std::string &adType)
+{
+	adType.clear();
+	if ( whichAds == GENERIC_AD || whichAds == ANY_AD ) {
+		query.LookupString( ATTR_TARGET_TYPE, adType );
+		if ( strcasecmp( adType.c_str(), "any" ) == 0 ) {
+			adType.clear();
+		}
+	}
+}
+
+// Returns true if cad is of type adType (if not empty) and filter is true.
+static bool
+query_matches(const std::string &adType, ExprTree *filter, ClassAd *cad)
 {
-	if ( !__adType__.empty() ) {
+	if ( !adType.empty() ) {
 		std::string type = "";
 		cad->LookupString( ATTR_MY_TYPE, type );
-		if ( strcasecmp( type.c_str(), __adType__.c_str() ) != 0 ) {
-			return 1;
+		if ( strcasecmp( type.c_str(), adType.c_str() ) != 0 ) {
+			return false;
 		}
 	}
 
 	classad::Value result;
 	bool val;
-	if ( EvalExprTree( __filter__, cad, NULL, result ) &&
-		 result.IsBooleanValueEquiv(val) && val ) {
-		// Found a match 
-        __numAds__++;
-		__ClassAdResultList__->Append(cad);
-		if (__numAds__ >= __resultLimit__) {
-			return 0; // tell it to stop iterating, we have all the results we want
-		}
-    } else {
-		__failed__++;
-	}
-
-    return 1;
+	return EvalExprTree( filter, cad, NULL, result ) &&
+		result.IsBooleanValueEquiv(val) && val;
 }
 
 
 void CollectorDaemon::process_query_public (AdTypes whichAds,
 											ClassAd *query,
-											List<ClassAd>* results)
+											const std::function<bool(ClassAd*)> &output,
+											query_stats_t &qstats)
 {
-	// set up for hashtable scan
-	__query__ = query;
-	__numAds__ = 0;
-	__failed__ = 0;
-	__ClassAdResultList__ = results;
-	// An empty adType means don't check the MyType of the ads.
-	// This means either the command indicates we're only checking one
-	// type of ad, or the query's TargetType is "Any" (match all ad types).
-	__adType__ = "";
-	if ( whichAds == GENERIC_AD || whichAds == ANY_AD ) {
-		query->LookupString( ATTR_TARGET_TYPE, __adType__ );
-		if ( strcasecmp( __adType__.c_str(), "any" ) == 0 ) {
-			__adType__ = "";
-		}
-	}
+	std::string adType;
+	get_query_ad_type(whichAds, *query, adType);
+
+	qstats.matched = 0;
+	qstats.skipped = 0;
 
-	__filter__ = query->LookupExpr( ATTR_REQUIREMENTS );
-	if ( __filter__ == NULL ) {
+	ExprTree *filter = query->LookupExpr( ATTR_REQUIREMENTS );
+	if ( filter == NULL ) {
 		dprintf (D_ALWAYS, "Query missing %s\n", ATTR_REQUIREMENTS );
 		return;
 	}
 
-	__resultLimit__ = INT_MAX; // no limit
-	if ( ! query->LookupInteger(ATTR_LIMIT_RESULTS, __resultLimit__) || __resultLimit__ <= 0) {
-		__resultLimit__ = INT_MAX; // no limit
+	qstats.limit = INT_MAX; // no limit
+	if ( ! query->LookupInteger(ATTR_LIMIT_RESULTS, qstats.limit) || qstats.limit <= 0) {
+		qstats.limit = INT_MAX; // no limit
 	}
 
 	// See if we should exclude Collector Ads from generic queries.  Still
@@ -1544,10 +1908,10 @@ void CollectorDaemon::process_query_public (AdTypes whichAds,
 		dprintf(D_FULLDEBUG, "Received query with generic type; filtering collector ads\n");
 		MyString modified_filter;
 		modified_filter.formatstr("(%s) && (MyType =!= \"Collector\")",
-			ExprTreeToString(__filter__));
+			ExprTreeToString(filter));
 		query->AssignExpr(ATTR_REQUIREMENTS,modified_filter.Value());
-		__filter__ = query->LookupExpr(ATTR_REQUIREMENTS);
-		if ( __filter__ == NULL ) {
+		filter = query->LookupExpr(ATTR_REQUIREMENTS);
+		if ( filter == NULL ) {
 			dprintf (D_ALWAYS, "Failed to parse modified filter: %s\n", 
 				modified_filter.Value());
 			return;
@@ -1566,10 +1930,10 @@ void CollectorDaemon::process_query_public (AdTypes whichAds,
 		if (!checks_absent) {
 			MyString modified_filter;
 			modified_filter.formatstr("(%s) && (%s =!= True)",
-				ExprTreeToString(__filter__),ATTR_ABSENT);
+				ExprTreeToString(filter),ATTR_ABSENT);
 			query->AssignExpr(ATTR_REQUIREMENTS,modified_filter.Value());
-			__filter__ = query->LookupExpr(ATTR_REQUIREMENTS);
-			if ( __filter__ == NULL ) {
+			filter = query->LookupExpr(ATTR_REQUIREMENTS);
+			if ( filter == NULL ) {
 				dprintf (D_ALWAYS, "Failed to parse modified filter: %s\n", 
 					modified_filter.Value());
 				return;
@@ -1578,52 +1942,27 @@ void CollectorDaemon::process_query_public (AdTypes whichAds,
 		}
 	}
 
-	if (!collector.walkHashTable (whichAds, query_scanFunc))
-	{
-		dprintf (D_ALWAYS, "Error sending query response\n");
-	}
-
-	dprintf (D_ALWAYS, "(Sending %d ads in response to query)\n", __numAds__);
-}	
-
-//
-// Setting ATTR_LAST_HEARD_FROM to 0 causes the housekeeper to invalidate
-// the ad.  Since we don't want that -- we just want the ad to expire --
-// set the time to the next-smallest legal value, instead.  Expiring
-// invalidated ads allows the offline plugin to decide if they should go
-// absent, instead.
-//
-int CollectorDaemon::expiration_scanFunc (ClassAd *cad)
-{
-    return setAttrLastHeardFrom( cad, 1 );
-}
-
-int CollectorDaemon::invalidation_scanFunc (ClassAd *cad)
-{
-    return setAttrLastHeardFrom( cad, 0 );
-}
-
-int CollectorDaemon::setAttrLastHeardFrom (ClassAd* cad, unsigned long time)
-{
-	if ( !__adType__.empty() ) {
-		std::string type = "";
-		cad->LookupString( ATTR_MY_TYPE, type );
-		if ( strcasecmp( type.c_str(), __adType__.c_str() ) != 0 ) {
+	bool output_failed = false;
+	collector.walkHashTable (whichAds, [&](ClassAd *cad) -> int {
+		if ( ! query_matches(adType, filter, cad)) {
+			qstats.skipped++;
 			return 1;
 		}
-	}
-
-	classad::Value result;
-	bool val;
-	if ( EvalExprTree( __filter__, cad, NULL, result ) &&
-		 result.IsBooleanValueEquiv(val) && val ) {
+		qstats.matched++;
+		if ( ! output(cad)) {
+			output_failed = true;
+			return 0;
+		}
+			// stop iterating once we have all the results we want
+		return (qstats.matched < qstats.limit) ? 1 : 0;
+	});
 
-		cad->Assign( ATTR_LAST_HEARD_FROM, time );
-        __numAds__++;
-    }
+	if (output_failed) {
+		dprintf (D_ALWAYS, "Error sending query response\n");
+	}
 
-    return 1;
-}
+	dprintf (D_ALWAYS, "(Sent %d ads in response to query)\n", qstats.matched);
+}	
 
 void CollectorDaemon::process_invalidation (AdTypes whichAds, ClassAd &query, Stream *sock)
 {
@@ -1636,12 +1975,13 @@ void CollectorDaemon::process_invalidation (AdTypes whichAds, ClassAd &query, St
 	sock->timeout(QueryTimeout);
 
 	bool query_contains_hash_key = false;
+	int num_ads = 0;
 
     bool expireInvalidatedAds = param_boolean( "EXPIRE_INVALIDATED_ADS", false );
     if( expireInvalidatedAds ) {
-        __numAds__ = collector.expire( whichAds, query, &query_contains_hash_key );
+        num_ads = collector.expire( whichAds, query, &query_contains_hash_key );
     } else {        
-	__numAds__ = collector.remove( whichAds, query, &query_contains_hash_key );
+	num_ads = collector.remove( whichAds, query, &query_contains_hash_key );
     }
 
     if ( !query_contains_hash_key )
@@ -1649,47 +1989,54 @@ void CollectorDaemon::process_invalidation (AdTypes whichAds, ClassAd &query, St
 		dprintf ( D_ALWAYS, "Walking tables to invalidate... O(n)\n" );
 
 		// set up for hashtable scan
-		__query__ = &query;
-		__filter__ = query.LookupExpr( ATTR_REQUIREMENTS );
-		// An empty adType means don't check the MyType of the ads.
-		// This means either the command indicates we're only checking
-		// one type of ad, or the query's TargetType is "Any" (match
-		// all ad types).
-		__adType__ = "";
-		if ( whichAds == GENERIC_AD || whichAds == ANY_AD ) {
-			query.LookupString( ATTR_TARGET_TYPE, __adType__ );
-			if ( strcasecmp( __adType__.c_str(), "any" ) == 0 ) {
-				__adType__ = "";
-			}
-		}
+		ExprTree *filter = query.LookupExpr( ATTR_REQUIREMENTS );
+		std::string adType;
+		get_query_ad_type(whichAds, query, adType);
 
-		if ( __filter__ == NULL ) {
+		if ( filter == NULL ) {
 			dprintf (D_ALWAYS, "Invalidation missing %s\n", ATTR_REQUIREMENTS );
 			return;
 		}
 
+		//
+		// Setting ATTR_LAST_HEARD_FROM to 0 causes the housekeeper to invalidate
+		// the ad.  Since we don't want that -- we just want the ad to expire --
+		// set the time to the next-smallest legal value, instead.  Expiring
+		// invalidated ads allows the offline plugin to decide if they should go
+		// absent, instead.
+		//
+		auto setAttrLastHeardFrom = [&](unsigned long time) {
+			return [&, time](ClassAd *cad) -> int {
+				if (query_matches(adType, filter, cad)) {
+					cad->Assign( ATTR_LAST_HEARD_FROM, time );
+					num_ads++;
+				}
+				return 1;
+			};
+		};
+
         if (expireInvalidatedAds)
         {
-            collector.walkHashTable (whichAds, expiration_scanFunc);
+            collector.walkHashTable (whichAds, setAttrLastHeardFrom(1));
             collector.invokeHousekeeper (whichAds);
         } else if (param_boolean("HOUSEKEEPING_ON_INVALIDATE", true)) 
 		{
 			// first set all the "LastHeardFrom" attributes to low values ...
-			collector.walkHashTable (whichAds, invalidation_scanFunc);
+			collector.walkHashTable (whichAds, setAttrLastHeardFrom(0));
 
 			// ... then invoke the housekeeper
 			collector.invokeHousekeeper (whichAds);
 		} else 
 		{
-			__numAds__ = collector.invalidateAds(whichAds, query);
+			num_ads = collector.invalidateAds(whichAds, query);
 		}
 	}
 
-	dprintf (D_ALWAYS, "(Invalidated %d ads)\n", __numAds__ );
+	dprintf (D_ALWAYS, "(Invalidated %d ads)\n", num_ads );
 
 		// Suppose lots of ads are getting invalidated and we have no clue
 		// why.  That is what the following block of code tries to solve.
-	if( __numAds__ > 1 ) {
+	if( num_ads > 1 ) {
 		dprintf(D_ALWAYS, "The invalidation query was this:\n");
 		dPrintAd(D_ALWAYS, query);
 	}
@@ -1697,60 +2044,6 @@ void CollectorDaemon::process_invalidation (AdTypes whichAds, ClassAd &query, St
 
 
 
-int CollectorDaemon::reportStartdScanFunc( ClassAd *cad )
-{
-	return normalTotals->update( cad );
-}
-
-int CollectorDaemon::reportSubmittorScanFunc( ClassAd *cad )
-{
-	++submittorNumAds;
-
-	int tmp1, tmp2;
-	if( !cad->LookupInteger( ATTR_RUNNING_JOBS , tmp1 ) ||
-		!cad->LookupInteger( ATTR_IDLE_JOBS, tmp2 ) )
-			return 0;
-	submittorRunningJobs += tmp1;
-	submittorIdleJobs	 += tmp2;
-
-	return 1;
-}
-
-int CollectorDaemon::reportMiniStartdScanFunc( ClassAd *cad )
-{
-    char buf[80];
-	int iRet = 0;
-
-	++startdNumAds;
-
-	if ( cad && cad->LookupString( ATTR_STATE, buf, sizeof(buf) ) )
-	{
-		machinesTotal++;
-		switch ( buf[0] )
-		{
-			case 'C':
-				machinesClaimed++;
-				break;
-			case 'U':
-				machinesUnclaimed++;
-				break;
-			case 'O':
-				machinesOwner++;
-				break;
-		}
-
-		// Count the number of jobs in each universe
-		int universe;
-		if ( cad->LookupInteger( ATTR_JOB_UNIVERSE, universe ) )
-		{
-			ustatsAccum.accumulate( universe );
-		}
-		iRet = 1;
-	}
-
-    return iRet;
-}
-
 void CollectorDaemon::Config()
 {
 	dprintf(D_ALWAYS, "In CollectorDaemon::Config()\n");
@@ -1873,6 +2166,7 @@ void CollectorDaemon::Config()
 
     // if we're not the View Collector, let's set something up to forward
     // all of our ads to the view collector.
+    flush_view_forward_queues();
     for (vector<vc_entry>::iterator e(vc_list.begin());  e != vc_list.end();  ++e) {
         delete e->collector;
         delete e->sock;
@@ -1916,6 +2210,18 @@ void CollectorDaemon::Config()
         view_sock_timeslice.setMaxInterval(1200);
     }
 
+    // batch the startd ads sent to view collectors over TCP
+    view_forward_interval = param_integer("COLLECTOR_FORWARD_BATCH_INTERVAL", 0, 0);
+    view_forward_queue_size = param_integer("COLLECTOR_FORWARD_QUEUE_SIZE", 100000, 1);
+    if (view_forward_timer_id != -1) {
+        daemonCore->Cancel_Timer(view_forward_timer_id);
+        view_forward_timer_id = -1;
+    }
+    if (view_forward_interval > 0 && !vc_list.empty()) {
+        view_forward_timer_id = daemonCore->Register_Timer(view_forward_interval, view_forward_interval,
+                                    flush_view_forward_queues, "flush_view_forward_queues");
+    }
+
 	if (viewCollectorTypes) delete viewCollectorTypes;
 	viewCollectorTypes = NULL;
 	if (!vc_list.empty()) {
@@ -1948,6 +2254,9 @@ void CollectorDaemon::Config()
     max_query_workers = param_integer ("COLLECTOR_QUERY_WORKERS", 4, 0);
 	max_pending_query_workers = param_integer ("COLLECTOR_QUERY_WORKERS_PENDING", 50, 0);
 	max_query_worktime = param_integer("COLLECTOR_QUERY_MAX_WORKTIME",0,0);
+	subscriptions_.config();
+	query_cache.config(param_integer("COLLECTOR_QUERY_CACHE_TTL", 0, 0),
+		(size_t)param_integer("COLLECTOR_QUERY_CACHE_MAX_MEMORY", 256, 1) * 1024 * 1024);
 	reserved_for_highprio_query_workers = param_integer("COLLECTOR_QUERY_WORKERS_RESERVE_FOR_HIGH_PRIO",1,0);
 
 	// max_query_workers had better be at least one greater than reserved_for_highprio_query_workers,
@@ -2036,34 +2345,24 @@ void CollectorDaemon::Shutdown()
 
 void CollectorDaemon::sendCollectorAd()
 {
-    // compute submitted jobs information
-    submittorRunningJobs = 0;
-    submittorIdleJobs = 0;
-    submittorNumAds = 0;
-    if( !collector.walkHashTable( SUBMITTOR_AD, reportSubmittorScanFunc ) ) {
-         dprintf( D_ALWAYS, "Error making collector ad (submittor scan)\n" );
-    }
-    collectorStats.global.SubmitterAds = submittorNumAds;
-
-    // compute machine information
-    machinesTotal = 0;
-    machinesUnclaimed = 0;
-    machinesClaimed = 0;
-    machinesOwner = 0;
-    startdNumAds = 0;
+	// the engine keeps the submitter and machine totals up to date
+	// as ads come and go, so there is no need to walk the tables.
+	const CollectorTotals & totals = collector.totals();
+	collectorStats.global.SubmitterAds = totals.numSubmittorAds();
+	collectorStats.global.MachineAds = totals.numStartdAds();
+
 	ustatsAccum.Reset( );
-    if (!collector.walkHashTable (STARTD_AD, reportMiniStartdScanFunc)) {
-            dprintf (D_ALWAYS, "Error making collector ad (startd scan) \n");
-    }
-    collectorStats.global.MachineAds = startdNumAds;
+	for (int univ = 0; univ < CONDOR_UNIVERSE_MAX; univ++) {
+		ustatsAccum.accumulate( univ, totals.jobsInUniverse( univ ) );
+	}
 
     // insert values into the ad
-    ad->InsertAttr(ATTR_RUNNING_JOBS,submittorRunningJobs);
-    ad->InsertAttr(ATTR_IDLE_JOBS,submittorIdleJobs);
-    ad->InsertAttr(ATTR_NUM_HOSTS_TOTAL,machinesTotal);
-    ad->InsertAttr(ATTR_NUM_HOSTS_CLAIMED,machinesClaimed);
-    ad->InsertAttr(ATTR_NUM_HOSTS_UNCLAIMED,machinesUnclaimed);
-    ad->InsertAttr(ATTR_NUM_HOSTS_OWNER,machinesOwner);
+    ad->InsertAttr(ATTR_RUNNING_JOBS,totals.runningJobs());
+    ad->InsertAttr(ATTR_IDLE_JOBS,totals.idleJobs());
+    ad->InsertAttr(ATTR_NUM_HOSTS_TOTAL,totals.numMachines());
+    ad->InsertAttr(ATTR_NUM_HOSTS_CLAIMED,totals.numMachines(claimed_state));
+    ad->InsertAttr(ATTR_NUM_HOSTS_UNCLAIMED,totals.numMachines(unclaimed_state));
+    ad->InsertAttr(ATTR_NUM_HOSTS_OWNER,totals.numMachines(owner_state));
 
 	// Accumulate for the monthly
 	ustatsMonthly.setMax( ustatsAccum );
@@ -2211,38 +2510,21 @@ void CollectorDaemon::send_classad_to_sock(int cmd, ClassAd* theAd) {
         Sock* view_sock = e->sock;
         const char* view_name = e->name.c_str();
 
-        bool raw_command = false;
-        if (!view_sock->is_connected()) {
-            // We must have gotten disconnected.  (Or this is the 1st time.)
-            // In case we keep getting disconnected or fail to connect,
-            // and each connection attempt takes a long time, restrict
-            // what fraction of our time we spend trying to reconnect.
-            if (view_sock_timeslice.isTimeToRun()) {
-                dprintf(D_ALWAYS,"Connecting to CONDOR_VIEW_HOST %s\n", view_name);
-
-                // Only run timeslice timer for TCP, since connect on UDP 
-                // is instantaneous.
-                if (view_sock->type() == Stream::reli_sock) {
-	                view_sock_timeslice.setStartTimeNow();
-                }
-                int r = view_coll->connectSock(view_sock,20);
-                if (view_sock->type() == Stream::reli_sock) {
-	                view_sock_timeslice.setFinishTimeNow();
-                }
-
-                if (!view_sock->is_connected() || (!r)) {
-                    dprintf(D_ALWAYS,"Failed to connect to CONDOR_VIEW_HOST %s so not forwarding ad.\n", view_name);
-                    continue;
-                }
-            } else {
-                dprintf(D_FULLDEBUG,"Skipping forwarding of ad to CONDOR_VIEW_HOST %s, because reconnect is delayed for %us.\n", view_name, view_sock_timeslice.getTimeToNextRun());
+        if (view_forward_interval > 0 && view_sock->type() == Stream::reli_sock) {
+            if (cmd == UPDATE_STARTD_AD) {
+                queue_view_forward(*e, theAd);
                 continue;
             }
-        } else if (view_sock->type() == Stream::reli_sock) {
-            // we already did the security handshake the last time
-            // we sent a command on this socket, so just send a
-            // raw command this time to avoid reauthenticating
-            raw_command = true;
+            if (cmd == INVALIDATE_STARTD_ADS) {
+                // the view collector must see the updates before this
+                unparsed_ads_t unparsed;
+                flush_view_forward_queue(*e, unparsed);
+            }
+        }
+
+        bool raw_command = false;
+        if ( ! connect_view_sock(*e, raw_command)) {
+            continue;
         }
 
         // Run timeslice timer if raw_command is false, since this means 
@@ -2292,6 +2574,212 @@ void CollectorDaemon::send_classad_to_sock(int cmd, ClassAd* theAd) {
     }
 }
 
+bool CollectorDaemon::connect_view_sock(vc_entry &e, bool &raw_command)
+{
+    DCCollector* view_coll = e.collector;
+    Sock* view_sock = e.sock;
+    const char* view_name = e.name.c_str();
+
+    raw_command = false;
+    if (!view_sock->is_connected()) {
+        // We must have gotten disconnected.  (Or this is the 1st time.)
+        // In case we keep getting disconnected or fail to connect,
+        // and each connection attempt takes a long time, restrict
+        // what fraction of our time we spend trying to reconnect.
+        if (view_sock_timeslice.isTimeToRun()) {
+            dprintf(D_ALWAYS,"Connecting to CONDOR_VIEW_HOST %s\n", view_name);
+
+            // Only run timeslice timer for TCP, since connect on UDP 
+            // is instantaneous.
+            if (view_sock->type() == Stream::reli_sock) {
+                view_sock_timeslice.setStartTimeNow();
+            }
+            int r = view_coll->connectSock(view_sock,20);
+            if (view_sock->type() == Stream::reli_sock) {
+                view_sock_timeslice.setFinishTimeNow();
+            }
+
+            if (!view_sock->is_connected() || (!r)) {
+                dprintf(D_ALWAYS,"Failed to connect to CONDOR_VIEW_HOST %s so not forwarding ad.\n", view_name);
+                return false;
+            }
+        } else {
+            dprintf(D_FULLDEBUG,"Skipping forwarding of ad to CONDOR_VIEW_HOST %s, because reconnect is delayed for %us.\n", view_name, view_sock_timeslice.getTimeToNextRun());
+            return false;
+        }
+    } else if (view_sock->type() == Stream::reli_sock) {
+        // we already did the security handshake the last time
+        // we sent a command on this socket, so just send a
+        // raw command this time to avoid reauthenticating
+        raw_command = true;
+    }
+    return true;
+}
+
+void CollectorDaemon::queue_view_forward(vc_entry &e, ClassAd *theAd)
+{
+    AdNameHashKey hk;
+    if ( ! makeStartdAdHashKey(hk, theAd)) {
+        return;
+    }
+    MyString key;
+    hk.sprint(key);
+
+        // a slot that is already waiting keeps its place in line
+    if (e.pending.count(key.Value())) {
+        return;
+    }
+
+    while ((int)e.pending_order.size() >= view_forward_queue_size && ! e.pending_order.empty()) {
+        e.pending.erase(e.pending_order.front());
+        e.pending_order.pop_front();
+        ++view_forward_dropped;
+    }
+    e.pending_order.push_back(key.Value());
+    e.pending[key.Value()] = hk;
+}
+
+// Send the startd ads waiting for this view collector, in bulk updates if
+// it is new enough to take them, otherwise one UPDATE_STARTD_AD per ad.
+// The public ads are unparsed only once for all of the view collectors.
+// A slot leaves the queue only once its ad has been sent.
+void CollectorDaemon::flush_view_forward_queue(vc_entry &e, unparsed_ads_t &unparsed)
+{
+    const int max_batch = 1000;
+    const char* view_name = e.name.c_str();
+    Sock* view_sock = e.sock;
+
+        // remove the first n slots from the queue
+    auto pop_pending = [&e](size_t n) {
+        for ( ; n > 0 && ! e.pending_order.empty(); --n) {
+            e.pending.erase(e.pending_order.front());
+            e.pending_order.pop_front();
+        }
+    };
+
+    while ( ! e.pending_order.empty()) {
+        bool raw_command = false;
+        if ( ! connect_view_sock(e, raw_command)) {
+                // keep the ads for when the view collector is back
+            return;
+        }
+
+            // the slots of the batch, each with the number of queue
+            // entries up to and including it
+        std::vector< std::pair<const std::string*, ClassAd*> > batch;
+        std::vector<size_t> through;
+        size_t examined = 0;
+        for (auto kit = e.pending_order.begin();
+             kit != e.pending_order.end() && (int)batch.size() < max_batch; ++kit) {
+            const std::string & key = *kit;
+            AdNameHashKey & hk = e.pending[key];
+            ++examined;
+
+            ClassAd *pubAd = collector.lookup(STARTD_AD, hk);
+            if ( ! pubAd) {
+                continue;
+            }
+            ClassAd *pvtAd = collector.lookup(STARTD_PVT_AD, hk);
+            if (pvtAd && !forwardClaimedPrivateAds) {
+                std::string state;
+                if (pubAd->LookupString(ATTR_STATE, state) && state == "Claimed") {
+                    pvtAd = NULL;
+                }
+            }
+            auto it = unparsed.find(key);
+            if (it == unparsed.end()) {
+                it = unparsed.insert(std::make_pair(key, std::make_pair(0, std::string()))).first;
+                it->second.first = unparseClassAdForPut(*pubAd, PUT_CLASSAD_NO_PRIVATE, NULL, it->second.second);
+            }
+            batch.push_back(std::make_pair(&it->first, pvtAd));
+            through.push_back(examined);
+        }
+        if (batch.empty()) {
+                // none of these slots has an ad any more
+            pop_pending(examined);
+            continue;
+        }
+
+            // only collectors that know about UPDATE_STARTD_AD_BULK get
+            // one, as in DCCollector::canSendBulkUpdate().  before the
+            // first command on a new connection we don't know the
+            // version yet, so send single updates until we do.
+        auto *verinfo = view_sock->get_peer_version();
+        bool bulk = verinfo && verinfo->built_since_version(8, 9, 10);
+
+        if ( ! bulk) {
+            for (size_t ii = 0; ii < batch.size(); ++ii) {
+                if (ii > 0 && ! connect_view_sock(e, raw_command)) {
+                    return;
+                }
+                if ( raw_command == false ) {
+                    view_sock_timeslice.setStartTimeNow();
+                }
+                bool ok = e.collector->startCommand(UPDATE_STARTD_AD, view_sock, 20, NULL, NULL, raw_command);
+                if ( raw_command == false ) {
+                    view_sock_timeslice.setFinishTimeNow();
+                }
+                const std::pair<int, std::string> & pub = unparsed[*batch[ii].first];
+                ok = ok && putUnparsedClassAd(view_sock, pub.first, pub.second.data(), pub.second.size(), 0);
+                if (ok && batch[ii].second) {
+                    ok = putClassAd(view_sock, *batch[ii].second);
+                }
+                if ( ! ok || ! view_sock->end_of_message()) {
+                    dprintf(D_ALWAYS, "Can't forward classad to View Collector %s\n", view_name);
+                    view_sock->close();
+                    pop_pending(ii > 0 ? through[ii-1] : 0);
+                    return;
+                }
+            }
+            pop_pending(examined);
+            dprintf(D_FULLDEBUG, "Forwarded %d ads to View Collector %s\n",
+                    (int)batch.size(), view_name);
+            continue;
+        }
+
+        if ( raw_command == false ) {
+            view_sock_timeslice.setStartTimeNow();
+        }
+        bool ok = e.collector->startCommand(UPDATE_STARTD_AD_BULK, view_sock, 20, NULL, NULL, raw_command);
+        if ( raw_command == false ) {
+            view_sock_timeslice.setFinishTimeNow();
+        }
+
+            // an empty private ad tells the view collector that there
+            // is none to forward for that slot
+        ClassAd no_pvt_ad;
+        view_sock->encode();
+        ok = ok && view_sock->put((int)batch.size());
+        for (auto it = batch.begin(); ok && it != batch.end(); ++it) {
+            const std::pair<int, std::string> & pub = unparsed[*it->first];
+            ok = putUnparsedClassAd(view_sock, pub.first, pub.second.data(), pub.second.size(), 0) &&
+                 putClassAd(view_sock, it->second ? *it->second : no_pvt_ad);
+        }
+        if ( ! ok || ! view_sock->end_of_message()) {
+            dprintf(D_ALWAYS, "Can't forward bulk update of %d ads to View Collector %s\n",
+                    (int)batch.size(), view_name);
+            view_sock->close();
+            return;
+        }
+        pop_pending(examined);
+        dprintf(D_FULLDEBUG, "Forwarded bulk update of %d ads to View Collector %s\n",
+                (int)batch.size(), view_name);
+    }
+}
+
+void CollectorDaemon::flush_view_forward_queues()
+{
+    unparsed_ads_t unparsed;
+    for (vector<vc_entry>::iterator e(vc_list.begin());  e != vc_list.end();  ++e) {
+        flush_view_forward_queue(*e, unparsed);
+    }
+    if (view_forward_dropped) {
+        dprintf(D_ALWAYS, "Dropped %ld ads waiting to be forwarded to View Collectors, "
+                "COLLECTOR_FORWARD_QUEUE_SIZE is %d\n", view_forward_dropped, view_forward_queue_size);
+        view_forward_dropped = 0;
+    }
+}
+
 //  Collector stats on universes
 CollectorUniverseStats::CollectorUniverseStats( void )
 {
@@ -2325,11 +2813,11 @@ CollectorUniverseStats::Reset( void )
 }
 
 void
-CollectorUniverseStats::accumulate(int univ )
+CollectorUniverseStats::accumulate(int univ, int n )
 {
 	if (  ( univ >= 0 ) && ( univ < CONDOR_UNIVERSE_MAX ) ) {
-		perUniverse[univ]++;
-		count++;
+		perUniverse[univ] += n;
+		count += n;
 	}
 }
 
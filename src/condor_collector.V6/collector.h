@@ -22,6 +22,9 @@
 
 #include <vector>
 #include <queue>
+#include <deque>
+#include <map>
+#include <functional>
 
 #include "condor_classad.h"
 #include "totals.h"
@@ -31,6 +34,8 @@
 #include "collector_stats.h"
 #include "dc_collector.h"
 #include "offline_plugin.h"
+#include "query_cache.h"
+#include "subscriptions.h"
 
 //----------------------------------------------------------------
 // Simple job universe stats
@@ -41,7 +46,7 @@ class CollectorUniverseStats {
 	CollectorUniverseStats( CollectorUniverseStats & );
 	~CollectorUniverseStats( void );
 	void Reset( void );
-	void accumulate( int univ );
+	void accumulate( int univ, int n = 1 );
 	int getValue( int univ );
 	int getCount( void ) const;
 	int setMax( CollectorUniverseStats & );
@@ -101,20 +106,32 @@ public:
 	static AdTypes receive_query_public( int );
 	static int receive_invalidation(int, Stream*);
 	static int receive_update(int, Stream*);
+	static int receive_bulk_update(int, Stream*);
+	static int receive_subscription(int, Stream*);
     static int receive_update_expect_ack(int, Stream*);
 
-	static void process_query_public(AdTypes, ClassAd*, List<ClassAd>*);
+	typedef struct query_stats {
+		int matched;
+		int skipped;
+		int limit;
+	} query_stats_t;
+
+		// Find the ads that match the query and pass each one to output()
+		// as it is found, stopping early if output() returns false.
+	static void process_query_public(AdTypes, ClassAd*, const std::function<bool(ClassAd*)> &output, query_stats_t &qstats);
 	static ClassAd * process_global_query( const char *constraint, void *arg );
 	static int select_by_match( ClassAd *cad );
 	static void process_invalidation(AdTypes, ClassAd&, Stream*);
 
-	static int query_scanFunc(ClassAd*);
-	static int invalidation_scanFunc(ClassAd*);
-	static int expiration_scanFunc(ClassAd*);
+		// Return the cached result of this query, or NULL if it is not in
+		// the cache.  key is set to the cache key if the result of the
+		// query may be cached, and cleared otherwise.
+	static std::shared_ptr<const QueryCacheResult> * lookup_query_cache(AdTypes, ClassAd*, Stream*, std::string &key);
+	static bool query_wants_private_ads(AdTypes, Stream*);
+		// Return true if the query asks only for the totals of the startd
+		// ads and can be answered from the totals the engine keeps.
+	static bool is_summary_query(AdTypes, ClassAd*);
 
-	static int reportStartdScanFunc(ClassAd*);
-	static int reportSubmittorScanFunc(ClassAd*);
-	static int reportMiniStartdScanFunc(ClassAd *cad);
 
 	static int sigint_handler(Service*, int);
 	static void unixsigint_handler();
@@ -124,6 +141,7 @@ public:
 
 	static void forward_classad_to_view_collector(int cmd, const char *filterAttr, ClassAd *ad);
 	static void send_classad_to_sock(int cmd, ClassAd* theAd);	
+	static void flush_view_forward_queues();
 
 		// Take an incoming session and forward a token request to the schedd.
 	static int schedd_token_request(int, Stream *stream);
@@ -137,9 +155,16 @@ public:
         std::string name;
         DCCollector* collector;
         Sock* sock;
+        // startd ads waiting for the next bulk update, oldest first.
+        // only the key is kept, so that the ad is looked up when it is
+        // sent and a slot that updated many times is sent once.
+        std::deque<std::string> pending_order;
+        std::map<std::string, AdNameHashKey> pending;
     };
+    typedef std::map<std::string, std::pair<int, std::string> > unparsed_ads_t;
 
     static OfflineCollectorPlugin offline_plugin_;
+	static CollectorSubscriptions subscriptions_;
 
 	static const int HandleQueryInProcNever = 0x0000;
 	static const int HandleQueryInProcSmallTable = 0x0001;
@@ -153,9 +178,27 @@ public:
 		Stream *sock;
 		AdTypes whichAds;
 		bool is_locate;
+		bool is_summary;
 		char subsys[15];
+		std::shared_ptr<const QueryCacheResult> *cached_result;
+		// when set, the result is added to the query cache under this key,
+		// directly by a query handled in-process, or by way of cache_pipe
+		// by a forked worker
+		std::string *cache_key;
+		unsigned long cache_generation;
+		int cache_pipe;
 	} pending_query_entry_t;
 
+	// the result of a query being read back from a forked worker
+	struct query_cache_fill {
+		std::string key;
+		unsigned long generation;
+		std::string result;
+	};
+	static std::map<int, query_cache_fill> query_cache_fills; // by pipe
+	static int query_cache_pipe_handler(int pipe_end);
+	static void fill_query_cache(pending_query_entry_t *query_entry, QueryCacheResult *result);
+
 	static std::queue<pending_query_entry_t *> query_queue_high_prio;
 	static std::queue<pending_query_entry_t *> query_queue_low_prio;
 	static int ReaperId;
@@ -175,29 +218,23 @@ public:
 protected:
 	static CollectorStats collectorStats;
 	static CollectorEngine collector;
+	static QueryCache query_cache;
 	static Timeslice view_sock_timeslice;
     static std::vector<vc_entry> vc_list;
+	static int view_forward_interval;	// batch startd ads for this long, 0 to send each at once
+	static int view_forward_queue_size;	// max startd ads waiting per view collector
+	static int view_forward_timer_id;
+	static long view_forward_dropped;
+
+	static bool connect_view_sock(vc_entry &e, bool &raw_command);
+	static void queue_view_forward(vc_entry &e, ClassAd *ad);
+	static void flush_view_forward_queue(vc_entry &e, unparsed_ads_t &unparsed);
 
 	static int HandleQueryInProcPolicy;	// one of above HandleQueryInProc* constants
 	static int ClientTimeout;
 	static int QueryTimeout;
 	static char* CollectorName;
 
-	static ClassAd* __query__;
-	static List<ClassAd>* __ClassAdResultList__;
-	static int __numAds__;
-	static int __resultLimit__;
-	static int __failed__;
-	static std::string __adType__;
-	static ExprTree *__filter__;
-
-	static TrackTotals* normalTotals;
-	static int submittorRunningJobs;
-	static int submittorIdleJobs;
-	static int submittorNumAds;
-
-	static int machinesTotal,machinesUnclaimed,machinesClaimed,machinesOwner;
-	static int startdNumAds;
 
 	static CollectorUniverseStats ustatsAccum;
 	static CollectorUniverseStats ustatsMonthly;
@@ -215,7 +252,6 @@ protected:
 
 private:
 
-	static int setAttrLastHeardFrom( ClassAd* cad, unsigned long time );
 
 };
 
@@ -30,6 +30,9 @@ extern "C" void event_mgr (void);
 #include "condor_attributes.h"
 #include "condor_daemon_core.h"
 #include "classad_merge.h"
+#include "condor_threads.h"
+
+#include <atomic>
 
 //-------------------------------------------------------------
 
@@ -38,7 +41,6 @@ extern "C" void event_mgr (void);
 
 static void killHashTable (CollectorHashTable &);
 static int killGenericHashTable(CollectorHashTable *);
-static void purgeHashTable (CollectorHashTable &);
 
 int 	engine_clientTimeoutHandler (Service *);
 int 	engine_housekeepingHandler  (Service *);
@@ -72,6 +74,7 @@ CollectorEngine::CollectorEngine (CollectorStats *stats ) :
 	collectorStats = stats;
 	m_collector_requirements = NULL;
 	m_get_ad_options = 0;
+	m_anyAdSetGeneration = 0;
 }
 
 
@@ -146,6 +149,8 @@ scheduleHousekeeper (int timeout)
 
 	m_forwardFilteringEnabled = param_boolean( "COLLECTOR_FORWARD_FILTERING", false );
 
+	m_sharedMachineAds.config();
+
 	// cancel outstanding housekeeping requests
 	if (housekeeperTimerID != -1)
 	{
@@ -156,8 +161,12 @@ scheduleHousekeeper (int timeout)
 	if (timeout < 0)
 		return 0;
 
-	// set to new timeout interval
-	machineUpdateInterval = timeout;
+	// set to new timeout interval, ads that use it as their lifetime
+	// now expire at a different time
+	if (machineUpdateInterval != timeout) {
+		machineUpdateInterval = timeout;
+		rescheduleAllExpirations();
+	}
 
 	m_forwardInterval = param_integer("COLLECTOR_FORWARD_INTERVAL", machineUpdateInterval / 3, 0);
 
@@ -232,6 +241,7 @@ CollectorEngine::invalidateAds(AdTypes adType, ClassAd &query)
 						"\t\tError while removing ad: \"%s\"\n",
 						hkString.Value());
 			} else {
+				adRemoved(*table, *ad);
 				dprintf(D_ALWAYS,
 						"\t\t**** Invalidating ad: \"%s\"\n",
 						hkString.Value());
@@ -244,27 +254,16 @@ CollectorEngine::invalidateAds(AdTypes adType, ClassAd &query)
 	return count;
 }
 
-int (*CollectorEngine::genericTableScanFunction)(ClassAd *) = NULL;
-
-int CollectorEngine::
-genericTableWalker(CollectorHashTable *cht)
-{
-	ASSERT(genericTableScanFunction != NULL);
-	return cht->walk(genericTableScanFunction);
-}
-
 int CollectorEngine::
-walkGenericTables(int (*scanFunction)(ClassAd *))
+walkGenericTables(const std::function<int(ClassAd *)> &scanFunction)
 {
-	int ret;
-	genericTableScanFunction = scanFunction;
-	ret = GenericAds.walk(genericTableWalker);
-	genericTableScanFunction = NULL;
-	return ret;
+	return GenericAds.walk([&scanFunction](CollectorHashTable *cht) {
+		return cht->walk(scanFunction);
+	});
 }
 
 int CollectorEngine::
-walkHashTable (AdTypes adType, int (*scanFunction)(ClassAd *))
+walkHashTable (AdTypes adType, const std::function<int(ClassAd *)> &scanFunction)
 {
 	//int retval = 1;
 
@@ -345,11 +344,114 @@ collector_runtime_probe CollectorEngine_rucc_other_runtime;
 #endif
 
 
+static void
+insertAuthenticatedIdentity(ClassAd *clientAd, Sock *sock)
+{
+	const char* authn_user = sock->getFullyQualifiedUser();
+	if (authn_user) {
+		clientAd->Assign(ATTR_AUTHENTICATED_IDENTITY, authn_user);
+		clientAd->Assign(ATTR_AUTHENTICATION_METHOD, sock->getAuthenticationMethodUsed());
+	} else {
+		// remove it from the ad if it's not authenticated.
+		clientAd->Delete(ATTR_AUTHENTICATED_IDENTITY);
+		clientAd->Delete(ATTR_AUTHENTICATION_METHOD);
+	}
+}
+
+// The number of updates being read from their sockets.  This is changed
+// by worker threads outside of the lock, so it is atomic.
+static std::atomic<int> ingest_reading(0);
+collector_runtime_probe CollectorEngine_ingest_read_runtime;
+collector_runtime_probe CollectorEngine_ingest_apply_runtime;
+
+// Read all of the ads of an update message into memory, without parsing
+// them.  This is only socket I/O and decryption, so when there is a
+// thread pool (THREAD_WORKER_POOL_SIZE) it is done outside of the
+// DaemonCore lock, and many updates can be read at the same time.  The
+// parsing, which uses the shared ClassAd cache, and the changes to the
+// tables are done by the caller with the lock held, one update at a time.
+// Since DaemonCore never services a socket in two threads at once, the
+// updates from one connection are still applied in the order they were sent.
+bool CollectorEngine::
+readUpdateMessage (int command, Sock *sock, std::vector<UpdateAdLines> &ads)
+{
+	int num_ads = 1;
+	int num_required = 1;
+	bool ok = true;
+	bool eom_ok = true;
+
+	ads.clear();
+
+	double begin = condor_gettimestamp_double();
+	++ingest_reading;
+	collectorStats->global.UpdatesReading = ingest_reading;
+
+	bool ep = CondorThreads::enable_parallel(true);
+	{
+		sock->decode();
+		switch (command) {
+		case UPDATE_STARTD_AD_BULK:
+				// a count, then the public and private ad of each slot
+			if ( ! sock->get(num_ads) || num_ads < 0 || num_ads > 100000) {
+				ok = false;
+				num_ads = 0;
+			}
+			num_ads *= 2;
+			num_required = num_ads;
+			break;
+		case UPDATE_STARTD_AD:
+		case UPDATE_STARTD_AD_WITH_ACK:
+		case UPDATE_STARTD_AD_DELTA:
+				// the private ad that follows is optional
+			num_ads = 2;
+			break;
+		}
+
+		ads.resize(num_ads);
+		int num_read = 0;
+		while (ok && num_read < num_ads) {
+			UpdateAdLines & ad = ads[num_read];
+			if ( ! getClassAdLines(sock, ad.lines, ad.num_lines, m_get_ad_options & GET_CLASSAD_NO_TYPES)) {
+				break;
+			}
+			++num_read;
+		}
+		ok = ok && (num_read >= num_required);
+		ads.resize(num_read);
+
+		eom_ok = sock->end_of_message();
+	}
+	CondorThreads::enable_parallel(ep);
+	--ingest_reading;
+		// back under the lock, so the stat can be set from the counter
+		// without racing the other readers
+	collectorStats->global.UpdatesReading = ingest_reading;
+
+	CollectorEngine_ingest_read_runtime.Add(condor_gettimestamp_double() - begin);
+
+	if ( ! ok) {
+		dprintf (D_ALWAYS,"Command %d on Sock not followed by ClassAd (or timeout occured)\n",
+				command);
+	} else if ( ! eom_ok) {
+		dprintf(D_FULLDEBUG,"Warning: Command %d; maybe shedding data on eom\n",
+				 command);
+	}
+	return ok;
+}
+
+bool CollectorEngine::
+parseUpdateAd (const UpdateAdLines &ad_lines, ClassAd &ad)
+{
+	return parseClassAdLines(ad_lines.lines.data(), ad_lines.lines.size(), ad_lines.num_lines, ad, m_get_ad_options);
+}
+
 ClassAd *CollectorEngine::
 collect (int command, Sock *sock, const condor_sockaddr& from, int &insert)
 {
 	ClassAd	*clientAd;
+	ClassAd	*pvtAd = NULL;
 	ClassAd	*rval;
+	std::vector<UpdateAdLines> ads;
 
 #ifdef PROFILE_RECEIVE_UPDATE
 	_condor_auto_accum_runtime<collector_runtime_probe> rt(CollectorEngine_ruc_runtime);
@@ -361,18 +463,30 @@ collect (int command, Sock *sock, const condor_sockaddr& from, int &insert)
 		// is ready to read.
 	sock->timeout(1);
 
+	if ( ! readUpdateMessage(command, sock, ads)) {
+		return 0;
+	}
+
+	_condor_auto_accum_runtime<collector_runtime_probe> apply_rt(CollectorEngine_ingest_apply_runtime);
+
 	// get the ad
 	clientAd = new ClassAd;
 	if (!clientAd) return 0;
 
-	if( !getClassAdEx(sock, *clientAd, m_get_ad_options) )
+	if ( ! parseUpdateAd(ads[0], *clientAd))
 	{
 		dprintf (D_ALWAYS,"Command %d on Sock not followed by ClassAd (or timeout occured)\n",
 				command);
 		delete clientAd;
-		sock->end_of_message();
 		return 0;
 	}
+	if (ads.size() > 1) {
+		pvtAd = new ClassAd;
+		if ( ! parseUpdateAd(ads[1], *pvtAd)) {
+			delete pvtAd;
+			pvtAd = NULL;
+		}
+	}
 
 #ifdef PROFILE_RECEIVE_UPDATE
 	double delta_time = rt.tick(rt_last);
@@ -380,40 +494,110 @@ collect (int command, Sock *sock, const condor_sockaddr& from, int &insert)
 #endif
 
 	// insert the authenticated user into the ad itself
-	const char* authn_user = sock->getFullyQualifiedUser();
-	if (authn_user) {
-		clientAd->Assign(ATTR_AUTHENTICATED_IDENTITY, authn_user);
-		clientAd->Assign(ATTR_AUTHENTICATION_METHOD, sock->getAuthenticationMethodUsed());
-	} else {
-		// remove it from the ad if it's not authenticated.
-		clientAd->Delete(ATTR_AUTHENTICATED_IDENTITY);
-		clientAd->Delete(ATTR_AUTHENTICATION_METHOD);
-	}
+	insertAuthenticatedIdentity(clientAd, sock);
 
 #ifdef PROFILE_RECEIVE_UPDATE
 	CollectorEngine_ruc_authid_runtime.Add(rt.tick(rt_last));
 #endif
 
-	rval = collect(command, clientAd, from, insert, sock);
+	rval = collect(command, clientAd, from, insert, sock, &pvtAd);
 #ifdef PROFILE_RECEIVE_UPDATE
 	CollectorEngine_ruc_collect_runtime.Add(rt.tick(rt_last));
 #endif
 
-	// Don't leak the ad on error!
+	// Don't leak the ads on error, or the private ad if it wasn't wanted
 	if ( ! rval ) {
 		delete clientAd;
 	}
+	delete pvtAd;
 
-	// get the end_of_message()
-	if (!sock->end_of_message())
-	{
-		dprintf(D_FULLDEBUG,"Warning: Command %d; maybe shedding data on eom\n",
-				 command);
-	}
-	
 	return rval;
 }
 
+bool CollectorEngine::
+collectBulk (int command, Sock *sock, const condor_sockaddr& from, std::vector<ClassAd*> &updated)
+{
+	int num_ads = 0;
+	std::vector< std::pair<ClassAd*, ClassAd*> > ads;
+	bool ok = true;
+
+		// Avoid lengthy blocking on communication with our peer.
+	sock->timeout(1);
+
+		// read everything before we touch the tables, so that a
+		// communication error can't leave us with only some of the slots
+	std::vector<UpdateAdLines> ad_lines;
+	if ( ! readUpdateMessage(command, sock, ad_lines)) {
+		return false;
+	}
+
+	_condor_auto_accum_runtime<collector_runtime_probe> apply_rt(CollectorEngine_ingest_apply_runtime);
+
+	num_ads = (int)ad_lines.size() / 2;
+	for (int i = 0; ok && i < num_ads; ++i) {
+		ClassAd *pubAd = new ClassAd;
+		ClassAd *pvtAd = new ClassAd;
+		ads.push_back(std::make_pair(pubAd, pvtAd));
+		if ( ! parseUpdateAd(ad_lines[2*i], *pubAd) ||
+			 ! parseUpdateAd(ad_lines[2*i+1], *pvtAd)) {
+			dprintf (D_ALWAYS,"Command %d: failed to read ad %d of %d\n",
+					 command, i, num_ads);
+			ok = false;
+		}
+	}
+
+	std::vector<AdNameHashKey> keys(ads.size());
+	for (size_t i = 0; ok && i < ads.size(); ++i) {
+		insertAuthenticatedIdentity(ads[i].first, sock);
+		if ( ! ValidateClassAd(UPDATE_STARTD_AD, ads[i].first, sock)) {
+			ok = false;
+		} else if ( ! makeStartdAdHashKey(keys[i], ads[i].first)) {
+			dprintf (D_ALWAYS, "Could not make hashkey --- ignoring bulk update\n");
+			ok = false;
+		}
+	}
+
+	if ( ! ok) {
+		for (auto it = ads.begin(); it != ads.end(); ++it) {
+			delete it->first;
+			delete it->second;
+		}
+		return false;
+	}
+
+	HashString hashString;
+	int insert;
+	for (size_t i = 0; i < ads.size(); ++i) {
+		ClassAd *pubAd = ads[i].first;
+		ClassAd *pvtAd = ads[i].second;
+		hashString.Build( keys[i] );
+
+			// every ad was checked above, and updateClassAd() stores any
+			// ad it is given, so no slot can be left out from here on.
+		ClassAd *retVal = updateClassAd (StartdAds, "StartdAd     ", "Start",
+										 pubAd, keys[i], hashString, insert, from );
+		ASSERT( retVal );
+		updated.push_back(retVal);
+
+			// an empty private ad means the sender had none to give us,
+			// as when a collector forwards a claimed slot to a view collector
+		if (pvtAd->size() == 0) {
+			delete pvtAd;
+			continue;
+		}
+
+			// same fix ups as for a single UPDATE_STARTD_AD
+		SetMyTypeName( *pvtAd, STARTD_ADTYPE );
+		CopyAttribute( ATTR_MY_ADDRESS, *pvtAd, *retVal );
+		CopyAttribute( ATTR_NAME, *pvtAd, *retVal );
+		(void) updateClassAd (StartdPrivateAds, "StartdPvtAd  ",
+							  "StartdPvt", pvtAd, keys[i], hashString, insert,
+							  from );
+	}
+
+	return true;
+}
+
 bool CollectorEngine::ValidateClassAd(int command,ClassAd *clientAd,Sock *sock)
 {
 
@@ -537,7 +721,7 @@ bool CollectorEngine::ValidateClassAd(int command,ClassAd *clientAd,Sock *sock)
 bool   last_updateClassAd_was_insert;
 
 ClassAd *CollectorEngine::
-collect (int command,ClassAd *clientAd,const condor_sockaddr& from,int &insert,Sock *sock)
+collect (int command,ClassAd *clientAd,const condor_sockaddr& from,int &insert,Sock *sock,ClassAd **givenPvtAd)
 {
 	ClassAd		*retVal;
 	ClassAd		*pvtAd;
@@ -555,7 +739,9 @@ collect (int command,ClassAd *clientAd,const condor_sockaddr& from,int &insert,S
 		repeatStartdAds = param_integer("COLLECTOR_REPEAT_STARTD_ADS",0);
 	}
 
-	if( !ValidateClassAd(command,clientAd,sock) ) {
+		// a delta ad can only be validated once it is combined with the
+		// ad it applies to, so applyDeltaClassAd() does that itself.
+	if( command != UPDATE_STARTD_AD_DELTA && !ValidateClassAd(command,clientAd,sock) ) {
 	    insert = -4;
 		return NULL;
 	}
@@ -569,7 +755,8 @@ collect (int command,ClassAd *clientAd,const condor_sockaddr& from,int &insert,S
 	{
 	  case UPDATE_STARTD_AD:
 	  case UPDATE_STARTD_AD_WITH_ACK:
-		if ( repeatStartdAds > 0 ) {
+	  case UPDATE_STARTD_AD_DELTA:
+		if ( repeatStartdAds > 0 && command != UPDATE_STARTD_AD_DELTA ) {
 			clientAdToRepeat = new ClassAd(*clientAd);
 		}
 		if (!makeStartdAdHashKey (hk, clientAd))
@@ -585,8 +772,18 @@ collect (int command,ClassAd *clientAd,const condor_sockaddr& from,int &insert,S
 		CollectorEngine_rucc_makeHashKey_runtime.Add(rt.tick(rt_last));
 #endif
 
-		retVal=updateClassAd (StartdAds, "StartdAd     ", "Start",
-							  clientAd, hk, hashString, insert, from );
+		if (command == UPDATE_STARTD_AD_DELTA) {
+			retVal=applyDeltaClassAd (StartdAds, "StartdAd     ", "Start",
+									  clientAd, hk, hashString, insert, sock );
+			if ( ! retVal) {
+					// the sender must resend the full ad; the private
+					// ad that follows is shed by our caller.
+				break;
+			}
+		} else {
+			retVal=updateClassAd (StartdAds, "StartdAd     ", "Start",
+								  clientAd, hk, hashString, insert, from );
+		}
 
 #ifdef PROFILE_RECEIVE_UPDATE
 		if (last_updateClassAd_was_insert) { CollectorEngine_rucc_insertAd_runtime.Add(rt.tick(rt_last));
@@ -594,21 +791,34 @@ collect (int command,ClassAd *clientAd,const condor_sockaddr& from,int &insert,S
 #endif
 
 		// if we want to store private ads
-		if (!sock)
+		if (!sock && !givenPvtAd)
 		{
 			dprintf (D_ALWAYS, "Want private ads, but no socket given!\n");
 			break;
 		}
 		else
 		{
-			if (!(pvtAd = new ClassAd))
+			if (givenPvtAd)
 			{
-				EXCEPT ("Memory error!");
+					// already read from the sock by the caller
+				pvtAd = *givenPvtAd;
+				*givenPvtAd = NULL;
 			}
-			if( !getClassAdEx(sock, *pvtAd, m_get_ad_options) )
+			else
+			{
+				if (!(pvtAd = new ClassAd))
+				{
+					EXCEPT ("Memory error!");
+				}
+				if( !getClassAdEx(sock, *pvtAd, m_get_ad_options) )
+				{
+					delete pvtAd;
+					pvtAd = NULL;
+				}
+			}
+			if ( ! pvtAd)
 			{
 				dprintf(D_FULLDEBUG,"\t(Could not get startd's private ad)\n");
-				delete pvtAd;
 				break;
 			}
 
@@ -904,7 +1114,7 @@ collect (int command,ClassAd *clientAd,const condor_sockaddr& from,int &insert,S
 	}
 
 #ifdef PROFILE_RECEIVE_UPDATE
-	if (command != UPDATE_STARTD_AD && command != UPDATE_STARTD_AD_WITH_ACK) {
+	if (command != UPDATE_STARTD_AD && command != UPDATE_STARTD_AD_WITH_ACK && command != UPDATE_STARTD_AD_DELTA) {
 		CollectorEngine_rucc_other_runtime.Add(rt.tick(rt_last));
 	}
 #endif
@@ -956,6 +1166,7 @@ int CollectorEngine::remove (AdTypes t_AddType, const ClassAd & c_query, bool *q
 			{
 				hk.sprint( hkString );
 				iRet = !table->remove(hk);
+				adRemoved(*table, *pAd);
 				dprintf (D_ALWAYS,"\t\t**** Removed(%d) ad(s): \"%s\"\n", iRet, hkString.Value() );
 				delete pAd;
 			}
@@ -981,6 +1192,8 @@ int CollectorEngine::expire( AdTypes adType, const ClassAd & query, bool * query
                 cAd->Assign( ATTR_LAST_HEARD_FROM, 1 );
                 
                 if( CollectorDaemon::offline_plugin_.expire( * cAd ) == true ) {
+                    scheduleExpiration( *hTable, cAd );
+                    m_totals.recount( *cAd );
                     return rVal;
                 }
                 
@@ -989,6 +1202,7 @@ int CollectorEngine::expire( AdTypes adType, const ClassAd & query, bool * query
                     dprintf( D_ALWAYS, "\t\t Error removing ad\n" );
                     return 0;
                 }
+                adRemoved( *hTable, *cAd );
                 rVal = (! rVal);
                 
                 MyString hkString;
@@ -1011,9 +1225,54 @@ remove (AdTypes adType, AdNameHashKey &hk)
 	if (!LookupByAdType(adType, table, func)) {
 		return 0;
 	}
+	ClassAd *ad = NULL;
+	if (table->lookup(hk, ad) == -1) {
+		return 0;
+	}
+	adRemoved(*table, *ad);
 	return !table->remove(hk);
 }
 
+void CollectorEngine::
+adRemoved (const CollectorHashTable &table, ClassAd &ad) const
+{
+	adSetChanged(table);
+	unscheduleExpiration(&ad);
+
+	// private ads share the key of the public ad, so only tell subscribers
+	// about the public one.
+	if (&table != &StartdPrivateAds) {
+		CollectorDaemon::subscriptions_.remove(ad);
+	}
+
+	m_sharedMachineAds.release(ad);
+	m_totals.remove(ad);
+}
+
+void CollectorEngine::
+countAd (const CollectorHashTable &table, const ClassAd &ad) const
+{
+	if (&table == &StartdAds) {
+		m_totals.addStartd(ad);
+	} else if (&table == &SubmittorAds) {
+		m_totals.addSubmittor(ad);
+	}
+}
+
+unsigned long CollectorEngine::
+adSetGeneration (AdTypes adType)
+{
+	if (ANY_AD == adType || GENERIC_AD == adType) {
+		return m_anyAdSetGeneration;
+	}
+	CollectorHashTable *table;
+	CollectorEngine::HashFunc func;
+	if (!LookupByAdType(adType, table, func)) {
+		return m_anyAdSetGeneration;
+	}
+	return m_adSetGenerations[table];
+}
+
 void CollectorEngine::
 identifySelfAd(ClassAd * ad)
 {
@@ -1068,6 +1327,8 @@ updateClassAd (CollectorHashTable &hashTable,
 		{
 			EXCEPT ("Error inserting ad (out of memory)");
 		}
+		adSetChanged(hashTable);
+		scheduleExpiration(hashTable, new_ad);
 		
 		insert = 1;
 		
@@ -1075,6 +1336,11 @@ updateClassAd (CollectorHashTable &hashTable,
 			new_ad->Assign( ATTR_LAST_FORWARDED, (int)time(NULL) );
 		}
 
+		if (&hashTable == &StartdAds) {
+			m_sharedMachineAds.share(*new_ad);
+		}
+		countAd(hashTable, *new_ad);
+
 		return new_ad;
 	}
 	else
@@ -1094,6 +1360,9 @@ updateClassAd (CollectorHashTable &hashTable,
 		if (hashTable.insert(hk, new_ad) == -1) {
 			EXCEPT( "Error inserting ad" );
 		}
+		unscheduleExpiration(old_ad);
+		scheduleExpiration(hashTable, new_ad);
+		adSetChanged(hashTable);
 
 		if ( m_forwardFilteringEnabled && ( strcmp( label, "Start" ) == 0 || strcmp( label, "StartdPvt" ) == 0 || strcmp( label, "Submittor" ) == 0 ) ) {
 			bool forward = false;
@@ -1124,8 +1393,15 @@ updateClassAd (CollectorHashTable &hashTable,
 
 		if (isSelfAd(old_ad)) { __self_ad__ = new_ad; }
 
+		m_sharedMachineAds.release(*old_ad);
+		m_totals.remove(*old_ad);
 		delete old_ad;
 
+		if (&hashTable == &StartdAds) {
+			m_sharedMachineAds.share(*new_ad);
+		}
+		countAd(hashTable, *new_ad);
+
 		insert = 0;
 		return new_ad;
 	}
@@ -1168,11 +1444,118 @@ mergeClassAd (CollectorHashTable &hashTable,
 
 		// Now, finally, merge the new ClassAd into the old one
 		MergeClassAds(old_ad,&new_ad_copy,true);
+		scheduleExpiration(hashTable, old_ad);
+		adSetChanged(hashTable);
+		m_totals.recount(*old_ad);
 	}
 	delete new_ad;
 	return old_ad;
 }
 
+ClassAd * CollectorEngine::
+applyDeltaClassAd (CollectorHashTable &hashTable,
+				   const char *adType,
+				   const char *label,
+				   ClassAd *delta_ad,
+				   AdNameHashKey &hk,
+				   const MyString &hashString,
+				   int  &insert,
+				   Sock *sock )
+{
+	ClassAd		*old_ad = NULL;
+
+	insert = -5;
+
+	if ( hashTable.lookup (hk, old_ad) == -1) {
+		dprintf (D_ALWAYS, "%s: Delta update for ** \"%s\" has no base ad; "
+				 "requesting full update.\n", adType, hashString.Value() );
+			// We should _NOT_ delete delta_ad if we return NULL
+			// because our caller will delete it in that case.
+		return NULL;
+	}
+
+		// The delta must be relative to the ad we have, otherwise we
+		// have missed an update (or the startd restarted) in between.
+	long long base_seq = -1, old_seq = -2;
+	long long new_start = 0, old_start = 0;
+	delta_ad->LookupInteger(ATTR_UPDATE_DELTA_BASE, base_seq);
+	old_ad->LookupInteger(ATTR_UPDATE_SEQUENCE_NUMBER, old_seq);
+	delta_ad->LookupInteger(ATTR_DAEMON_START_TIME, new_start);
+	old_ad->LookupInteger(ATTR_DAEMON_START_TIME, old_start);
+	if ( base_seq != old_seq || new_start != old_start ) {
+		dprintf (D_ALWAYS, "%s: Delta update for ** \"%s\" is against "
+				 "sequence %lld but we have %lld; requesting full update.\n",
+				 adType, hashString.Value(), base_seq, old_seq );
+		return NULL;
+	}
+
+		// Validate the ad as it will look once the delta is applied.
+	std::string removed;
+	delta_ad->LookupString(ATTR_UPDATE_DELTA_REMOVED, removed);
+	delta_ad->Delete(ATTR_UPDATE_DELTA_REMOVED);
+	delta_ad->Delete(ATTR_UPDATE_DELTA_BASE);
+	delta_ad->ChainToAd(old_ad);
+	bool valid = ValidateClassAd(UPDATE_STARTD_AD, delta_ad, sock);
+	delta_ad->Unchain();
+	if ( ! valid) {
+		insert = -4;
+		return NULL;
+	}
+
+	dprintf (D_FULLDEBUG, "%s: Applying delta of %d attributes to ... \"%s\"\n",
+			 adType, delta_ad->size(), hashString.Value() );
+
+	collectorStats->update( label, old_ad, delta_ad );
+
+		// deleting an attribute of a chained ad would leave it
+		// as undefined, so put the shared attributes back first.
+	m_sharedMachineAds.unshare(*old_ad);
+
+	bool forward = false;
+	int last_forwarded = 0;
+	if ( m_forwardFilteringEnabled ) {
+		old_ad->LookupInteger( ATTR_LAST_FORWARDED, last_forwarded );
+		if ( last_forwarded + m_forwardInterval < time(NULL) ) {
+			forward = true;
+		} else {
+			const char *attr;
+			m_forwardWatchList.rewind();
+			while ( (attr = m_forwardWatchList.next()) ) {
+				if ( delta_ad->Lookup(attr) ) {
+					forward = true;
+					break;
+				}
+			}
+		}
+	}
+
+	StringList removed_list(removed.c_str(), ",");
+	const char *attr;
+	removed_list.rewind();
+	while ( (attr = removed_list.next()) ) {
+		old_ad->Delete(attr);
+		if ( m_forwardFilteringEnabled && m_forwardWatchList.contains_anycase(attr) ) {
+			forward = true;
+		}
+	}
+
+	old_ad->Update(*delta_ad);
+	old_ad->Assign(ATTR_LAST_HEARD_FROM, (int)time(NULL));
+	m_sharedMachineAds.share(*old_ad);
+	scheduleExpiration(hashTable, old_ad);
+	adSetChanged(hashTable);
+	m_totals.recount(*old_ad);
+
+	if ( m_forwardFilteringEnabled ) {
+		old_ad->Assign( ATTR_SHOULD_FORWARD, forward );
+		old_ad->Assign( ATTR_LAST_FORWARDED, forward ? (int)time(NULL) : last_forwarded );
+	}
+
+	delete delta_ad;
+	insert = 0;
+	return old_ad;
+}
+
 
 void
 CollectorEngine::
@@ -1191,49 +1574,50 @@ housekeeper()
 	dprintf (D_ALWAYS, "Housekeeper:  Ready to clean old ads\n");
 
 	dprintf (D_ALWAYS, "\tCleaning StartdAds ...\n");
-	cleanHashTable (StartdAds, now, makeStartdAdHashKey);
+	expireDueAds (StartdAds, now, makeStartdAdHashKey);
 
 	dprintf (D_ALWAYS, "\tCleaning StartdPrivateAds ...\n");
-	cleanHashTable (StartdPrivateAds, now, makeStartdAdHashKey);
+	expireDueAds (StartdPrivateAds, now, makeStartdAdHashKey);
+	m_sharedMachineAds.purge();
 
 	dprintf (D_ALWAYS, "\tCleaning ScheddAds ...\n");
-	cleanHashTable (ScheddAds, now, makeScheddAdHashKey);
+	expireDueAds (ScheddAds, now, makeScheddAdHashKey);
 
 	dprintf (D_ALWAYS, "\tCleaning SubmittorAds ...\n");
-	cleanHashTable (SubmittorAds, now, makeScheddAdHashKey);
+	expireDueAds (SubmittorAds, now, makeScheddAdHashKey);
 
 	dprintf (D_ALWAYS, "\tCleaning LicenseAds ...\n");
-	cleanHashTable (LicenseAds, now, makeLicenseAdHashKey);
+	expireDueAds (LicenseAds, now, makeLicenseAdHashKey);
 
 	dprintf (D_ALWAYS, "\tCleaning MasterAds ...\n");
-	cleanHashTable (MasterAds, now, makeMasterAdHashKey);
+	expireDueAds (MasterAds, now, makeMasterAdHashKey);
 
 	dprintf (D_ALWAYS, "\tCleaning CkptServerAds ...\n");
-	cleanHashTable (CkptServerAds, now, makeCkptSrvrAdHashKey);
+	expireDueAds (CkptServerAds, now, makeCkptSrvrAdHashKey);
 
 	dprintf (D_ALWAYS, "\tCleaning CollectorAds ...\n");
-	cleanHashTable (CollectorAds, now, makeCollectorAdHashKey);
+	expireDueAds (CollectorAds, now, makeCollectorAdHashKey);
 
 	dprintf (D_ALWAYS, "\tCleaning StorageAds ...\n");
-	cleanHashTable (StorageAds, now, makeStorageAdHashKey);
+	expireDueAds (StorageAds, now, makeStorageAdHashKey);
 
 	dprintf (D_ALWAYS, "\tCleaning AccountingAds ...\n");
-	cleanHashTable (AccountingAds, now, makeAccountingAdHashKey);
+	expireDueAds (AccountingAds, now, makeAccountingAdHashKey);
 
 	dprintf (D_ALWAYS, "\tCleaning NegotiatorAds ...\n");
-	cleanHashTable (NegotiatorAds, now, makeNegotiatorAdHashKey);
+	expireDueAds (NegotiatorAds, now, makeNegotiatorAdHashKey);
 
 	dprintf (D_ALWAYS, "\tCleaning HadAds ...\n");
-	cleanHashTable (HadAds, now, makeHadAdHashKey);
+	expireDueAds (HadAds, now, makeHadAdHashKey);
 
     dprintf (D_ALWAYS, "\tCleaning GridAds ...\n");
-	cleanHashTable (GridAds, now, makeGridAdHashKey);
+	expireDueAds (GridAds, now, makeGridAdHashKey);
 
 	dprintf (D_ALWAYS, "\tCleaning Generic Ads ...\n");
 	CollectorHashTable *cht;
 	GenericAds.startIterations();
 	while (GenericAds.iterate(cht)) {
-		cleanHashTable (*cht, now, makeGenericAdHashKey);
+		expireDueAds (*cht, now, makeGenericAdHashKey);
 	}
 
 	// cron manager
@@ -1246,57 +1630,192 @@ void CollectorEngine::
 cleanHashTable (CollectorHashTable &hashTable, time_t now, HashFunc makeKey) const
 {
 	ClassAd  *ad;
+
+	hashTable.startIterations ();
+	while (hashTable.iterate (ad))
+	{
+		expireAd (hashTable, ad, now, makeKey);
+	}
+}
+
+void CollectorEngine::
+expireDueAds (CollectorHashTable &hashTable, time_t now, HashFunc makeKey) const
+{
+	auto q = m_expirationQueues.find(&hashTable);
+	if (q == m_expirationQueues.end()) {
+		return;
+	}
+
+	// the queue is ordered by the time each ad was due to expire when it
+	// was last scheduled.  an ad that has been heard from since then is
+	// just put back in the queue at its new time.
+	std::set<std::pair<time_t, ClassAd *> > &queue = q->second;
+	while ( ! queue.empty() && queue.begin()->first < now) {
+		ClassAd *ad = queue.begin()->second;
+		expireAd (hashTable, ad, now, makeKey);
+	}
+}
+
+bool CollectorEngine::
+adExpirationTime (const ClassAd *ad, time_t &when) const
+{
+	int timeStamp;
+	int max_lifetime;
+
+	if (!ad->LookupInteger (ATTR_LAST_HEARD_FROM, timeStamp)) {
+		return false;
+	}
+	if( !ad->LookupInteger( ATTR_CLASSAD_LIFETIME, max_lifetime ) ) {
+		max_lifetime = machineUpdateInterval;
+	}
+	when = (time_t)timeStamp + max_lifetime;
+	return true;
+}
+
+void CollectorEngine::
+scheduleExpiration (CollectorHashTable &hashTable, ClassAd *ad, time_t not_before) const
+{
+	unscheduleExpiration (ad);
+
+	time_t when;
+	if ( ! adExpirationTime (ad, when)) {
+		return;
+	}
+	if (when < not_before) {
+		when = not_before;
+	}
+	AdExpiration & exp = m_adExpirations[ad];
+	exp.table = &hashTable;
+	exp.when = when;
+	m_expirationQueues[&hashTable].insert(std::make_pair(when, ad));
+}
+
+void CollectorEngine::
+unscheduleExpiration (const ClassAd *ad) const
+{
+	auto it = m_adExpirations.find(ad);
+	if (it == m_adExpirations.end()) {
+		return;
+	}
+	m_expirationQueues[it->second.table].erase(std::make_pair(it->second.when, const_cast<ClassAd *>(ad)));
+	m_adExpirations.erase(it);
+}
+
+void CollectorEngine::
+adChanged (ClassAd *ad)
+{
+	auto it = m_adExpirations.find(ad);
+	if (it != m_adExpirations.end()) {
+		adSetChanged (*it->second.table);
+	} else {
+		// we don't know which table the ad is in, so it could be any
+		for (auto gen = m_adSetGenerations.begin(); gen != m_adSetGenerations.end(); ++gen) {
+			++gen->second;
+		}
+		++m_anyAdSetGeneration;
+	}
+	rescheduleExpiration (ad);
+	m_totals.recount (*ad);
+}
+
+void CollectorEngine::
+rescheduleExpiration (ClassAd *ad)
+{
+	auto it = m_adExpirations.find(ad);
+	if (it != m_adExpirations.end()) {
+		scheduleExpiration (*it->second.table, ad);
+	}
+}
+
+void CollectorEngine::
+rescheduleAllExpirations ()
+{
+	m_adExpirations.clear();
+	m_expirationQueues.clear();
+
+	auto schedule = [this](CollectorHashTable &table) {
+		table.walk([this, &table](ClassAd *ad) {
+			scheduleExpiration (table, ad);
+			return 1;
+		});
+	};
+	schedule (StartdAds);
+	schedule (StartdPrivateAds);
+	schedule (ScheddAds);
+	schedule (SubmittorAds);
+	schedule (LicenseAds);
+	schedule (MasterAds);
+	schedule (CkptServerAds);
+	schedule (CollectorAds);
+	schedule (StorageAds);
+	schedule (AccountingAds);
+	schedule (NegotiatorAds);
+	schedule (HadAds);
+	schedule (GridAds);
+	GenericAds.walk([&schedule](CollectorHashTable *cht) {
+		schedule (*cht);
+		return 1;
+	});
+}
+
+bool CollectorEngine::
+expireAd (CollectorHashTable &hashTable, ClassAd *ad, time_t now, HashFunc makeKey) const
+{
 	int   	 timeStamp;
 	int		 max_lifetime;
 	AdNameHashKey  hk;
 	double   timeDiff;
 	MyString	hkString;
 
-	hashTable.startIterations ();
-	while (hashTable.iterate (ad))
-	{
-		// Read the timestamp of the ad
-		if (!ad->LookupInteger (ATTR_LAST_HEARD_FROM, timeStamp)) {
-			dprintf (D_ALWAYS, "\t\tError looking up time stamp on ad\n");
-			continue;
-		}
+	// Read the timestamp of the ad
+	if (!ad->LookupInteger (ATTR_LAST_HEARD_FROM, timeStamp)) {
+		dprintf (D_ALWAYS, "\t\tError looking up time stamp on ad\n");
+		unscheduleExpiration (ad);
+		return false;
+	}
 
-		// how long has it been since the last update?
-		timeDiff = difftime( now, timeStamp );
+	// how long has it been since the last update?
+	timeDiff = difftime( now, timeStamp );
 
-		if( !ad->LookupInteger( ATTR_CLASSAD_LIFETIME, max_lifetime ) ) {
-			max_lifetime = machineUpdateInterval;
-		}
+	if( !ad->LookupInteger( ATTR_CLASSAD_LIFETIME, max_lifetime ) ) {
+		max_lifetime = machineUpdateInterval;
+	}
 
-		// check if it has expired
-		if ( timeDiff > (double) max_lifetime )
-		{
-			// then remove it from the segregated table
-			(*makeKey) (hk, ad);
-			hk.sprint( hkString );
-			if( timeStamp == 0 ) {
-				dprintf (D_ALWAYS,"\t\t**** Removing invalidated ad: \"%s\"\n", hkString.Value() );
-			}
-			else {
-				dprintf (D_ALWAYS,"\t\t**** Removing stale ad: \"%s\"\n", hkString.Value() );
-			    /* let the off-line plug-in know we are about to expire this ad, so it can
-				   potentially mark the ad absent. if expire() returns false, then delete
-				   the ad as planned; if it return true, it was likely marked as absent,
-				   so then this ad should NOT be deleted. */
-				if ( CollectorDaemon::offline_plugin_.expire( *ad ) == true ) {
-					// plugin say to not delete this ad, so continue
-					continue;
-				} else {
-					dprintf (D_ALWAYS,"\t\t**** Removing stale ad: \"%s\"\n", hkString.Value() );
-				}
-			}
-			if (hashTable.remove (hk) == -1)
-			{
-				dprintf (D_ALWAYS, "\t\tError while removing ad\n");
-			}
-			delete ad;
+	// check if it has expired
+	if ( timeDiff <= (double) max_lifetime )
+	{
+		scheduleExpiration (hashTable, ad);
+		return false;
+	}
+
+	// then remove it from the segregated table
+	(*makeKey) (hk, ad);
+	hk.sprint( hkString );
+	if( timeStamp == 0 ) {
+		dprintf (D_ALWAYS,"\t\t**** Removing invalidated ad: \"%s\"\n", hkString.Value() );
+	}
+	else {
+		dprintf (D_ALWAYS,"\t\t**** Removing stale ad: \"%s\"\n", hkString.Value() );
+		/* let the off-line plug-in know we are about to expire this ad, so it can
+		   potentially mark the ad absent. if expire() returns false, then delete
+		   the ad as planned; if it return true, it was likely marked as absent,
+		   so then this ad should NOT be deleted. */
+		if ( CollectorDaemon::offline_plugin_.expire( *ad ) == true ) {
+			// plugin say to not delete this ad, look at it again later
+			scheduleExpiration (hashTable, ad, now);
+			m_totals.recount (*ad);
+			return false;
+		} else {
+			dprintf (D_ALWAYS,"\t\t**** Removing stale ad: \"%s\"\n", hkString.Value() );
 		}
 	}
+	if (hashTable.remove (hk) == -1)
+	{
+		dprintf (D_ALWAYS, "\t\tError while removing ad\n");
+	}
+	adRemoved(hashTable, *ad);
+	delete ad;
+	return true;
 }
 
 
@@ -1367,7 +1886,7 @@ CollectorEngine::LookupByAdType(AdTypes adType,
 }
 
 
-static void
+void CollectorEngine::
 purgeHashTable( CollectorHashTable &table )
 {
 	ClassAd* ad;
@@ -1377,6 +1896,7 @@ purgeHashTable( CollectorHashTable &table )
 		if( table.remove(hk) == -1 ) {
 			dprintf( D_ALWAYS, "\t\tError while removing ad\n" );
 		}		
+		adRemoved(table, *ad);
 		delete ad;
 	}
 }
@@ -24,6 +24,13 @@
 
 #include "collector_stats.h"
 #include "hashkey.h"
+#include "shared_machine_ads.h"
+#include "collector_totals.h"
+
+#include <functional>
+#include <map>
+#include <set>
+#include <unordered_map>
 
 class CollectorEngine : public Service
 {
@@ -37,11 +44,21 @@ class CollectorEngine : public Service
 	// interval to clean out ads
 	int scheduleHousekeeper (int = 300);
 	int invokeHousekeeper (AdTypes);
+	// an ad in a table was changed in place (by the offline plugin)
+	void adChanged (ClassAd *);
 	int invalidateAds(AdTypes, ClassAd &);
 
 	// perform the collect operation of the given command
 	ClassAd *collect (int, Sock *, const condor_sockaddr&, int &);
-	ClassAd *collect (int, ClassAd *, const condor_sockaddr&, int &, Sock* = NULL);
+	// if pvtAd is given, the private ad of a startd update has already
+	// been read from the sock; the ad is taken if it is used.
+	ClassAd *collect (int, ClassAd *, const condor_sockaddr&, int &, Sock* = NULL, ClassAd ** pvtAd = NULL);
+
+	// read the public and private ads of many startd slots and apply
+	// them all, or none of them if any fails to parse or validate.  all
+	// of the ads are checked before any table is changed.  the public
+	// ads that were stored are returned in updated.
+	bool collectBulk (int, Sock *, const condor_sockaddr&, std::vector<ClassAd*> &updated);
 
 	// lookup classad in the specified table with the given hashkey
 	ClassAd *lookup (AdTypes, AdNameHashKey &);
@@ -68,7 +85,12 @@ class CollectorEngine : public Service
 	int remove (AdTypes, AdNameHashKey &);
 
 	// walk specified hash table with the given visit procedure
-	int walkHashTable (AdTypes, int (*)(ClassAd *));
+	int walkHashTable (AdTypes, const std::function<int(ClassAd *)> &);
+
+	// changes whenever an ad in the tables for the given type is added,
+	// updated or removed, so that cached query results can tell if they
+	// are stale
+	unsigned long adSetGeneration (AdTypes);
 
 	// Walk through a specific (non-generic, non-ANY) table using a lambda
 	template<typename T>
@@ -103,6 +125,9 @@ class CollectorEngine : public Service
 	void identifySelfAd(ClassAd * ad);
 	bool isSelfAd(void * ad) { return __self_ad__ != NULL && __self_ad__ == ad; }
 
+	// running totals of the startd and submitter ads
+	const CollectorTotals & totals() const { return m_totals; }
+
 	// Publish stats into the collector's ClassAd
 	//int publishStats( ClassAd *ad );
 
@@ -144,9 +169,7 @@ class CollectorEngine : public Service
 	GenericAdHashTable GenericAds;
 
 	// for walking through the generic hash tables
-	static int (*genericTableScanFunction)(ClassAd *);
-	static int genericTableWalker(CollectorHashTable *cht);
-	int walkGenericTables(int (*scanFunction)(ClassAd *));
+	int walkGenericTables(const std::function<int(ClassAd *)> &scanFunction);
 
 	// relevant variables from the config file
 	int	clientTimeout; 
@@ -154,7 +177,51 @@ class CollectorEngine : public Service
 
 	void  housekeeper ();
 	int  housekeeperTimerID;
+	// remove every expired ad of the table
 	void cleanHashTable (CollectorHashTable &, time_t, HashFunc) const;
+	// remove the expired ads of the table, looking only at those that
+	// are due according to the expiration queue
+	void expireDueAds (CollectorHashTable &, time_t, HashFunc) const;
+	bool expireAd (CollectorHashTable &, ClassAd *, time_t, HashFunc) const;
+	void purgeHashTable (CollectorHashTable &);
+
+	// every ad that is in a table, by the time it will expire
+	struct AdExpiration {
+		CollectorHashTable *table;
+		time_t when;
+	};
+	bool adExpirationTime (const ClassAd *ad, time_t &when) const;
+	void scheduleExpiration (CollectorHashTable &table, ClassAd *ad, time_t not_before = 0) const;
+	void unscheduleExpiration (const ClassAd *ad) const;
+	void rescheduleExpiration (ClassAd *ad);
+	void rescheduleAllExpirations ();
+	mutable std::unordered_map<const ClassAd *, AdExpiration> m_adExpirations;
+	mutable std::map<const CollectorHashTable *, std::set<std::pair<time_t, ClassAd *> > > m_expirationQueues;
+
+	// the unparsed attribute lines of one ad of an update message
+	struct UpdateAdLines {
+		std::string lines;
+		int num_lines;
+	};
+	bool readUpdateMessage (int command, Sock *sock, std::vector<UpdateAdLines> &ads);
+	bool parseUpdateAd (const UpdateAdLines &lines, ClassAd &ad);
+
+	// generation counts for adSetGeneration()
+	void adSetChanged (const CollectorHashTable &table) const {
+		++m_adSetGenerations[&table];
+		++m_anyAdSetGeneration;
+	}
+	// an ad is about to be removed from the table and deleted, tell
+	// subscribers and drop its shared machine attributes
+	void adRemoved (const CollectorHashTable &table, ClassAd &ad) const;
+	mutable std::map<const CollectorHashTable *, unsigned long> m_adSetGenerations;
+	mutable unsigned long m_anyAdSetGeneration;
+
+	// machine attributes shared by the slot ads of a startd
+	mutable SharedMachineAds m_sharedMachineAds;
+	// add or remove the ad from m_totals if it is in a table we total
+	void countAd (const CollectorHashTable &table, const ClassAd &ad) const;
+	mutable CollectorTotals m_totals;
 	ClassAd* updateClassAd(CollectorHashTable&,const char*, const char *,
 						   ClassAd*,AdNameHashKey&, const MyString &, int &, 
 						   const condor_sockaddr& );
@@ -168,6 +235,17 @@ class CollectorEngine : public Service
 							int  &insert,
 							const condor_sockaddr& /*from*/ );
 
+	// apply a delta update to the ad it was made against; returns NULL
+	// and sets insert to -5 if the sender must resend the whole ad
+	ClassAd * applyDeltaClassAd (CollectorHashTable &hashTable,
+								 const char *adType,
+								 const char *label,
+								 ClassAd *delta_ad,
+								 AdNameHashKey &hk,
+								 const MyString &hashString,
+								 int  &insert,
+								 Sock *sock );
+
 	// support for dynamically created tables
 	CollectorHashTable *findOrCreateTable(MyString &str);
 
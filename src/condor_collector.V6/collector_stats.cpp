@@ -377,6 +377,17 @@ void UpdatesStats::Init()
 	STATS_POOL_ADD(Pool, "", PendingQueries, IF_BASICPUB);
 	STATS_POOL_ADD_VAL_PUB_RECENT(Pool, "", DroppedQueries, IF_BASICPUB);
 
+	// stats for the query result cache.
+	STATS_POOL_ADD_VAL_PUB_RECENT(Pool, "", QueryCacheHits, IF_BASICPUB);
+	STATS_POOL_ADD_VAL_PUB_RECENT(Pool, "", QueryCacheMisses, IF_BASICPUB);
+	STATS_POOL_ADD(Pool, "", QueryCacheEntries, IF_BASICPUB);
+
+	// stats for the update ingestion stages: reading the message from
+	// the socket, and applying it to the tables.
+	STATS_POOL_ADD(Pool, "", UpdatesReading, IF_BASICPUB);
+	ADD_EXTERN_RUNTIME(Pool, CollectorEngine_ingest_read, IF_BASICPUB);
+	ADD_EXTERN_RUNTIME(Pool, CollectorEngine_ingest_apply, IF_BASICPUB);
+
 	ADD_EXTERN_RUNTIME(Pool, HandleQuery, IF_VERBOSEPUB);
 	ADD_EXTERN_RUNTIME(Pool, HandleLocate, IF_VERBOSEPUB);
 
@@ -175,6 +175,12 @@ struct UpdatesStats {
 	stats_entry_abs<int> PendingQueries;
 	stats_entry_recent<long> DroppedQueries;
 
+	stats_entry_recent<long> QueryCacheHits;
+	stats_entry_recent<long> QueryCacheMisses;
+	stats_entry_abs<int> QueryCacheEntries;
+
+	stats_entry_abs<int> UpdatesReading;
+
 #ifdef TRACK_QUERIES_BY_SUBSYS
 	stats_entry_recent<long> InProcQueriesFrom[SUBSYSTEM_ID_COUNT]; // Track subsystems < the AUTO subsys.
 	stats_entry_recent<long> ForkQueriesFrom[SUBSYSTEM_ID_COUNT]; // Track subsystems < the AUTO subsys.
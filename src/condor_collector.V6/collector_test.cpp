@@ -0,0 +1,406 @@
+/***************************************************************
+ *
+ * Copyright (C) 1990-2020, Condor Team, Computer Sciences Department,
+ * University of Wisconsin-Madison, WI.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You may
+ * obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************/
+
+// Tests of the parts of the collector that keep its ads and their totals,
+// run against ads that the test makes.  Prints each failure and returns the number of them.
+
+#include "condor_common.h"
+#include "condor_debug.h"
+#include "condor_config.h"
+#include "condor_attributes.h"
+#include "condor_adtypes.h"
+#include "condor_classad.h"
+#include "shared_machine_ads.h"
+#include "collector_totals.h"
+
+#include <set>
+
+static int failures = 0;
+
+#define CHECK(cond) \
+	if ( ! (cond)) { \
+		fprintf(stderr, "%s:%d: %s: check failed: %s\n", __FILE__, __LINE__, test_name, #cond); \
+		++failures; \
+	}
+
+// A slot ad of the startd at addr, with a few attributes of the machine
+// and a few of the slot.
+static ClassAd * make_slot_ad(const char * addr, int slot)
+{
+	ClassAd * ad = new ClassAd();
+	std::string name;
+	formatstr(name, "slot%d@machine", slot);
+	ad->Assign(ATTR_MY_ADDRESS, addr);
+	ad->Assign(ATTR_NAME, name);
+	ad->Assign(ATTR_SLOT_ID, slot);
+	ad->Assign(ATTR_OPSYS, "LINUX");
+	ad->Assign(ATTR_ARCH, "X86_64");
+	ad->Assign(ATTR_TOTAL_MEMORY, 16384);
+	ad->Assign("CronValue", 1);
+	return ad;
+}
+
+// Update an attribute of a shared ad in place, as the collector merges
+// an update into the ad it has.
+static void update_slot_ad(SharedMachineAds & shared, ClassAd & ad, const char * attr, int value)
+{
+	shared.unshare(ad);
+	ad.Assign(attr, value);
+	shared.share(ad);
+}
+
+static int lookup_int(const ClassAd & ad, const char * attr)
+{
+	int value = -1;
+	ad.LookupInteger(attr, value);
+	return value;
+}
+
+// Check that each slot still sees all of its own attributes, whichever
+// of them were moved to a parent.
+static bool slots_unchanged(ClassAd ** ads, int num_ads, const int * cron_values)
+{
+	for (int i = 0; i < num_ads; ++i) {
+		std::string opsys, name;
+		if ( ! ads[i]->LookupString(ATTR_OPSYS, opsys) || opsys != "LINUX" ||
+			lookup_int(*ads[i], ATTR_TOTAL_MEMORY) != 16384 ||
+			lookup_int(*ads[i], ATTR_SLOT_ID) != i + 1 ||
+			lookup_int(*ads[i], "CronValue") != cron_values[i])
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+// The attributes the slots of a startd have in common go into one parent,
+// a slot that differs from the others makes a smaller parent, and purge()
+// grows the parent again once the slots agree.
+static void test_shared_machine_ads()
+{
+	const char * test_name = "shared_machine_ads";
+
+	config_insert("COLLECTOR_SHARE_MACHINE_ATTRIBUTES", "true");
+	SharedMachineAds shared;
+	shared.config();
+
+	const int num_ads = 3;
+	ClassAd * ads[num_ads];
+	for (int i = 0; i < num_ads; ++i) {
+		ads[i] = make_slot_ad("<127.0.0.1:9618>", i + 1);
+		shared.share(*ads[i]);
+	}
+	ClassAd * other = make_slot_ad("<127.0.0.2:9618>", 1);
+	shared.share(*other);
+
+		// sharing: the first slot of a startd is chained to a parent of
+		// all of its attributes, which the next slot doesn't match, so
+		// it takes purge() to put the slots on one parent.
+	CHECK(ads[0]->GetChainedParentAd() != ads[1]->GetChainedParentAd());
+	CHECK(ads[1]->GetChainedParentAd() == ads[2]->GetChainedParentAd());
+	CHECK(shared.numParents() == 3);
+	shared.purge();
+	CHECK(shared.numParents() == 2);
+	CHECK(ads[0]->GetChainedParentAd() != NULL);
+	CHECK(ads[0]->GetChainedParentAd() == ads[2]->GetChainedParentAd());
+	CHECK(other->GetChainedParentAd() != ads[0]->GetChainedParentAd());
+	CHECK(ads[1]->LookupIgnoreChain(ATTR_OPSYS) == NULL);
+	CHECK(ads[1]->LookupIgnoreChain("CronValue") == NULL);
+	CHECK(ads[1]->LookupIgnoreChain(ATTR_SLOT_ID) != NULL);
+	int cron_values[num_ads] = { 1, 1, 1 };
+	CHECK(slots_unchanged(ads, num_ads, cron_values));
+	int full_size = ads[0]->GetChainedParentAd()->size();
+
+		// divergence: one slot has a new value, so the others keep theirs
+		// and the next parent leaves that attribute out
+	update_slot_ad(shared, *ads[1], "CronValue", 2);
+	cron_values[1] = 2;
+	CHECK(slots_unchanged(ads, num_ads, cron_values));
+	CHECK(ads[1]->LookupIgnoreChain("CronValue") != NULL);
+	CHECK(ads[1]->GetChainedParentAd() != NULL);
+	CHECK(ads[1]->GetChainedParentAd()->size() < full_size);
+	shared.purge();
+	CHECK(slots_unchanged(ads, num_ads, cron_values));
+	CHECK(ads[0]->GetChainedParentAd() == ads[1]->GetChainedParentAd());
+	CHECK(ads[0]->GetChainedParentAd()->size() == full_size - 1);
+	CHECK(shared.numParents() == 2);
+
+		// re-convergence: once every slot has the new value, purge()
+		// moves it back into the parent
+	update_slot_ad(shared, *ads[0], "CronValue", 2);
+	update_slot_ad(shared, *ads[2], "CronValue", 2);
+	cron_values[0] = cron_values[2] = 2;
+	CHECK(slots_unchanged(ads, num_ads, cron_values));
+	CHECK(ads[0]->GetChainedParentAd()->size() == full_size - 1);
+	shared.purge();
+	CHECK(slots_unchanged(ads, num_ads, cron_values));
+	CHECK(shared.numParents() == 2);
+	for (int i = 0; i < num_ads; ++i) {
+		CHECK(ads[i]->GetChainedParentAd() == ads[0]->GetChainedParentAd());
+		CHECK(ads[i]->LookupIgnoreChain("CronValue") == NULL);
+	}
+	CHECK(ads[0]->GetChainedParentAd()->size() == full_size);
+	CHECK(lookup_int(*other, "CronValue") == 1);
+
+		// parents go away with the last of their slots
+	for (int i = 0; i < num_ads; ++i) {
+		shared.release(*ads[i]);
+		delete ads[i];
+	}
+	shared.purge();
+	CHECK(shared.numParents() == 1);
+	shared.release(*other);
+	delete other;
+	shared.purge();
+	CHECK(shared.numParents() == 0);
+}
+
+// Describe the totals of the given ads, worked out from scratch by walking
+// them, as the collector did before it kept them as ads came and went.
+static std::string scan_totals(const std::set<ClassAd *> & startds, const std::set<ClassAd *> & submittors)
+{
+	int machines = 0, running = 0, idle = 0;
+	int states[_state_threshold_] = { 0 };
+	int universes[CONDOR_UNIVERSE_MAX] = { 0 };
+	std::map<std::string, StartdNormalTotal> groups;
+	std::map<std::string, int> malformed;
+
+	for (auto it = startds.begin(); it != startds.end(); ++it) {
+		ClassAd * ad = *it;
+		std::string arch, opsys, key, state;
+		if (ad->LookupString(ATTR_ARCH, arch) && ad->LookupString(ATTR_OPSYS, opsys)) {
+			formatstr(key, "%s/%s", arch.c_str(), opsys.c_str());
+		}
+		StartdNormalTotal & total = groups[key];
+		malformed[key] += 0;
+		bool has_state = ad->LookupString(ATTR_STATE, state);
+		if (has_state) {
+			++machines;
+			State st = string_to_state(state.c_str());
+			if (st < _state_threshold_) {
+				++states[st];
+			}
+			int universe;
+			if (ad->LookupInteger(ATTR_JOB_UNIVERSE, universe) &&
+				universe >= 0 && universe < CONDOR_UNIVERSE_MAX) {
+				++universes[universe];
+			}
+		}
+		if (key.empty() || ! total.update(ad, 0)) {
+			++malformed[key];
+		}
+	}
+	for (auto it = submittors.begin(); it != submittors.end(); ++it) {
+		int r, i;
+		if ((*it)->LookupInteger(ATTR_RUNNING_JOBS, r) && (*it)->LookupInteger(ATTR_IDLE_JOBS, i)) {
+			running += r;
+			idle += i;
+		}
+	}
+
+	std::string out;
+	formatstr(out, "startds=%d submittors=%d machines=%d running=%d idle=%d states",
+		(int)startds.size(), (int)submittors.size(), machines, running, idle);
+	for (int i = 0; i < _state_threshold_; ++i) {
+		formatstr_cat(out, " %d", states[i]);
+	}
+	out += " universes";
+	for (int i = 0; i < CONDOR_UNIVERSE_MAX; ++i) {
+		formatstr_cat(out, " %d", universes[i]);
+	}
+	for (auto it = groups.begin(); it != groups.end(); ++it) {
+		ClassAd summary;
+		if ( ! it->first.empty()) {
+			it->second.publishSummary(summary);
+		}
+		formatstr_cat(out, "\n[%s] malformed=%d", it->first.c_str(), malformed[it->first]);
+		const char * attrs[] = { ATTR_NUM_HOSTS_TOTAL, ATTR_NUM_HOSTS_OWNER, ATTR_NUM_HOSTS_UNCLAIMED,
+			ATTR_NUM_HOSTS_CLAIMED, ATTR_NUM_HOSTS_MATCHED, ATTR_NUM_HOSTS_PREEMPTING, ATTR_NUM_HOSTS_DRAINED };
+		for (size_t i = 0; i < sizeof(attrs)/sizeof(attrs[0]); ++i) {
+			formatstr_cat(out, " %s=%d", attrs[i], lookup_int(summary, attrs[i]));
+		}
+	}
+	return out;
+}
+
+// Describe the totals that CollectorTotals has kept, in the same form.
+static std::string kept_totals(const CollectorTotals & totals)
+{
+	std::string out;
+	formatstr(out, "startds=%d submittors=%d machines=%d running=%d idle=%d states",
+		totals.numStartdAds(), totals.numSubmittorAds(), totals.numMachines(),
+		totals.runningJobs(), totals.idleJobs());
+	for (int i = 0; i < _state_threshold_; ++i) {
+		formatstr_cat(out, " %d", totals.numMachines((State)i));
+	}
+	out += " universes";
+	for (int i = 0; i < CONDOR_UNIVERSE_MAX; ++i) {
+		formatstr_cat(out, " %d", totals.jobsInUniverse(i));
+	}
+	totals.publishStartdSummary([&out](ClassAd * summary) -> bool {
+		std::string key;
+		summary->LookupString(ATTR_SUMMARY_KEY, key);
+		formatstr_cat(out, "\n[%s] malformed=%d", key.c_str(), lookup_int(*summary, ATTR_NUM_HOSTS_MALFORMED));
+		const char * attrs[] = { ATTR_NUM_HOSTS_TOTAL, ATTR_NUM_HOSTS_OWNER, ATTR_NUM_HOSTS_UNCLAIMED,
+			ATTR_NUM_HOSTS_CLAIMED, ATTR_NUM_HOSTS_MATCHED, ATTR_NUM_HOSTS_PREEMPTING, ATTR_NUM_HOSTS_DRAINED };
+		for (size_t i = 0; i < sizeof(attrs)/sizeof(attrs[0]); ++i) {
+			formatstr_cat(out, " %s=%d", attrs[i], lookup_int(*summary, attrs[i]));
+		}
+		return true;
+	});
+	return out;
+}
+
+static ClassAd * make_startd_ad(const char * arch, const char * opsys, const char * state, int universe)
+{
+	ClassAd * ad = new ClassAd();
+	SetMyTypeName(*ad, STARTD_ADTYPE);
+	if (arch) ad->Assign(ATTR_ARCH, arch);
+	if (opsys) ad->Assign(ATTR_OPSYS, opsys);
+	if (state) ad->Assign(ATTR_STATE, state);
+	if (universe >= 0) ad->Assign(ATTR_JOB_UNIVERSE, universe);
+	return ad;
+}
+
+static ClassAd * make_submittor_ad(int running, int idle)
+{
+	ClassAd * ad = new ClassAd();
+	SetMyTypeName(*ad, SUBMITTER_ADTYPE);
+	ad->Assign(ATTR_RUNNING_JOBS, running);
+	ad->Assign(ATTR_IDLE_JOBS, idle);
+	return ad;
+}
+
+#define CHECK_TOTALS() \
+	{ \
+		std::string kept = kept_totals(totals); \
+		std::string scanned = scan_totals(startds, submittors); \
+		if (kept != scanned) { \
+			fprintf(stderr, "%s:%d: %s: totals differ, kept:\n%s\nscanned:\n%s\n", \
+				__FILE__, __LINE__, test_name, kept.c_str(), scanned.c_str()); \
+			++failures; \
+		} \
+	}
+
+// The totals the collector keeps as startd and submitter ads are added,
+// changed in place, replaced and removed are the same as a walk of the
+// ads would give.
+static void test_collector_totals()
+{
+	const char * test_name = "collector_totals";
+
+	CollectorTotals totals;
+	std::set<ClassAd *> startds, submittors;
+	CHECK_TOTALS();
+
+	ClassAd * a1 = make_startd_ad("X86_64", "LINUX", "Unclaimed", -1);
+	ClassAd * a2 = make_startd_ad("X86_64", "LINUX", "Claimed", CONDOR_UNIVERSE_VANILLA);
+	ClassAd * a3 = make_startd_ad("ARM", "LINUX", "Owner", -1);
+		// malformed: no Arch, or a state that condor_status doesn't show
+	ClassAd * a4 = make_startd_ad(NULL, "LINUX", "Unclaimed", -1);
+	ClassAd * a5 = make_startd_ad("X86_64", "LINUX", "Bogus", -1);
+	ClassAd * a6 = make_startd_ad("X86_64", "LINUX", NULL, CONDOR_UNIVERSE_VANILLA);
+	ClassAd * s1 = make_submittor_ad(3, 10);
+	ClassAd * s2 = make_submittor_ad(0, 4);
+	ClassAd * added[] = { a1, a2, a3, a4, a5, a6 };
+	for (size_t i = 0; i < sizeof(added)/sizeof(added[0]); ++i) {
+		totals.addStartd(*added[i]);
+		startds.insert(added[i]);
+	}
+	totals.addSubmittor(*s1);
+	totals.addSubmittor(*s2);
+	submittors.insert(s1);
+	submittors.insert(s2);
+	CHECK_TOTALS();
+	CHECK(totals.numStartdAds() == 6);
+	CHECK(totals.numMachines() == 5);
+	CHECK(totals.runningJobs() == 3 && totals.idleJobs() == 14);
+
+		// changed in place, as a merged update does
+	a2->Assign(ATTR_STATE, "Unclaimed");
+	a2->Delete(ATTR_JOB_UNIVERSE);
+	totals.recount(*a2);
+	s1->Assign(ATTR_RUNNING_JOBS, 5);
+	totals.recount(*s1);
+	CHECK_TOTALS();
+	CHECK(totals.jobsInUniverse(CONDOR_UNIVERSE_VANILLA) == 0);
+
+		// removed before the change and added after it
+	totals.remove(*a4);
+	a4->Assign(ATTR_ARCH, "X86_64");
+	totals.addStartd(*a4);
+	CHECK_TOTALS();
+
+		// replaced by a new ad
+	ClassAd * a1b = make_startd_ad("X86_64", "LINUX", "Claimed", CONDOR_UNIVERSE_JAVA);
+	totals.remove(*a1);
+	startds.erase(a1);
+	delete a1;
+	totals.addStartd(*a1b);
+	startds.insert(a1b);
+	CHECK_TOTALS();
+
+		// adding an ad that is already counted counts it again
+	a3->Assign(ATTR_STATE, "Matched");
+	totals.addStartd(*a3);
+	CHECK_TOTALS();
+
+		// the last ad of a group takes the group with it
+	totals.remove(*a3);
+	startds.erase(a3);
+	delete a3;
+	totals.remove(*s2);
+	submittors.erase(s2);
+	delete s2;
+	CHECK_TOTALS();
+	int groups = 0;
+	totals.publishStartdSummary([&groups](ClassAd *) -> bool { ++groups; return true; });
+	CHECK(groups == 1);
+
+		// removing an ad that isn't counted changes nothing
+	ClassAd stranger;
+	totals.remove(stranger);
+	totals.recount(stranger);
+	CHECK_TOTALS();
+
+	for (auto it = startds.begin(); it != startds.end(); ++it) {
+		totals.remove(**it);
+		delete *it;
+	}
+	startds.clear();
+	for (auto it = submittors.begin(); it != submittors.end(); ++it) {
+		totals.remove(**it);
+		delete *it;
+	}
+	submittors.clear();
+	CHECK_TOTALS();
+	CHECK(totals.numMachines() == 0 && totals.runningJobs() == 0);
+}
+
+int
+main( int /* argc */, char ** /* argv */ )
+{
+	test_shared_machine_ads();
+	test_collector_totals();
+
+	if (failures == 0) {
+		fprintf(stdout, "No failures detected.\n");
+	}
+	return failures;
+}
@@ -0,0 +1,188 @@
+/***************************************************************
+ *
+ * Copyright (C) 1990-2020, Condor Team, Computer Sciences Department,
+ * University of Wisconsin-Madison, WI.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You may
+ * obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************/
+
+#include "condor_common.h"
+#include "condor_debug.h"
+#include "condor_attributes.h"
+#include "condor_adtypes.h"
+#include "condor_classad.h"
+
+#include "collector_totals.h"
+
+CollectorTotals::CollectorTotals()
+	: m_machines(0)
+	, m_runningJobs(0)
+	, m_idleJobs(0)
+{
+	memset(m_states, 0, sizeof(m_states));
+	memset(m_universes, 0, sizeof(m_universes));
+}
+
+void
+CollectorTotals::addStartd(const ClassAd & ad)
+{
+	if (m_startds.count(&ad)) {
+		remove(ad);
+	}
+
+	// the key is the same one condor_status uses, ads without an
+	// Arch or OpSys go into the group with the empty key.
+	std::string arch, opsys, key;
+	if (ad.LookupString(ATTR_ARCH, arch) && ad.LookupString(ATTR_OPSYS, opsys)) {
+		formatstr(key, "%s/%s", arch.c_str(), opsys.c_str());
+	}
+
+	StartdCount & count = m_startds[&ad];
+	count.group = m_groups.insert(StartdGroups::value_type(key, StartdGroup())).first;
+	count.state = _error_state_;
+	count.has_state = false;
+	count.counted = false;
+	count.universe = -1;
+
+	StartdGroup & group = count.group->second;
+	group.ads += 1;
+
+	std::string state;
+	if (ad.LookupString(ATTR_STATE, state)) {
+		count.has_state = true;
+		count.state = string_to_state(state.c_str());
+		m_machines += 1;
+		if (count.state < _state_threshold_) {
+			m_states[count.state] += 1;
+		}
+
+		int universe;
+		if (ad.LookupInteger(ATTR_JOB_UNIVERSE, universe) &&
+			universe >= 0 && universe < CONDOR_UNIVERSE_MAX)
+		{
+			count.universe = universe;
+			m_universes[universe] += 1;
+		}
+	}
+
+	if ( ! key.empty() && count.has_state) {
+		count.counted = group.total.count(count.state, 1) != 0;
+	}
+	if ( ! count.counted) {
+		group.malformed += 1;
+	}
+}
+
+void
+CollectorTotals::addSubmittor(const ClassAd & ad)
+{
+	if (m_submittors.count(&ad)) {
+		remove(ad);
+	}
+
+	SubmittorCount & count = m_submittors[&ad];
+	count.running = 0;
+	count.idle = 0;
+
+	int running, idle;
+	if (ad.LookupInteger(ATTR_RUNNING_JOBS, running) &&
+		ad.LookupInteger(ATTR_IDLE_JOBS, idle))
+	{
+		count.running = running;
+		count.idle = idle;
+		m_runningJobs += running;
+		m_idleJobs += idle;
+	}
+}
+
+void
+CollectorTotals::remove(const ClassAd & ad)
+{
+	auto st = m_startds.find(&ad);
+	if (st != m_startds.end()) {
+		StartdCount & count = st->second;
+		StartdGroup & group = count.group->second;
+		if (count.counted) {
+			group.total.count(count.state, -1);
+		} else {
+			group.malformed -= 1;
+		}
+		if (count.has_state) {
+			m_machines -= 1;
+			if (count.state < _state_threshold_) {
+				m_states[count.state] -= 1;
+			}
+		}
+		if (count.universe >= 0) {
+			m_universes[count.universe] -= 1;
+		}
+		if (--group.ads <= 0) {
+			m_groups.erase(count.group);
+		}
+		m_startds.erase(st);
+		return;
+	}
+
+	auto sub = m_submittors.find(&ad);
+	if (sub != m_submittors.end()) {
+		m_runningJobs -= sub->second.running;
+		m_idleJobs -= sub->second.idle;
+		m_submittors.erase(sub);
+	}
+}
+
+void
+CollectorTotals::recount(const ClassAd & ad)
+{
+	if (m_startds.count(&ad)) {
+		addStartd(ad);
+	} else if (m_submittors.count(&ad)) {
+		addSubmittor(ad);
+	}
+}
+
+int
+CollectorTotals::numMachines(State state) const
+{
+	if (state < 0 || state >= _state_threshold_) {
+		return 0;
+	}
+	return m_states[state];
+}
+
+int
+CollectorTotals::jobsInUniverse(int universe) const
+{
+	if (universe < 0 || universe >= CONDOR_UNIVERSE_MAX) {
+		return 0;
+	}
+	return m_universes[universe];
+}
+
+void
+CollectorTotals::publishStartdSummary(const std::function<bool(ClassAd*)> &output) const
+{
+	for (auto it = m_groups.begin(); it != m_groups.end(); ++it) {
+		ClassAd ad;
+		SetMyTypeName(ad, STARTD_ADTYPE);
+		ad.Assign(ATTR_SUMMARY_KEY, it->first);
+		ad.Assign(ATTR_NUM_HOSTS_MALFORMED, it->second.malformed);
+		if ( ! it->first.empty()) {
+			it->second.total.publishSummary(ad);
+		}
+		if ( ! output(&ad)) {
+			return;
+		}
+	}
+}
@@ -0,0 +1,96 @@
+/***************************************************************
+ *
+ * Copyright (C) 1990-2020, Condor Team, Computer Sciences Department,
+ * University of Wisconsin-Madison, WI.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You may
+ * obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************/
+
+#ifndef _COLLECTOR_TOTALS_H_
+#define _COLLECTOR_TOTALS_H_
+
+#include "condor_classad.h"
+#include "condor_state.h"
+#include "condor_universe.h"
+#include "totals.h"
+
+#include <functional>
+#include <map>
+#include <string>
+#include <unordered_map>
+
+// Totals of the startd and submitter ads in the collector, kept up to
+// date as ads are added, replaced and removed so that neither the
+// collector's own ad nor a condor_status -total query has to walk the
+// tables.
+//
+// What each ad added to the totals is remembered, so removing an ad
+// takes back exactly that even if the ad was changed in place since.
+class CollectorTotals {
+public:
+	CollectorTotals();
+
+	void addStartd(const ClassAd & ad);
+	void addSubmittor(const ClassAd & ad);
+	// the ad is about to be changed or deleted
+	void remove(const ClassAd & ad);
+	// the ad was changed in place, count it again
+	void recount(const ClassAd & ad);
+
+	// what the collector ad publishes
+	int numStartdAds() const { return (int)m_startds.size(); }
+	int numSubmittorAds() const { return (int)m_submittors.size(); }
+	int numMachines() const { return m_machines; }
+	int numMachines(State state) const;
+	int runningJobs() const { return m_runningJobs; }
+	int idleJobs() const { return m_idleJobs; }
+	int jobsInUniverse(int universe) const;
+
+	// one ad per Arch/OpSys with the totals that condor_status -total
+	// shows for startds, see StartdNormalTotal
+	void publishStartdSummary(const std::function<bool(ClassAd*)> &output) const;
+
+private:
+	struct StartdGroup {
+		StartdGroup() : ads(0), malformed(0) {}
+		int ads;
+		int malformed;
+		StartdNormalTotal total;
+	};
+	typedef std::map<std::string, StartdGroup> StartdGroups;
+
+	struct StartdCount {
+		StartdGroups::iterator group;
+		State state;
+		bool has_state;
+		bool counted;
+		int universe;
+	};
+	struct SubmittorCount {
+		int running;
+		int idle;
+	};
+
+	StartdGroups m_groups;
+	std::unordered_map<const ClassAd *, StartdCount> m_startds;
+	std::unordered_map<const ClassAd *, SubmittorCount> m_submittors;
+
+	int m_machines;
+	int m_states[_state_threshold_];
+	int m_universes[CONDOR_UNIVERSE_MAX];
+	int m_runningJobs;
+	int m_idleJobs;
+};
+
+#endif
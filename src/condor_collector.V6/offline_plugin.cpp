@@ -201,10 +201,19 @@ OfflineCollectorPlugin::persistentStoreAd(const char *key, ClassAd &ad)
 			"Replacing existing offline ad.\n");
 	}
 
+	/* the collector may have chained the ad to the machine attributes
+	   it shares with other slots; store all of them. */
+	ClassAd flat_ad;
+	ClassAd *store_ad = &ad;
+	if ( ad.GetChainedParentAd() ) {
+		flat_ad.CopyFromChain( ad );
+		store_ad = &flat_ad;
+	}
+
 	/* try to add the new ad */
 	if ( !_ads->NewClassAd ( 
 		key, 
-		&ad ) ) {
+		store_ad ) ) {
 
 		dprintf (
 			D_FULLDEBUG,
@@ -0,0 +1,184 @@
+/***************************************************************
+ *
+ * Copyright (C) 1990-2020, Condor Team, Computer Sciences Department,
+ * University of Wisconsin-Madison, WI.
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You may
+ * obtain a copy of the License at
+ * 
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************/
+
+#include "condor_common.h"
+#include "condor_debug.h"
+#include "condor_classad.h"
+#include "classad_oldnew.h"
+
+#include "query_cache.h"
+
+#include <algorithm>
+
+void
+QueryCacheResult::add(const ClassAd & ad, const classad::References * projection)
+{
+	m_offsets.push_back(m_lines.size());
+	m_num_lines.push_back(unparseClassAdForPut(ad, PUT_CLASSAD_NO_PRIVATE, projection, m_lines));
+}
+
+bool
+QueryCacheResult::put(Stream * sock, size_t i) const
+{
+	size_t begin = m_offsets[i];
+	size_t end = (i+1 < m_offsets.size()) ? m_offsets[i+1] : m_lines.size();
+	return putUnparsedClassAd(sock, m_num_lines[i], m_lines.data() + begin, end - begin, 0);
+}
+
+void
+QueryCacheResult::serialize(std::string & buf) const
+{
+	size_t num_ads = m_num_lines.size();
+	buf.reserve(sizeof(num_ads) + num_ads * (sizeof(int) + sizeof(size_t)) + m_lines.size());
+	buf.append((const char *)&num_ads, sizeof(num_ads));
+	if (num_ads) {
+		buf.append((const char *)&m_num_lines[0], num_ads * sizeof(int));
+		buf.append((const char *)&m_offsets[0], num_ads * sizeof(size_t));
+	}
+	buf += m_lines;
+}
+
+bool
+QueryCacheResult::deserialize(const std::string & buf)
+{
+	size_t num_ads = 0;
+	if (buf.size() < sizeof(num_ads)) {
+		return false;
+	}
+	memcpy(&num_ads, buf.data(), sizeof(num_ads));
+	size_t pos = sizeof(num_ads);
+	if (num_ads > (buf.size() - pos) / (sizeof(int) + sizeof(size_t))) {
+		return false;
+	}
+	m_num_lines.resize(num_ads);
+	m_offsets.resize(num_ads);
+	if (num_ads) {
+		memcpy(&m_num_lines[0], buf.data() + pos, num_ads * sizeof(int));
+		pos += num_ads * sizeof(int);
+		memcpy(&m_offsets[0], buf.data() + pos, num_ads * sizeof(size_t));
+		pos += num_ads * sizeof(size_t);
+	}
+	m_lines.assign(buf, pos, std::string::npos);
+	for (size_t i = 0; i < num_ads; ++i) {
+		if (m_offsets[i] > m_lines.size() || (i && m_offsets[i] < m_offsets[i-1])) {
+			m_num_lines.clear();
+			m_offsets.clear();
+			m_lines.clear();
+			return false;
+		}
+	}
+	return true;
+}
+
+
+void
+QueryCache::config(int ttl, size_t max_memory)
+{
+	m_ttl = ttl;
+	m_max_memory = max_memory;
+	if ( ! enabled()) {
+		m_entries.clear();
+		m_memory = 0;
+	} else {
+		purge(time(NULL));
+	}
+}
+
+void
+QueryCache::makeKey(AdTypes whichAds, const ClassAd & query, std::string & key)
+{
+	std::vector<std::string> attrs;
+	for (auto it = query.begin(); it != query.end(); ++it) {
+		attrs.push_back(it->first);
+	}
+	std::sort(attrs.begin(), attrs.end(), classad::CaseIgnLTStr());
+
+	classad::ClassAdUnParser unp;
+	unp.SetOldClassAd(true, true);
+
+	formatstr(key, "%d", (int)whichAds);
+	for (auto it = attrs.begin(); it != attrs.end(); ++it) {
+		key += '\n';
+		key += *it;
+		key += '=';
+		unp.Unparse(key, query.Lookup(*it));
+	}
+}
+
+void
+QueryCache::erase(std::map<std::string, Entry>::iterator it)
+{
+	m_memory -= it->second.result->memory();
+	m_entries.erase(it);
+}
+
+void
+QueryCache::purge(time_t now)
+{
+	for (auto it = m_entries.begin(); it != m_entries.end(); ) {
+		auto next = it; ++next;
+		if (it->second.created + m_ttl <= now) {
+			erase(it);
+		}
+		it = next;
+	}
+}
+
+std::shared_ptr<const QueryCacheResult>
+QueryCache::lookup(const std::string & key, unsigned long generation, time_t now)
+{
+	auto it = m_entries.find(key);
+	if (it == m_entries.end()) {
+		return std::shared_ptr<const QueryCacheResult>();
+	}
+	if (it->second.created + m_ttl <= now || it->second.generation != generation) {
+		erase(it);
+		return std::shared_ptr<const QueryCacheResult>();
+	}
+	return it->second.result;
+}
+
+void
+QueryCache::insert(const std::string & key, const std::shared_ptr<const QueryCacheResult> & result, unsigned long generation, time_t now)
+{
+	if ( ! enabled() || result->memory() > m_max_memory) {
+		return;
+	}
+
+	purge(now);
+	auto it = m_entries.find(key);
+	if (it != m_entries.end()) {
+		erase(it);
+	}
+
+		// make room by dropping the oldest results
+	while (m_memory + result->memory() > m_max_memory && ! m_entries.empty()) {
+		auto oldest = m_entries.begin();
+		for (it = m_entries.begin(); it != m_entries.end(); ++it) {
+			if (it->second.created < oldest->second.created) { oldest = it; }
+		}
+		erase(oldest);
+	}
+
+	Entry & entry = m_entries[key];
+	entry.result = result;
+	entry.generation = generation;
+	entry.created = now;
+	m_memory += result->memory();
+}
@@ -0,0 +1,95 @@
+/***************************************************************
+ *
+ * Copyright (C) 1990-2020, Condor Team, Computer Sciences Department,
+ * University of Wisconsin-Madison, WI.
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You may
+ * obtain a copy of the License at
+ * 
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************/
+
+#ifndef _COLLECTOR_QUERY_CACHE_H_
+#define _COLLECTOR_QUERY_CACHE_H_
+
+#include "condor_classad.h"
+#include "condor_adtypes.h"
+#include "stream.h"
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+// The result of one query, with each ad already unparsed into the lines
+// that putClassAd would send, so that repeats of the query can be
+// answered without evaluating the constraint or unparsing the ads again.
+class QueryCacheResult {
+public:
+	QueryCacheResult() {}
+
+	// unparse the ad (with the given projection) and add it to the result
+	void add(const ClassAd & ad, const classad::References * projection);
+
+	// send ad number i, returns false on failure
+	bool put(Stream * sock, size_t i) const;
+
+	size_t numAds() const { return m_num_lines.size(); }
+	size_t memory() const { return m_lines.size() + m_num_lines.size() * (sizeof(int) + sizeof(size_t)); }
+
+	// the result as bytes, so that a forked query worker can pass it back
+	// to the collector.  deserialize returns false if buf is not whole.
+	void serialize(std::string & buf) const;
+	bool deserialize(const std::string & buf);
+
+private:
+	std::vector<int> m_num_lines;   // number of attribute lines in each ad
+	std::vector<size_t> m_offsets;  // where each ad starts in m_lines
+	std::string m_lines;
+};
+
+// Query results cached for a short time, keyed on the normalized query.
+// A result is dropped once it is older than the TTL, or when an ad in the
+// table it was made from has been added, updated or removed.
+class QueryCache {
+public:
+	QueryCache() : m_ttl(0), m_max_memory(0), m_memory(0) {}
+
+	void config(int ttl, size_t max_memory);
+	bool enabled() const { return m_ttl > 0; }
+	size_t maxMemory() const { return m_max_memory; }
+
+	// build the cache key for a query.  the attributes of the query ad
+	// are sorted so that the same query always gives the same key.
+	static void makeKey(AdTypes whichAds, const ClassAd & query, std::string & key);
+
+	std::shared_ptr<const QueryCacheResult> lookup(const std::string & key, unsigned long generation, time_t now);
+	void insert(const std::string & key, const std::shared_ptr<const QueryCacheResult> & result, unsigned long generation, time_t now);
+
+	size_t numEntries() const { return m_entries.size(); }
+
+private:
+	struct Entry {
+		std::shared_ptr<const QueryCacheResult> result;
+		unsigned long generation;
+		time_t created;
+	};
+
+	void purge(time_t now);
+	void erase(std::map<std::string, Entry>::iterator it);
+
+	int m_ttl;
+	size_t m_max_memory;
+	size_t m_memory;
+	std::map<std::string, Entry> m_entries;
+};
+
+#endif
@@ -0,0 +1,253 @@
+/***************************************************************
+ *
+ * Copyright (C) 1990-2020, Condor Team, Computer Sciences Department,
+ * University of Wisconsin-Madison, WI.
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You may
+ * obtain a copy of the License at
+ * 
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************/
+
+#include "condor_common.h"
+#include "condor_debug.h"
+#include "condor_config.h"
+#include "condor_attributes.h"
+#include "condor_classad.h"
+
+#include "shared_machine_ads.h"
+
+SharedMachineAds::~SharedMachineAds()
+{
+	for (auto it = m_parents.begin(); it != m_parents.end(); ++it) {
+		delete it->second;
+	}
+}
+
+void
+SharedMachineAds::config()
+{
+	m_enabled = param_boolean("COLLECTOR_SHARE_MACHINE_ATTRIBUTES", false);
+}
+
+SharedMachineAds::Parent *
+SharedMachineAds::parentOf(const ClassAd & ad) const
+{
+	const classad::ClassAd * chained = ad.GetChainedParentAd();
+	if ( ! chained) {
+		return NULL;
+	}
+	auto it = m_parents.find(chained);
+	return (it == m_parents.end()) ? NULL : it->second;
+}
+
+void
+SharedMachineAds::attach(Parent * parent, ClassAd & ad)
+{
+	ad.ChainToAd(&parent->ad);
+	ad.PruneChildAd();
+	parent->children.insert(&ad);
+}
+
+void
+SharedMachineAds::detach(Parent * parent, ClassAd & ad)
+{
+	parent->children.erase(&ad);
+	if ( ! parent->children.empty()) {
+		return;
+	}
+		// keep the current parent of a startd around for its next update,
+		// purge() frees it if that never comes.
+	auto cur = m_current.find(parent->key);
+	if (cur != m_current.end() && cur->second == parent) {
+		return;
+	}
+	m_parents.erase(&parent->ad);
+	delete parent;
+}
+
+void
+SharedMachineAds::share(ClassAd & ad)
+{
+	if (ad.GetChainedParentAd()) {
+		if ( ! parentOf(ad)) {
+			return; // chained to something that isn't ours
+		}
+		unshare(ad);
+	}
+	if ( ! m_enabled) {
+		return;
+	}
+
+		// all of the slots of a startd have the same address
+	std::string key;
+	if ( ! ad.LookupString(ATTR_MY_ADDRESS, key)) {
+		return;
+	}
+
+	Parent * current = NULL;
+	auto cur = m_current.find(key);
+	if (cur != m_current.end()) {
+		current = cur->second;
+	}
+
+	if (current) {
+		bool matches = true;
+		for (auto it = current->ad.begin(); it != current->ad.end(); ++it) {
+			classad::ExprTree * expr = ad.Lookup(it->first);
+			if ( ! expr || ! expr->SameAs(it->second)) {
+				matches = false;
+				break;
+			}
+		}
+		if (matches) {
+			if (current->ad.size() > 0) {
+				attach(current, ad);
+			}
+			return;
+		}
+	}
+
+		// make a new parent from what this ad has in common with the
+		// current one, or from all of the ad if this is the first slot.
+	Parent * parent = new Parent(key);
+	if (current) {
+		for (auto it = current->ad.begin(); it != current->ad.end(); ++it) {
+			classad::ExprTree * expr = ad.Lookup(it->first);
+			if (expr && expr->SameAs(it->second)) {
+				parent->ad.Insert(it->first, expr->Copy());
+			}
+		}
+	} else {
+		parent->ad.Update(ad);
+	}
+	m_parents[&parent->ad] = parent;
+	m_current[key] = parent;
+	if (current && current->children.empty()) {
+		m_parents.erase(&current->ad);
+		delete current;
+	}
+
+	if (parent->ad.size() == 0) {
+		return;
+	}
+	attach(parent, ad);
+}
+
+void
+SharedMachineAds::unshare(ClassAd & ad)
+{
+	Parent * parent = parentOf(ad);
+	if ( ! parent) {
+		return;
+	}
+	ChainCollapse(ad);
+	detach(parent, ad);
+}
+
+void
+SharedMachineAds::release(ClassAd & ad)
+{
+	Parent * parent = parentOf(ad);
+	if ( ! parent) {
+		return;
+	}
+	ad.Unchain();
+	detach(parent, ad);
+}
+
+// Make a parent of every attribute that the slots chained to the parents
+// of a startd have in common, if that is more than its current parent
+// has, and chain all of those slots to it.
+void
+SharedMachineAds::reshare(const std::string & key, const std::vector<Parent *> & parents)
+{
+	std::vector<ClassAd *> ads;
+	for (auto pit = parents.begin(); pit != parents.end(); ++pit) {
+		ads.insert(ads.end(), (*pit)->children.begin(), (*pit)->children.end());
+	}
+	if (ads.empty()) {
+		return;
+	}
+
+		// start from all of one slot, its own attributes taking the
+		// place of those of its parent, then keep what every slot has.
+	std::map<std::string, classad::ExprTree *, classad::CaseIgnLTStr> common;
+	const classad::ClassAd * chained = ads.front()->GetChainedParentAd();
+	for (auto it = chained->begin(); it != chained->end(); ++it) {
+		common[it->first] = it->second;
+	}
+	for (auto it = ads.front()->begin(); it != ads.front()->end(); ++it) {
+		common[it->first] = it->second;
+	}
+	for (auto ait = ads.begin() + 1; ait != ads.end() && ! common.empty(); ++ait) {
+		for (auto it = common.begin(); it != common.end(); ) {
+			classad::ExprTree * expr = (*ait)->Lookup(it->first);
+			if (expr && expr->SameAs(it->second)) {
+				++it;
+			} else {
+				it = common.erase(it);
+			}
+		}
+	}
+
+		// every slot has all of the attributes of its parent, so this is
+		// only the same as the current parent when it is the same size.
+	auto cur = m_current.find(key);
+	Parent * current = (cur != m_current.end()) ? cur->second : NULL;
+	if (common.empty() ||
+		(parents.size() == 1 && parents.front() == current && common.size() <= (size_t)current->ad.size())) {
+		return;
+	}
+
+	Parent * parent = new Parent(key);
+	for (auto it = common.begin(); it != common.end(); ++it) {
+		parent->ad.Insert(it->first, it->second->Copy());
+	}
+	m_parents[&parent->ad] = parent;
+	m_current[key] = parent;
+	for (auto ait = ads.begin(); ait != ads.end(); ++ait) {
+		ChainCollapse(**ait);
+		attach(parent, **ait);
+	}
+		// these include the current parent, since purge() has already
+		// freed it if no slot was chained to it.
+	for (auto pit = parents.begin(); pit != parents.end(); ++pit) {
+		m_parents.erase(&(*pit)->ad);
+		delete *pit;
+	}
+}
+
+void
+SharedMachineAds::purge()
+{
+	for (auto it = m_current.begin(); it != m_current.end(); ) {
+		Parent * parent = it->second;
+		if ( ! parent->children.empty()) {
+			++it;
+			continue;
+		}
+		m_parents.erase(&parent->ad);
+		delete parent;
+		it = m_current.erase(it);
+	}
+
+	if (m_enabled) {
+		std::map<std::string, std::vector<Parent *> > by_startd;
+		for (auto it = m_parents.begin(); it != m_parents.end(); ++it) {
+			by_startd[it->second->key].push_back(it->second);
+		}
+		for (auto it = by_startd.begin(); it != by_startd.end(); ++it) {
+			reshare(it->first, it->second);
+		}
+	}
+	dprintf(D_FULLDEBUG, "Slot ads share %d machine ads\n", (int)m_parents.size());
+}
@@ -0,0 +1,90 @@
+/***************************************************************
+ *
+ * Copyright (C) 1990-2020, Condor Team, Computer Sciences Department,
+ * University of Wisconsin-Madison, WI.
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You may
+ * obtain a copy of the License at
+ * 
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************/
+
+#ifndef _COLLECTOR_SHARED_MACHINE_ADS_H_
+#define _COLLECTOR_SHARED_MACHINE_ADS_H_
+
+#include "condor_classad.h"
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+// The slot ads of a startd repeat many attributes that describe the
+// machine rather than the slot (OpSys, Arch, TotalMemory, GPU and
+// Docker details, startd cron output, ...).  To store them only once,
+// the attributes that a slot ad has in common with the other slots of
+// its startd are moved into a shared parent ad, and the slot ad is
+// chained to it.  Lookups and putClassAd see the chained attributes, so
+// query results do not change.
+//
+// A parent is only ever used for an ad that has every attribute of the
+// parent with the same value, since a chained ad can not hide an
+// attribute of its parent.  When a slot ad does not match, a new parent
+// is made from the attributes the two have in common, and older parents
+// are freed once the last ad chained to them is gone.  So a parent only
+// ever shrinks as slots are updated; purge() makes a new parent of what
+// the slots of a startd have in common again once they converge.
+class SharedMachineAds {
+public:
+	SharedMachineAds() : m_enabled(false) {}
+	~SharedMachineAds();
+
+	void config();
+
+	// chain the (unchained) ad to the parent for its startd, moving
+	// the shared attributes out of the ad.
+	void share(ClassAd & ad);
+
+	// undo share(), copying the shared attributes back into the ad.
+	// this must be done before attributes are deleted from the ad.
+	void unshare(ClassAd & ad);
+
+	// the ad is about to be deleted
+	void release(ClassAd & ad);
+
+	// free parents that no ad is chained to, and grow the parent of
+	// each startd back to what its slots now have in common.
+	void purge();
+
+	size_t numParents() const { return m_parents.size(); }
+
+private:
+	struct Parent {
+		Parent(const std::string & k) : key(k) {}
+		std::string key;
+		ClassAd ad;
+		// the ads chained to this one
+		std::set<ClassAd *> children;
+	};
+
+	Parent * parentOf(const ClassAd & ad) const;
+	void attach(Parent * parent, ClassAd & ad);
+	void detach(Parent * parent, ClassAd & ad);
+	void reshare(const std::string & key, const std::vector<Parent *> & parents);
+
+	bool m_enabled;
+	// the parent that new ads are matched against, by startd address
+	std::map<std::string, Parent *> m_current;
+	// every parent that exists, by its ad
+	std::map<const classad::ClassAd *, Parent *> m_parents;
+};
+
+#endif
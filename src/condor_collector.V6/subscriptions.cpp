@@ -0,0 +1,373 @@
+/***************************************************************
+ *
+ * Copyright (C) 1990-2020, Condor Team, Computer Sciences Department,
+ * University of Wisconsin-Madison, WI.
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You may
+ * obtain a copy of the License at
+ * 
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************/
+
+#include "condor_common.h"
+#include "condor_debug.h"
+#include "condor_config.h"
+#include "condor_attributes.h"
+#include "condor_classad.h"
+#include "classad_oldnew.h"
+#include "condor_daemon_core.h"
+#include "dc_collector.h"
+
+#include "subscriptions.h"
+
+AdSubscription::AdSubscription(CollectorSubscriptions & mgr, ReliSock * sock, ClassAd * query)
+	: m_mgr(mgr)
+	, m_sock(sock)
+	, m_query(query)
+	, m_filter(NULL)
+	, m_sync_events(0)
+	, m_unfinished_eom(false)
+{
+	m_query->LookupString(ATTR_TARGET_TYPE, m_adType);
+	if (strcasecmp(m_adType.c_str(), "any") == 0) {
+		m_adType.clear();
+	}
+	m_filter = m_query->LookupExpr(ATTR_REQUIREMENTS);
+
+	std::string projection;
+	if (m_query->LookupString(ATTR_PROJECTION, projection)) {
+		StringTokenIterator list(projection);
+		const std::string * attr;
+		while ((attr = list.next_string())) { m_projection.insert(*attr); }
+	}
+}
+
+AdSubscription::~AdSubscription()
+{
+	delete m_query;
+}
+
+bool
+AdSubscription::matches(const ClassAd & ad) const
+{
+	std::string type;
+	ad.LookupString(ATTR_MY_TYPE, type);
+	if ( ! m_adType.empty() && strcasecmp(type.c_str(), m_adType.c_str()) != 0) {
+		return false;
+	}
+	if (m_mgr.protectCollectorAds() && strcasecmp(type.c_str(), COLLECTOR_ADTYPE) == 0) {
+		return false;
+	}
+
+	classad::Value result;
+	bool val;
+	return EvalExprTree(m_filter, const_cast<ClassAd *>(&ad), NULL, result) &&
+		result.IsBooleanValueEquiv(val) && val;
+}
+
+bool
+AdSubscription::update(const ClassAd & ad, const std::string & key)
+{
+	bool known = m_keys.count(key) > 0;
+	if (matches(ad)) {
+		if ( ! known) { m_keys.insert(key); }
+		return send(known ? AD_EVENT_MODIFY : AD_EVENT_ADD, ad);
+	}
+	if (known) {
+		m_keys.erase(key);
+		return send(AD_EVENT_REMOVE, ad);
+	}
+	return true;
+}
+
+bool
+AdSubscription::remove(const ClassAd & ad, const std::string & key)
+{
+	if (m_keys.erase(key)) {
+		return send(AD_EVENT_REMOVE, ad);
+	}
+	return true;
+}
+
+bool
+AdSubscription::send(int event, const ClassAd & ad)
+{
+	if (blocked()) {
+		if (m_backlog.size() - m_sync_events >= m_mgr.maxBacklog()) {
+			dprintf(D_ALWAYS, "Subscription from %s has %d unsent events\n",
+				peer(), (int)(m_backlog.size() - m_sync_events));
+			return false;
+		}
+		queue(event, ad);
+		return true;
+	}
+
+	return put(event, ad);
+}
+
+void
+AdSubscription::queue(int event, const ClassAd & ad)
+{
+	m_backlog.push_back(PendingEvent());
+	PendingEvent & pe = m_backlog.back();
+	pe.event = event;
+	pe.num_lines = unparseClassAdForPut(ad, PUT_CLASSAD_NO_PRIVATE, m_projection.empty() ? NULL : &m_projection, pe.lines);
+}
+
+void
+AdSubscription::syncAd(const ClassAd & ad, const std::string & key)
+{
+	if (matches(ad) && m_keys.insert(key).second) {
+		queue(AD_EVENT_ADD, ad);
+	}
+}
+
+bool
+AdSubscription::startSync()
+{
+	ClassAd empty;
+	queue(AD_EVENT_SYNCED, empty);
+	m_sync_events = m_backlog.size();
+	if ( ! flush()) {
+		return false;
+	}
+	if (blocked()) {
+		m_mgr.scheduleFlush();
+	}
+	return true;
+}
+
+bool
+AdSubscription::put(int event, const ClassAd & ad)
+{
+	m_sock->encode();
+	{
+		BlockingModeGuard guard(m_sock, true);
+		if ( ! m_sock->code(event) ||
+			 ! putClassAd(m_sock, ad, PUT_CLASSAD_NON_BLOCKING | PUT_CLASSAD_NO_PRIVATE,
+				m_projection.empty() ? NULL : &m_projection)) {
+			return false;
+		}
+	}
+	return finish_put();
+}
+
+bool
+AdSubscription::put(const PendingEvent & pe)
+{
+	m_sock->encode();
+	{
+		BlockingModeGuard guard(m_sock, true);
+		if ( ! m_sock->code(const_cast<int &>(pe.event)) ||
+			 ! putUnparsedClassAd(m_sock, pe.num_lines, pe.lines.data(), pe.lines.size(), 0)) {
+			return false;
+		}
+	}
+	return finish_put();
+}
+
+bool
+AdSubscription::finish_put()
+{
+	int retval = m_sock->end_of_message_nonblocking();
+	if (m_sock->clear_backlog_flag()) {
+		m_unfinished_eom = true;
+		m_mgr.scheduleFlush();
+	} else if ( ! retval) {
+		return false;
+	}
+	return true;
+}
+
+bool
+AdSubscription::flush()
+{
+	if (m_unfinished_eom) {
+		int retval = m_sock->finish_end_of_message();
+		if (m_sock->clear_backlog_flag()) {
+			return true;
+		} else if (retval == 1) {
+			m_unfinished_eom = false;
+		} else {
+			return false;
+		}
+	}
+	while ( ! m_unfinished_eom && ! m_backlog.empty()) {
+		if ( ! put(m_backlog.front())) {
+			return false;
+		}
+		m_backlog.pop_front();
+		if (m_sync_events > 0 && --m_sync_events == 0) {
+			dprintf(D_FULLDEBUG, "Subscription from %s synced\n", peer());
+		}
+	}
+	return true;
+}
+
+int
+AdSubscription::peerClosed(Stream *)
+{
+		// The client never sends anything after subscribing, so the
+		// socket is only readable once it has been closed.
+	dprintf(D_FULLDEBUG, "Subscription from %s closed by client\n", peer());
+	m_mgr.forget(this);
+	m_sock = NULL;	// daemonCore deletes the socket when we return
+	delete this;
+	return FALSE;
+}
+
+
+CollectorSubscriptions::CollectorSubscriptions()
+	: m_max_subscriptions(0)
+	, m_max_backlog(0)
+	, m_protect_collector_ads(false)
+	, m_flush_tid(-1)
+{
+}
+
+void
+CollectorSubscriptions::config()
+{
+	m_max_subscriptions = param_integer("COLLECTOR_MAX_SUBSCRIPTIONS", 100, 0);
+	m_max_backlog = param_integer("COLLECTOR_SUBSCRIPTION_MAX_BACKLOG", 10000, 1);
+	m_protect_collector_ads = param_boolean("PROTECT_COLLECTOR_ADS", false);
+}
+
+AdSubscription *
+CollectorSubscriptions::subscribe(ReliSock * sock, ClassAd * query)
+{
+	if ((int)m_subs.size() >= m_max_subscriptions) {
+		dprintf(D_ALWAYS, "Refusing subscription from %s, already have %d (COLLECTOR_MAX_SUBSCRIPTIONS)\n",
+			sock->peer_description(), (int)m_subs.size());
+		delete query;
+		return NULL;
+	}
+	if ( ! query->Lookup(ATTR_REQUIREMENTS)) {
+		dprintf(D_ALWAYS, "Subscription from %s missing %s\n",
+			sock->peer_description(), ATTR_REQUIREMENTS);
+		delete query;
+		return NULL;
+	}
+
+	AdSubscription * sub = new AdSubscription(*this, sock, query);
+	int rc = daemonCore->Register_Socket(sock, "Ad Subscription",
+		(SocketHandlercpp)&AdSubscription::peerClosed,
+		"AdSubscription::peerClosed", sub, ALLOW);
+	if (rc < 0) {
+		dprintf(D_ALWAYS, "Failed to register socket for subscription from %s\n",
+			sock->peer_description());
+		sub->m_sock = NULL;
+		delete sub;
+		return NULL;
+	}
+	m_subs.push_back(sub);
+
+	std::string projection;
+	query->LookupString(ATTR_PROJECTION, projection);
+	dprintf(D_ALWAYS, "Subscription from %s: type=%s; requirements={%s}; projection={%s}\n",
+		sock->peer_description(), sub->m_adType.empty() ? "Any" : sub->m_adType.c_str(),
+		ExprTreeToString(sub->m_filter), projection.c_str());
+	return sub;
+}
+
+int
+CollectorSubscriptions::numSyncing() const
+{
+	int num = 0;
+	for (auto it = m_subs.begin(); it != m_subs.end(); ++it) {
+		if ((*it)->syncing()) { ++num; }
+	}
+	return num;
+}
+
+void
+CollectorSubscriptions::forget(AdSubscription * sub)
+{
+	m_subs.remove(sub);
+}
+
+void
+CollectorSubscriptions::drop(AdSubscription * sub, const char * why)
+{
+	dprintf(D_ALWAYS, "Dropping subscription from %s: %s\n", sub->peer(), why);
+	forget(sub);
+	if (sub->m_sock) {
+		daemonCore->Cancel_Socket(sub->m_sock);
+		delete sub->m_sock;
+		sub->m_sock = NULL;
+	}
+	delete sub;
+}
+
+void
+CollectorSubscriptions::update(const ClassAd & ad)
+{
+	if (m_subs.empty()) {
+		return;
+	}
+
+	std::string key;
+	DCCollectorAdSequences::makeAdKey(ad, key);
+	for (auto it = m_subs.begin(); it != m_subs.end(); ) {
+		AdSubscription * sub = *it++;
+		if ( ! sub->update(ad, key)) {
+			drop(sub, "failed to send update");
+		}
+	}
+}
+
+void
+CollectorSubscriptions::remove(const ClassAd & ad)
+{
+	if (m_subs.empty()) {
+		return;
+	}
+
+	std::string key;
+	DCCollectorAdSequences::makeAdKey(ad, key);
+	for (auto it = m_subs.begin(); it != m_subs.end(); ) {
+		AdSubscription * sub = *it++;
+		if ( ! sub->remove(ad, key)) {
+			drop(sub, "failed to send remove");
+		}
+	}
+}
+
+void
+CollectorSubscriptions::scheduleFlush()
+{
+	if (m_flush_tid < 0) {
+		m_flush_tid = daemonCore->Register_Timer(1,
+			(TimerHandlercpp)&CollectorSubscriptions::flushBlocked,
+			"CollectorSubscriptions::flushBlocked", this);
+	}
+}
+
+void
+CollectorSubscriptions::flushBlocked()
+{
+	m_flush_tid = -1;
+	bool still_blocked = false;
+	for (auto it = m_subs.begin(); it != m_subs.end(); ) {
+		AdSubscription * sub = *it++;
+		if ( ! sub->blocked()) {
+			continue;
+		}
+		if ( ! sub->flush()) {
+			drop(sub, "failed to send queued events");
+		} else if (sub->blocked()) {
+			still_blocked = true;
+		}
+	}
+	if (still_blocked) {
+		scheduleFlush();
+	}
+}
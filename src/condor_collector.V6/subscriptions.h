@@ -0,0 +1,135 @@
+/***************************************************************
+ *
+ * Copyright (C) 1990-2020, Condor Team, Computer Sciences Department,
+ * University of Wisconsin-Madison, WI.
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You may
+ * obtain a copy of the License at
+ * 
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************/
+
+#ifndef _COLLECTOR_SUBSCRIPTIONS_H_
+#define _COLLECTOR_SUBSCRIPTIONS_H_
+
+#include "condor_classad.h"
+#include "reli_sock.h"
+#include "dc_service.h"
+
+#include <deque>
+#include <list>
+#include <set>
+#include <string>
+
+class CollectorSubscriptions;
+
+// One client connection of the SUBSCRIBE_ADS command.  Events are sent
+// without blocking; while the client is slow to read them, they are
+// queued here, and the subscription is dropped if the queue grows too long.
+// The ads that match when the client subscribes are queued all at once,
+// followed by AD_EVENT_SYNCED, and do not count against that limit.
+class AdSubscription : public Service {
+public:
+	AdSubscription(CollectorSubscriptions & mgr, ReliSock * sock, ClassAd * query);
+	~AdSubscription();
+
+	const char * peer() const { return m_sock ? m_sock->peer_description() : "(closed)"; }
+
+		// Send the event this update means to this subscriber, if any.
+		// returns false if the subscriber should be dropped.
+	bool update(const ClassAd & ad, const std::string & key);
+	bool remove(const ClassAd & ad, const std::string & key);
+
+		// Send an event, or queue it if the client is behind
+	bool send(int event, const ClassAd & ad);
+
+		// Queue an ad that matches at the time of subscribing
+	void syncAd(const ClassAd & ad, const std::string & key);
+		// Queue AD_EVENT_SYNCED after the ads from syncAd() and start
+		// sending them.  returns false on failure
+	bool startSync();
+		// true until the client has been sent AD_EVENT_SYNCED
+	bool syncing() const { return m_sync_events > 0; }
+
+		// Try to send the queued events, returns false on failure
+	bool flush();
+	bool blocked() const { return m_unfinished_eom || ! m_backlog.empty(); }
+
+		// Socket handler, called when the client closes the connection
+	int peerClosed(Stream *);
+
+private:
+	friend class CollectorSubscriptions;
+
+	struct PendingEvent {
+		int event;
+		int num_lines;
+		std::string lines;
+	};
+
+	bool matches(const ClassAd & ad) const;
+	void queue(int event, const ClassAd & ad);
+	bool put(int event, const ClassAd & ad);
+	bool put(const PendingEvent & pe);
+	bool finish_put();
+
+	CollectorSubscriptions & m_mgr;
+	ReliSock * m_sock;
+	ClassAd * m_query;
+	std::string m_adType;
+	classad::ExprTree * m_filter;
+	classad::References m_projection;
+	std::set<std::string> m_keys;       // the ads that the subscriber thinks match
+	std::deque<PendingEvent> m_backlog;
+	size_t m_sync_events;               // events at the front of m_backlog from the initial sync
+	bool m_unfinished_eom;
+};
+
+// All of the subscriptions of the collector.  Fed from the same places
+// that notify collector plugins of updates, and from the engine when ads
+// are removed.
+class CollectorSubscriptions : public Service {
+public:
+	CollectorSubscriptions();
+
+	void config();
+
+		// Take over the socket of a SUBSCRIBE_ADS command and the query ad.
+		// returns NULL (and deletes the query) if the subscription is refused.
+	AdSubscription * subscribe(ReliSock * sock, ClassAd * query);
+
+		// close the connection of the subscription and delete it
+	void drop(AdSubscription * sub, const char * why);
+
+	void update(const ClassAd & ad);
+	void remove(const ClassAd & ad);
+
+	int numSubscriptions() const { return (int)m_subs.size(); }
+		// subscriptions still sending the ads that matched at first
+	int numSyncing() const;
+	size_t maxBacklog() const { return m_max_backlog; }
+	bool protectCollectorAds() const { return m_protect_collector_ads; }
+
+private:
+	friend class AdSubscription;
+
+	void forget(AdSubscription * sub);
+	void scheduleFlush();
+	void flushBlocked();
+
+	std::list<AdSubscription *> m_subs;
+	int m_max_subscriptions;
+	size_t m_max_backlog;
+	bool m_protect_collector_ads;
+	int m_flush_tid;
+};
+
+#endif
@@ -311,6 +311,60 @@ CollectorList::sendUpdates (int cmd, ClassAd * ad1, ClassAd* ad2, bool nonblocki
 	return success_count;
 }
 
+int
+CollectorList::sendBulkUpdates (int cmd, DCCollectorAdPairs & ads, bool nonblocking,
+	DCTokenRequester *token_requester, const std::string &identity,
+	const std::string authz_name)
+{
+	int success_count = 0;
+
+	if ( ! adSeq) {
+		adSeq = new DCCollectorAdSequences();
+	}
+
+	// advance the sequence numbers for these ads
+	//
+	time_t now = time(NULL);
+	for (auto it = ads.begin(); it != ads.end(); ++it) {
+		DCCollectorAdSeq * seqgen = adSeq->getAdSeq(*it->first);
+		if (seqgen) { seqgen->advance(now); }
+	}
+
+	this->rewind();
+	DCCollector * daemon;
+	while (this->next(daemon)) {
+		if (daemon->canSendBulkUpdate(cmd) && daemon->sendBulkUpdate(cmd, ads, *adSeq)) {
+			success_count++;
+			continue;
+		}
+
+			// no usable connection (yet), so send the ads one at a time;
+			// the first of these will establish a connection that the
+			// next bulk update can use.
+		dprintf( D_FULLDEBUG,
+				 "Trying to update collector %s with %d separate ads\n",
+				 daemon->addr(), (int)ads.size() );
+		bool all_sent = true;
+		for (auto it = ads.begin(); it != ads.end(); ++it) {
+			void *data = nullptr;
+			if (token_requester && daemon->name()) {
+				data = token_requester->createCallbackData(daemon->name(),
+					identity, authz_name);
+			}
+			if ( ! daemon->sendUpdate(cmd, it->first, *adSeq, it->second, nonblocking,
+				DCTokenRequester::daemonUpdateCallback, data) )
+			{
+				all_sent = false;
+			}
+		}
+		if (all_sent) {
+			success_count++;
+		}
+	}
+
+	return success_count;
+}
+
 QueryResult
 CollectorList::query (CondorQuery & cQuery, bool (*callback)(void*, ClassAd *), void* pv, CondorError * errstack) {
 
@@ -97,6 +97,9 @@ public:
 
 class DCCollectorAdSequences;
 
+// The public and private ads of the slots in a bulk update
+typedef std::vector< std::pair<ClassAd*, ClassAd*> > DCCollectorAdPairs;
+
 class CollectorList : public DaemonList {
  public:
 	CollectorList(DCCollectorAdSequences * adseq=NULL);
@@ -115,6 +118,14 @@ class CollectorList : public DaemonList {
 		DCTokenRequester *token_requester = nullptr, const std::string &identity = "",
 		const std::string authz_name = "");
 
+		// Send the ads of many slots to all the collectors, in a single
+		// message to each collector that supports it and one update per
+		// slot to the others.
+		// return - number of successfull updates
+	int sendBulkUpdates (int cmd, DCCollectorAdPairs & ads, bool nonblocking,
+		DCTokenRequester *token_requester = nullptr, const std::string &identity = "",
+		const std::string authz_name = "");
+
 		// use this to detach the ad sequence counters before destroying the collector list
 		// we do this when we want to move the sequence counters to a new list
 	DCCollectorAdSequences * detachAdSequences() { DCCollectorAdSequences * p = adSeq; adSeq = NULL; return p; }
@@ -51,6 +51,8 @@ DCCollector::init( bool needs_reconfig )
 	update_rsock = NULL;
 	use_tcp = true;
 	use_nonblocking_update = true;
+	use_delta_updates = false;
+	max_consecutive_deltas = 0;
 	update_destination = NULL;
 	timerclear( &m_blacklist_monitor_query_started );
 
@@ -107,6 +109,10 @@ DCCollector::deepCopy( const DCCollector& copy )
 
 	use_tcp = copy.use_tcp;
 	use_nonblocking_update = copy.use_nonblocking_update;
+	use_delta_updates = copy.use_delta_updates;
+	max_consecutive_deltas = copy.max_consecutive_deltas;
+		// the baselines belong to copy's update_rsock, so don't copy them
+	delta_baselines.clear();
 
 	up_type = copy.up_type;
 
@@ -226,6 +232,9 @@ void
 DCCollector::reconfig( void )
 {
 	use_nonblocking_update = param_boolean("NONBLOCKING_COLLECTOR_UPDATE",true);
+	use_delta_updates = param_boolean("UPDATE_COLLECTOR_WITH_DELTAS",false);
+	max_consecutive_deltas = param_integer("UPDATE_COLLECTOR_DELTA_LIMIT",10,0);
+	delta_baselines.clear();
 
 	if( ! _addr ) {
 		locate();
@@ -296,31 +305,21 @@ DCCollector::sendUpdate( int cmd, ClassAd* ad1, DCCollectorAdSequences& adSeq, C
 		nonblocking = false;
 	}
 
-	// Add start time & seq # to the ads before we publish 'em
-	if ( ad1 ) {
-		ad1->Assign(ATTR_DAEMON_START_TIME, startTime);
-		ad1->Assign(ATTR_DAEMON_LAST_RECONFIG_TIME, reconfigTime);
-	}
-	if ( ad2 ) {
-		ad2->Assign(ATTR_DAEMON_START_TIME, startTime);
-		ad2->Assign(ATTR_DAEMON_LAST_RECONFIG_TIME, reconfigTime);
-	}
-
-	if ( ad1 ) {
-		DCCollectorAdSeq* seqgen = adSeq.getAdSeq(*ad1);
-		if (seqgen) {
-			long long seq = seqgen->getSequence();
-			ad1->Assign(ATTR_UPDATE_SEQUENCE_NUMBER, seq);
-			if (ad2) { ad2->Assign(ATTR_UPDATE_SEQUENCE_NUMBER, seq); }
+	prepareUpdateAds( ad1, ad2, adSeq );
+
+		// Forget the delta baselines of slots that are going away,
+		// there will be no more updates for them.
+	if ( cmd == INVALIDATE_STARTD_ADS && ad1 && ! delta_baselines.empty() ) {
+		std::string prefix;
+		if ( ad1->LookupString(ATTR_NAME, prefix) ) {
+			prefix += "\n";
+			auto it = delta_baselines.lower_bound(prefix);
+			while ( it != delta_baselines.end() && it->first.compare(0, prefix.size(), prefix) == 0 ) {
+				it = delta_baselines.erase(it);
+			}
 		}
 	}
 
-		// Prior to 7.2.0, the negotiator depended on the startd
-		// supplying matching MyAddress in public and private ads.
-	if ( ad1 && ad2 ) {
-		CopyAttribute(ATTR_MY_ADDRESS,*ad2,*ad1);
-	}
-
 		// We never want to try sending an update to port 0.  If we're
 		// about to try that, and we're trying to talk to a local
 		// collector, we should try re-reading the address file and
@@ -384,6 +383,103 @@ DCCollector::sendUpdate( int cmd, ClassAd* ad1, DCCollectorAdSequences& adSeq, C
 
 
 
+void
+DCCollector::prepareUpdateAds( ClassAd* ad1, ClassAd* ad2, DCCollectorAdSequences& adSeq )
+{
+	// Add start time & seq # to the ads before we publish 'em
+	if ( ad1 ) {
+		ad1->Assign(ATTR_DAEMON_START_TIME, startTime);
+		ad1->Assign(ATTR_DAEMON_LAST_RECONFIG_TIME, reconfigTime);
+	}
+	if ( ad2 ) {
+		ad2->Assign(ATTR_DAEMON_START_TIME, startTime);
+		ad2->Assign(ATTR_DAEMON_LAST_RECONFIG_TIME, reconfigTime);
+	}
+
+	if ( ad1 ) {
+		DCCollectorAdSeq* seqgen = adSeq.getAdSeq(*ad1);
+		if (seqgen) {
+			long long seq = seqgen->getSequence();
+			ad1->Assign(ATTR_UPDATE_SEQUENCE_NUMBER, seq);
+			if (ad2) { ad2->Assign(ATTR_UPDATE_SEQUENCE_NUMBER, seq); }
+		}
+	}
+
+		// Prior to 7.2.0, the negotiator depended on the startd
+		// supplying matching MyAddress in public and private ads.
+	if ( ad1 && ad2 ) {
+		CopyAttribute(ATTR_MY_ADDRESS,*ad2,*ad1);
+	}
+}
+
+
+bool
+DCCollector::canSendBulkUpdate( int cmd )
+{
+	if ( ! _is_configured || ! use_tcp || ! update_rsock || cmd != UPDATE_STARTD_AD ) {
+		return false;
+	}
+		// only collectors that know about UPDATE_STARTD_AD_BULK
+	auto *verinfo = update_rsock->get_peer_version();
+	return verinfo && verinfo->built_since_version(8, 9, 10);
+}
+
+
+bool
+DCCollector::sendBulkUpdate( int cmd, DCCollectorAdPairs & ads, DCCollectorAdSequences& adSeq )
+{
+	if ( ! canSendBulkUpdate(cmd) ) {
+		return false;
+	}
+
+	for ( auto it = ads.begin(); it != ads.end(); ++it ) {
+		if ( ! it->first || ! it->second ) {
+			return false;
+		}
+		prepareUpdateAds( it->first, it->second, adSeq );
+	}
+
+	dprintf( D_FULLDEBUG,
+			 "Attempting to send bulk update of %d ads via TCP to collector %s\n",
+			 (int)ads.size(), update_destination );
+
+		// public ads never carry secrets, the private ads always do;
+		// see finishUpdate() for the rules used for single updates.
+	bool ok = true;
+	update_rsock->encode();
+	if ( ! update_rsock->put(UPDATE_STARTD_AD_BULK) || ! update_rsock->put((int)ads.size()) ) {
+		ok = false;
+	}
+	for ( auto it = ads.begin(); ok && it != ads.end(); ++it ) {
+		if ( ! putClassAd(update_rsock, *it->first, PUT_CLASSAD_NO_PRIVATE) ||
+			 ! putClassAd(update_rsock, *it->second, 0) )
+		{
+			ok = false;
+		}
+	}
+	if ( ok && ! update_rsock->end_of_message() ) {
+		ok = false;
+	}
+
+	if ( ! ok ) {
+		newError( CA_COMMUNICATION_ERROR,
+				  "Failed to send bulk update to collector" );
+		dprintf( D_FULLDEBUG, "Couldn't send bulk update on cached TCP socket "
+				 "to collector %s, closing it\n", update_destination );
+		delete update_rsock;
+		update_rsock = NULL;
+		delta_baselines.clear();
+		return false;
+	}
+
+		// the collector now has the full ads, so deltas start over from these
+	for ( auto it = ads.begin(); it != ads.end(); ++it ) {
+		rememberDeltaBaseline( *it->first, false );
+	}
+	return true;
+}
+
+
 bool
 DCCollector::finishUpdate( DCCollector *self, Sock* sock, ClassAd* ad1, ClassAd* ad2, StartCommandCallbackType callback_fn, void *miscdata )
 {
@@ -685,8 +781,17 @@ DCCollector::sendTCPUpdate( int cmd, ClassAd* ad1, ClassAd* ad2, bool nonblockin
 		// since finishUpdate() assumes we've already sent the command
 		// int, and since we do *NOT* want to use startCommand() again
 		// on a cached TCP socket, just code the int ourselves...
+		// if the collector has already seen a full ad for this slot on this
+		// socket, we can send just the attributes that changed since then.
+	ClassAd delta_ad;
+	bool send_delta = (cmd == UPDATE_STARTD_AD) && ad1 && makeDeltaAd(*ad1, delta_ad);
 	update_rsock->encode();
-	if (update_rsock->put(cmd) && finishUpdate(this, update_rsock, ad1, ad2, callback_fn, miscdata)) {
+	if (update_rsock->put(send_delta ? UPDATE_STARTD_AD_DELTA : cmd) &&
+		finishUpdate(this, update_rsock, send_delta ? &delta_ad : ad1, ad2, callback_fn, miscdata))
+	{
+		if (cmd == UPDATE_STARTD_AD && ad1) {
+			rememberDeltaBaseline(*ad1, send_delta);
+		}
 		if (callback_fn) {
 			(*callback_fn)(true, update_rsock, nullptr, update_rsock->getTrustDomain(), update_rsock->shouldTryTokenRequest(), miscdata);
 		}
@@ -709,6 +814,13 @@ DCCollector::initiateTCPUpdate( int cmd, ClassAd* ad1, ClassAd* ad2, bool nonblo
 		delete update_rsock;
 		update_rsock = NULL;
 	}
+		// a new connection may be to a collector that has never seen
+		// our ads, so deltas must start over with full ads.
+	delta_baselines.clear();
+	if (cmd == UPDATE_STARTD_AD && ad1) {
+		rememberDeltaBaseline(*ad1, false);
+	}
+
 	if(nonblocking) {
 		UpdateData *ud = new UpdateData(cmd, Sock::reli_sock, ad1, ad2, this, callback_fn, miscdata);
 			// Note that UpdateData automatically adds itself to the pending_update_list.
@@ -722,6 +834,7 @@ DCCollector::initiateTCPUpdate( int cmd, ClassAd* ad1, ClassAd* ad2, bool nonblo
 	Sock *sock = startCommand(cmd, Sock::reli_sock, 20);
 
 	if(!sock) {
+		delta_baselines.clear();
 		newError( CA_COMMUNICATION_ERROR,
 				  "Failed to send TCP update command to collector" );
 		dprintf(D_ALWAYS,"Failed to send update to %s.\n",idStr());
@@ -735,6 +848,87 @@ DCCollector::initiateTCPUpdate( int cmd, ClassAd* ad1, ClassAd* ad2, bool nonblo
 }
 
 
+bool
+DCCollector::makeDeltaAd( ClassAd & ad, ClassAd & delta )
+{
+	if ( ! use_delta_updates || ! update_rsock ) {
+		return false;
+	}
+
+		// only collectors that know about UPDATE_STARTD_AD_DELTA
+	auto *verinfo = update_rsock->get_peer_version();
+	if ( ! verinfo || ! verinfo->built_since_version(8, 9, 10) ) {
+		return false;
+	}
+
+	std::string key;
+	DCCollectorAdSequences::makeAdKey(ad, key);
+	auto found = delta_baselines.find(key);
+	if ( found == delta_baselines.end() ) {
+		return false;
+	}
+	DeltaBaseline & base = found->second;
+	if ( base.deltas_sent >= max_consecutive_deltas ) {
+			// time for a full update, so that anything the collector
+			// may have merged into its copy of the ad gets replaced
+		return false;
+	}
+
+	delta.Clear();
+	for ( auto it = ad.begin(); it != ad.end(); ++it ) {
+		ExprTree * old_expr = base.ad.Lookup(it->first);
+		if ( ! old_expr || ! old_expr->SameAs(it->second) ) {
+			delta.Insert(it->first, it->second->Copy());
+		}
+	}
+
+	std::string removed;
+	for ( auto it = base.ad.begin(); it != base.ad.end(); ++it ) {
+		if ( ! ad.Lookup(it->first) ) {
+			if ( ! removed.empty() ) { removed += ","; }
+			removed += it->first;
+		}
+	}
+	if ( ! removed.empty() ) {
+		delta.Assign(ATTR_UPDATE_DELTA_REMOVED, removed);
+	}
+
+		// The collector needs these to find the ad that the delta applies to
+		// and to check that it has not missed an update in between.
+	static const char * const key_attrs[] = {
+		ATTR_MY_TYPE, ATTR_TARGET_TYPE, ATTR_NAME, ATTR_MACHINE, ATTR_SLOT_ID,
+		ATTR_MY_ADDRESS, ATTR_STARTD_IP_ADDR, ATTR_DAEMON_START_TIME,
+	};
+	for ( size_t i = 0; i < COUNTOF(key_attrs); ++i ) {
+		if ( ! delta.Lookup(key_attrs[i]) && ad.Lookup(key_attrs[i]) ) {
+			CopyAttribute(key_attrs[i], delta, ad);
+		}
+	}
+	delta.Assign(ATTR_UPDATE_DELTA_BASE, base.seq);
+
+	dprintf( D_FULLDEBUG, "Sending delta update of %d of %d attributes for %s\n",
+			 delta.size(), ad.size(), key.c_str() );
+	return true;
+}
+
+
+void
+DCCollector::rememberDeltaBaseline( const ClassAd & ad, bool was_delta )
+{
+	if ( ! use_delta_updates ) {
+		return;
+	}
+
+	std::string key;
+	DCCollectorAdSequences::makeAdKey(ad, key);
+	DeltaBaseline & base = delta_baselines[key];
+	base.ad = ad;
+	base.seq = 0;
+	ad.LookupInteger(ATTR_UPDATE_SEQUENCE_NUMBER, base.seq);
+	base.deltas_sent = was_delta ? base.deltas_sent + 1 : 0;
+}
+
+
 void
 DCCollector::displayResults( void )
 {
@@ -778,19 +972,64 @@ DCCollector::initDestinationStrings( void )
 }
 
 
+ReliSock*
+DCCollector::subscribe( const ClassAd & query, CondorError * errstack )
+{
+	ReliSock * sock = reliSock( 20, 0, errstack );
+	if ( ! sock) {
+		dprintf( D_ALWAYS, "DCCollector::subscribe() failed to connect "
+			"to collector at '%s'\n", _addr ? _addr : "(unknown)" );
+		return NULL;
+	}
+
+	if ( ! startCommand(SUBSCRIBE_ADS, sock, 20, errstack) ||
+		 ! putClassAd(sock, query) || ! sock->end_of_message()) {
+		dprintf( D_ALWAYS, "DCCollector::subscribe() failed to send "
+			"subscription to collector at '%s'\n", _addr ? _addr : "(unknown)" );
+		delete sock;
+		return NULL;
+	}
+
+		// events arrive whenever the pool changes, so don't time out
+		// waiting for them.
+	sock->timeout( 0 );
+	sock->decode();
+	return sock;
+}
+
+bool
+DCCollector::readAdEvent( ReliSock * sock, int & event, ClassAd & ad )
+{
+	ad.Clear();
+	sock->decode();
+	if ( ! sock->code(event) || ! getClassAd(sock, ad) || ! sock->end_of_message()) {
+		return false;
+	}
+	return true;
+}
+
 //
 // Ad Sequence Number class methods
 //
 
-// Get a sequence number class for this classad, creating it if needed.
-DCCollectorAdSeq* DCCollectorAdSequences::getAdSeq(const ClassAd & ad)
+// Build the key that identifies an ad across updates.
+void DCCollectorAdSequences::makeAdKey(const ClassAd & ad, std::string & key)
 {
-	std::string name, attr;
-	ad.LookupString( ATTR_NAME, name );
+	std::string attr;
+	key.clear();
+	ad.LookupString( ATTR_NAME, key );
 	ad.LookupString( ATTR_MY_TYPE, attr );
-	name += "\n"; name += attr;
+	key += "\n"; key += attr;
+	attr.clear();
 	ad.LookupString( ATTR_MACHINE, attr );
-	name += "\n"; name += attr;
+	key += "\n"; key += attr;
+}
+
+// Get a sequence number class for this classad, creating it if needed.
+DCCollectorAdSeq* DCCollectorAdSequences::getAdSeq(const ClassAd & ad)
+{
+	std::string name;
+	makeAdKey(ad, name);
 
 	DCCollectorAdSeqMap::iterator it = seqs.find(name);
 	if (it != seqs.end()) {
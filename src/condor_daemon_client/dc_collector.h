@@ -50,10 +50,21 @@ protected:
 	time_t    last_advance; // last time advance was called (for garbage collection if we ever want to do that)
 };
 
+// Events sent by the collector to a SUBSCRIBE_ADS client.  Each event is
+// one message holding the event code followed by a ClassAd.
+enum CollectorAdEvent {
+	AD_EVENT_ADD = 1,     // an ad now matches the subscription
+	AD_EVENT_MODIFY = 2,  // an ad that matched has been updated
+	AD_EVENT_REMOVE = 3,  // an ad that matched was removed or no longer matches
+	AD_EVENT_SYNCED = 4,  // all ads that matched when subscribing have been sent, the ad is empty
+};
+
 typedef std::map<std::string, DCCollectorAdSeq> DCCollectorAdSeqMap;
 class DCCollectorAdSequences {
 public:
 	DCCollectorAdSeq* getAdSeq(const ClassAd & ad);
+	// build the key used to identify an ad across updates (Name, MyType & Machine)
+	static void makeAdKey(const ClassAd & ad, std::string & key);
 private:
 	DCCollectorAdSeqMap seqs;
 };
@@ -95,6 +106,22 @@ public:
 		*/
 	bool sendUpdate( int cmd, ClassAd* ad1, DCCollectorAdSequences& seq, ClassAd* ad2, bool nonblocking, StartCommandCallbackType=nullptr, void *miscdata=nullptr );
 
+		/** Can the ads of many slots be sent to this collector in a
+			single UPDATE_STARTD_AD_BULK message right now?  Only true
+			when we already have a TCP connection to a collector that
+			understands the command.
+		*/
+	bool canSendBulkUpdate( int cmd );
+
+		/** Send the public and private ads of many slots to this
+			collector in one message.  The collector applies all of
+			them, or none of them.  On failure the cached TCP socket is
+			closed and the caller should fall back to sendUpdate().
+			@param cmd The per-ad command, must be UPDATE_STARTD_AD
+			@param ads The public and private ad of each slot
+		*/
+	bool sendBulkUpdate( int cmd, DCCollectorAdPairs & ads, DCCollectorAdSequences& seq );
+
 	void reconfig( void );
 
 	const char* updateDestination( void );
@@ -104,6 +131,7 @@ public:
 	void blacklistMonitorQueryFinished( bool success );
 
 	bool useTCPForUpdates() const { return use_tcp; }
+	bool useDeltaUpdates() const { return use_delta_updates; }
 
 	time_t getStartTime() const { return startTime; }
 	time_t getReconfigTime() const { return reconfigTime; }
@@ -115,18 +143,49 @@ public:
 		const std::vector<std::string> &authz_bounding_set,
 		int lifetime, std::string &token, CondorError &err);
 
+		/** Subscribe to changes of the ads that match the query ad,
+			which has the same form as a QUERY_ANY_ADS query.  The
+			collector first sends an AD_EVENT_ADD for each matching ad,
+			then AD_EVENT_SYNCED, and then events as ads change.
+			@return the socket to read events from with readAdEvent(),
+			or NULL on failure.  The caller must delete the socket.
+		*/
+	ReliSock* subscribe( const ClassAd & query, CondorError * errstack = NULL );
+
+		/** Read the next event from a socket returned by subscribe().
+			Blocks until an event arrives or the socket times out.
+		*/
+	static bool readAdEvent( ReliSock * sock, int & event, ClassAd & ad );
+
 private:
 
 	void init( bool needs_reconfig );
 
 	void deepCopy( const DCCollector& copy );
 
+	void prepareUpdateAds( ClassAd* ad1, ClassAd* ad2, DCCollectorAdSequences& adSeq );
+
 	ReliSock* update_rsock;
 
 	bool use_tcp;
 	bool use_nonblocking_update;
+	bool use_delta_updates;
+	int  max_consecutive_deltas;
 	UpdateType up_type;
 
+		// The last startd ad sent over update_rsock for each slot, so that
+		// the next update can be sent as a delta against it.
+	struct DeltaBaseline {
+		DeltaBaseline() : seq(0), deltas_sent(0) {}
+		ClassAd ad;
+		long long seq;
+		int deltas_sent;
+	};
+	std::map<std::string, DeltaBaseline> delta_baselines;
+
+	bool makeDeltaAd( ClassAd & ad, ClassAd & delta );
+	void rememberDeltaBaseline( const ClassAd & ad, bool was_delta );
+
 	std::deque<class UpdateData*> pending_update_list;
 	friend class UpdateData;
 
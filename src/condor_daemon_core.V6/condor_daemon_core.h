@@ -1512,6 +1512,18 @@ class DaemonCore : public Service
 		DCTokenRequester *requester = nullptr, const std::string &identity = "",
 		const std::string &authz_name = "");
 
+		/**
+		   Like sendUpdates(), but sends the public and private ads
+		   of many slots at once, in a single message to each collector
+		   that supports bulk updates.
+		   @param cmd The per-ad update command (UPDATE_STARTD_AD)
+		   @param ads The public and private ClassAd of each slot.
+		   @return The number of collectors that were updated.
+		*/
+	int sendBulkUpdates(int cmd, DCCollectorAdPairs & ads, bool nonblock = false,
+		DCTokenRequester *requester = nullptr, const std::string &identity = "",
+		const std::string &authz_name = "");
+
 	DCCollectorAdSequences & getUpdateAdSeq() { return m_collector_list->getAdSeq(); }
 
 	bool getStartTime(int & startTime);
@@ -2148,6 +2160,11 @@ class DaemonCore : public Service
 	bool evalExpr( ClassAd* ad, const char* param_name,
 				   const char* attr_name, const char* message );
 
+		/** Evaluate DAEMON_SHUTDOWN and DAEMON_SHUTDOWN_FAST against
+			the given update ad, and start shutting down if either is TRUE.
+		*/
+	void checkDaemonShutdown( ClassAd* ad );
+
 	CollectorList* m_collector_list;
 
 		/**
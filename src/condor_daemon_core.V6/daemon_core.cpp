@@ -10981,6 +10981,32 @@ DaemonCore::sendUpdates( int cmd, ClassAd* ad1, ClassAd* ad2, bool nonblock,
 	ASSERT(ad1);
 	ASSERT(m_collector_list);
 
+	checkDaemonShutdown(ad1);
+
+		// Even if we just decided to shut ourselves down, we should
+		// still send the updates originally requested by the caller.
+	return m_collector_list->sendUpdates(cmd, ad1, ad2, nonblock, token_requester,
+		identity, authz_name);
+}
+
+int
+DaemonCore::sendBulkUpdates( int cmd, DCCollectorAdPairs & ads, bool nonblock,
+	DCTokenRequester *token_requester, const std::string &identity, const std::string &authz_name )
+{
+	ASSERT(m_collector_list);
+	if (ads.empty()) {
+		return 0;
+	}
+
+	checkDaemonShutdown(ads.front().first);
+
+	return m_collector_list->sendBulkUpdates(cmd, ads, nonblock, token_requester,
+		identity, authz_name);
+}
+
+void
+DaemonCore::checkDaemonShutdown( ClassAd *ad1 )
+{
 		// Now's our chance to evaluate the DAEMON_SHUTDOWN expressions.
 	if (!m_in_daemon_shutdown_fast &&
 		evalExpr(ad1, "DAEMON_SHUTDOWN_FAST", ATTR_DAEMON_SHUTDOWN_FAST,
@@ -10997,11 +11023,6 @@ DaemonCore::sendUpdates( int cmd, ClassAd* ad1, ClassAd* ad2, bool nonblock,
 		m_in_daemon_shutdown = true;
 		daemonCore->Send_Signal( daemonCore->getpid(), SIGTERM );
 	}
-
-		// Even if we just decided to shut ourselves down, we should
-		// still send the updates originally requested by the caller.
-	return m_collector_list->sendUpdates(cmd, ad1, ad2, nonblock, token_requester,
-		identity, authz_name);
 }
 
 
@@ -418,6 +418,9 @@
 #define ATTR_JOB_UNIVERSE  "JobUniverse"
 #define ATTR_JOB_WALL_CLOCK_CKPT  "WallClockCheckpoint"
 #define ATTR_JOB_QUEUE_BIRTHDATE  "JobQueueBirthdate"
+#define ATTR_JOB_QUEUE_RECOVERY_RECORDS  "JobQueueRecoveryRecords"
+#define ATTR_JOB_QUEUE_RECOVERY_THREADS  "JobQueueRecoveryThreads"
+#define ATTR_JOB_QUEUE_RECOVERY_TIME  "JobQueueRecoveryTime"
 #define ATTR_JOB_REQUIRES_SANDBOX  "JobRequiresSandbox"
 #define ATTR_JOB_VM_TYPE  "JobVMType"
 #define ATTR_JOB_VM_MEMORY  "JobVMMemory"
@@ -747,6 +750,8 @@
 #define ATTR_CLASSAD_LIFETIME  "ClassAdLifetime"
 #define ATTR_UPDATE_PRIO  "UpdatePrio"
 #define ATTR_UPDATE_SEQUENCE_NUMBER  "UpdateSequenceNumber"
+#define ATTR_UPDATE_DELTA_BASE  "UpdateDeltaBase"
+#define ATTR_UPDATE_DELTA_REMOVED  "UpdateDeltaRemoved"
 #define ATTR_USE_GRID_SHELL  "UseGridShell"
 #define ATTR_USE_PARROT  "UseParrot"
 #define ATTR_USER  "User"
@@ -783,6 +788,13 @@
 #define ATTR_NUM_HOSTS_CLAIMED  "HostsClaimed"
 #define ATTR_NUM_HOSTS_UNCLAIMED  "HostsUnclaimed"
 #define ATTR_NUM_HOSTS_OWNER  "HostsOwner"
+#define ATTR_NUM_HOSTS_MATCHED  "HostsMatched"
+#define ATTR_NUM_HOSTS_PREEMPTING  "HostsPreempting"
+#define ATTR_NUM_HOSTS_BACKFILL  "HostsBackfill"
+#define ATTR_NUM_HOSTS_DRAINED  "HostsDrained"
+#define ATTR_NUM_HOSTS_MALFORMED  "HostsMalformed"
+#define ATTR_SUMMARY_ONLY  "SummaryOnly"
+#define ATTR_SUMMARY_KEY  "SummaryKey"
 #define ATTR_MAX_RUNNING_JOBS  "MaxRunningJobs"
 #define ATTR_VERSION					AttrGetName( ATTRE_VERSION )
 #define ATTR_SHADOW_VERSION  "ShadowVersion"
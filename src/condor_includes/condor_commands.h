@@ -348,6 +348,15 @@ const int UPDATE_OWN_SUBMITTOR_AD = 80;
 // Request a collector to retrieve an identity token from a schedd.
 const int IMPERSONATION_TOKEN_REQUEST = 81;
 
+// Update a startd ad with only the attributes that changed since the
+// update identified by ATTR_UPDATE_DELTA_BASE.
+const int UPDATE_STARTD_AD_DELTA = 82;
+// Update the public and private ads of many startd slots in one message.
+const int UPDATE_STARTD_AD_BULK = 83;
+// Register a query and receive add, modify and remove events for the
+// matching ads over the same connection.
+const int SUBSCRIBE_ADS = 84;
+
 /* these comments are used to control command_table_generator.pl
 NAMETABLE_DIRECTIVE:END_SECTION:collector
 */
@@ -46,7 +46,8 @@ private:
 };
 
 JobCluster::JobCluster()
-	: next_id(1)
+	: cache_cluster_ad_sigs(false)
+	, next_id(1)
 	, significant_attrs(NULL)
 #ifdef USE_AUTOCLUSTER_TO_JOBID_MAP
 	, keep_job_ids(false)
@@ -64,6 +65,8 @@ JobCluster::~JobCluster()
 void JobCluster::clear()
 {
 	cluster_map.clear();
+	cluster_hashes.clear();
+	cluster_ad_sigs.clear();
 #ifdef USE_AUTOCLUSTER_TO_JOBID_MAP
 	cluster_use.clear();
 	cluster_gone.clear();
@@ -133,6 +136,19 @@ bool JobCluster::setSigAttrs(const char* new_sig_attrs, bool free_input_attrs, b
 	return sig_attrs_changed;
 }
 
+void JobCluster::erase_signature(JobSigidMap::iterator it)
+{
+	size_t hash = std::hash<std::string>()(it->first);
+	auto range = cluster_hashes.equal_range(hash);
+	for (auto ht = range.first; ht != range.second; ++ht) {
+		if (ht->second == it) {
+			cluster_hashes.erase(ht);
+			break;
+		}
+	}
+	cluster_map.erase(it);
+}
+
 #ifdef USE_AUTOCLUSTER_TO_JOBID_MAP
 
 // lookup the autocluster for a job (assumes job.autocluster_id is valid)
@@ -195,7 +211,7 @@ void JobCluster::collect_garbage(bool brute_force) // free the deleted clusters
 		}
 		// advance here so that we can erase the previous entry if needed.
 		JobSigidMap::iterator last = it++;
-		if (gone) { cluster_map.erase(last); }
+		if (gone) { erase_signature(last); }
 	}
 	cluster_gone.clear();
 }
@@ -262,6 +278,26 @@ int JobCluster::getClusterid(JobQueueJob & job, bool expand_refs, std::string *
 	classad::ClassAdUnParser unp;
 	unp.SetOldClassAd( true, true );
 
+	// values that the job gets from its cluster ad are unparsed once per cluster ad
+	ClusterAdSig * cluster_sig = NULL;
+	if (cache_cluster_ad_sigs && job.Cluster()) {
+		cluster_sig = &cluster_ad_sigs[job.jid.cluster];
+		cluster_sig->in_use = true;
+	}
+	auto append_value = [&](const std::string & name, ExprTree * tree) {
+		if ( ! tree) return;
+		if (cluster_sig && ! job.LookupIgnoreChain(name)) {
+			auto vt = cluster_sig->values.find(name);
+			if (vt == cluster_sig->values.end()) {
+				vt = cluster_sig->values.insert(std::make_pair(name, std::string())).first;
+				unp.Unparse(vt->second, tree);
+			}
+			signature += vt->second;
+		} else {
+			unp.Unparse(signature, tree);
+		}
+	};
+
 	// first put the pre-defined significant attrs in the sig
 	list.rewind();
 	int ix = 0;
@@ -269,7 +305,7 @@ int JobCluster::getClusterid(JobQueueJob & job, bool expand_refs, std::string *
 		ExprTree * tree = sigset[ix];
 		signature += *attr;
 		signature += " = ";
-		if (tree) { unp.Unparse(signature, tree); }
+		append_value(*attr, tree);
 		signature += '\n';
 		if (final_list) {
 			if (need_sep) { (*final_list) += ','; }
@@ -284,7 +320,7 @@ int JobCluster::getClusterid(JobQueueJob & job, bool expand_refs, std::string *
 		ExprTree * tree = sigset[ix];
 		signature += *it;
 		signature += " = ";
-		if (tree) { unp.Unparse(signature, tree); }
+		append_value(*it, tree);
 		signature += '\n';
 		if (final_list) {
 			if (need_sep) { (*final_list) += ','; }
@@ -296,14 +332,23 @@ int JobCluster::getClusterid(JobQueueJob & job, bool expand_refs, std::string *
 
 	// now check the signature against the current cluster map
 	// and either return the matching cluster id, or a new cluster id.
-	JobSigidMap::iterator it;
-	it = cluster_map.find(signature);
+	// the signatures share long prefixes, so look them up by hash first.
+	size_t hash = std::hash<std::string>()(signature);
+	JobSigidMap::iterator it = cluster_map.end();
+	std::pair<JobSigHashMap::iterator, JobSigHashMap::iterator> range = cluster_hashes.equal_range(hash);
+	for (JobSigHashMap::iterator ht = range.first; ht != range.second; ++ht) {
+		if (ht->second->first == signature) {
+			it = ht->second;
+			break;
+		}
+	}
 	if (it != cluster_map.end()) {
 		cur_id = it->second;
 	}
 	else {
 		cur_id = next_id++;
-		cluster_map.insert(JobSigidMap::value_type(signature,cur_id));
+		it = cluster_map.insert(JobSigidMap::value_type(signature,cur_id)).first;
+		cluster_hashes.insert(JobSigHashMap::value_type(hash, it));
 	}
 
 #ifdef USE_AUTOCLUSTER_TO_JOBID_MAP
@@ -333,6 +378,7 @@ int JobCluster::getClusterid(JobQueueJob & job, bool expand_refs, std::string *
 AutoCluster::AutoCluster()
 	: sig_attrs_came_from_config_file(false)
 {
+	this->cache_cluster_ad_sigs = true;
 #ifdef USE_AUTOCLUSTER_TO_JOBID_MAP
 	this->keep_job_ids = true;
 #endif
@@ -549,7 +595,18 @@ void AutoCluster::sweep()
 		if (in_use == cluster_in_use.end()) {
 				// found an entry to remove.
 			dprintf(D_FULLDEBUG,"removing auto cluster id %d\n",id);
-			cluster_map.erase( it );
+			erase_signature( it );
+		}
+	}
+
+		// forget the cached signature values of cluster ads that were not
+		// used since mark(), their clusters are likely gone or done.
+	for (ClusterAdSigMap::iterator ct = cluster_ad_sigs.begin(); ct != cluster_ad_sigs.end(); ) {
+		if (ct->second.in_use) {
+			ct->second.in_use = false;
+			++ct;
+		} else {
+			ct = cluster_ad_sigs.erase(ct);
 		}
 	}
 }
@@ -607,11 +664,20 @@ int AutoCluster::getAutoClusterid(JobQueueJob *job)
 		// the signature needs to be recomputed as it may have changed.
 	job->Assign(ATTR_AUTO_CLUSTER_ATTRS, final_list);
 
+		// neither Assign() above is logged, so tell the job queue snapshots
+	JobQueueAdChangedInPlace(job->jid);
+
 	return cur_id;
 }
 
 bool AutoCluster::preSetAttribute(JobQueueJob &job, const char * attr, const char * /*value*/, int /*flags*/)
 {
+	// the cached values of a cluster ad are dropped when the change is
+	// committed, see clusterAdChanged()
+	if (job.IsCluster()) {
+		return false;
+	}
+
 	// If any of the attrs used to create the signature are
 	// changed, then delete the ATTR_AUTO_CLUSTER_ID, since
 	// the signature needs to be recomputed as it may have changed.
@@ -651,6 +717,7 @@ void AutoCluster::removeFromAutocluster(JobQueueJob &job)
 		job.Delete(ATTR_AUTO_CLUSTER_ID);
 		job.Delete(ATTR_AUTO_CLUSTER_ATTRS);
 		job.autocluster_id = -1;
+		JobQueueAdChangedInPlace(job.jid);
 	}
 }
 
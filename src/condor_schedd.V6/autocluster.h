@@ -26,6 +26,7 @@
 
 #include "condor_classad.h"
 #include <generic_stats.h>
+#include <unordered_map>
 
 class JobIdSet;
 class JobAggregationResults;
@@ -52,6 +53,23 @@ protected:
 	friend class JobAggregationResults;
 	typedef std::map<std::string,int> JobSigidMap;
 	JobSigidMap cluster_map;  // map of signature to a cluster id
+	// the entries of cluster_map by the hash of their signature, so that finding
+	// the cluster id of a job only compares whole signatures when the hashes match.
+	typedef std::unordered_multimap<size_t, JobSigidMap::iterator> JobSigHashMap;
+	JobSigHashMap cluster_hashes;
+	void erase_signature(JobSigidMap::iterator it); // remove from both of the above
+
+	// the unparsed values of the significant attributes of cluster ads, so that
+	// making the signature of a job only unparses the attributes that its own ad sets.
+	// an entry is dropped when a change to its cluster ad is committed, see AutoCluster::clusterAdChanged()
+	struct ClusterAdSig {
+		bool in_use; // used since the last AutoCluster::sweep()
+		std::map<std::string, std::string, classad::CaseIgnLTStr> values; // attr -> unparsed value
+		ClusterAdSig() : in_use(true) {}
+	};
+	typedef std::map<int, ClusterAdSig> ClusterAdSigMap;
+	ClusterAdSigMap cluster_ad_sigs;
+	bool cache_cluster_ad_sigs;
 #ifdef USE_AUTOCLUSTER_TO_JOBID_MAP
 	typedef std::map<int, JobIdSet> JobIdSetMap;
 	JobIdSetMap cluster_use; // map clusterId to a set of jobIds
@@ -137,11 +155,17 @@ public:
 	JobAggregationResults * aggregateOn(bool use_default, const char * projection, int result_limit, classad::ExprTree * constraint);
 
 	/** called just before setAttribute sets an attribute value so that we can decide whether
-	  * or not to invalidate the autocluster
+	  * or not to invalidate the autocluster, or the cached signature values of a cluster ad.
+	  * Also called just before an attribute is deleted, with a NULL value.
 	  * Returns true if job was removed from its autocluster.
 	  */
 	bool preSetAttribute(JobQueueJob & job, const char * attr, const char * value, int flags);
 
+	/** called after a transaction that changed a cluster ad is committed, so that the
+	  * jobs of the cluster unparse the values they get from the cluster ad again.
+	  */
+	void clusterAdChanged(int cluster) { cluster_ad_sigs.erase(cluster); }
+
 	/** Unconditionally remove a job from its assigned autocluster.
 	 */
 	void removeFromAutocluster(JobQueueJob &job);
@@ -0,0 +1,204 @@
+/***************************************************************
+ *
+ * Copyright (C) 1990-2020, Condor Team, Computer Sciences Department,
+ * University of Wisconsin-Madison, WI.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You may
+ * obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************/
+
+#include "condor_common.h"
+#include "condor_debug.h"
+#include "condor_attributes.h"
+#include "compat_classad_util.h"
+#include "qmgmt.h"
+#include "job_queue_index.h"
+
+#include <algorithm>
+#include <iterator>
+
+bool
+JobQueueIndexes::IsIndexedAttr(const char * attr)
+{
+	return MATCH == strcasecmp(attr, ATTR_OWNER) ||
+		MATCH == strcasecmp(attr, ATTR_USER) ||
+		MATCH == strcasecmp(attr, ATTR_JOB_STATUS) ||
+		MATCH == strcasecmp(attr, ATTR_DAGMAN_JOB_ID);
+}
+
+// returns true if the job has the attribute, and sets other if it is not a literal string
+static bool
+index_value(JobQueueJob * job, const char * attr, std::string & value, bool & other)
+{
+	classad::ExprTree * tree = job->Lookup(attr);
+	if ( ! tree) {
+		return false;
+	}
+	other = ! ExprTreeIsLiteralString(tree, value);
+	return true;
+}
+
+// returns true if the job has the attribute, and sets other if it is not a literal integer
+static bool
+index_value(JobQueueJob * job, const char * attr, long long & value, bool & other)
+{
+	classad::ExprTree * tree = job->Lookup(attr);
+	if ( ! tree) {
+		return false;
+	}
+	classad::Value val;
+	other = ! ExprTreeIsLiteral(tree, val) || ! val.IsIntegerValue(value);
+	return true;
+}
+
+template <typename T, typename C>
+static const typename JobAttrIndex<T,C>::Entry *
+add_to_index(JobAttrIndex<T,C> & index, JobQueueJob * job, const char * attr, int cluster)
+{
+	T value = T();
+	bool other = false;
+	if ( ! index_value(job, attr, value, other)) {
+		return NULL;
+	}
+	return index.Add(value, other, cluster);
+}
+
+void
+JobQueueIndexes::IndexJob(JobQueueJob * job)
+{
+	Remove(job);
+
+	JobQueueIndexEntry * entry = new JobQueueIndexEntry;
+	entry->cluster = job->jid.cluster;
+	entry->orphan = job->Cluster() == NULL;
+	entry->owner = add_to_index(m_owner, job, ATTR_OWNER, entry->cluster);
+	entry->user = add_to_index(m_user, job, ATTR_USER, entry->cluster);
+	entry->status = add_to_index(m_status, job, ATTR_JOB_STATUS, entry->cluster);
+	entry->dagman = add_to_index(m_dagman, job, ATTR_DAGMAN_JOB_ID, entry->cluster);
+	if (entry->orphan) {
+		++m_orphans;
+	}
+	job->index_entry = entry;
+}
+
+void
+JobQueueIndexes::Reindex(JobQueueJob * job)
+{
+	if (job->IsCluster()) {
+		JobQueueCluster * clusterad = static_cast<JobQueueCluster*>(job);
+		for (JobQueueJob * proc = clusterad->FirstAttachedJob(); proc; proc = clusterad->NextAttachedJob(proc)) {
+			IndexJob(proc);
+		}
+	} else if (job->IsJob()) {
+		IndexJob(job);
+	}
+}
+
+void
+JobQueueIndexes::Remove(JobQueueJob * job)
+{
+	JobQueueIndexEntry * entry = job->index_entry;
+	if ( ! entry) {
+		return;
+	}
+	if (entry->owner) { m_owner.Remove(entry->owner, entry->cluster); }
+	if (entry->user) { m_user.Remove(entry->user, entry->cluster); }
+	if (entry->status) { m_status.Remove(entry->status, entry->cluster); }
+	if (entry->dagman) { m_dagman.Remove(entry->dagman, entry->cluster); }
+	if (entry->orphan) {
+		--m_orphans;
+	}
+	delete entry;
+	job->index_entry = NULL;
+}
+
+bool
+JobQueueIndexes::CandidateClusters(classad::ExprTree * constraint, std::set<int> & clusters) const
+{
+	if ( ! constraint || m_orphans > 0) {
+		return false;
+	}
+
+	classad::ExprTree * tree = SkipExprParens(constraint);
+	if (tree->GetKind() == classad::ExprTree::OP_NODE) {
+		classad::Operation::OpKind op;
+		classad::ExprTree *t1, *t2, *t3;
+		((const classad::Operation*)tree)->GetComponents(op, t1, t2, t3);
+		if (op == classad::Operation::LOGICAL_AND_OP) {
+			// a job must match both sides, so either side will do,
+			// and if we can use both, the jobs must be in both.
+			std::set<int> left, right;
+			bool use_left = CandidateClusters(t1, left);
+			bool use_right = CandidateClusters(t2, right);
+			if (use_left && use_right) {
+				std::set_intersection(left.begin(), left.end(), right.begin(), right.end(),
+					std::inserter(clusters, clusters.end()));
+			} else if (use_left) {
+				clusters.swap(left);
+			} else if (use_right) {
+				clusters.swap(right);
+			} else {
+				return false;
+			}
+			return true;
+		}
+		if (op == classad::Operation::LOGICAL_OR_OP) {
+			// a job can match either side, so we need both.
+			std::set<int> right;
+			if ( ! CandidateClusters(t1, clusters) || ! CandidateClusters(t2, right)) {
+				return false;
+			}
+			clusters.insert(right.begin(), right.end());
+			return true;
+		}
+	}
+
+	classad::Operation::OpKind op;
+	std::string attr;
+	classad::Value value;
+	if ( ! ExprTreeIsAttrCmpLiteral(tree, op, attr, value)) {
+		return false;
+	}
+	// == ignores case for strings and =?= does not, so both match a subset of
+	// the jobs in the case insensitive index
+	if (op != classad::Operation::EQUAL_OP && op != classad::Operation::META_EQUAL_OP) {
+		return false;
+	}
+
+	std::string sval;
+	long long ival;
+	if (value.IsStringValue(sval)) {
+		if (MATCH == strcasecmp(attr.c_str(), ATTR_OWNER)) {
+			m_owner.Find(sval, clusters);
+			return true;
+		}
+		if (MATCH == strcasecmp(attr.c_str(), ATTR_USER)) {
+			m_user.Find(sval, clusters);
+			return true;
+		}
+	} else if (value.IsIntegerValue(ival)) {
+		if (MATCH == strcasecmp(attr.c_str(), ATTR_CLUSTER_ID)) {
+			if (ival > 0 && ival <= INT_MAX) { clusters.insert((int)ival); }
+			return true;
+		}
+		if (MATCH == strcasecmp(attr.c_str(), ATTR_JOB_STATUS)) {
+			m_status.Find(ival, clusters);
+			return true;
+		}
+		if (MATCH == strcasecmp(attr.c_str(), ATTR_DAGMAN_JOB_ID)) {
+			m_dagman.Find(ival, clusters);
+			return true;
+		}
+	}
+	return false;
+}
@@ -0,0 +1,126 @@
+/***************************************************************
+ *
+ * Copyright (C) 1990-2020, Condor Team, Computer Sciences Department,
+ * University of Wisconsin-Madison, WI.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You may
+ * obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************/
+
+#ifndef _JOB_QUEUE_INDEX_H
+#define _JOB_QUEUE_INDEX_H
+
+/*
+   Indexes of the committed jobs in the schedd job queue by Owner, User,
+   JobStatus and DAGManJobId, so that a query like condor_q for one user's
+   jobs does not have to evaluate its constraint against every job.
+
+   The indexes hold clusters rather than jobs: for each value, the clusters
+   that have at least one job with that value, and how many.  Owner, User
+   and DAGManJobId are nearly always the same for every job in a cluster, so
+   this keeps the indexes small.  The constraint is still evaluated against
+   every job of the clusters the indexes pick, so a cluster that is picked
+   for only some of its jobs costs time, but never changes the answer.
+
+   A job whose value is not a literal of the indexed type (an expression,
+   say) is kept aside and its cluster is picked for every value.
+*/
+
+#include <map>
+#include <set>
+#include <string>
+
+class JobQueueJob;
+
+// An index by the value of one job attribute, see above
+template <typename T, typename Compare = std::less<T> >
+class JobAttrIndex {
+public:
+	typedef std::map<int,int> Clusters; // cluster id -> number of its jobs with the value
+	typedef std::pair<const T, Clusters> Entry;
+
+	JobAttrIndex() : m_other(T(), Clusters()) {}
+
+		// returns the entry the job was filed under, which it must give
+		// back to Remove().  other means the value is not a literal of type T
+	const Entry * Add(const T & value, bool other, int cluster) {
+		Entry * entry = other ? &m_other : &*m_values.insert(Entry(value, Clusters())).first;
+		entry->second[cluster] += 1;
+		return entry;
+	}
+	void Remove(const Entry * entry, int cluster) {
+		Entry * ent = const_cast<Entry*>(entry);
+		auto it = ent->second.find(cluster);
+		if (it != ent->second.end() && --it->second <= 0) {
+			ent->second.erase(it);
+		}
+		if (ent != &m_other && ent->second.empty()) {
+			m_values.erase(m_values.find(ent->first));
+		}
+	}
+	void Find(const T & value, std::set<int> & clusters) const {
+		auto it = m_values.find(value);
+		if (it != m_values.end()) {
+			for (auto ct = it->second.begin(); ct != it->second.end(); ++ct) { clusters.insert(ct->first); }
+		}
+		for (auto ct = m_other.second.begin(); ct != m_other.second.end(); ++ct) { clusters.insert(ct->first); }
+	}
+
+private:
+	std::map<T, Clusters, Compare> m_values;
+	Entry m_other;
+};
+
+typedef JobAttrIndex<std::string, classad::CaseIgnLTStr> JobStringIndex;
+typedef JobAttrIndex<long long> JobIntIndex;
+
+// where one job is filed in the indexes
+struct JobQueueIndexEntry {
+	int cluster;
+	bool orphan; // the job has no cluster ad
+	const JobStringIndex::Entry * owner;
+	const JobStringIndex::Entry * user;
+	const JobIntIndex::Entry * status;
+	const JobIntIndex::Entry * dagman;
+};
+
+class JobQueueIndexes {
+public:
+	JobQueueIndexes() : m_orphans(0) {}
+
+		// true if changing this attribute can move a job in the indexes
+	static bool IsIndexedAttr(const char * attr);
+
+		// file the job, or all of the jobs of a cluster ad, under their
+		// current values.  the job must already be chained to its cluster ad.
+	void Reindex(JobQueueJob * job);
+		// take a job that is leaving the queue out of the indexes
+	void Remove(JobQueueJob * job);
+
+		// Returns true and the ids of the clusters that have all of the jobs
+		// the constraint can match, if the indexes can tell that from the
+		// top level && and || clauses of the constraint.  The clusters may
+		// include some that no longer exist.
+	bool CandidateClusters(classad::ExprTree * constraint, std::set<int> & clusters) const;
+
+private:
+	void IndexJob(JobQueueJob * job);
+
+	JobStringIndex m_owner;
+	JobStringIndex m_user;
+	JobIntIndex m_status;
+	JobIntIndex m_dagman;
+	int m_orphans; // jobs that have no cluster ad, these can't be found by cluster.
+};
+
+#endif
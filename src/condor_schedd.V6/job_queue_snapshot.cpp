@@ -0,0 +1,198 @@
+/***************************************************************
+ *
+ * Copyright (C) 1990-2020, Condor Team, Computer Sciences Department,
+ * University of Wisconsin-Madison, WI.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You may
+ * obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************/
+
+#include "condor_common.h"
+#include "condor_debug.h"
+#include "qmgmt.h"
+#include "job_queue_snapshot.h"
+#include "classad/classadCache.h"
+
+const JobQueueSnapshot::Ad *
+JobQueueSnapshot::Lookup(const JOB_ID_KEY & key) const
+{
+	auto ct = m_clusters.find(key.cluster);
+	if (ct == m_clusters.end()) {
+		return NULL;
+	}
+	if (key.proc < 0) {
+		return ct->second->ad.get();
+	}
+	auto jt = ct->second->jobs.find(key.proc);
+	return (jt == ct->second->jobs.end()) ? NULL : jt->second.get();
+}
+
+void
+JobQueueSnapshots::Start(Queue * queue)
+{
+	Stop();
+	m_queue = queue;
+	m_copied = 0;
+	m_queue->TrackChangedKeys(true);
+	Rebuild();
+}
+
+void
+JobQueueSnapshots::Stop()
+{
+	if (m_queue) {
+		m_queue->TrackChangedKeys(false);
+	}
+	m_queue = NULL;
+	m_current.reset();
+}
+
+std::shared_ptr<JobQueueSnapshot::Ad>
+JobQueueSnapshots::CopyAd(JobQueueJob * job, const std::shared_ptr<JobQueueSnapshot::Ad> & cluster)
+{
+	std::shared_ptr<JobQueueSnapshot::Ad> copy(new JobQueueSnapshot::Ad);
+	// copy the attributes only, not the scope pointers into the live queue.
+	// a cached expression would be shared with the live queue and every
+	// other ad that has the same value, so copy the expression it holds.
+	for (auto it = job->begin(); it != job->end(); ++it) {
+		classad::ExprTree * tree = it->second;
+		if (tree->GetKind() == classad::ExprTree::EXPR_ENVELOPE) {
+			tree = static_cast<classad::CachedExprEnvelope*>(tree)->get();
+		}
+		if (tree) {
+			copy->ad.Insert(it->first, tree->Copy());
+		}
+	}
+	copy->cluster = cluster;
+	if (cluster) {
+		copy->ad.ChainToAd(&cluster->ad);
+	}
+	copy->universe = job->Universe();
+	copy->status = job->Status();
+	copy->is_job = job->IsJob();
+	++m_copied;
+	return copy;
+}
+
+void
+JobQueueSnapshots::Rebuild()
+{
+	std::shared_ptr<JobQueueSnapshot> snap(new JobQueueSnapshot);
+
+	// copy the cluster ads first so that the job copies can be chained to them.
+	// this does not use StartIterateAllClassAds() so that it does not disturb
+	// a GetNextJob scan in progress.
+	m_queue->WalkAllClassAds([&](const JobQueueKey & key, JobQueueJob * job) {
+		if (job && job->IsCluster()) {
+			std::shared_ptr<JobQueueSnapshot::Cluster> & cl = snap->m_clusters[key.cluster];
+			if ( ! cl) { cl.reset(new JobQueueSnapshot::Cluster); }
+			cl->ad = CopyAd(job, NULL);
+			++snap->m_num_ads;
+		}
+	});
+	m_queue->WalkAllClassAds([&](const JobQueueKey & key, JobQueueJob * job) {
+		if ( ! job || ! job->IsJob()) return;
+		std::shared_ptr<JobQueueSnapshot::Cluster> & cl = snap->m_clusters[key.cluster];
+		if ( ! cl) { cl.reset(new JobQueueSnapshot::Cluster); }
+		cl->jobs[key.proc] = CopyAd(job, cl->ad);
+		++snap->m_num_ads;
+	});
+
+	m_current = snap;
+	dprintf(D_FULLDEBUG, "Made a job queue snapshot of %d ads\n", (int)snap->m_num_ads);
+}
+
+// Bring one cluster of the snapshot up to date.  procs holds the procs
+// that changed, and -1 if the cluster ad did.
+void
+JobQueueSnapshots::UpdateCluster(JobQueueSnapshot & snap, int cluster_id, const std::set<int> & procs)
+{
+	std::shared_ptr<JobQueueSnapshot::Cluster> & slot = snap.m_clusters[cluster_id];
+	if ( ! slot) {
+		slot.reset(new JobQueueSnapshot::Cluster);
+	} else if (slot.use_count() > 1) {
+		// an older snapshot that a query is reading holds this cluster
+		slot.reset(new JobQueueSnapshot::Cluster(*slot));
+	}
+	JobQueueSnapshot::Cluster & cl = *slot;
+	snap.m_num_ads -= (cl.ad ? 1 : 0) + cl.jobs.size();
+
+	JobQueueJob * job = NULL;
+	std::set<int> copy_procs;
+	for (auto it = procs.begin(); it != procs.end(); ++it) {
+		if (*it >= 0) { copy_procs.insert(*it); }
+	}
+	if (procs.count(-1)) {
+		if (m_queue->Lookup(JobQueueKey(cluster_id, -1), job) && job && job->IsCluster()) {
+			cl.ad = CopyAd(job, NULL);
+		} else {
+			cl.ad.reset();
+		}
+		// the jobs are chained to the cluster ad, so they need new copies too
+		for (auto jt = cl.jobs.begin(); jt != cl.jobs.end(); ++jt) {
+			copy_procs.insert(jt->first);
+		}
+	}
+
+	for (auto it = copy_procs.begin(); it != copy_procs.end(); ++it) {
+		job = NULL;
+		if (m_queue->Lookup(JobQueueKey(cluster_id, *it), job) && job && job->IsJob()) {
+			cl.jobs[*it] = CopyAd(job, cl.ad);
+		} else {
+			cl.jobs.erase(*it);
+		}
+	}
+
+	if ( ! cl.ad && cl.jobs.empty()) {
+		snap.m_clusters.erase(cluster_id);
+	} else {
+		snap.m_num_ads += (cl.ad ? 1 : 0) + cl.jobs.size();
+	}
+}
+
+void
+JobQueueSnapshots::Update(JobQueueSnapshot & snap, const std::set<std::string> & keys)
+{
+	std::map<int, std::set<int> > changed;
+	for (auto it = keys.begin(); it != keys.end(); ++it) {
+		JobQueueKey key;
+		if ( ! key.set(it->c_str()) || key.cluster <= 0) continue;
+		changed[key.cluster].insert(key.proc);
+	}
+	for (auto it = changed.begin(); it != changed.end(); ++it) {
+		UpdateCluster(snap, it->first, it->second);
+	}
+}
+
+std::shared_ptr<const JobQueueSnapshot>
+JobQueueSnapshots::Current()
+{
+	if ( ! m_queue) {
+		return std::shared_ptr<const JobQueueSnapshot>();
+	}
+
+	std::set<std::string> keys;
+	m_queue->TakeChangedKeys(keys);
+	if ( ! m_current) {
+		Rebuild();
+	} else if ( ! keys.empty()) {
+		if (m_current.use_count() > 1) {
+			// a query is still reading the current snapshot, so leave it
+			// alone and update a copy that shares the clusters with it.
+			// UpdateCluster() copies the clusters that change.
+			m_current.reset(new JobQueueSnapshot(*m_current));
+		}
+		Update(*m_current, keys);
+	}
+	return m_current;
+}
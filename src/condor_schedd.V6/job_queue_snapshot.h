@@ -0,0 +1,122 @@
+/***************************************************************
+ *
+ * Copyright (C) 1990-2020, Condor Team, Computer Sciences Department,
+ * University of Wisconsin-Madison, WI.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You may
+ * obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************/
+
+#ifndef _JOB_QUEUE_SNAPSHOT_H
+#define _JOB_QUEUE_SNAPSHOT_H
+
+/*
+   A read-only copy of the committed job queue, for answering queries on
+   threads other than the schedd's main thread.
+
+   Each ad in a snapshot is a private copy of a job or cluster ad, with the
+   job copies chained to the copy of their cluster ad, and is never changed
+   once it is made.  The copies are made from the parsed expressions
+   rather than through the ClassAd expression cache, so they share
+   nothing with the live job queue.
+
+   A snapshot is a map of clusters, each holding the copies of its ads.
+   Snapshots share the clusters and ads that did not change: bringing
+   the current snapshot up to date only copies the ads that changed since
+   it was made, and a cluster or the map of clusters is only copied if a
+   query is still reading an older snapshot that holds it, otherwise it
+   is updated in place.
+
+   The first snapshot is made when snapshots are started.  Snapshots are
+   brought up to date on the main thread, between transactions, from the
+   keys the job queue log says were changed.  A thread that is handed a
+   snapshot may read it but must hand it back to the main thread to be
+   released.
+*/
+
+#include "classad_collection.h"
+
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+
+class JobQueueSnapshot {
+public:
+	struct Ad {
+		ClassAd ad;
+		std::shared_ptr<Ad> cluster; // the copy this ad is chained to, if any
+		int universe;
+		int status;
+		bool is_job;
+	};
+	struct Cluster {
+		std::shared_ptr<Ad> ad;                  // the cluster ad, if any
+		std::map<int, std::shared_ptr<Ad> > jobs; // by proc id
+	};
+	typedef std::map<int, std::shared_ptr<Cluster> > ClusterMap;
+
+	const Ad * Lookup(const JOB_ID_KEY & key) const;
+	size_t NumAds() const { return m_num_ads; }
+
+		// call fn for each ad in key order, each cluster ad before its
+		// jobs, until fn returns false.  returns false if fn did.
+	template <typename Fn> bool WalkAds(Fn fn) const {
+		for (auto ct = m_clusters.begin(); ct != m_clusters.end(); ++ct) {
+			const Cluster & cl = *ct->second;
+			if (cl.ad && ! fn(*cl.ad)) return false;
+			for (auto jt = cl.jobs.begin(); jt != cl.jobs.end(); ++jt) {
+				if ( ! fn(*jt->second)) return false;
+			}
+		}
+		return true;
+	}
+
+private:
+	friend class JobQueueSnapshots;
+	JobQueueSnapshot() : m_num_ads(0) {}
+	ClusterMap m_clusters;
+	size_t m_num_ads;
+};
+
+// The current snapshot of a job queue
+class JobQueueSnapshots {
+public:
+	typedef GenericClassAdCollection<JobQueueKey, JobQueuePayload> Queue;
+
+	JobQueueSnapshots() : m_queue(NULL), m_copied(0) {}
+	~JobQueueSnapshots() { Stop(); }
+
+		// start keeping snapshots of this job queue, or stop
+	void Start(Queue * queue);
+	void Stop();
+	bool Enabled() const { return m_queue != NULL; }
+
+		// a snapshot of the job queue as of the last commit
+	std::shared_ptr<const JobQueueSnapshot> Current();
+
+		// number of ads copied into snapshots since Start()
+	long long AdsCopied() const { return m_copied; }
+
+private:
+	std::shared_ptr<JobQueueSnapshot::Ad> CopyAd(JobQueueJob * job, const std::shared_ptr<JobQueueSnapshot::Ad> & cluster);
+	void Rebuild();
+	void UpdateCluster(JobQueueSnapshot & snap, int cluster_id, const std::set<int> & procs);
+	void Update(JobQueueSnapshot & snap, const std::set<std::string> & keys);
+
+	Queue * m_queue;
+	std::shared_ptr<JobQueueSnapshot> m_current;
+	long long m_copied;
+};
+
+#endif
@@ -0,0 +1,642 @@
+/***************************************************************
+ *
+ * Copyright (C) 1990-2020, Condor Team, Computer Sciences Department,
+ * University of Wisconsin-Madison, WI.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You may
+ * obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************/
+
+// Tests of the parts of the schedd that keep track of the job queue
+// outside of the job queue itself, run against a job queue log that
+// the test builds, or against job records that it makes.  Prints each failure and returns the number of them.
+
+#include "condor_common.h"
+#include "condor_debug.h"
+#include "condor_config.h"
+#include "condor_attributes.h"
+#include "qmgmt.h"
+#include "job_queue_snapshot.h"
+#include "job_queue_index.h"
+#include "shadow_recycle.h"
+#include "compat_classad_util.h"
+#include "classad/classadCache.h"
+
+// The job queue classes need these from qmgmt.cpp, which the test does
+// not link.  They only need to do what a job queue without factories does.
+
+JobQueueCluster::~JobQueueCluster()
+{
+}
+
+void JobQueueCluster::AttachJob(JobQueueJob * job)
+{
+	++num_attached;
+	qe.append_tail(job->qe);
+	job->parent = this;
+}
+
+void JobQueueBase::PopulateFromAd()
+{
+	if (!entry_type) {
+		if (!jid.cluster) {
+			this->LookupInteger(ATTR_CLUSTER_ID, jid.cluster);
+			this->LookupInteger(ATTR_PROC_ID, jid.proc);
+		}
+		if (jid.cluster == 0 && jid.proc == 0) entry_type = entry_type_header;
+		else if (jid.cluster == 0) entry_type = entry_type_jobset;
+		else if (jid.cluster > 0) entry_type = (jid.proc < 0) ? entry_type_cluster : entry_type_job;
+	}
+}
+
+void JobQueueJob::PopulateFromAd()
+{
+	JobQueueBase::PopulateFromAd();
+	if ( ! universe) {
+		int uni;
+		if (this->LookupInteger(ATTR_JOB_UNIVERSE, uni)) {
+			this->universe = uni;
+		}
+	}
+}
+
+class TestJobQueueEntryMaker : public ConstructLogEntry
+{
+public:
+	virtual ClassAd* New(const char * key, const char * /*mytype*/) const {
+		JOB_ID_KEY jid(key);
+		if (jid.cluster > 0 && jid.proc < 0) {
+			return new JobQueueCluster(jid);
+		}
+		JobQueueJob * job = new JobQueueJob();
+		job->jid = jid;
+		return job;
+	}
+	virtual void Delete(ClassAd* &val) const { delete val; val = NULL; }
+};
+
+typedef GenericClassAdCollection<JobQueueKey, JobQueuePayload> TestJobQueue;
+
+static int failures = 0;
+
+#define CHECK(cond) \
+	if ( ! (cond)) { \
+		fprintf(stderr, "%s:%d: %s: check failed: %s\n", __FILE__, __LINE__, test_name, #cond); \
+		++failures; \
+	}
+
+// Make a job queue log for a test, removing the file of any earlier run.
+static TestJobQueue * make_queue(const char * test_name, std::string & filename)
+{
+	formatstr(filename, "test_job_queue_%s.%d.log", test_name, (int)getpid());
+	remove(filename.c_str());
+	return new TestJobQueue(new TestJobQueueEntryMaker(), filename.c_str(), 0);
+}
+
+static void add_job(TestJobQueue & queue, int cluster, int proc, const char * owner)
+{
+	JobQueueKey key(cluster, proc);
+	queue.NewClassAd(key, JOB_ADTYPE, STARTD_ADTYPE);
+	std::string val;
+	formatstr(val, "%d", cluster);
+	queue.SetAttribute(key, ATTR_CLUSTER_ID, val.c_str());
+	formatstr(val, "%d", proc);
+	queue.SetAttribute(key, ATTR_PROC_ID, val.c_str());
+	if (owner) {
+		formatstr(val, "\"%s\"", owner);
+		queue.SetAttribute(key, ATTR_OWNER, val.c_str());
+	}
+}
+
+static long long snapshot_value(const JobQueueSnapshot & snap, int cluster, int proc, const char * attr)
+{
+	const JobQueueSnapshot::Ad * sad = snap.Lookup(JobQueueKey(cluster, proc));
+	long long value = -1;
+	if (sad) {
+		sad->ad.EvaluateAttrInt(attr, value);
+	}
+	return value;
+}
+
+// A snapshot that a query holds does not change when a transaction is
+// committed, and the next snapshot has the committed change, sharing the
+// copies of the ads that did not change.
+static void test_snapshot_stable_across_commit()
+{
+	const char * test_name = "snapshot_stable_across_commit";
+	std::string filename;
+	TestJobQueue * queue = make_queue(test_name, filename);
+
+	add_job(*queue, 1, -1, "alice");
+	queue->SetAttribute(JobQueueKey(1, -1), "Value", "1");
+	add_job(*queue, 1, 0, NULL);
+	add_job(*queue, 1, 1, NULL);
+	add_job(*queue, 2, -1, "bob");
+	add_job(*queue, 2, 0, NULL);
+	queue->SetAttribute(JobQueueKey(2, 0), "Value", "1");
+
+	JobQueueSnapshots snapshots;
+	snapshots.Start(queue);
+	std::shared_ptr<const JobQueueSnapshot> before = snapshots.Current();
+	CHECK(before && before->NumAds() == 5);
+
+	queue->BeginTransaction();
+	queue->SetAttribute(JobQueueKey(2, 0), "Value", "2");
+	queue->CommitTransaction();
+
+	CHECK(snapshot_value(*before, 2, 0, "Value") == 1);
+
+	std::shared_ptr<const JobQueueSnapshot> after = snapshots.Current();
+	CHECK(after != before);
+	CHECK(snapshot_value(*after, 2, 0, "Value") == 2);
+	CHECK(snapshot_value(*before, 2, 0, "Value") == 1);
+	// the job that did not change, and its cluster, are shared
+	CHECK(after->Lookup(JobQueueKey(1, 0)) == before->Lookup(JobQueueKey(1, 0)));
+	CHECK(after->Lookup(JobQueueKey(1, -1)) == before->Lookup(JobQueueKey(1, -1)));
+
+	// a change to a cluster ad is seen through every job of the cluster
+	queue->BeginTransaction();
+	queue->SetAttribute(JobQueueKey(1, -1), "Value", "3");
+	queue->CommitTransaction();
+	std::shared_ptr<const JobQueueSnapshot> clust = snapshots.Current();
+	CHECK(snapshot_value(*clust, 1, 0, "Value") == 3);
+	CHECK(snapshot_value(*clust, 1, 1, "Value") == 3);
+	CHECK(snapshot_value(*after, 1, 0, "Value") == 1);
+
+	// a removed job is gone from the next snapshot only
+	queue->BeginTransaction();
+	queue->DestroyClassAd(JobQueueKey(1, 1));
+	queue->CommitTransaction();
+	std::shared_ptr<const JobQueueSnapshot> removed = snapshots.Current();
+	CHECK(removed->Lookup(JobQueueKey(1, 1)) == NULL);
+	CHECK(removed->NumAds() == 4);
+	CHECK(clust->Lookup(JobQueueKey(1, 1)) != NULL);
+
+	int walked = 0;
+	removed->WalkAds([&](const JobQueueSnapshot::Ad &) -> bool { ++walked; return true; });
+	CHECK(walked == 4);
+
+	before.reset(); after.reset(); clust.reset(); removed.reset();
+	snapshots.Stop();
+	delete queue;
+	remove(filename.c_str());
+}
+
+// When no query holds the current snapshot it is brought up to date in
+// place, and a reader that asks for the current snapshot again sees the
+// new state.
+static void test_snapshot_updated_in_place()
+{
+	const char * test_name = "snapshot_updated_in_place";
+	std::string filename;
+	TestJobQueue * queue = make_queue(test_name, filename);
+
+	add_job(*queue, 1, -1, "alice");
+	add_job(*queue, 1, 0, NULL);
+	queue->SetAttribute(JobQueueKey(1, 0), "Value", "1");
+
+	JobQueueSnapshots snapshots;
+	snapshots.Start(queue);
+	const JobQueueSnapshot * first = snapshots.Current().get();
+
+	queue->BeginTransaction();
+	queue->SetAttribute(JobQueueKey(1, 0), "Value", "2");
+	add_job(*queue, 1, 1, NULL);
+	queue->CommitTransaction();
+
+	std::shared_ptr<const JobQueueSnapshot> snap = snapshots.Current();
+	CHECK(snap.get() == first);
+	CHECK(snapshot_value(*snap, 1, 0, "Value") == 2);
+	CHECK(snap->Lookup(JobQueueKey(1, 1)) != NULL);
+
+	snap.reset();
+	snapshots.Stop();
+	delete queue;
+	remove(filename.c_str());
+}
+
+// With the ClassAd expression cache on, the copies in a snapshot hold
+// expressions of their own rather than cached ones shared with the queue.
+static void test_snapshot_without_cache()
+{
+	const char * test_name = "snapshot_without_cache";
+	std::string filename;
+	classad::ClassAdSetExpressionCaching(true);
+	TestJobQueue * queue = make_queue(test_name, filename);
+
+	add_job(*queue, 1, -1, "alice");
+	add_job(*queue, 1, 0, NULL);
+	queue->SetAttribute(JobQueueKey(1, 0), ATTR_REQUIREMENTS, "(TARGET.Memory >= 1024) && (TARGET.Arch == \"X86_64\")");
+
+	JobQueueSnapshots snapshots;
+	snapshots.Start(queue);
+	std::shared_ptr<const JobQueueSnapshot> snap = snapshots.Current();
+	const JobQueueSnapshot::Ad * sad = snap->Lookup(JobQueueKey(1, 0));
+	CHECK(sad != NULL);
+	if (sad) {
+		int envelopes = 0;
+		for (auto it = sad->ad.begin(); it != sad->ad.end(); ++it) {
+			if (it->second->GetKind() == classad::ExprTree::EXPR_ENVELOPE) { ++envelopes; }
+		}
+		CHECK(envelopes == 0);
+		CHECK(sad->ad.Lookup(ATTR_REQUIREMENTS) != NULL);
+		std::string owner;
+		CHECK(sad->ad.LookupString(ATTR_OWNER, owner) && owner == "alice");
+	}
+
+	snap.reset();
+	snapshots.Stop();
+	delete queue;
+	remove(filename.c_str());
+	classad::ClassAdSetExpressionCaching(false);
+}
+
+// Check that each submitter's jobs in the PrioRec index are in the order
+// that sorting the PrioRec array with prio_compar puts them in, and that
+// merging the submitters gives the order of the whole array.
+static void check_prio_rec_order(const char * test_name, const PrioRecIndex & index, std::vector<prio_rec> recs)
+{
+	if ( ! recs.empty()) {
+		qsort(&recs[0], recs.size(), sizeof(recs[0]), (int(*)(const void*, const void*))prio_compar);
+	}
+	CHECK(index.size() == (int)recs.size());
+
+	size_t filed = 0;
+	for (auto sub = index.All().begin(); sub != index.All().end(); ++sub) {
+		std::vector<PROC_ID> expected, actual;
+		for (auto it = recs.begin(); it != recs.end(); ++it) {
+			if (sub->first == it->submitter) { expected.push_back(it->id); }
+		}
+		for (auto it = sub->second.begin(); it != sub->second.end(); ++it) { actual.push_back(it->id); }
+		CHECK(actual == expected);
+		CHECK(index.Find(sub->first.c_str()) == &sub->second);
+		filed += actual.size();
+	}
+	CHECK(filed == recs.size());
+
+	std::vector<PROC_ID> merged;
+	std::vector<std::pair<PrioRecIndex::Queue::const_iterator, PrioRecIndex::Queue::const_iterator> > heads;
+	for (auto sub = index.All().begin(); sub != index.All().end(); ++sub) {
+		heads.push_back(std::make_pair(sub->second.begin(), sub->second.end()));
+	}
+	PrioRecIndex::Less less;
+	for (;;) {
+		int best = -1;
+		for (int i = 0; i < (int)heads.size(); ++i) {
+			if (heads[i].first == heads[i].second) { continue; }
+			if (best < 0 || less(*heads[i].first, *heads[best].first)) { best = i; }
+		}
+		if (best < 0) { break; }
+		merged.push_back((heads[best].first++)->id);
+	}
+	std::vector<PROC_ID> all;
+	for (auto it = recs.begin(); it != recs.end(); ++it) { all.push_back(it->id); }
+	CHECK(merged == all);
+}
+
+static prio_rec make_rec(int cluster, int proc, const char * submitter, int job_prio, int qdate)
+{
+	prio_rec rec;
+	rec.id.cluster = cluster;
+	rec.id.proc = proc;
+	rec.job_prio = job_prio;
+	rec.qdate = qdate;
+	strncpy(rec.submitter, submitter, sizeof(rec.submitter) - 1);
+	rec.submitter[sizeof(rec.submitter) - 1] = 0;
+	return rec;
+}
+
+// The PrioRec index keeps the jobs of every submitter in prio_compar order
+// as jobs are added, refiled with a new priority, and removed.
+static void test_prio_rec_index_order()
+{
+	const char * test_name = "prio_rec_index_order";
+	const char * submitters[] = { "alice@pool", "bob@pool", "carol@pool" };
+
+	std::vector<prio_rec> recs;
+	unsigned int seed = 12345;
+	for (int cluster = 1; cluster <= 20; ++cluster) {
+		for (int proc = 0; proc < 5; ++proc) {
+			seed = seed * 1103515245 + 12345;
+			prio_rec rec = make_rec(cluster, proc, submitters[(seed >> 8) % 3],
+				(int)((seed >> 12) % 4) - 1, 1000 + (int)((seed >> 16) % 7));
+			rec.pre_job_prio1 = ((seed >> 20) % 5 == 0) ? 1 : 0;
+			rec.post_job_prio1 = (int)((seed >> 24) % 2);
+			recs.push_back(rec);
+		}
+	}
+
+	PrioRecIndex index;
+	for (auto it = recs.rbegin(); it != recs.rend(); ++it) {
+		index.Insert(*it);
+	}
+	check_prio_rec_order(test_name, index, recs);
+
+	// refile some jobs with a new priority, one of them to another submitter
+	for (size_t i = 0; i < recs.size(); i += 7) {
+		recs[i].job_prio += 3;
+		index.Insert(recs[i]);
+	}
+	strncpy(recs[3].submitter, "dave@pool", sizeof(recs[3].submitter) - 1);
+	index.Insert(recs[3]);
+	check_prio_rec_order(test_name, index, recs);
+
+	// remove every job of one submitter and a few others
+	std::vector<prio_rec> kept;
+	for (size_t i = 0; i < recs.size(); ++i) {
+		if (strcmp(recs[i].submitter, "bob@pool") == 0 || i % 11 == 0) {
+			index.Remove(JOB_ID_KEY(recs[i].id));
+		} else {
+			kept.push_back(recs[i]);
+		}
+	}
+	CHECK(index.Find("bob@pool") == NULL);
+	check_prio_rec_order(test_name, index, kept);
+
+	index.Clear();
+	CHECK(index.size() == 0 && index.All().empty());
+}
+
+// A job queue in memory for the job queue index tests: each job is chained
+// to its cluster ad, as the schedd does once the queue is loaded.
+struct IndexTestQueue {
+	std::vector<JobQueueCluster *> clusters;
+	std::vector<JobQueueJob *> jobs;
+	JobQueueIndexes index;
+
+	JobQueueCluster * AddCluster(int cluster, const char * owner) {
+		JOB_ID_KEY jid(cluster, -1);
+		JobQueueCluster * clusterad = new JobQueueCluster(jid);
+		clusterad->Assign(ATTR_CLUSTER_ID, cluster);
+		clusterad->Assign(ATTR_OWNER, owner);
+		clusterad->Assign(ATTR_USER, std::string(owner) + "@submit.example");
+		clusters.push_back(clusterad);
+		return clusterad;
+	}
+	JobQueueJob * AddJob(JobQueueCluster * clusterad, int proc, int status) {
+		JobQueueJob * job = new JobQueueJob();
+		job->Assign(ATTR_CLUSTER_ID, clusterad->jid.cluster);
+		job->Assign(ATTR_PROC_ID, proc);
+		job->Assign(ATTR_JOB_STATUS, status);
+		job->PopulateFromAd();
+		job->ChainToAd(clusterad);
+		clusterad->AttachJob(job);
+		jobs.push_back(job);
+		return job;
+	}
+	~IndexTestQueue() {
+		for (auto it = jobs.begin(); it != jobs.end(); ++it) {
+			index.Remove(*it);
+			(*it)->Unchain();
+			delete *it;
+		}
+		for (auto it = clusters.begin(); it != clusters.end(); ++it) {
+			delete *it;
+		}
+	}
+};
+
+// The jobs that match the constraint, found by checking every job, and
+// found by checking only the jobs of the clusters the indexes pick.  Returns
+// whether the indexes picked clusters.
+static bool index_matches(IndexTestQueue & queue, classad::ExprTree * tree,
+	std::set<JOB_ID_KEY> & scanned, std::set<JOB_ID_KEY> & indexed, size_t & candidates)
+{
+	for (auto it = queue.jobs.begin(); it != queue.jobs.end(); ++it) {
+		if (EvalExprBool(*it, tree)) { scanned.insert((*it)->jid); }
+	}
+
+	std::set<int> clusters;
+	candidates = 0;
+	if ( ! queue.index.CandidateClusters(tree, clusters)) {
+		indexed = scanned;
+		return false;
+	}
+	for (auto it = queue.clusters.begin(); it != queue.clusters.end(); ++it) {
+		if ( ! clusters.count((*it)->jid.cluster)) { continue; }
+		for (JobQueueJob * job = (*it)->FirstAttachedJob(); job; job = (*it)->NextAttachedJob(job)) {
+			++candidates;
+			if (EvalExprBool(job, tree)) { indexed.insert(job->jid); }
+		}
+	}
+	return true;
+}
+
+// Check each constraint: narrowed is 1 if the indexes must pick clusters
+// for it, 0 if they must not, and -1 if either is right.
+struct IndexCase {
+	const char * constraint;
+	int narrowed;
+};
+
+static void check_index_cases(const char * test_name, IndexTestQueue & queue, const IndexCase * cases, size_t num_cases)
+{
+	for (size_t i = 0; i < num_cases; ++i) {
+		classad::ExprTree * tree = NULL;
+		if (ParseClassAdRvalExpr(cases[i].constraint, tree) != 0 || ! tree) {
+			fprintf(stderr, "%s: cannot parse %s\n", test_name, cases[i].constraint);
+			++failures;
+			continue;
+		}
+		std::set<JOB_ID_KEY> scanned, indexed;
+		size_t candidates = 0;
+		bool narrowed = index_matches(queue, tree, scanned, indexed, candidates);
+		if (indexed != scanned) {
+			fprintf(stderr, "%s: %s: the indexes found %d jobs, a full scan %d\n",
+				test_name, cases[i].constraint, (int)indexed.size(), (int)scanned.size());
+			++failures;
+		}
+		if (cases[i].narrowed >= 0 && narrowed != (cases[i].narrowed > 0)) {
+			fprintf(stderr, "%s: %s: the indexes %s clusters\n",
+				test_name, cases[i].constraint, narrowed ? "picked" : "did not pick");
+			++failures;
+		}
+		if (narrowed && cases[i].narrowed > 0 && candidates >= queue.jobs.size()) {
+			fprintf(stderr, "%s: %s: the indexes picked every job\n", test_name, cases[i].constraint);
+			++failures;
+		}
+		delete tree;
+	}
+}
+
+static const IndexCase index_cases[] = {
+	{ "Owner == \"alice\"", 1 },
+	{ "Owner == \"ALICE\"", 1 },
+	{ "Owner =?= \"alice\"", 1 },
+	{ "Owner =?= \"Alice\"", 1 },
+	{ "\"bob\" == Owner", 1 },
+	{ "(Owner == \"bob\")", 1 },
+	{ "User == \"carol@submit.example\"", 1 },
+	{ "ClusterId == 3", 1 },
+	{ "ClusterId == 3 && ProcId == 1", 1 },
+	{ "JobStatus == 5", 1 },
+	{ "JobStatus == 1 && Owner == \"bob\"", 1 },
+	{ "JobStatus == 5 || ClusterId == 2", 1 },
+	{ "DAGManJobId == 4", 1 },
+	{ "Owner == \"nobody\"", 1 },
+	{ "MY.Owner == \"alice\"", -1 },
+	{ "Owner != \"alice\"", 0 },
+	{ "Owner =!= \"alice\"", 0 },
+	{ "JobStatus > 1", 0 },
+	{ "JobStatus == 2.0", 0 },
+	{ "JobStatus == 2 || ProcId == 0", 0 },
+	{ "!(Owner == \"alice\")", 0 },
+	{ "Owner == \"alice\" || Foo == 1", 0 },
+	{ "Foo == \"alice\"", 0 },
+	{ "Owner == Foo", 0 },
+	{ "ClusterId == 0", 1 },
+	{ "true", 0 },
+};
+
+// The clusters the job queue indexes pick for a constraint hold every job
+// that a scan of the whole queue finds, as jobs and clusters change.
+static void test_index_matches_scan()
+{
+	const char * test_name = "index_matches_scan";
+	IndexTestQueue queue;
+
+	const char * owners[] = { "alice", "bob", "carol", "Alice" };
+	for (int cluster = 1; cluster <= 12; ++cluster) {
+		JobQueueCluster * clusterad = queue.AddCluster(cluster, owners[cluster % 4]);
+		for (int proc = 0; proc < 4; ++proc) {
+			JobQueueJob * job = queue.AddJob(clusterad, proc, (cluster + proc) % 3 ? IDLE : RUNNING);
+			if (cluster == 5 && proc == 2) {
+				// a job of its own owner, in a cluster of another
+				job->Assign(ATTR_OWNER, "bob");
+			}
+			if (cluster == 6 && proc == 1) {
+				job->Assign(ATTR_JOB_STATUS, 5);
+			}
+			if (cluster == 7 && proc == 3) {
+				// not a literal, so it is kept aside by the index
+				job->AssignExpr(ATTR_JOB_STATUS, "1 + 4");
+			}
+			if (cluster == 8) {
+				job->Assign(ATTR_DAGMAN_JOB_ID, 4);
+			}
+		}
+	}
+	for (auto it = queue.jobs.begin(); it != queue.jobs.end(); ++it) {
+		queue.index.Reindex(*it);
+	}
+	check_index_cases(test_name, queue, index_cases, COUNTOF(index_cases));
+
+	// a job changes status, and a whole cluster changes owner
+	queue.jobs[9]->Assign(ATTR_JOB_STATUS, 5);
+	queue.index.Reindex(queue.jobs[9]);
+	queue.clusters[2]->Assign(ATTR_OWNER, "alice");
+	queue.index.Reindex(queue.clusters[2]);
+	check_index_cases(test_name, queue, index_cases, COUNTOF(index_cases));
+
+	// a job that was not reindexed would be missed, so check that the
+	// test can tell
+	queue.jobs[0]->Assign(ATTR_JOB_STATUS, 5);
+	std::set<JOB_ID_KEY> scanned, indexed;
+	size_t candidates = 0;
+	classad::ExprTree * tree = NULL;
+	ParseClassAdRvalExpr("JobStatus == 5", tree);
+	index_matches(queue, tree, scanned, indexed, candidates);
+	CHECK(scanned.count(queue.jobs[0]->jid) && ! indexed.count(queue.jobs[0]->jid));
+	delete tree;
+	queue.index.Reindex(queue.jobs[0]);
+	check_index_cases(test_name, queue, index_cases, COUNTOF(index_cases));
+
+	// a job without a cluster ad means the indexes can't be used
+	JobQueueJob * orphan = new JobQueueJob();
+	orphan->Assign(ATTR_CLUSTER_ID, 99);
+	orphan->Assign(ATTR_PROC_ID, 0);
+	orphan->Assign(ATTR_OWNER, "alice");
+	orphan->PopulateFromAd();
+	queue.index.Reindex(orphan);
+	std::set<int> clusters;
+	tree = NULL;
+	ParseClassAdRvalExpr("Owner == \"alice\"", tree);
+	CHECK( ! queue.index.CandidateClusters(tree, clusters));
+	queue.index.Remove(orphan);
+	CHECK(queue.index.CandidateClusters(tree, clusters));
+	delete tree;
+	delete orphan;
+}
+
+// A same-owner job that can be started normally, which a recycled shadow
+// should be handed.
+static RecycleCandidate make_candidate(int universe, const char * owner)
+{
+	RecycleCandidate job;
+	job.universe = universe;
+	job.has_match = true;
+	job.still_runnable = true;
+	job.owner = owner;
+	return job;
+}
+
+// With RECYCLE_SHADOWS_ACROSS_CLAIMS, a shadow whose claim has run out of
+// jobs is handed the job waiting for a shadow only when it could have run
+// that job on its own claim, and otherwise exits.
+static void test_recycle_shadow_hand_off()
+{
+	const char * test_name = "recycle_shadow_hand_off";
+
+	CHECK(ShadowCanRunWaitingJob("alice", make_candidate(CONDOR_UNIVERSE_VANILLA, "alice")));
+	CHECK(ShadowCanRunWaitingJob("alice", make_candidate(CONDOR_UNIVERSE_JAVA, "alice")));
+	CHECK(ShadowCanRunWaitingJob("alice", make_candidate(CONDOR_UNIVERSE_VM, "alice")));
+
+		// the shadow has already switched to its owner
+	CHECK( ! ShadowCanRunWaitingJob("alice", make_candidate(CONDOR_UNIVERSE_VANILLA, "bob")));
+	CHECK( ! ShadowCanRunWaitingJob("alice", make_candidate(CONDOR_UNIVERSE_VANILLA, "")));
+	CHECK( ! ShadowCanRunWaitingJob("", make_candidate(CONDOR_UNIVERSE_VANILLA, "")));
+	CHECK( ! ShadowCanRunWaitingJob(NULL, make_candidate(CONDOR_UNIVERSE_VANILLA, "alice")));
+
+		// universes that have a shadow of their own, or none
+	CHECK( ! ShadowCanRunWaitingJob("alice", make_candidate(CONDOR_UNIVERSE_PARALLEL, "alice")));
+	CHECK( ! ShadowCanRunWaitingJob("alice", make_candidate(CONDOR_UNIVERSE_GRID, "alice")));
+	CHECK( ! ShadowCanRunWaitingJob("alice", make_candidate(CONDOR_UNIVERSE_LOCAL, "alice")));
+	CHECK( ! ShadowCanRunWaitingJob("alice", make_candidate(CONDOR_UNIVERSE_SCHEDULER, "alice")));
+
+	RecycleCandidate job = make_candidate(CONDOR_UNIVERSE_VANILLA, "alice");
+	job.is_reconnect = true;
+	CHECK( ! ShadowCanRunWaitingJob("alice", job));
+
+	job = make_candidate(CONDOR_UNIVERSE_VANILLA, "alice");
+	job.has_match = false;
+	CHECK( ! ShadowCanRunWaitingJob("alice", job));
+
+	job = make_candidate(CONDOR_UNIVERSE_VANILLA, "alice");
+	job.dedicated = true;
+	CHECK( ! ShadowCanRunWaitingJob("alice", job));
+
+	job = make_candidate(CONDOR_UNIVERSE_VANILLA, "alice");
+	job.paired = true;
+	CHECK( ! ShadowCanRunWaitingJob("alice", job));
+
+		// held or removed while it waited
+	job = make_candidate(CONDOR_UNIVERSE_VANILLA, "alice");
+	job.still_runnable = false;
+	CHECK( ! ShadowCanRunWaitingJob("alice", job));
+}
+
+int
+main( int /* argc */, char ** /* argv */ )
+{
+	test_snapshot_stable_across_commit();
+	test_snapshot_updated_in_place();
+	test_snapshot_without_cache();
+	test_prio_rec_index_order();
+	test_index_matches_scan();
+	test_recycle_shadow_hand_off();
+
+	if (failures == 0) {
+		fprintf(stdout, "No failures detected.\n");
+	}
+	return failures;
+}
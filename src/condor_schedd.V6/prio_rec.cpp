@@ -0,0 +1,95 @@
+/***************************************************************
+ *
+ * Copyright (C) 1990-2007, Condor Team, Computer Sciences Department,
+ * University of Wisconsin-Madison, WI.
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You may
+ * obtain a copy of the License at
+ * 
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************/
+
+#include "condor_common.h"
+#include "proc.h"
+#include "prio_rec.h"
+
+// The order of the PrioRec array and of each submitter's jobs in the
+// PrioRec index.  Returns -1 when a should run before b.
+extern "C" {
+int
+prio_compar(prio_rec* a, prio_rec* b)
+{
+	 /* compare submitted job preprio's: higher values have more priority */
+	 /* Typically used to prioritize entire DAG jobs over other DAG jobs */
+	if( a->pre_job_prio1 < b->pre_job_prio1 ) {
+		return 1;
+	}
+	if( a->pre_job_prio1 > b->pre_job_prio1 ) {
+		return -1;
+	}
+
+	if( a->pre_job_prio2 < b->pre_job_prio2 ) {
+		return 1;
+	}
+	if( a->pre_job_prio2 > b->pre_job_prio2 ) {
+		return -1;
+	}
+	 
+	 /* compare job priorities: higher values have more priority */
+	 if( a->job_prio < b->job_prio ) {
+		  return 1;
+	 }
+	 if( a->job_prio > b->job_prio ) {
+		  return -1;
+	 }
+	 
+	 /* compare submitted job postprio's: higher values have more priority */
+	 /* Typically used to prioritize entire DAG jobs over other DAG jobs */
+	if( a->post_job_prio1 < b->post_job_prio1 ) {
+		return 1;
+	}
+	if( a->post_job_prio1 > b->post_job_prio1 ) {
+		return -1;
+	}
+
+	if( a->post_job_prio2 < b->post_job_prio2 ) {
+		return 1;
+	}
+	if( a->post_job_prio2 > b->post_job_prio2 ) {
+		return -1;
+	}
+
+	 /* here,updown priority and job_priority are both equal */
+
+	 /* check for job submit times */
+	 if( a->qdate < b->qdate ) {
+		  return -1;
+	 }
+	 if( a->qdate > b->qdate ) {
+		  return 1;
+	 }
+
+	 /* go in order of cluster id */
+	if ( a->id.cluster < b->id.cluster )
+		return -1;
+	if ( a->id.cluster > b->id.cluster )
+		return 1;
+
+	/* finally, go in order of the proc id */
+	if ( a->id.proc < b->id.proc )
+		return -1;
+	if ( a->id.proc > b->id.proc )
+		return 1;
+
+	/* give up! very unlikely we'd ever get here */
+	return 0;
+}
+} // end of extern
@@ -26,6 +26,10 @@
 #ifndef _PRIO_REC_H_
 #define _PRIO_REC_H_
 
+#include <map>
+#include <set>
+#include <string>
+
 const 	int		INITIAL_MAX_PRIO_REC = 2048;
 
 /* this record contains all the parameters required for
@@ -59,4 +63,54 @@ public:
 	}
 };
 
+extern "C" int prio_compar(prio_rec*, prio_rec*);
+
+/* The runnable jobs of each submitter, in the same order as the sorted
+ * PrioRec array.  When SCHEDD_INCREMENTAL_PRIO_RECS is true this is kept
+ * up to date as jobs change instead of building the PrioRec array, so a
+ * job is inserted or removed in log time, and finding the jobs of one
+ * submitter does not mean walking past the jobs of all of the others. */
+class PrioRecIndex {
+public:
+	struct Less {
+		bool operator()(const prio_rec & a, const prio_rec & b) const {
+			return prio_compar(const_cast<prio_rec*>(&a), const_cast<prio_rec*>(&b)) < 0;
+		}
+	};
+	typedef std::set<prio_rec, Less> Queue;
+	typedef std::map<std::string, Queue> Submitters;
+
+	void Insert(const prio_rec & rec) {
+		Remove(rec.id);
+		Submitters::iterator sub = m_submitters.insert(Submitters::value_type(rec.submitter, Queue())).first;
+		Queue::iterator it = sub->second.insert(rec).first;
+		m_jobs[JOB_ID_KEY(rec.id)] = Location(sub, it);
+	}
+	void Remove(const JOB_ID_KEY & jid) {
+		std::map<JOB_ID_KEY, Location>::iterator loc = m_jobs.find(jid);
+		if (loc == m_jobs.end()) {
+			return;
+		}
+		Submitters::iterator sub = loc->second.first;
+		sub->second.erase(loc->second.second);
+		if (sub->second.empty()) {
+			m_submitters.erase(sub);
+		}
+		m_jobs.erase(loc);
+	}
+	void Clear() { m_jobs.clear(); m_submitters.clear(); }
+
+	int size() const { return (int)m_jobs.size(); }
+	const Submitters & All() const { return m_submitters; }
+	const Queue * Find(const char * submitter) const {
+		Submitters::const_iterator sub = m_submitters.find(submitter);
+		return (sub == m_submitters.end()) ? NULL : &sub->second;
+	}
+
+private:
+	typedef std::pair<Submitters::iterator, Queue::iterator> Location;
+	Submitters m_submitters;
+	std::map<JOB_ID_KEY, Location> m_jobs; // where each job is filed
+};
+
 #endif
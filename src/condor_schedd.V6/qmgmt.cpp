@@ -55,7 +55,10 @@
 #include "classad_helpers.h"
 #include "iso_dates.h"
 #include "jobsets.h"
+#include "job_queue_index.h"
+#include "job_queue_snapshot.h"
 #include <param_info.h>
+#include <queue>
 
 #if defined(HAVE_DLOPEN) || defined(WIN32)
 #include "ScheddPlugin.h"
@@ -86,7 +89,7 @@ ClassAdLog<K,AD>::filter_iterator::operator++(int)
 	int miss_count = 0;
 	Stopwatch sw;
 	sw.start();
-	while (!(m_cur == end))
+	while (m_keys ? (m_key_pos < m_keys->size()) : !(m_cur == end))
 	{
 		miss_count++;
 			// 500 was chosen here based on a queue of 1M jobs and
@@ -99,7 +102,12 @@ ClassAdLog<K,AD>::filter_iterator::operator++(int)
 		if ((miss_count % 500 == 0) && (sw.get_ms() > m_timeslice_ms)) {break;}
 
 		cur = *this;
-		AD tmp_ad = (*m_cur++).second;
+		AD tmp_ad = NULL;
+		if (m_keys) {
+			m_table->lookup((*m_keys)[m_key_pos++], tmp_ad);
+		} else {
+			tmp_ad = (*m_cur++).second;
+		}
 		if (!tmp_ad) continue;
 
 		// we want to ignore all but job ads, unless the options flag indicates we should
@@ -131,9 +139,10 @@ ClassAdLog<K,AD>::filter_iterator::operator++(int)
 		//}
 		cur.m_found_ad = true;
 		m_found_ad = true;
+		cur.m_key_ad = tmp_ad;
 		break;
 	}
-	if ((m_cur == end) && (!m_found_ad)) {
+	if ((m_keys ? (m_key_pos >= m_keys->size()) : (m_cur == end)) && (!m_found_ad)) {
 		m_done = true;
 	}
 	return cur;
@@ -171,6 +180,11 @@ int		MaterializeJobs(JobQueueCluster * clusterAd, TransactionWatcher & txn, int
 
 static bool qmgmt_was_initialized = false;
 static JobQueueType *JobQueue = 0;
+static JobQueueIndexes *JobQueueIndex = NULL; // NULL unless SCHEDD_JOB_QUEUE_INDEXES
+static PrioRecIndex *PrioRecs = NULL; // NULL unless SCHEDD_INCREMENTAL_PRIO_RECS
+static std::set<JOB_ID_KEY> PrioRecJobsChanged; // to be refiled in PrioRecs by the next BuildPrioRecArray()
+static JobQueueSnapshots JobQueueSnapshotter;
+static bool job_queue_snapshots_wanted = false;
 static StringList DirtyJobIDs;
 static std::set<int> DirtyPidsSignaled;
 static int next_cluster_num = -1;
@@ -196,6 +210,7 @@ typedef _condor_auto_accum_runtime< stats_entry_probe<double> > condor_auto_runt
 schedd_runtime_probe WalkJobQ_runtime;
 schedd_runtime_probe WalkJobQ_mark_idle_runtime;
 schedd_runtime_probe WalkJobQ_get_job_prio_runtime;
+schedd_runtime_probe WalkJobQ_index_job_prio_runtime;
 
 class Service;
 
@@ -239,6 +254,17 @@ static void HandleFlushJobQueueLogTimer();
 static int dirty_notice_interval = 0;
 static void PeriodicDirtyAttributeNotification();
 static void ScheduleJobQueueLogFlush();
+static bool job_queue_log_binary = false;
+static bool job_queue_group_commit = false;
+static int job_queue_commit_pipe[2] = { -1, -1 };
+static void ConfigJobQueueGroupCommit();
+static int HandleJobQueueCommitPipe(int pipe_end);
+static ClassAd JobQueueRecoveryStats;
+static bool job_queue_background_rotation = false;
+static int job_queue_rotation_pid = -1;
+static int job_queue_rotation_reaper_id = -1;
+static int JobQueueRotationWorker(void *, Stream *);
+static int JobQueueRotationReaper(int pid, int exit_status);
 
 bool qmgmt_all_users_trusted = false;
 static std::vector<std::string> super_users;
@@ -252,11 +278,38 @@ static const char *default_super_user =
 // in schedd.cpp
 void IncrementLiveJobCounter(LiveJobCounters & num, int universe, int status, int increment /*, JobQueueJob * job*/);
 
+// If the job queue indexes can tell which clusters the constraint can match,
+// return true and the keys of those cluster ads and of their jobs.
+bool
+GetJobQueueIndexKeys(const classad::ExprTree * constraint, std::vector<JobQueueKey> & keys)
+{
+	std::set<int> clusters;
+	if ( ! JobQueueIndex || ! JobQueueIndex->CandidateClusters(const_cast<classad::ExprTree*>(constraint), clusters)) {
+		return false;
+	}
+	for (auto it = clusters.begin(); it != clusters.end(); ++it) {
+		JobQueueCluster * clusterad = GetClusterAd(*it);
+		if ( ! clusterad) continue;
+		keys.push_back(clusterad->jid);
+		for (JobQueueJob * job = clusterad->FirstAttachedJob(); job; job = clusterad->NextAttachedJob(job)) {
+			keys.push_back(job->jid);
+		}
+	}
+	dprintf(D_FULLDEBUG, "Job queue indexes narrowed the query to %d clusters and %d ads\n",
+		(int)clusters.size(), (int)keys.size());
+	return true;
+}
+
 //static int allow_remote_submit = FALSE;
 JobQueueLogType::filter_iterator
 GetJobQueueIterator(const classad::ExprTree &requirements, int timeslice_ms)
 {
-	return JobQueue->GetFilteredIterator(requirements, timeslice_ms);
+	JobQueueLogType::filter_iterator it = JobQueue->GetFilteredIterator(requirements, timeslice_ms);
+	std::shared_ptr<std::vector<JobQueueKey> > keys(new std::vector<JobQueueKey>);
+	if (GetJobQueueIndexKeys(&requirements, *keys)) {
+		it.set_keys(keys);
+	}
+	return it;
 }
 
 JobQueueLogType::filter_iterator
@@ -421,6 +474,13 @@ ConstructClassAdLogTableEntry<JobQueueJob*>::Delete(ClassAd* &ad) const
 			// in which case the actual destruction would be delayed until the transaction commit. i.e. here...
 			IncrementLiveJobCounter(scheduler.liveJobCounts, job->Universe(), job->Status(), -1);
 			if (job->ownerinfo) { IncrementLiveJobCounter(job->ownerinfo->live, job->Universe(), job->Status(), -1); }
+			scheduler.uncountJob(job);
+			scheduler.forgetPeriodicExprs(job);
+			if (PrioRecs) {
+				PrioRecs->Remove(job->jid);
+				PrioRecJobsChanged.erase(job->jid);
+			}
+			if (JobQueueIndex) { JobQueueIndex->Remove(job); }
 
 			if (job->Cluster()) {
 				job->Cluster()->DetachJob(job);
@@ -431,6 +491,43 @@ ConstructClassAdLogTableEntry<JobQueueJob*>::Delete(ClassAd* &ad) const
 }
 
 
+// have the next count_jobs() recount this job, or all of the jobs in this cluster,
+// the next PeriodicExprHandler() evaluate their periodic expressions, and the
+// next BuildPrioRecArray() refile them in the PrioRec index.
+static void
+JobAdChanged(JobQueueJob * job)
+{
+	if ( ! scheduler.incrementalJobCounts() && ! scheduler.changeDrivenPeriodicExprs() && ! PrioRecs) {
+		return;
+	}
+	if (job->IsCluster()) {
+		JobQueueCluster * clusterad = static_cast<JobQueueCluster*>(job);
+		for (JobQueueJob * proc = clusterad->FirstAttachedJob(); proc; proc = clusterad->NextAttachedJob(proc)) {
+			scheduler.jobCountsChanged(proc);
+			scheduler.periodicExprsChanged(proc);
+			if (PrioRecs) { PrioRecJobsChanged.insert(proc->jid); }
+		}
+	} else if (job->IsJob()) {
+		scheduler.jobCountsChanged(job);
+		scheduler.periodicExprsChanged(job);
+		if (PrioRecs) { PrioRecJobsChanged.insert(job->jid); }
+	}
+}
+
+// keep the job queue indexes up to date with a change that was made outside of
+// a transaction.  changes inside a transaction are reindexed when it commits.
+static void
+JobQueueIndexAttrChanged(const JobQueueKey & key, const char * attr_name)
+{
+	if ( ! JobQueueIndex || JobQueue->InTransaction() || ! JobQueueIndexes::IsIndexedAttr(attr_name)) {
+		return;
+	}
+	JobQueueJob * job = NULL;
+	if (JobQueue->Lookup(key, job)) {
+		JobQueueIndex->Reindex(job);
+	}
+}
+
 static
 void
 ClusterCleanup(int cluster_id)
@@ -1271,6 +1368,142 @@ InitQmgmt()
 
 	flush_job_queue_log_delay = param_integer("SCHEDD_JOB_QUEUE_LOG_FLUSH_DELAY",5,0);
 	dirty_notice_interval = param_integer("SCHEDD_JOB_QUEUE_NOTIFY_UPDATES",30,0);
+
+#ifdef WIN32
+	job_queue_log_binary = false;
+#else
+	job_queue_log_binary = param_boolean("SCHEDD_JOB_QUEUE_LOG_BINARY", false);
+#endif
+	if (JobQueue) {
+		// takes effect the next time the log is cleaned
+		JobQueue->SetBinaryFormat(job_queue_log_binary);
+	}
+
+#ifdef WIN32
+	job_queue_background_rotation = false;
+#else
+	job_queue_background_rotation = param_boolean("SCHEDD_JOB_QUEUE_BACKGROUND_ROTATION", false);
+#endif
+
+	job_queue_group_commit = param_boolean("SCHEDD_JOB_QUEUE_GROUP_COMMIT", false);
+	if (JobQueue) {
+		ConfigJobQueueGroupCommit();
+	}
+}
+
+// With group commit on, durable job queue commits do not block the schedd
+// on an fdatasync.  The ClassAdLog writer thread syncs in the background
+// and pokes us through a pipe when it has, at which point we send the
+// replies that were waiting for the commit to be on disk.
+static void
+ConfigJobQueueGroupCommit()
+{
+	if (job_queue_group_commit == JobQueue->GroupCommit()) {
+		return;
+	}
+	if ( ! job_queue_group_commit) {
+		JobQueue->SetGroupCommit(false);
+		dprintf(D_ALWAYS, "Job queue group commit disabled\n");
+		return;
+	}
+
+#ifdef WIN32
+	dprintf(D_ALWAYS, "SCHEDD_JOB_QUEUE_GROUP_COMMIT is not supported on this platform, ignoring it\n");
+#else
+	if (job_queue_commit_pipe[0] == -1) {
+		if ( ! daemonCore->Create_Pipe(job_queue_commit_pipe, true, false, true, true)) {
+			dprintf(D_ALWAYS, "Failed to create job queue commit pipe, not using group commit\n");
+			return;
+		}
+		daemonCore->Register_Pipe(job_queue_commit_pipe[0], "Job queue commit pipe",
+			HandleJobQueueCommitPipe, "HandleJobQueueCommitPipe");
+	}
+	int notify_fd = -1;
+	if ( ! daemonCore->Get_Pipe_FD(job_queue_commit_pipe[1], &notify_fd)) {
+		dprintf(D_ALWAYS, "Failed to get job queue commit pipe fd, not using group commit\n");
+		return;
+	}
+	JobQueue->SetGroupCommit(true, notify_fd);
+	dprintf(D_ALWAYS, "Job queue group commit enabled\n");
+#endif
+}
+
+static int
+HandleJobQueueCommitPipe(int pipe_end)
+{
+	char buf[64];
+	while (daemonCore->Read_Pipe(pipe_end, buf, sizeof(buf)) > 0) {
+		// drain the wakeups, one pass over the callbacks covers them all
+	}
+	if (JobQueue) {
+		JobQueue->RunCommitCallbacks();
+	}
+	return TRUE;
+}
+
+void
+EnableJobQueueSnapshots(bool enable)
+{
+	job_queue_snapshots_wanted = enable;
+	if ( ! JobQueue) {
+		// InitJobQueue() starts them
+		return;
+	}
+	if (enable && ! JobQueueSnapshotter.Enabled()) {
+		JobQueueSnapshotter.Start(JobQueue);
+	} else if ( ! enable) {
+		JobQueueSnapshotter.Stop();
+	}
+}
+
+std::shared_ptr<const JobQueueSnapshot>
+GetJobQueueSnapshot()
+{
+	return JobQueueSnapshotter.Current();
+}
+
+void
+JobQueueAdChangedInPlace(const JobQueueKey & key)
+{
+	if (JobQueue) {
+		JobQueue->MarkKeyChanged(key);
+	}
+}
+
+void
+JobQueueWhenCommitted(const std::function<void()> & fn)
+{
+	if (JobQueue) {
+		JobQueue->WhenCommitted(fn);
+	} else {
+		fn();
+	}
+}
+
+bool
+JobQueueCommitPending()
+{
+	return JobQueue && JobQueue->CommitPending();
+}
+
+void
+AddJobQueueRecoveryTime(const char * phase, double secs)
+{
+	std::string attr;
+	formatstr(attr, "JobQueueRecovery%sTime", phase);
+	JobQueueRecoveryStats.Assign(attr, secs);
+
+	double total = 0;
+	JobQueueRecoveryStats.LookupFloat(ATTR_JOB_QUEUE_RECOVERY_TIME, total);
+	JobQueueRecoveryStats.Assign(ATTR_JOB_QUEUE_RECOVERY_TIME, total + secs);
+
+	dprintf(D_ALWAYS, "Job queue recovery: %s took %.3f seconds\n", phase, secs);
+}
+
+void
+PublishJobQueueRecoveryStats(ClassAd & ad)
+{
+	ad.Update(JobQueueRecoveryStats);
 }
 
 void
@@ -1583,6 +1816,21 @@ InitJobQueue(const char *job_queue_name,int max_historical_logs)
 	CheckSpoolVersion(spool.Value(),SPOOL_MIN_VERSION_SCHEDD_SUPPORTS,SPOOL_CUR_VERSION_SCHEDD_SUPPORTS,spool_min_version,spool_cur_version);
 
 	JobQueue = new JobQueueType(new ConstructClassAdLogTableEntry<JobQueuePayload>(),job_queue_name,max_historical_logs);
+	JobQueue->SetBinaryFormat(job_queue_log_binary);
+
+	const ClassAdLogLoadStats & load_stats = JobQueue->GetLoadStats();
+	JobQueueRecoveryStats.Assign(ATTR_JOB_QUEUE_RECOVERY_RECORDS, (long long)load_stats.records);
+	JobQueueRecoveryStats.Assign(ATTR_JOB_QUEUE_RECOVERY_THREADS, load_stats.threads);
+	AddJobQueueRecoveryTime("Read", load_stats.read_time);
+	AddJobQueueRecoveryTime("Parse", load_stats.parse_time);
+	AddJobQueueRecoveryTime("Play", load_stats.play_time);
+	double phase_start = _condor_debug_get_time_double();
+
+	if (JobQueue->IsBinaryFormat() != job_queue_log_binary) {
+			// rewrite the log in the configured format below
+		dprintf(D_ALWAYS, "Converting job queue log to %s format\n", job_queue_log_binary ? "binary" : "text");
+		JobQueueDirty = true;
+	}
 	ClusterSizeHashTable = new ClusterSizeHashTable_t(hashFuncInt);
 	TotalJobsCount = 0;
 	jobs_added_this_transaction = 0;
@@ -1985,6 +2233,28 @@ InitJobQueue(const char *job_queue_name,int max_historical_logs)
 			updates, scheduler.jobSets->count());
 	}
 
+	// the PrioRec index is filled by the first BuildPrioRecArray()
+	delete PrioRecs;
+	PrioRecs = NULL;
+	PrioRecJobsChanged.clear();
+	if (param_boolean("SCHEDD_INCREMENTAL_PRIO_RECS", false)) {
+		PrioRecs = new PrioRecIndex();
+	}
+	DirtyPrioRecArray();
+
+	// Index the jobs now that they are all chained to their cluster ads
+	delete JobQueueIndex;
+	JobQueueIndex = NULL;
+	if (param_boolean("SCHEDD_JOB_QUEUE_INDEXES", true)) {
+		JobQueueIndex = new JobQueueIndexes();
+		JobQueue->StartIterateAllClassAds();
+		while (JobQueue->Iterate(ad)) {
+			if (ad->IsJob()) {
+				JobQueueIndex->Reindex(ad);
+			}
+		}
+	}
+
 
     // We defined a candidate next_cluster_num above, as (current-max-clust) + (increment).
     // If the candidate exceeds the configured max, then wrap it.  Default maximum is zero,
@@ -2028,12 +2298,17 @@ InitJobQueue(const char *job_queue_name,int max_historical_logs)
 		// The spool renaming also needs to be saved here.  This is not
 		// optional, so we cannot just call CleanJobQueue() here, because
 		// that does not abort on failure.
+	double now = _condor_debug_get_time_double();
+	AddJobQueueRecoveryTime("Convert", now - phase_start);
+	phase_start = now;
+
 	if( JobQueueDirty ) {
 		if( !JobQueue->TruncLog() ) {
 			EXCEPT("Failed to write the modified job queue log to disk, so cannot continue.");
 		}
 		JobQueueDirty = false;
 	}
+	AddJobQueueRecoveryTime("Rotate", _condor_debug_get_time_double() - phase_start);
 
 	if( spool_cur_version < 1 ) {
 		SpoolHierarchyChangePass2(spool.Value(),spool_rename_list);
@@ -2042,6 +2317,13 @@ InitJobQueue(const char *job_queue_name,int max_historical_logs)
 	if( spool_cur_version != SPOOL_CUR_VERSION_SCHEDD_SUPPORTS ) {
 		WriteSpoolVersion(spool.Value(),SPOOL_MIN_VERSION_SCHEDD_WRITES,SPOOL_CUR_VERSION_SCHEDD_SUPPORTS);
 	}
+
+		// recovery above commits synchronously, group commit starts now
+	ConfigJobQueueGroupCommit();
+
+	if (job_queue_snapshots_wanted) {
+		JobQueueSnapshotter.Start(JobQueue);
+	}
 }
 
 
@@ -2056,6 +2338,70 @@ CleanJobQueue()
 }
 
 
+// With SCHEDD_JOB_QUEUE_BACKGROUND_ROTATION, the periodic rotation of
+// the job queue log forks a process that writes out the state of the
+// queue, while we keep appending to the old log.  When it exits, the
+// reaper copies what we appended onto the new log and swaps it in.
+void
+CleanJobQueueInBackground()
+{
+	if ( ! job_queue_background_rotation) {
+		CleanJobQueue();
+		return;
+	}
+	if (job_queue_rotation_pid > 0) {
+		dprintf(D_ALWAYS, "Job queue log is still being rotated by pid %d\n", job_queue_rotation_pid);
+		return;
+	}
+	if ( ! JobQueue->BeginBackgroundTruncLog()) {
+		dprintf(D_ALWAYS, "Cannot rotate the job queue log in the background, cleaning job queue...\n");
+		JobQueue->TruncLog();
+		JobQueueDirty = false;
+		return;
+	}
+
+	if (job_queue_rotation_reaper_id < 0) {
+		job_queue_rotation_reaper_id = daemonCore->Register_Reaper(
+			"JobQueueRotationReaper", JobQueueRotationReaper, "JobQueueRotationReaper");
+	}
+	int pid = daemonCore->Create_Thread(JobQueueRotationWorker, NULL, NULL, job_queue_rotation_reaper_id);
+	if (pid == FALSE) {
+		dprintf(D_ALWAYS, "Failed to fork to rotate the job queue log, cleaning job queue...\n");
+		JobQueue->FinishBackgroundTruncLog(false);
+		JobQueue->TruncLog();
+		JobQueueDirty = false;
+		return;
+	}
+	job_queue_rotation_pid = pid;
+	JobQueueDirty = false;
+}
+
+static int
+JobQueueRotationWorker(void *, Stream *)
+{
+	return JobQueue->WriteBackgroundTruncLog() ? 0 : 1;
+}
+
+static int
+JobQueueRotationReaper(int pid, int exit_status)
+{
+	if (pid != job_queue_rotation_pid) {
+		return FALSE;
+	}
+	job_queue_rotation_pid = -1;
+	if ( ! JobQueue) {
+		return TRUE;
+	}
+
+	bool written = WIFEXITED(exit_status) && WEXITSTATUS(exit_status) == 0;
+	if ( ! JobQueue->FinishBackgroundTruncLog(written)) {
+			// make sure the log is rotated on shutdown at least
+		JobQueueDirty = true;
+	}
+	return TRUE;
+}
+
+
 void
 DestroyJobQueue( void )
 {
@@ -2074,8 +2420,16 @@ DestroyJobQueue( void )
 		CleanJobQueue();
 	}
 	ASSERT( JobQueueDirty == false );
+		// answer anyone still waiting on a group commit
+	JobQueue->SetGroupCommit(false);
+	JobQueueSnapshotter.Stop();
 	delete JobQueue;
 	JobQueue = NULL;
+	delete JobQueueIndex;
+	JobQueueIndex = NULL;
+	delete PrioRecs;
+	PrioRecs = NULL;
+	PrioRecJobsChanged.clear();
 
 	DirtyJobIDs.clearAll();
 
@@ -2824,10 +3178,13 @@ unsetQSock()
 }
 
 
+static int serve_q_requests(ReliSock *sock);
+static void park_q_session(ReliSock *sock);
+static int handle_q_resume(Stream *sock);
+
 int
 handle_q(int cmd, Stream *sock)
 {
-	int	rval;
 	bool all_good;
 
 	all_good = setQSock((ReliSock*)sock);
@@ -2848,12 +3205,27 @@ handle_q(int cmd, Stream *sock)
 
 	BeginTransaction();
 
+	return serve_q_requests((ReliSock*)sock);
+}
+
+// Runs the qmgmt session set up in Q_SOCK until the client closes it, or
+// parks the session while a reply waits for its commit to be on disk and
+// returns KEEP_STREAM.  See handle_q_resume().
+static int
+serve_q_requests(ReliSock *sock)
+{
+	int	rval;
 	bool may_fork = false;
 	ForkStatus fork_status = FORK_FAILED;
 	do {
 		/* Probably should wrap a timer around this */
 		rval = do_Q_request( *Q_SOCK, may_fork );
 
+		if( rval == Q_REPLY_WHEN_COMMITTED ) {
+			park_q_session(sock);
+			return KEEP_STREAM;
+		}
+
 		if( may_fork && fork_status == FORK_FAILED ) {
 			fork_status = schedd_forker.NewJob();
 
@@ -2885,6 +3257,50 @@ handle_q(int cmd, Stream *sock)
 	return 0;
 }
 
+// Set the session aside until the group commit is on disk, then send the
+// reply and wait for the client's next request.  Other clients are served
+// meanwhile.
+static void
+park_q_session(ReliSock *sock)
+{
+	QmgmtPeer *peer = getQmgmtConnectionInfo();
+	ASSERT(peer);
+	if (daemonCore->SocketIsRegistered(sock)) {
+		daemonCore->Cancel_Socket(sock);
+	}
+
+	JobQueueWhenCommitted([peer, sock]() {
+		int rval = peer->reply_when_committed();
+		peer->reply_when_committed = nullptr;
+		if (rval >= 0) {
+			rval = daemonCore->Register_Socket(sock, "Qmgmt Client",
+				handle_q_resume, "handle_q_resume", ALLOW);
+		}
+		if (rval < 0) {
+			dprintf(D_FULLDEBUG, "QMGR Connection closed before commit reply\n");
+				// the peer holds no transaction after a commit
+			delete peer;
+			delete sock;
+			return;
+		}
+		daemonCore->Register_DataPtr(peer);
+	});
+}
+
+// Called when a client whose session was parked by park_q_session()
+// sends its next request.
+static int
+handle_q_resume(Stream *sock)
+{
+	QmgmtPeer *peer = (QmgmtPeer*)daemonCore->GetDataPtr();
+	ASSERT(peer);
+	if ( ! setQmgmtConnectionInfo(peer)) {
+		delete peer;
+		return 0;
+	}
+	return serve_q_requests((ReliSock*)sock);
+}
+
 int GetMyProxyPassword (int, int, char **);
 
 int get_myproxy_password_handler(int /*i*/, Stream *socket) {
@@ -3395,7 +3811,9 @@ int DestroyProc(int cluster_id, int proc_id)
 	scheduler.autocluster.removeFromAutocluster(*ad);
 
 	// Append to history file
-	AppendHistory(ad);
+	if (AppendHistory(ad)) {
+		scheduler.rememberHistoryAd(*ad);
+	}
 
 	// Write a per-job history file (if PER_JOB_HISTORY_DIR param is set)
 	WritePerJobHistoryFile(ad, false);
@@ -3575,7 +3993,9 @@ int DestroyCluster(int cluster_id, const char* reason)
 				}
 
 				// Apend to history file
-				AppendHistory(ad);
+				if (AppendHistory(ad)) {
+					scheduler.rememberHistoryAd(*ad);
+				}
 #if defined(HAVE_DLOPEN) || defined(WIN32)
 				ScheddPluginManager::Archive(ad);
 #endif
@@ -3870,6 +4290,7 @@ SetSecureAttributeInt(int cluster_id, int proc_id, const char *attr_name, int at
 	JOB_ID_KEY_BUF key;
 	IdToKey(cluster_id,proc_id,key);
 	JobQueue->SetAttribute(key, attr_name, buf, flags & SETDIRTY);
+	JobQueueIndexAttrChanged(key, attr_name);
 
 	return 0;
 }
@@ -3893,6 +4314,7 @@ SetSecureAttributeString(int cluster_id, int proc_id, const char *attr_name, con
 	JOB_ID_KEY_BUF key;
 	IdToKey(cluster_id,proc_id,key);
 	JobQueue->SetAttribute(key, attr_name, buf.c_str(), flags & SETDIRTY);
+	JobQueueIndexAttrChanged(key, attr_name);
 
 	return 0;
 }
@@ -3906,6 +4328,7 @@ SetSecureAttribute(int cluster_id, int proc_id, const char *attr_name, const cha
 	JOB_ID_KEY_BUF key;
 	IdToKey(cluster_id,proc_id,key);
 	JobQueue->SetAttribute(key, attr_name, attr_value, flags & SETDIRTY);
+	JobQueueIndexAttrChanged(key, attr_name);
 
 	return 0;
 }
@@ -4563,13 +4986,18 @@ SetAttribute(int cluster_id, int proc_id, const char *attr_name,
 
 		// give the autocluster code a chance to invalidate (or rebuild)
 		// based on the changed attribute.
-		if (scheduler.autocluster.preSetAttribute(*job, attr_name, attr_value, flags)) {
+		// when the PrioRec index is kept, JobAdChanged() refiles just this job instead.
+		if (scheduler.autocluster.preSetAttribute(*job, attr_name, attr_value, flags) && ! PrioRecs) {
 			DirtyPrioRecArray();
 			dprintf(D_FULLDEBUG,
 					"Prioritized runnable job list will be rebuilt, because "
 					"ClassAd attribute %s=%s changed\n",
 					attr_name,attr_value);
 		}
+
+		// this catches changes made outside of a transaction,
+		// the commit catches the rest.
+		JobAdChanged(job);
 	}
 
 	// This block handles rounding of attributes.
@@ -4681,7 +5109,7 @@ SetAttribute(int cluster_id, int proc_id, const char *attr_name,
 	}
 	free( round_param );
 
-	if( !PrioRecArrayIsDirty ) {
+	if( !PrioRecArrayIsDirty && ! PrioRecs ) {
 		if (attr_category & catDirtyPrioRec) {
 			DirtyPrioRecArray();
 		} else if(attr_id == idATTR_JOB_STATUS) {
@@ -4714,6 +5142,7 @@ SetAttribute(int cluster_id, int proc_id, const char *attr_name,
 	}
 
 	JobQueue->SetAttribute(key, attr_name, attr_value, flags & SETDIRTY);
+	JobQueueIndexAttrChanged(key, attr_name);
 	if( flags & SHOULDLOG ) {
 		const char* old_val = NULL;
 		if (job) {
@@ -5699,8 +6128,9 @@ int CommitTransactionInternal( bool durable, CondorError * errorStack ) {
 	// so we can clear the trigger bit here.
 	triggers &= ~catSpoolingHold;
 
+	// the keys are always needed to drop the cached autocluster values of changed cluster ads
+	JobQueue->GetTransactionKeys(ad_keys);
 	if (triggers) {
-		JobQueue->GetTransactionKeys(ad_keys);
 
 		// before we commit the transaction, if there were changes to a cluster ad
 		// update the EditedClusterAttrs for that cluster
@@ -5932,6 +6362,31 @@ int CommitTransactionInternal( bool durable, CondorError * errorStack ) {
 	}	// end of if a new cluster(s) submitted
 
 
+	// the jobs of a cluster whose ad changed have to unparse its values again when
+	// their autocluster is next worked out. this is not done in preSetAttribute(),
+	// since a signature made before the commit would cache the old values again.
+	for (auto it = ad_keys.begin(); it != ad_keys.end(); ++it) {
+		JobQueueKey job_id;
+		if (job_id.set(it->c_str()) && job_id.cluster > 0 && job_id.proc < 0) {
+			scheduler.autocluster.clusterAdChanged(job_id.cluster);
+		}
+	}
+
+	// have the next count_jobs() recount the jobs that were changed in this transaction,
+	// the next PeriodicExprHandler() evaluate them and the next BuildPrioRecArray() refile
+	// them, and refile them in the job queue indexes.
+	if (scheduler.incrementalJobCounts() || scheduler.changeDrivenPeriodicExprs() || JobQueueIndex || PrioRecs) {
+		JobQueueKey job_id;
+		for (auto it = ad_keys.begin(); it != ad_keys.end(); ++it) {
+			if ( ! job_id.set(it->c_str()) || job_id.cluster <= 0) continue;
+			JobQueueJob * job = NULL;
+			if (JobQueue->Lookup(job_id, job)) {
+				JobAdChanged(job);
+				if (JobQueueIndex) { JobQueueIndex->Reindex(job); }
+			}
+		}
+	}
+
 	// finally, invoke callbacks that were triggered by various SetAttribute calls in the transaction.
 	// NOTE: you might be tempted to move this up above the processing of new ad keys, but that won't work
 	// because most lookups in the job ad don't work until it has been chained to the cluster ad.
@@ -6277,7 +6732,17 @@ DeleteAttribute(int cluster_id, int proc_id, const char *attr_name)
 		return rc;
 	}
 
+	JobQueueJob * job = NULL;
+	if (JobQueue->Lookup(key, job) && job) {
+			// as in SetAttribute(), the job leaves its autocluster if
+			// the attribute is significant.
+		if (scheduler.autocluster.preSetAttribute(*job, attr_name, NULL, SetAttribute_Delete) && ! PrioRecs) {
+			DirtyPrioRecArray();
+		}
+	}
+
 	JobQueue->DeleteAttribute(key, attr_name);
+	JobQueueIndexAttrChanged(key, attr_name);
 
 	JobQueueDirty = true;
 
@@ -7256,8 +7721,34 @@ GetNextJobByConstraint(const char *constraint, int initScan)
 	JobQueueJob *ad;
 	JobQueueKey key;
 
+		// when the job queue indexes can narrow the constraint, the scan
+		// walks the keys of the clusters they picked instead of the queue
+	static std::vector<JobQueueKey> index_keys;
+	static size_t index_pos = 0;
+	static bool use_index = false;
+
 	if (initScan) {
-		JobQueue->StartIterateAllClassAds();
+		use_index = false;
+		index_keys.clear();
+		index_pos = 0;
+		classad::ExprTree * tree = NULL;
+		if (JobQueueIndex && constraint && constraint[0] && ParseClassAdRvalExpr(constraint, tree) == 0) {
+			use_index = GetJobQueueIndexKeys(tree, index_keys);
+		}
+		delete tree;
+		if ( ! use_index) {
+			JobQueue->StartIterateAllClassAds();
+		}
+	}
+
+	if (use_index) {
+		while (index_pos < index_keys.size()) {
+			key = index_keys[index_pos++];
+			if (key.proc >= 0 && JobQueue->Lookup(key, ad) && EvalExprBool(ad, constraint)) {
+				return ad;
+			}
+		}
+		return NULL;
 	}
 
 	while(JobQueue->Iterate(key,ad)) {
@@ -7539,10 +8030,11 @@ int    last_autocluster_type=0;
 int    last_autocluster_classad_cache_hit=0;
 stats_entry_abs<int> SCGetAutoClusterType;
 
-// Returns cur_hosts so that another function in the scheduler can
-// update JobsRunning and keep the scheduler and queue manager
-// seperate. 
-int get_job_prio(JobQueueJob *job, const JOB_ID_KEY & jid, void *)
+// Fills in the prio_rec of a job that should be considered for running,
+// returns false if it should not be.  jobs that are already matched are
+// left out unless include_matched is true.  cur_hosts is set either way.
+static bool
+make_prio_rec(JobQueueJob *job, const JOB_ID_KEY & jid, prio_rec & rec, int & cur_hosts, bool include_matched)
 {
     int     job_prio = 0, 
             pre_job_prio1, 
@@ -7552,7 +8044,6 @@ int get_job_prio(JobQueueJob *job, const JOB_ID_KEY & jid, void *)
     int     job_status;
     int     q_date;
     char    owner[100];
-    int     cur_hosts;
     int     max_hosts;
     int     universe;
 
@@ -7605,12 +8096,12 @@ int get_job_prio(JobQueueJob *job, const JOB_ID_KEY & jid, void *)
 			job_status==REMOVED || job_status==COMPLETED ||
 			job->IsNoopJob() ||
 			!service_this_universe(universe,job) ||
-			scheduler.AlreadyMatched(job, job->Universe()))
+			( ! include_matched && scheduler.AlreadyMatched(job, job->Universe())))
 	{
-        return cur_hosts;
+        return false;
 	}
 
-	// --- Insert this job into the PrioRec array ---
+	// --- Fill in the prio_rec of this job ---
 
        // If pre/post prios are not defined as forced attributes, set them to INT_MIN
 	// to flag priocompare routine to not use them.
@@ -7668,30 +8159,80 @@ int get_job_prio(JobQueueJob *job, const JOB_ID_KEY & jid, void *)
 		}
 	}
 
-    PrioRec[N_PrioRecs].id             = jid;
-    PrioRec[N_PrioRecs].job_prio       = job_prio;
-    PrioRec[N_PrioRecs].pre_job_prio1  = pre_job_prio1;
-    PrioRec[N_PrioRecs].pre_job_prio2  = pre_job_prio2;
-    PrioRec[N_PrioRecs].post_job_prio1 = post_job_prio1;
-    PrioRec[N_PrioRecs].post_job_prio2 = post_job_prio2;
-    PrioRec[N_PrioRecs].status         = job_status;
-    PrioRec[N_PrioRecs].qdate          = q_date;
+    rec.id             = jid;
+    rec.job_prio       = job_prio;
+    rec.pre_job_prio1  = pre_job_prio1;
+    rec.pre_job_prio2  = pre_job_prio2;
+    rec.post_job_prio1 = post_job_prio1;
+    rec.post_job_prio2 = post_job_prio2;
+    rec.status         = job_status;
+    rec.qdate          = q_date;
 	if ( auto_id == -1 ) {
-		PrioRec[N_PrioRecs].auto_cluster_id = jid.cluster;
+		rec.auto_cluster_id = jid.cluster;
 	} else {
-		PrioRec[N_PrioRecs].auto_cluster_id = auto_id;
+		rec.auto_cluster_id = auto_id;
 	}
 
-	strcpy(PrioRec[N_PrioRecs].submitter, powner);
+	strcpy(rec.submitter, powner);
+
+	return true;
+}
 
-    N_PrioRecs += 1;
-	if ( N_PrioRecs == MAX_PRIO_REC ) {
-		grow_prio_recs( 2 * N_PrioRecs );
+// Returns cur_hosts so that another function in the scheduler can
+// update JobsRunning and keep the scheduler and queue manager
+// seperate. 
+int get_job_prio(JobQueueJob *job, const JOB_ID_KEY & jid, void *)
+{
+	int cur_hosts = 0;
+	if (make_prio_rec(job, jid, PrioRec[N_PrioRecs], cur_hosts, false)) {
+		N_PrioRecs += 1;
+		if ( N_PrioRecs == MAX_PRIO_REC ) {
+			grow_prio_recs( 2 * N_PrioRecs );
+		}
 	}
+	return cur_hosts;
+}
 
+// the same for the PrioRec index, which keeps matched jobs, since a match
+// going away is not a change to the job.  FindRunnableJob() skips them.
+static int
+index_job_prio(JobQueueJob *job, const JOB_ID_KEY & jid, void *)
+{
+	prio_rec rec;
+	int cur_hosts = 0;
+	if (make_prio_rec(job, jid, rec, cur_hosts, true)) {
+		PrioRecs->Insert(rec);
+	}
 	return cur_hosts;
 }
 
+// refile the jobs that changed since the last time in the PrioRec index
+static void
+UpdatePrioRecIndex()
+{
+	if (PrioRecJobsChanged.empty()) {
+		return;
+	}
+	for (auto it = PrioRecJobsChanged.begin(); it != PrioRecJobsChanged.end(); ++it) {
+		PrioRecs->Remove(*it);
+		JobQueueJob * job = GetJobAd(*it);
+		if (job) {
+			index_job_prio(job, *it, NULL);
+		}
+	}
+	N_PrioRecs = PrioRecs->size();
+	dprintf(D_FULLDEBUG, "Updated prioritized runnable job list for %d changed jobs, %d runnable jobs\n",
+		(int)PrioRecJobsChanged.size(), N_PrioRecs);
+	PrioRecJobsChanged.clear();
+}
+
+const PrioRecIndex *
+GetPrioRecIndex()
+{
+	return PrioRecs;
+}
+
+
 bool
 jobLeaseIsValid( ClassAd* job, int cluster, int proc )
 {
@@ -8053,7 +8594,14 @@ static void DoBuildPrioRecArray() {
 	BuildPrioRec_mark_runtime += rt.tick(now);
 
 	N_PrioRecs = 0;
-	WalkJobQueue(get_job_prio);
+	if (PrioRecs) {
+		PrioRecs->Clear();
+		PrioRecJobsChanged.clear();
+		WalkJobQueue(index_job_prio);
+		N_PrioRecs = PrioRecs->size();
+	} else {
+		WalkJobQueue(get_job_prio);
+	}
 	BuildPrioRec_walk_runtime += rt.tick(now);
 
 		// N_PrioRecs might be 0, if we have no jobs to run at the
@@ -8062,7 +8610,7 @@ static void DoBuildPrioRecArray() {
 		// array, since that's not that expensive, and we need it for
 		// all the flocking logic at the end of this function.
 		// Discovered by Derek Wright and insure-- on 2/28/01
-	if( N_PrioRecs ) {
+	if( N_PrioRecs && ! PrioRecs ) {
 		qsort( (char *)PrioRec, N_PrioRecs, sizeof(PrioRec[0]),
 			   (int(*)(const void*, const void*))prio_compar );
 		BuildPrioRec_sort_runtime += rt.tick(now);
@@ -8112,6 +8660,12 @@ bool BuildPrioRecArray(bool no_match_found /*default false*/) {
 		PrioRecAutoClusterRejected->clear();
 	}
 
+		// the PrioRec index is only rebuilt when something other than
+		// the jobs changes, or periodically to sweep the autoclusters.
+	if (PrioRecs) {
+		UpdatePrioRecIndex();
+	}
+
 	if( !PrioRecArrayIsDirty ) {
 		dprintf(D_FULLDEBUG,
 				"Reusing prioritized runnable job list because nothing has "
@@ -8180,8 +8734,6 @@ bool UniverseUsesVanillaStartExpr(int universe)
 void FindRunnableJob(PROC_ID & jobid, ClassAd* my_match_ad, 
 					 char const * user)
 {
-	JobQueueJob *ad;
-
 	if (user && (strlen(user) == 0)) {
 		user = NULL;
 	}
@@ -8234,141 +8786,188 @@ void FindRunnableJob(PROC_ID & jobid, ClassAd* my_match_ad,
 
 	bool rebuilt_prio_rec_array = BuildPrioRecArray();
 
+		// Check one job of the prioritized list, returns 1 if it is the
+		// one, 0 if not, and -1 if it is no longer runnable and its record
+		// should be disabled until the PrioRec array is rebuilt.
+	auto try_prio_rec = [&](const prio_rec & rec) -> int {
+		JobQueueJob *ad = GetJobAd( rec.id.cluster, rec.id.proc );
+		if (!ad) {
+				// This ad must have been deleted since we last built
+				// runnable job list.
+			return 0;
+		}	
 
-		// Iterate through the most recently constructed list of
-		// jobs, nicely pre-sorted in priority order.
-
-	do {
-		for (i=0; i < N_PrioRecs; i++) {
-
-			if ( PrioRec[i].submitter[0] == '\0' ) {
-					// This record has been disabled, because it is no longer
-					// runnable.
-				continue;
-			}
+		int junk; // don't care about the value
+		if ( PrioRecAutoClusterRejected->lookup( rec.auto_cluster_id, junk ) == 0 ) {
+				// We have already failed to match a job from this same
+				// autocluster with this machine.  Skip it.
+			return 0;
+		}
 
-			if ( !match_any_user && strcmp(PrioRec[i].submitter, user) != 0 ) {
-					// Owner doesn't match.
-				continue;
+		PROC_ID id = rec.id;
+		int isRunnable = Runnable(&id);
+		int isMatched = scheduler.AlreadyMatched(&id);
+		if( !isRunnable || isMatched ) {
+				// This job's status must have changed since the
+				// time it was added to the runnable job list.
+				// Prevent this job from being considered in any
+				// future iterations through the list.  the PrioRec
+				// index keeps the record, it is refiled when the
+				// job changes.
+			if ( ! PrioRecs) {
+				dprintf(D_FULLDEBUG,
+					"record for job %d.%d skipped until PrioRec rebuild (%s)\n",
+					rec.id.cluster, rec.id.proc, isRunnable ? "already matched" : "no longer runnable");
 			}
+			return -1;
+		}
 
-			ad = GetJobAd( PrioRec[i].id.cluster, PrioRec[i].id.proc );
-			if (!ad) {
-					// This ad must have been deleted since we last built
-					// runnable job list.
-				continue;
-			}	
 
-			int junk; // don't care about the value
-			if ( PrioRecAutoClusterRejected->lookup( PrioRec[i].auto_cluster_id, junk ) == 0 ) {
-					// We have already failed to match a job from this same
-					// autocluster with this machine.  Skip it.
-				continue;
-			}
+			// Now check if the job and the claimed resource match.
+			// NOTE : we must do this AFTER we ensure the job is still runnable, which
+			// is why we invoke Runnable() above first.
+		if ( ! IsAMatch( ad, my_match_ad ) ) {
+				// Job and machine do not match.
+				// Assume that none of the other jobs in this auto-cluster will match.
+				// THIS IS A DANGEROUS ASSUMPTION - what if this job is no longer
+				// part of this autocluster?  TODO perhaps we should verify this
+				// job is still part of this autocluster here.
+			PrioRecAutoClusterRejected->insert( rec.auto_cluster_id, 1 );
+				// Move along to the next job in the prio rec array
+			return 0;
+		}
 
-			int isRunnable = Runnable(&PrioRec[i].id);
-			int isMatched = scheduler.AlreadyMatched(&PrioRec[i].id);
-			if( !isRunnable || isMatched ) {
-					// This job's status must have changed since the
-					// time it was added to the runnable job list.
-					// Prevent this job from being considered in any
-					// future iterations through the list.
-				PrioRec[i].submitter[0] = '\0';
-				dprintf(D_FULLDEBUG,
-						"record for job %d.%d skipped until PrioRec rebuild (%s)\n",
-						PrioRec[i].id.cluster, PrioRec[i].id.proc, isRunnable ? "already matched" : "no longer runnable");
+			// Now check of the job can be started - this checks various schedd limits
+			// as embodied by the START_VANILLA_UNIVERSE expression.
+#ifdef USE_VANILLA_START
+		if (eval_for_each_job) {
+			vad.Insert(job_attr, ad);
+			bool runnable = scheduler.evalVanillaStartExpr(vad);
+			vad.Remove(job_attr);
 
+			if ( ! runnable) {
+				dprintf(D_FULLDEBUG | D_MATCH, "job %d.%d Matches, but START_VANILLA_UNIVERSE is false\n", ad->jid.cluster, ad->jid.proc);
 					// Move along to the next job in the prio rec array
-				continue;
+				return 0;
 			}
+		}
+#endif
 
-				// Now check if the job and the claimed resource match.
-				// NOTE : we must do this AFTER we ensure the job is still runnable, which
-				// is why we invoke Runnable() above first.
-			if ( ! IsAMatch( ad, my_match_ad ) ) {
-					// Job and machine do not match.
-					// Assume that none of the other jobs in this auto-cluster will match.
-					// THIS IS A DANGEROUS ASSUMPTION - what if this job is no longer
-					// part of this autocluster?  TODO perhaps we should verify this
-					// job is still part of this autocluster here.
-				PrioRecAutoClusterRejected->insert( PrioRec[i].auto_cluster_id, 1 );
-					// Move along to the next job in the prio rec array
-				continue;
+			// Make sure that the startd ranks this job >= the
+			// rank of the job that initially claimed it.
+			// We stashed that rank in the startd ad when
+			// the match was created.
+			// (As of 6.9.0, the startd does not reject reuse
+			// of the claim with lower RANK, but future versions
+			// very well may.)
+
+		float current_startd_rank;
+		if( my_match_ad &&
+			my_match_ad->LookupFloat(ATTR_CURRENT_RANK, current_startd_rank) )
+		{
+			float new_startd_rank = 0;
+			if( EvalFloat(ATTR_RANK, my_match_ad, ad, new_startd_rank) )
+			{
+				if( new_startd_rank < current_startd_rank ) {
+					return 0;
+				}
 			}
+		}
 
-				// Now check of the job can be started - this checks various schedd limits
-				// as embodied by the START_VANILLA_UNIVERSE expression.
-#ifdef USE_VANILLA_START
-			if (eval_for_each_job) {
-				vad.Insert(job_attr, ad);
-				bool runnable = scheduler.evalVanillaStartExpr(vad);
-				vad.Remove(job_attr);
-
-				if ( ! runnable) {
-					dprintf(D_FULLDEBUG | D_MATCH, "job %d.%d Matches, but START_VANILLA_UNIVERSE is false\n", ad->jid.cluster, ad->jid.proc);
-						// Move along to the next job in the prio rec array
-					continue;
-				}
+			// If Concurrency Limits are in play it is
+			// important not to reuse a claim from one job
+			// that has one set of limits for a job that
+			// has a different set. This is because the
+			// Accountant is keeping track of limits based
+			// on the matches that are being handed out.
+			//
+			// A future optimization here may be to allow
+			// jobs with a subset of the limits given to
+			// the current match to reuse it.
+
+		std::string jobLimits, recordedLimits;
+		if (param_boolean("CLAIM_RECYCLING_CONSIDER_LIMITS", true)) {
+			ad->LookupString(ATTR_CONCURRENCY_LIMITS, jobLimits);
+			my_match_ad->LookupString(ATTR_MATCHED_CONCURRENCY_LIMITS,
+									  recordedLimits);
+			lower_case(jobLimits);
+			lower_case(recordedLimits);
+
+			if (jobLimits == recordedLimits) {
+				dprintf(D_FULLDEBUG,
+						"ConcurrencyLimits match, can reuse claim\n");
+			} else {
+				dprintf(D_FULLDEBUG,
+						"ConcurrencyLimits do not match, cannot "
+						"reuse claim\n");
+				PrioRecAutoClusterRejected->
+					insert(rec.auto_cluster_id, 1);
+				return 0;
 			}
-#endif
+		}
 
-				// Make sure that the startd ranks this job >= the
-				// rank of the job that initially claimed it.
-				// We stashed that rank in the startd ad when
-				// the match was created.
-				// (As of 6.9.0, the startd does not reject reuse
-				// of the claim with lower RANK, but future versions
-				// very well may.)
-
-			float current_startd_rank;
-			if( my_match_ad &&
-				my_match_ad->LookupFloat(ATTR_CURRENT_RANK, current_startd_rank) )
-			{
-				float new_startd_rank = 0;
-				if( EvalFloat(ATTR_RANK, my_match_ad, ad, new_startd_rank) )
-				{
-					if( new_startd_rank < current_startd_rank ) {
-						continue;
+		jobid = rec.id; // success!
+		return 1;
+	};
+
+		// Iterate through the most recently constructed list of
+		// jobs, nicely pre-sorted in priority order.
+
+	do {
+		if (PrioRecs) {
+				// the index has the jobs of each submitter in order, when
+				// matching any user merge the submitters' queues so that the
+				// jobs are tried in the same order as the PrioRec array.
+			if (match_any_user) {
+				typedef std::pair<PrioRecIndex::Queue::const_iterator, PrioRecIndex::Queue::const_iterator> Cursor;
+				PrioRecIndex::Less less;
+				auto after = [&less](const Cursor & a, const Cursor & b) { return less(*b.first, *a.first); };
+				std::priority_queue<Cursor, std::vector<Cursor>, decltype(after)> heads(after);
+				for (auto sub = PrioRecs->All().begin(); sub != PrioRecs->All().end(); ++sub) {
+					if ( ! sub->second.empty()) {
+						heads.push(Cursor(sub->second.begin(), sub->second.end()));
+					}
+				}
+				while ( ! heads.empty()) {
+					Cursor head = heads.top();
+					heads.pop();
+					if (try_prio_rec(*head.first) > 0) {
+						return;
+					}
+					if (++head.first != head.second) {
+						heads.push(head);
+					}
+				}
+			} else if (PrioRecs->Find(user)) {
+				const PrioRecIndex::Queue * q = PrioRecs->Find(user);
+				for (auto it = q->begin(); it != q->end(); ++it) {
+					if (try_prio_rec(*it) > 0) {
+						return;
 					}
 				}
 			}
+		} else {
+			for (i=0; i < N_PrioRecs; i++) {
 
-				// If Concurrency Limits are in play it is
-				// important not to reuse a claim from one job
-				// that has one set of limits for a job that
-				// has a different set. This is because the
-				// Accountant is keeping track of limits based
-				// on the matches that are being handed out.
-				//
-				// A future optimization here may be to allow
-				// jobs with a subset of the limits given to
-				// the current match to reuse it.
-
-			std::string jobLimits, recordedLimits;
-			if (param_boolean("CLAIM_RECYCLING_CONSIDER_LIMITS", true)) {
-				ad->LookupString(ATTR_CONCURRENCY_LIMITS, jobLimits);
-				my_match_ad->LookupString(ATTR_MATCHED_CONCURRENCY_LIMITS,
-										  recordedLimits);
-				lower_case(jobLimits);
-				lower_case(recordedLimits);
-
-				if (jobLimits == recordedLimits) {
-					dprintf(D_FULLDEBUG,
-							"ConcurrencyLimits match, can reuse claim\n");
-				} else {
-					dprintf(D_FULLDEBUG,
-							"ConcurrencyLimits do not match, cannot "
-							"reuse claim\n");
-					PrioRecAutoClusterRejected->
-						insert(PrioRec[i].auto_cluster_id, 1);
+				if ( PrioRec[i].submitter[0] == '\0' ) {
+						// This record has been disabled, because it is no longer
+						// runnable.
 					continue;
 				}
-			}
 
-			jobid = PrioRec[i].id; // success!
-			return;
+				if ( !match_any_user && strcmp(PrioRec[i].submitter, user) != 0 ) {
+						// Owner doesn't match.
+					continue;
+				}
 
-		}	// end of for loop through PrioRec array
+				int rval = try_prio_rec(PrioRec[i]);
+				if (rval > 0) {
+					return;
+				} else if (rval < 0) {
+					PrioRec[i].submitter[0] = '\0';
+				}
+			}	// end of for loop through PrioRec array
+		}
 
 		if(rebuilt_prio_rec_array) {
 				// We found nothing, and we had a freshly built job list.
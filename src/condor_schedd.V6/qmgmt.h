@@ -73,6 +73,10 @@ class QmgmtPeer {
 
 		friend inline const char * EffectiveUser(QmgmtPeer * qsock);
 
+			// the reply to a commit that waits for the commit to be on disk,
+			// see Q_REPLY_WHEN_COMMITTED.  returns < 0 if the client went away.
+		std::function<int()> reply_when_committed;
+
 	protected:
 
 		char *owner;  
@@ -114,6 +118,7 @@ inline const char * EffectiveUser(QmgmtPeer * peer) {
 #define JQJ_CACHE_DIRTY_JOBOBJ        0x00001 // set when an attribute cached in the JobQueueJob that doesn't have it's own flag has changed
 #define JQJ_CACHE_DIRTY_SUBMITTERDATA 0x00002 // set when an attribute that affects the submitter name is changed
 #define JQJ_CACHE_DIRTY_CLUSTERATTRS  0x00004 // set then ATTR_EDITED_CLUSTER_ATTRS changes, used only in the cluster ad.
+#define JQJ_CACHE_DIRTY_COUNTS        0x00008 // set when the job is queued to have its contribution to the schedd job counts recomputed
 
 class JobFactory;
 class JobQueueCluster;
@@ -191,6 +196,12 @@ public:
 	// DO NOT FREE FROM HERE!
 	struct SubmitterData * submitterdata;
 	struct OwnerInfo * ownerinfo;
+	// what this job last added to the schedd job counts, owned by the job
+	// and freed by Scheduler::uncountJob(). NULL unless SCHEDD_INCREMENTAL_JOB_COUNTS
+	struct JobCountTally * count_tally;
+	// where this job is filed in the job queue indexes, owned by the job
+	// and freed by JobQueueIndexes::Remove(). see job_queue_index.h
+	struct JobQueueIndexEntry * index_entry;
 protected:
 	JobQueueCluster * parent; // job pointer back to the 
 	qelm qe;
@@ -207,6 +218,8 @@ public:
 		, autocluster_id(0)
 		, submitterdata(NULL)
 		, ownerinfo(NULL)
+		, count_tally(NULL)
+		, index_entry(NULL)
 		, parent(NULL)
 	{}
 	virtual ~JobQueueJob() {};
@@ -273,6 +286,9 @@ public:
 	void AttachJob(JobQueueJob * job);
 	void DetachJob(JobQueueJob * job);
 	void DetachAllJobs(); // When you absolutely positively need to free this class...
+	// iterate the jobs attached to this cluster, these return NULL at the end.
+	JobQueueJob * FirstAttachedJob() { return qe.empty() ? NULL : qe.next()->as<JobQueueJob>(); }
+	JobQueueJob * NextAttachedJob(JobQueueJob * job) { qelm * q = job->qe.next(); return (q == &qe) ? NULL : q->as<JobQueueJob>(); }
 	void JobStatusChanged(int old_status, int new_status);  // update cluster counters by job status.
 
 	void PopulateInfoAd(ClassAd & iad, int num_pending, bool include_factory_info); // fill out an info ad from fields in this structure and from the factory
@@ -353,6 +369,8 @@ bool UserCheck2( ClassAd *ad, const char *test_owner, char const *job_owner=NULL
 
 bool BuildPrioRecArray(bool no_match_found=false);
 void DirtyPrioRecArray();
+// the PrioRec index when SCHEDD_INCREMENTAL_PRIO_RECS is true, NULL when the PrioRec array is used
+const PrioRecIndex * GetPrioRecIndex();
 extern ClassAd *dollarDollarExpand(int cid, int pid, ClassAd *job, ClassAd *res, bool persist_expansions);
 bool rewriteSpooledJobAd(ClassAd *job_ad, int cluster, int proc, bool modify_ad);
 
@@ -544,6 +562,16 @@ typedef ClassAdLog<JOB_ID_KEY, JobQueuePayload> JobQueueLogType;
 #define JOB_QUEUE_ITERATOR_OPT_INCLUDE_CLUSTERS     0x0001
 JobQueueLogType::filter_iterator GetJobQueueIterator(const classad::ExprTree &requirements, int timeslice_ms);
 JobQueueLogType::filter_iterator GetJobQueueIteratorEnd();
+// the keys of the cluster ads and jobs that the job queue indexes say the
+// constraint can match, returns false if they can't narrow it down.
+bool GetJobQueueIndexKeys(const classad::ExprTree * constraint, std::vector<JobQueueKey> & keys);
+// a read-only copy of the committed job queue for query threads, see
+// job_queue_snapshot.h.  empty unless snapshots are enabled.
+class JobQueueSnapshot;
+void EnableJobQueueSnapshots(bool enable);
+std::shared_ptr<const JobQueueSnapshot> GetJobQueueSnapshot();
+// call after changing a job ad in place without a log record, so that snapshots see the change
+void JobQueueAdChangedInPlace(const JobQueueKey & key);
 
 
 class schedd_runtime_probe;
@@ -560,6 +588,18 @@ void InitQmgmt();
 void InitJobQueue(const char *job_queue_name,int max_historical_logs);
 void PostInitJobQueue();
 void CleanJobQueue();
+void CleanJobQueueInBackground();
+// with SCHEDD_JOB_QUEUE_GROUP_COMMIT, wait for or be told when every
+// job queue commit so far is on disk.  otherwise they already are.
+bool JobQueueCommitPending();
+// returned by do_Q_request() when the reply to a commit waits for the commit
+// to be on disk, the session is resumed once the reply is sent.
+#define Q_REPLY_WHEN_COMMITTED 1
+void JobQueueWhenCommitted(const std::function<void()> & fn);
+// how long each phase of loading the job queue at startup took, published
+// in the schedd ad as JobQueueRecovery<phase>Time
+void AddJobQueueRecoveryTime(const char * phase, double secs);
+void PublishJobQueueRecoveryStats(ClassAd & ad);
 bool setQSock( ReliSock* rsock );
 void unsetQSock();
 void MarkJobClean(PROC_ID job_id);
@@ -578,7 +618,8 @@ QmgmtPeer* getQmgmtConnectionInfo();
 bool JobSetDestroy(int setid);
 bool JobSetStoreAllDirtyAttrs(int setid, ClassAd & src, bool create);
 
-// priority records
+// priority records.  N_PrioRecs is the number of them, in the PrioRec
+// array or, when it is used instead, in the PrioRec index.
 extern prio_rec *PrioRec;
 extern int N_PrioRecs;
 extern HashTable<int,int> *PrioRecAutoClusterRejected;
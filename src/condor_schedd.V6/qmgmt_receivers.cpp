@@ -54,6 +54,48 @@ static bool QmgmtMayAccessAttribute( char const *attr_name ) {
 	// the client at attempted commit.
 static std::unique_ptr<CondorError> g_transaction_error;
 
+	// The reply to CommitTransaction, sent at once or, with group
+	// commit, once the transaction is on disk.
+static int
+reply_to_commit( ReliSock *syscall_sock, int rval, int terrno, CondorError *errstack )
+{
+	syscall_sock->encode();
+	assert( syscall_sock->code(rval) );
+	const CondorVersionInfo *vers = syscall_sock->get_peer_version();
+	bool send_classad = vers && vers->built_since_version(8, 3, 4);
+	bool always_send_classad = vers && vers->built_since_version(8, 7, 4);
+	if( rval < 0 ) {
+		assert( syscall_sock->code(terrno) );
+	}
+	if( rval < 0 && send_classad ) {
+		// Send a classad, for less backwards-incompatibility.
+		int code = 1;
+		const char * reason = "QMGMT rejected job submission.";
+		if(! errstack->empty()) {
+			code = 2;
+			reason = errstack->message();
+		}
+
+		ClassAd reply;
+		reply.Assign( "ErrorCode", code );
+		reply.Assign( "ErrorReason", reason );
+		assert( putClassAd( syscall_sock, reply ) );
+	} else if( always_send_classad ) {
+		ClassAd reply;
+
+		std::string reason;
+		if(! errstack->empty()) {
+			reason = errstack->getFullText();
+			reply.Assign( "WarningReason", reason );
+		}
+
+		assert( putClassAd( syscall_sock, reply ) );
+	}
+
+	assert( syscall_sock->end_of_message() );;
+	return 0;
+}
+
 int
 do_Q_request(QmgmtPeer &Q_PEER, bool &may_fork)
 {
@@ -677,41 +719,17 @@ do_Q_request(QmgmtPeer &Q_PEER, bool &may_fork)
 		}
 		dprintf( D_SYSCALLS, "\tflags = %d, rval = %d, errno = %d\n", flags, rval, terrno );
 
-		syscall_sock->encode();
-		assert( syscall_sock->code(rval) );
-		const CondorVersionInfo *vers = syscall_sock->get_peer_version();
-		bool send_classad = vers && vers->built_since_version(8, 3, 4);
-		bool always_send_classad = vers && vers->built_since_version(8, 7, 4);
-		if( rval < 0 ) {
-			assert( syscall_sock->code(terrno) );
-		}
-		if( rval < 0 && send_classad ) {
-			// Send a classad, for less backwards-incompatibility.
-			int code = 1;
-			const char * reason = "QMGMT rejected job submission.";
-			if(! errstack->empty()) {
-				code = 2;
-				reason = errstack->message();
-			}
-
-			ClassAd reply;
-			reply.Assign( "ErrorCode", code );
-			reply.Assign( "ErrorReason", reason );
-			assert( putClassAd( syscall_sock, reply ) );
-		} else if( always_send_classad ) {
-			ClassAd reply;
-
-			std::string reason;
-			if(! errstack->empty()) {
-				reason = errstack->getFullText();
-				reply.Assign( "WarningReason", reason );
-			}
-
-			assert( putClassAd( syscall_sock, reply ) );
-		}
-
-		assert( syscall_sock->end_of_message() );;
-		return 0;
+			// the client reads our reply as "the jobs are safe", so with
+			// group commit the reply waits for the sync.  handle_q() reads
+			// no more requests from this client until the reply is sent.
+		if( rval >= 0 && ! Q_PEER.getReadOnly() && JobQueueCommitPending() ) {
+			std::shared_ptr<CondorError> err( errstack.release() );
+			Q_PEER.reply_when_committed = [syscall_sock, rval, terrno, err]() {
+				return reply_to_commit( syscall_sock, rval, terrno, err.get() );
+			};
+			return Q_REPLY_WHEN_COMMITTED;
+		}
+		return reply_to_commit( syscall_sock, rval, terrno, errstack.get() );
 	}
 
 	case CONDOR_GetAttributeFloat:
@@ -0,0 +1,158 @@
+/***************************************************************
+ *
+ * Copyright (C) 1990-2020, Condor Team, Computer Sciences Department,
+ * University of Wisconsin-Madison, WI.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You may
+ * obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************/
+
+#include "condor_common.h"
+#include "condor_debug.h"
+#include "condor_daemon_core.h"
+#include "query_thread_pool.h"
+
+QueryThreadPool::QueryThreadPool()
+	: m_stop(false)
+	, m_notify_fd(-1)
+{
+	m_pipe[0] = m_pipe[1] = -1;
+}
+
+QueryThreadPool::~QueryThreadPool()
+{
+	Stop();
+}
+
+int
+QueryThreadPool::Start(int threads)
+{
+	Stop();
+	if (threads <= 0) {
+		return 0;
+	}
+
+#ifdef WIN32
+	dprintf(D_ALWAYS, "Query threads are not supported on this platform\n");
+	return 0;
+#else
+	if (m_pipe[0] == -1) {
+		if ( ! daemonCore->Create_Pipe(m_pipe, true, false, true, true)) {
+			dprintf(D_ALWAYS, "Failed to create the query thread pipe, not using query threads\n");
+			return 0;
+		}
+		daemonCore->Register_Pipe(m_pipe[0], "Query thread pipe",
+			(PipeHandlercpp)&QueryThreadPool::HandlePipe, "QueryThreadPool::HandlePipe", this);
+	}
+	if ( ! daemonCore->Get_Pipe_FD(m_pipe[1], &m_notify_fd)) {
+		dprintf(D_ALWAYS, "Failed to get the query thread pipe fd, not using query threads\n");
+		return 0;
+	}
+
+	dprintf_make_thread_safe();
+	m_stop = false;
+	for (int i = 0; i < threads; ++i) {
+		m_threads.emplace_back(&QueryThreadPool::ThreadMain, this);
+	}
+	dprintf(D_ALWAYS, "Started %d query threads\n", threads);
+	return Size();
+#endif
+}
+
+void
+QueryThreadPool::Stop()
+{
+	if ( ! m_threads.empty()) {
+		{
+			std::lock_guard<std::mutex> guard(m_mutex);
+			m_stop = true;
+		}
+		m_cond.notify_all();
+		for (auto it = m_threads.begin(); it != m_threads.end(); ++it) {
+			it->join();
+		}
+		m_threads.clear();
+		dprintf(D_ALWAYS, "Stopped the query threads\n");
+	}
+	RunCompletions();
+}
+
+void
+QueryThreadPool::Run(const std::function<void()> & work, const std::function<void()> & done)
+{
+	Task task;
+	task.work = work;
+	task.done = done;
+	if (m_threads.empty()) {
+		task.work();
+		task.done();
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> guard(m_mutex);
+		m_queue.push_back(task);
+	}
+	m_cond.notify_one();
+}
+
+void
+QueryThreadPool::ThreadMain()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while (true) {
+		// finish the queued work before stopping, its completions are run by Stop()
+		m_cond.wait(lock, [this]{ return m_stop || ! m_queue.empty(); });
+		if (m_queue.empty()) {
+			return;
+		}
+		Task task = std::move(m_queue.front());
+		m_queue.pop_front();
+
+		lock.unlock();
+		task.work();
+		lock.lock();
+
+		// hand the task back whole so that what it holds is destroyed on the main thread
+		m_finished.push_back(std::move(task));
+		if (m_notify_fd >= 0) {
+			char c = 0;
+			if (write(m_notify_fd, &c, 1) < 0) {
+				// the pipe is full, so the main thread has a wakeup pending already
+			}
+		}
+	}
+}
+
+void
+QueryThreadPool::RunCompletions()
+{
+	std::deque<Task> finished;
+	{
+		std::lock_guard<std::mutex> guard(m_mutex);
+		finished.swap(m_finished);
+	}
+	for (auto it = finished.begin(); it != finished.end(); ++it) {
+		it->done();
+	}
+}
+
+int
+QueryThreadPool::HandlePipe(int pipe_end)
+{
+	char buf[64];
+	while (daemonCore->Read_Pipe(pipe_end, buf, sizeof(buf)) > 0) {
+		// drain the wakeups, one pass over the completions covers them all
+	}
+	RunCompletions();
+	return TRUE;
+}
@@ -0,0 +1,70 @@
+/***************************************************************
+ *
+ * Copyright (C) 1990-2020, Condor Team, Computer Sciences Department,
+ * University of Wisconsin-Madison, WI.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You may
+ * obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************/
+
+#ifndef _QUERY_THREAD_POOL_H
+#define _QUERY_THREAD_POOL_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A pool of threads for answering queries without tying up the main
+// thread.  The work given to a thread must only touch data that nothing
+// else changes while it runs, such as a job queue snapshot and the
+// socket of the query.  When the work is done, its completion runs on the
+// main thread from DaemonCore, and both are destroyed there, so anything
+// they hold on to is released on the main thread.
+class QueryThreadPool : public Service {
+public:
+	QueryThreadPool();
+	~QueryThreadPool();
+
+		// run this many threads, 0 for none.  work that was queued or
+		// running is finished first.  returns the number of threads running.
+	int Start(int threads);
+	void Stop();
+	int Size() const { return (int)m_threads.size(); }
+
+		// run work on a pool thread, then done on the main thread.
+	void Run(const std::function<void()> & work, const std::function<void()> & done);
+
+private:
+	struct Task {
+		std::function<void()> work;
+		std::function<void()> done;
+	};
+
+	void ThreadMain();
+	int HandlePipe(int pipe_end);
+	void RunCompletions();
+
+	std::vector<std::thread> m_threads;
+	std::mutex m_mutex;
+	std::condition_variable m_cond;
+	std::deque<Task> m_queue;     // waiting for a thread
+	std::deque<Task> m_finished;  // waiting for the main thread
+	bool m_stop;
+	int m_pipe[2];
+	int m_notify_fd;
+};
+
+#endif
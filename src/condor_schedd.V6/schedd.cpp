@@ -111,10 +111,12 @@ char const * const HOME_POOL_SUBMITTER_TAG = "";
 extern GridUniverseLogic* _gridlogic;
 
 #include "qmgmt.h"
+#include "job_queue_snapshot.h"
 #include "condor_qmgr.h"
 #include "condor_vm_universe_types.h"
 #include "enum_utils.h"
 #include "credmon_interface.h"
+#include "shadow_recycle.h"
 
 extern "C"
 {
@@ -174,6 +176,7 @@ bool jobIsSandboxed( ClassAd* ad );
 bool jobPrepNeedsThread( int cluster, int proc );
 bool jobCleanupNeedsThread( int cluster, int proc );
 int  count_a_job( JobQueueJob *job, const JOB_ID_KEY& jid, void* user);
+void count_a_job_each_cycle( JobQueueJob *job, time_t now );
 void mark_jobs_idle();
 void load_job_factories();
 static void WriteCompletionVisa(ClassAd* ad);
@@ -181,6 +184,7 @@ static void WriteCompletionVisa(ClassAd* ad);
 schedd_runtime_probe WalkJobQ_check_for_spool_zombies_runtime;
 schedd_runtime_probe WalkJobQ_count_a_job_runtime;
 schedd_runtime_probe WalkJobQ_PeriodicExprEval_runtime;
+schedd_runtime_probe WalkJobQ_CollectPeriodicExprJobs_runtime;
 schedd_runtime_probe WalkJobQ_clear_autocluster_id_runtime;
 schedd_runtime_probe WalkJobQ_add_runnable_local_jobs_runtime;
 schedd_runtime_probe WalkJobQ_fixAttrUser_runtime;
@@ -600,6 +604,14 @@ Scheduler::Scheduler() :
 	slotWeightOfJob(0),
 	slotWeightGuessAd(0),
 	m_use_slot_weights(false),
+	m_incrementalJobCounts(false),
+	m_rebuildJobCounts(true),
+	m_jobCountsAuditInterval(0),
+	m_jobCountsAuditTime(0),
+	m_changeDrivenPeriodicExprs(false),
+	m_periodicExprsFullWalk(true),
+	m_periodicExprsFullWalkInterval(0),
+	m_periodicExprsFullWalkTime(0),
 	m_local_startd_pid(-1),
 	m_matchPasswordEnabled(false),
 	m_token_requester(&Scheduler::token_request_callback, this)
@@ -717,6 +729,7 @@ Scheduler::Scheduler() :
 	jobThrottleNextJobDelay = 0;
 
 	JobStartCount = 0;
+	RecycleShadowsAcrossClaims = false;
 	MaxNextJobDelay = 0;
 	JobsThisBurst = -1;
 
@@ -726,6 +739,10 @@ Scheduler::Scheduler() :
 	BadCluster = BadProc = -1;
 	NumUniqueOwners = 0;
 	shadowReaperId = -1;
+	m_shadowPoolSize = 0;
+	m_shadowPoolTarget = 0;
+	m_shadowPoolStarts = 0;
+	m_shadowPoolTid = -1;
 	m_have_xfer_queue_contact = false;
 	AccountantName = 0;
 	UidDomain = 0;
@@ -1272,7 +1289,7 @@ Scheduler::fill_submitter_ad(ClassAd & pAd, const SubmitterData & Owner, const s
 			pAd.Delete(ATTR_JOB_PRIO_ARRAY_OVERFLOW);
 		}
 		// reverse iterator to go high to low prio
-		std::set<int>::const_reverse_iterator rit;
+		std::map<int,int>::const_reverse_iterator rit;
 		int num_entries = 0;
 		for (rit = Owner.PrioSet.rbegin();
 			 rit != Owner.PrioSet.rend() && num_entries < max_entries;
@@ -1281,7 +1298,7 @@ Scheduler::fill_submitter_ad(ClassAd & pAd, const SubmitterData & Owner, const s
 			if ( !str.empty() ) {
 				str += ",";
 			}
-			str += std::to_string( *rit );
+			str += std::to_string( rit->first );
 			num_entries++;
 		}
 		pAd.Assign(ATTR_JOB_PRIO_ARRAY, str);
@@ -1361,45 +1378,115 @@ Scheduler::count_jobs()
 	time_t AbsentSubmitterUpdateRate = param_integer("ABSENT_SUBMITTER_UPDATE_RATE", 60*5); // 5 min
 	time_t AbsentOwnerLifetime = param_integer("ABSENT_OWNER_LIFETIME", 60*5);
 
-	JobsRunning = 0;
-	JobsIdle = 0;
-	JobsHeld = 0;
-	JobsTotalAds = 0;
-	JobsFlocked = 0;
-	JobsRemoved = 0;
-	SchedUniverseJobsIdle = 0;
-	SchedUniverseJobsRunning = 0;
-	LocalUniverseJobsIdle = 0;
-	LocalUniverseJobsRunning = 0;
-	stats.JobsRunning = 0;
-	stats.JobsRunningRuntimes = 0;
-	stats.JobsRunningSizes = 0;
-	scheduler.OtherPoolStats.ResetJobsRunning();
-
 	time_t current_time = time(0);
 
-	for (OwnerInfoMap::iterator it = OwnersInfo.begin(); it != OwnersInfo.end(); ++it) {
-		OwnerInfo & Owner = it->second;
-		Owner.num.clear_counters();	// clear the jobs counters 
-	}
-
-	FlockPools.clear();
+		// which pools we flock to is part of what each idle job adds
+		// to the counts, so a change means starting over.
+	std::unordered_set<std::string> flock_pools;
 	if (FlockCollectors) {
 		FlockCollectors->rewind();
 		Daemon *daemon;
 		while (FlockCollectors->next(daemon)) {
 			auto col = static_cast<DCCollector*>(daemon);
-			FlockPools.insert(col->name());
+			flock_pools.insert(col->name());
+		}
+	}
+	if (flock_pools != FlockPools) {
+		FlockPools.swap(flock_pools);
+		m_rebuildJobCounts = true;
+	}
+
+		// When the counts are kept incrementally we walk the whole queue only
+		// the first time, after a reconfig, and every SCHEDD_JOB_COUNTS_AUDIT_INTERVAL
+		// to check that the incremental counts have not drifted.
+	bool walk_queue = ! m_incrementalJobCounts || m_rebuildJobCounts ||
+		(m_jobCountsAuditInterval > 0 && current_time - m_jobCountsAuditTime >= m_jobCountsAuditInterval);
+	bool audit = walk_queue && m_incrementalJobCounts && ! m_rebuildJobCounts;
+
+	auto snapshot_job_counts = [this](std::map<std::string, std::vector<long long> > & counts) {
+		counts["schedd"] = { (long long)JobsTotalAds, (long long)JobsRunning, (long long)JobsIdle,
+			(long long)JobsHeld, (long long)JobsRemoved,
+			(long long)SchedUniverseJobsRunning, (long long)SchedUniverseJobsIdle,
+			(long long)LocalUniverseJobsRunning, (long long)LocalUniverseJobsIdle };
+		for (auto it = Submitters.begin(); it != Submitters.end(); ++it) {
+			const SubmitterData & SubDat = it->second;
+			std::vector<long long> & num = counts["submitter " + it->first];
+			num = { (long long)SubDat.num.JobsCounted, (long long)SubDat.num.JobsIdle,
+				(long long)SubDat.num.WeightedJobsIdle, (long long)SubDat.num.JobsHeld,
+				(long long)SubDat.num.SchedulerJobsRunning, (long long)SubDat.num.SchedulerJobsIdle,
+				(long long)SubDat.num.LocalJobsRunning, (long long)SubDat.num.LocalJobsIdle };
+			for (auto prio = SubDat.PrioSet.begin(); prio != SubDat.PrioSet.end(); ++prio) {
+				num.push_back(prio->first);
+				num.push_back(prio->second);
+			}
 		}
+		for (auto it = OwnersInfo.begin(); it != OwnersInfo.end(); ++it) {
+			const OwnerInfo & Owner = it->second;
+			counts["owner " + it->first] = { (long long)Owner.num.JobsCounted,
+				(long long)Owner.num.JobsIdle, (long long)Owner.num.JobsHeld,
+				(long long)Owner.num.SchedulerJobsRunning, (long long)Owner.num.SchedulerJobsIdle,
+				(long long)Owner.num.LocalJobsRunning, (long long)Owner.num.LocalJobsIdle };
+		}
+	};
+	std::map<std::string, std::vector<long long> > counts_before;
+	if (audit) {
+		snapshot_job_counts(counts_before);
 	}
 
-	for (SubmitterDataMap::iterator it = Submitters.begin(); it != Submitters.end(); ++it) {
-		SubmitterData & SubDat = it->second;
-		SubDat.num.clear_job_counters();	// clear the jobs counters 
-		SubDat.PrioSet.clear();
-		SubDat.flock.clear();
-		for (const auto &entry : FlockPools) {
-			SubDat.flock[entry] = SubmitterFlockCounters();
+	JobsFlocked = 0;
+	stats.JobsRunning = 0;
+	stats.JobsRunningRuntimes = 0;
+	stats.JobsRunningSizes = 0;
+	scheduler.OtherPoolStats.ResetJobsRunning();
+
+	if (walk_queue) {
+		JobsRunning = 0;
+		JobsIdle = 0;
+		JobsHeld = 0;
+		JobsTotalAds = 0;
+		JobsRemoved = 0;
+		SchedUniverseJobsIdle = 0;
+		SchedUniverseJobsRunning = 0;
+		LocalUniverseJobsIdle = 0;
+		LocalUniverseJobsRunning = 0;
+
+		for (OwnerInfoMap::iterator it = OwnersInfo.begin(); it != OwnersInfo.end(); ++it) {
+			OwnerInfo & Owner = it->second;
+			Owner.num.clear_counters();	// clear the jobs counters 
+		}
+
+		for (SubmitterDataMap::iterator it = Submitters.begin(); it != Submitters.end(); ++it) {
+			SubmitterData & SubDat = it->second;
+			SubDat.num.clear_job_counters();	// clear the jobs counters 
+			SubDat.PrioSet.clear();
+			SubDat.flock.clear();
+			for (const auto &entry : FlockPools) {
+				SubDat.flock[entry] = SubmitterFlockCounters();
+			}
+		}
+
+		m_jobsToRecount.clear();
+		m_jobsCountedEachCycle.clear();
+	} else {
+			// the job counters are up to date, clear only the counts that
+			// come from match records and the submissions since last time.
+		for (OwnerInfoMap::iterator it = OwnersInfo.begin(); it != OwnersInfo.end(); ++it) {
+			OwnerInfo & Owner = it->second;
+			Owner.num.Hits = Owner.num.JobsCounted;
+			Owner.num.JobsRecentlyAdded = 0;
+			if (Owner.num.Hits > 0) { Owner.LastHitTime = current_time; }
+		}
+
+		for (SubmitterDataMap::iterator it = Submitters.begin(); it != Submitters.end(); ++it) {
+			SubmitterData & SubDat = it->second;
+			SubDat.num.Hits = SubDat.num.JobsCounted;
+			SubDat.num.JobsRunning = 0;
+			SubDat.num.WeightedJobsRunning = 0;
+			for (auto & entry : SubDat.flock) {
+				entry.second.JobsRunning = 0;
+				entry.second.WeightedJobsRunning = 0;
+			}
+			if (SubDat.num.Hits > 0) { SubDat.LastHitTime = current_time; }
 		}
 	}
 	SubmitterMap.Cleanup(time(NULL));
@@ -1410,9 +1497,43 @@ Scheduler::count_jobs()
 		// job cluster ids, since we're about to re-create it.
 	dedicated_scheduler.clearDedicatedClusters();
 
-		// inserts/finds an entry in Owners for each job
-		// updates SubmitterCounters: Hits, JobsIdle, WeightedJobsIdle & JobsHeld
-	WalkJobQueue(count_a_job);
+	if (walk_queue) {
+			// inserts/finds an entry in Owners for each job
+			// updates SubmitterCounters: Hits, JobsIdle, WeightedJobsIdle & JobsHeld
+		WalkJobQueue(count_a_job);
+
+		if (m_incrementalJobCounts) {
+			m_rebuildJobCounts = false;
+			m_jobCountsAuditTime = current_time;
+		}
+		if (audit) {
+			std::map<std::string, std::vector<long long> > counts_after;
+			snapshot_job_counts(counts_after);
+			int num_wrong = 0;
+			for (auto it = counts_after.begin(); it != counts_after.end(); ++it) {
+				auto before = counts_before.find(it->first);
+				if (before != counts_before.end()) {
+					if (before->second == it->second) continue;
+				} else {
+						// a submitter or owner that is new since the last count
+					bool all_zero = true;
+					for (long long num : it->second) { if (num != 0) all_zero = false; }
+					if (all_zero) continue;
+				}
+				++num_wrong;
+				dprintf(D_ALWAYS, "count_jobs: the incremental job counts for %s were wrong, corrected them\n", it->first.c_str());
+			}
+			dprintf(num_wrong ? D_ALWAYS : D_FULLDEBUG, "count_jobs: audit of the incremental job counts found %d wrong\n", num_wrong);
+		}
+	} else {
+		recount_changed_jobs();
+		for (auto it = m_jobsCountedEachCycle.begin(); it != m_jobsCountedEachCycle.end(); ++it) {
+			JobQueueJob * job = GetJobAd(it->cluster, it->proc);
+			if (job) {
+				count_a_job_each_cycle(job, current_time);
+			}
+		}
+	}
 
 	if( dedicated_scheduler.hasDedicatedClusters() ) {
 			// We found some dedicated clusters to service.  Wake up
@@ -1635,6 +1756,7 @@ Scheduler::count_jobs()
 	int job_queue_birthdate = (int)GetOriginalJobQueueBirthdate();
 	cad->Assign(ATTR_JOB_QUEUE_BIRTHDATE, job_queue_birthdate);
 	m_adBase->Assign(ATTR_JOB_QUEUE_BIRTHDATE, job_queue_birthdate);
+	PublishJobQueueRecoveryStats(*cad);
 
 	daemonCore->UpdateLocalAd(cad);
 
@@ -2262,6 +2384,7 @@ struct QueryJobAdsContinuation : Service {
 
 	QueryJobAdsContinuation(classad_shared_ptr<classad::ExprTree> requirements_, int limit, int timeslice_ms=0, int iter_opts=0);
 	int finish(Stream *);
+	bool sendFromSnapshot(ReliSock * sock, const JobQueueSnapshot & snap, const std::vector<JobQueueKey> * keys);
 };
 
 QueryJobAdsContinuation::QueryJobAdsContinuation(classad_shared_ptr<classad::ExprTree> requirements_, int limit, int timeslice_ms, int iter_opts)
@@ -2364,6 +2487,93 @@ QueryJobAdsContinuation::finish(Stream *stream) {
 	return KEEP_STREAM;
 }
 
+// Runs on a query thread.  Write the job ads in the snapshot that match to
+// the socket, or just count them for a summary.  This must only touch the
+// snapshot, the socket and this object.  keys limits the ads looked at,
+// if it is not NULL.
+bool
+QueryJobAdsContinuation::sendFromSnapshot(ReliSock * sock, const JobQueueSnapshot & snap, const std::vector<JobQueueKey> * keys)
+{
+	classad::ExprTree & expr = *requirements;
+	auto send_if_match = [&](const JobQueueSnapshot::Ad & sad) -> bool {
+		if ( ! sad.is_job) return true;
+
+		const classad::ClassAd * old_scope = expr.GetParentScope();
+		expr.SetParentScope(&sad.ad);
+		classad::Value result;
+		bool bval = false;
+		long long ival = 0;
+		bool matched = expr.Evaluate(result) &&
+			((result.IsBooleanValue(bval) && bval) || (result.IsIntegerValue(ival) && ival));
+		expr.SetParentScope(old_scope);
+		if ( ! matched) return true;
+
+		IncrementLiveJobCounter(query_job_counts, sad.universe, sad.status, 1);
+		if ( ! summary_only) {
+			if ( ! putClassAd(sock, sad.ad, PUT_CLASSAD_NO_PRIVATE, projection.empty() ? NULL : &projection) ||
+				! sock->end_of_message()) {
+				return false;
+			}
+		}
+		match_count++;
+		return true;
+	};
+
+	sock->encode();
+	if (keys) {
+		for (auto it = keys->begin(); it != keys->end(); ++it) {
+			if (match_limit >= 0 && match_count >= match_limit) break;
+			const JobQueueSnapshot::Ad * sad = snap.Lookup(*it);
+			if (sad && ! send_if_match(*sad)) return false;
+		}
+	} else {
+		return snap.WalkAds([&](const JobQueueSnapshot::Ad & sad) -> bool {
+			if (match_limit >= 0 && match_count >= match_limit) return true;
+			return send_if_match(sad);
+		});
+	}
+	return true;
+}
+
+// Answer a job query on a query thread from a snapshot of the job queue.
+// When the thread is done, the summary ad is sent from the main thread,
+// since the counts of all jobs are not part of the snapshot.
+static int
+QueryJobAdsOnThread(QueryThreadPool & pool, QueryJobAdsContinuation * continuation, Stream * stream)
+{
+	std::shared_ptr<const JobQueueSnapshot> snap = GetJobQueueSnapshot();
+	if ( ! snap) {
+		return continuation->finish(stream);
+	}
+	std::shared_ptr<std::vector<JobQueueKey> > keys(new std::vector<JobQueueKey>);
+	if ( ! GetJobQueueIndexKeys(continuation->requirements.get(), *keys)) {
+		keys.reset();
+	}
+
+	ReliSock * sock = static_cast<ReliSock*>(stream);
+	std::shared_ptr<bool> ok(new bool(true));
+	double begin = _condor_debug_get_time_double();
+	pool.Run(
+		[=]() {
+			*ok = continuation->sendFromSnapshot(sock, *snap, keys.get());
+		},
+		[=]() {
+			if ( ! *ok) {
+				sendJobErrorAd(sock, 4, "Failed to write ClassAd to wire");
+			} else {
+				const char * me = NULL;
+				LiveJobCounters * mine = NULL;
+				if ( ! continuation->my_name.empty()) { me = continuation->my_name.c_str(); mine = &continuation->my_job_counts; }
+				sendDone(sock, true, &continuation->query_job_counts, me, mine);
+			}
+			dprintf(D_FULLDEBUG, "Answered a job query with %d ads on a query thread in %.3f seconds\n",
+				continuation->match_count, _condor_debug_get_time_double() - begin);
+			delete continuation;
+			delete sock;
+		});
+	return KEEP_STREAM;
+}
+
 int Scheduler::command_query_job_ads(int cmd, Stream* stream)
 {
 	ClassAd queryAd;
@@ -2521,6 +2731,11 @@ int Scheduler::command_query_job_ads(int cmd, Stream* stream)
 		continuation->summary_only = true;
 	}
 
+	// factory queries need the live cluster ads, the snapshot does not have those.
+	if (m_queryThreads.Size() > 0 && ! (iter_options & JOB_QUEUE_ITERATOR_OPT_INCLUDE_CLUSTERS)) {
+		return QueryJobAdsOnThread(m_queryThreads, continuation, stream);
+	}
+
 	ForkStatus fork_status = schedd_forker.NewJob();
 	if (fork_status == FORK_PARENT)
 	{ // Successfully forked a child - as far as the schedd cares, this worked.
@@ -2865,32 +3080,54 @@ Scheduler::guessJobSlotWeight(JobQueueJob * job)
 	return job_weight;
 }
 
-int
-count_a_job(JobQueueJob* job, const JOB_ID_KEY& /*jid*/, void*)
+// look up the job attributes that decide how a job is counted.
+// returns false if the job has no status.
+static bool
+get_job_count_attrs(JobQueueJob * job, int & status, int & cur_hosts, int & max_hosts, int & universe)
+{
+	if (job->LookupInteger(ATTR_JOB_STATUS, status) == 0) {
+		return false;
+	}
+	if (job->LookupInteger(ATTR_CURRENT_HOSTS, cur_hosts) == 0) {
+		cur_hosts = ((status == RUNNING || status == TRANSFERRING_OUTPUT) ? 1 : 0);
+	}
+	if (job->LookupInteger(ATTR_MAX_HOSTS, max_hosts) == 0) {
+		max_hosts = ((status == IDLE) ? 1 : 0);
+	}
+	if (job->LookupInteger(ATTR_JOB_UNIVERSE, universe) == 0) {
+		universe = CONDOR_UNIVERSE_STANDARD;
+	}
+	return true;
+}
+
+// returns true if the job is an idle MPI or parallel job that the
+// dedicated scheduler should look at.
+static bool
+is_idle_dedicated_job(JobQueueJob * job, int status, int cur_hosts, int max_hosts, int universe)
+{
+	bool sendToDS = false;
+	job->LookupBool(ATTR_WANT_PARALLEL_SCHEDULING, sendToDS);
+	return (sendToDS || universe == CONDOR_UNIVERSE_MPI ||
+			universe == CONDOR_UNIVERSE_PARALLEL) && status == IDLE &&
+			max_hosts > cur_hosts;
+}
+
+// Work out what the job adds to the schedd, submitter and owner job counts
+// without changing any of them.  The counts that must be rebuilt on every
+// pass of count_jobs() are left to count_a_job_each_cycle().
+// returns false if the job is not counted at all.
+bool
+tally_a_job(JobQueueJob * job, JobCountTally & tally)
 {
 	int		status;
-#if 1  // cache ownerdata pointer in job object
-#else
-	int		niceUser;
-	MyString owner_buf;
-	char const*	owner;
-	MyString domain;
-#endif
 	int		cur_hosts;
 	int		max_hosts;
 	int		universe;
 
-		// we may get passed a NULL job ad if, for instance, the job ad was
-		// removed via condor_rm -f when some function didn't expect it.
-		// So check for it here before continuing onward...
-	if ( job == NULL ) {  
-		return 0;
-	}
-
-	if (job->LookupInteger(ATTR_JOB_STATUS, status) == 0) {
+	if ( ! get_job_count_attrs(job, status, cur_hosts, max_hosts, universe)) {
 		dprintf(D_ALWAYS, "Job has no %s attribute.  Ignoring...\n",
 				ATTR_JOB_STATUS);
-		return 0;
+		return false;
 	}
 
 	bool noop = false;
@@ -2915,17 +3152,7 @@ count_a_job(JobQueueJob* job, const JOB_ID_KEY& /*jid*/, void*)
 		job_id.proc = proc;
 		set_job_status(cluster, proc, COMPLETED);
 		scheduler.WriteTerminateToUserLog( job_id, noop_status );
-		return 0;
-	}
-
-	if (job->LookupInteger(ATTR_CURRENT_HOSTS, cur_hosts) == 0) {
-		cur_hosts = ((status == RUNNING || status == TRANSFERRING_OUTPUT) ? 1 : 0);
-	}
-	if (job->LookupInteger(ATTR_MAX_HOSTS, max_hosts) == 0) {
-		max_hosts = ((status == IDLE) ? 1 : 0);
-	}
-	if (job->LookupInteger(ATTR_JOB_UNIVERSE, universe) == 0) {
-		universe = CONDOR_UNIVERSE_STANDARD;
+		return false;
 	}
 
 	int request_cpus = 0;
@@ -2939,30 +3166,23 @@ count_a_job(JobQueueJob* job, const JOB_ID_KEY& /*jid*/, void*)
 	}
 	
 
-	// because we set job->ownerdata to NULL above, this will refresh
-	// the job->ownerdata pointer. we do this in case the accounting group
+	// this will refresh the job->submitterdata pointer if needed.
+	// we do this in case the accounting group
 	// or niceness has been queue-edited or otherwise changed.
 	SubmitterData * SubData = NULL;
 	OwnerInfo * OwnInfo = scheduler.get_submitter_and_owner(job, SubData);
 	if ( ! OwnInfo) {
 		dprintf(D_ALWAYS, "Job has no %s attribute.  Ignoring...\n", ATTR_OWNER);
-		return 0;
+		return false;
 	}
 		// Keep track of unique owners per submitter.
 	SubData->owners.insert(OwnInfo->name);
 
-	// increment our count of the number of job ads in the queue
-	scheduler.JobsTotalAds++;
-
-    time_t now = time(NULL);
-    OwnInfo->LastHitTime = now;
-    SubData->LastHitTime = now;
-
-    ScheddOtherStats * other_stats = NULL;
-    if (scheduler.OtherPoolStats.AnyEnabled()) {
-        other_stats = scheduler.OtherPoolStats.Matches(*job, now);
-    }
-    #define OTHER for (ScheddOtherStats * po = other_stats; po; po = po->next) (po->stats)
+	tally.submitter = SubData;
+	tally.owner = OwnInfo;
+	tally.eachCycle = status == RUNNING || status == TRANSFERRING_OUTPUT ||
+		universe == CONDOR_UNIVERSE_GRID ||
+		is_idle_dedicated_job(job, status, cur_hosts, max_hosts, universe);
 
     if (status == IDLE || status == RUNNING || status == TRANSFERRING_OUTPUT) {
         /*
@@ -2971,52 +3191,22 @@ count_a_job(JobQueueJob* job, const JOB_ID_KEY& /*jid*/, void*)
          */
         if ((status == RUNNING || status == TRANSFERRING_OUTPUT) && !cur_hosts)
         {
-                scheduler.JobsRunning += 1;
+                tally.JobsRunning = 1;
         }
         else if ((status == IDLE) && !max_hosts)
         {
-                scheduler.JobsIdle += 1;
+                tally.JobsIdle = 1;
         }
         else
         {
-                scheduler.JobsRunning += cur_hosts;
-                scheduler.JobsIdle += (max_hosts - cur_hosts);
-        }
-
-            // if job is not idle, then update statistics for running jobs
-        if (status == RUNNING || status == TRANSFERRING_OUTPUT) {
-            scheduler.stats.JobsRunning += 1;
-            OTHER.JobsRunning += 1;
-
-            int job_image_size = 0;
-            job->LookupInteger("ImageSize_RAW", job_image_size);
-            scheduler.stats.JobsRunningSizes += (int64_t)job_image_size * 1024;
-            OTHER.JobsRunningSizes += (int64_t)job_image_size * 1024;
-
-            int job_start_date = 0;
-            int job_running_time = 0;
-            if (job->LookupInteger(ATTR_JOB_START_DATE, job_start_date))
-                job_running_time = (now - job_start_date);
-            scheduler.stats.JobsRunningRuntimes += job_running_time;
-            OTHER.JobsRunningRuntimes += job_running_time;
+                tally.JobsRunning = cur_hosts;
+                tally.JobsIdle = (max_hosts - cur_hosts);
         }
     } else if (status == HELD) {
-        scheduler.JobsHeld++;
+        tally.JobsHeld = 1;
     } else if (status == REMOVED) {
-        scheduler.JobsRemoved++;
+        tally.JobsRemoved = 1;
     }
-    #undef OTHER
-
-	// update per-submitter and per-owner counters
-	SubmitterCounters * Counters = &SubData->num;
-	RealOwnerCounters * OwnerCounts = &OwnInfo->num;
-
-	// Hits also counts matchrecs, which aren't jobs. (hits is sort of a reference count)
-	Counters->Hits += 1;
-	Counters->JobsCounted += 1;
-	
-	OwnerCounts->Hits += 1;
-	OwnerCounts->JobsCounted += 1;
 
 	if ( (universe != CONDOR_UNIVERSE_GRID) &&	// handle Globus below...
 		 (!service_this_universe(universe,job))  )
@@ -3027,108 +3217,26 @@ count_a_job(JobQueueJob* job, const JOB_ID_KEY& /*jid*/, void*)
 		{
 			// Count REMOVED or HELD jobs that are in the process of being
 			// killed. cur_hosts tells us which these are.
-			scheduler.SchedUniverseJobsRunning += cur_hosts;
-			scheduler.SchedUniverseJobsIdle += (max_hosts - cur_hosts);
-			OwnerCounts->SchedulerJobsRunning += cur_hosts;
-			OwnerCounts->SchedulerJobsIdle += (max_hosts - cur_hosts);
-			Counters->SchedulerJobsRunning += cur_hosts;
-			Counters->SchedulerJobsIdle += (max_hosts - cur_hosts);
+			tally.SchedulerJobsRunning = cur_hosts;
+			tally.SchedulerJobsIdle = (max_hosts - cur_hosts);
 		}
 		if (universe == CONDOR_UNIVERSE_LOCAL)
 		{
 			// Count REMOVED or HELD jobs that are in the process of being
 			// killed. cur_hosts tells us which these are.
-			scheduler.LocalUniverseJobsRunning += cur_hosts;
-			scheduler.LocalUniverseJobsIdle += (max_hosts - cur_hosts);
-			OwnerCounts->LocalJobsRunning += cur_hosts;
-			OwnerCounts->LocalJobsIdle += (max_hosts - cur_hosts);
-			Counters->LocalJobsRunning += cur_hosts;
-			Counters->LocalJobsIdle += (max_hosts - cur_hosts);
-		}
-			// We want to record the cluster id of all idle MPI and parallel
-		    // jobs
-
-		bool sendToDS = false;
-		job->LookupBool(ATTR_WANT_PARALLEL_SCHEDULING, sendToDS);
-		if( (sendToDS || universe == CONDOR_UNIVERSE_MPI ||
-			 universe == CONDOR_UNIVERSE_PARALLEL) && status == IDLE ) {
-			if( max_hosts > cur_hosts ) {
-				int cluster = 0;
-				job->LookupInteger( ATTR_CLUSTER_ID, cluster );
-
-				int proc = 0;
-				job->LookupInteger( ATTR_PROC_ID, proc );
-					// Don't add all the procs in the cluster, just the first
-				if( proc == 0) {
-					dedicated_scheduler.addDedicatedCluster( cluster );
-				}
-			}
+			tally.LocalJobsRunning = cur_hosts;
+			tally.LocalJobsIdle = (max_hosts - cur_hosts);
 		}
 
 		// bailout now, since all the crud below is only for jobs
 		// which the schedd needs to service
-		return 0;
+		return true;
 	} 
 
-	if ( universe == CONDOR_UNIVERSE_GRID ) {
-		// for Globus, count jobs in UNSUBMITTED state by owner.
-		// later we make certain there is a grid manager daemon
-		// per owner.
-		int real_status = status;
-		bool want_service = service_this_universe(universe,job);
-		bool job_managed = jobExternallyManaged(job);
-		bool job_managed_done = jobManagedDone(job);
-		// if job is not already being managed : if we want matchmaking 
-		// for this job, but we have not found a 
-		// match yet, consider it "held" for purposes of the logic here.  we
-		// have no need to tell the gridmanager to deal with it until we've
-		// first found a match.
-		if ( (job_managed == false) && (want_service && cur_hosts == 0) ) {
-			status = HELD;
-		}
-		// if status is REMOVED, but the remote job id is not null,
-		// then consider the job IDLE for purposes of the logic here.  after all,
-		// the gridmanager needs to be around to finish the task of removing the job.
-		// if the gridmanager has set Managed="ScheddDone", then it's done
-		// with the job and doesn't want to see it again.
-		if ( status == REMOVED && job_managed_done == false ) {
-			if ( job->LookupString( ATTR_GRID_JOB_ID, NULL, 0 ) )
-			{
-				// looks like the job's remote job id is still valid,
-				// so there is still a job submitted remotely somewhere.
-				// fire up the gridmanager to try and really clean it up!
-				status = IDLE;
-			}
-		}
-
-#if 1   // cache ownerdata pointer in job object
-		std::string real_owner, domain;
-		job->LookupString(ATTR_OWNER,real_owner); // we can't get here if the job has no ATTR_OWNER
-		job->LookupString(ATTR_NT_DOMAIN, domain);
-#endif
-		// Don't count HELD jobs that aren't externally (gridmanager) managed
-		// Don't count jobs that the gridmanager has said it's completely
-		// done with.
-		UserIdentity userident(real_owner.c_str(),domain.c_str(),job);
-		if ( ( status != HELD || job_managed != false ) &&
-			 job_managed_done == false ) 
-		{
-			GridJobCounts * gridcounts = scheduler.GetGridJobCounts(userident);
-			ASSERT(gridcounts);
-			gridcounts->GridJobs++;
-		}
-		if ( status != HELD && job_managed == 0 && job_managed_done == 0 ) 
-		{
-			GridJobCounts * gridcounts = scheduler.GetGridJobCounts(userident);
-			ASSERT(gridcounts);
-			gridcounts->UnmanagedGridJobs++;
-		}
-			// If we do not need to do matchmaking on this job (i.e.
-			// service this globus universe job), than we can bailout now.
-		if (!want_service) {
-			return 0;
-		}
-		status = real_status;	// set status back for below logic...
+		// If we do not need to do matchmaking on this grid universe
+		// job, than we can bailout now.
+	if ( universe == CONDOR_UNIVERSE_GRID && ! service_this_universe(universe,job) ) {
+		return true;
 	}
 
 	if (status == IDLE || status == RUNNING || status == TRANSFERRING_OUTPUT) {
@@ -3138,15 +3246,11 @@ count_a_job(JobQueueJob* job, const JOB_ID_KEY& /*jid*/, void*)
 		if ( param_boolean("USE_GLOBAL_JOB_PRIOS",false) &&
 			 ((max_hosts - cur_hosts) > 0) )
 		{
-			int job_prio;
-			if ( job->LookupInteger(ATTR_JOB_PRIO,job_prio) ) {
-				SubData->PrioSet.insert( job_prio );
-			}
+			tally.hasJobPrio = job->LookupInteger(ATTR_JOB_PRIO, tally.JobPrio);
 		}
 			// Update Owners array JobsIdle
 		int job_idle = (max_hosts - cur_hosts);
-		OwnerCounts->JobsIdle += job_idle;
-		Counters->JobsIdle += job_idle;
+		tally.JobsIdleByOwner = job_idle;
 
 			// If we're biasing by slot weight, and the job is idle, and everything parsed...
 		int job_idle_weight;
@@ -3167,7 +3271,7 @@ count_a_job(JobQueueJob* job, const JOB_ID_KEY& /*jid*/, void*)
 			// here: either max_hosts == cur_hosts || !scheduler.m_use_slot_weights
 			job_idle_weight = request_cpus * job_idle;
 		}
-		Counters->WeightedJobsIdle += job_idle_weight;
+		tally.WeightedJobsIdle = job_idle_weight;
 
 			// Update per-flock jobs idle
 		std::string flock_targets;
@@ -3180,9 +3284,7 @@ count_a_job(JobQueueJob* job, const JOB_ID_KEY& /*jid*/, void*)
 				if (!strcasecmp(flock_entry, "default")) {
 					include_default_flock = true;
 				} else {
-					auto iter = SubData->flock.insert({flock_entry, SubmitterFlockCounters()});
-					iter.first->second.JobsIdle += job_idle;
-					iter.first->second.WeightedJobsIdle += job_idle_weight;
+					tally.flock[flock_entry] += 1;
 				}
 			}
 				// Subtract out overlap with default list of flocked pools.
@@ -3190,15 +3292,13 @@ count_a_job(JobQueueJob* job, const JOB_ID_KEY& /*jid*/, void*)
 			while ( (flock_entry = flock_list.next()) ) {
 				auto iter = scheduler.FlockPools.find(flock_entry);
 				if (iter != scheduler.FlockPools.end()) {
-					SubData->flock[flock_entry].JobsIdle -= job_idle;
-					SubData->flock[flock_entry].WeightedJobsIdle -= job_idle_weight;
+					tally.flock[flock_entry] -= 1;
 				}
 			}
 		}
 		if (include_default_flock) {
 			for (const auto &flock_entry : scheduler.FlockPools) {
-				SubData->flock[flock_entry].JobsIdle += job_idle;
-				SubData->flock[flock_entry].WeightedJobsIdle += job_idle_weight;
+				tally.flock[flock_entry] += 1;
 			}
 		}
 
@@ -3206,13 +3306,287 @@ count_a_job(JobQueueJob* job, const JOB_ID_KEY& /*jid*/, void*)
 			// We do it in Scheduler::count_jobs().
 
 	} else if (status == HELD) {
-		OwnerCounts->JobsHeld++;
-		Counters->JobsHeld++;
+		tally.JobsHeldByOwner = 1;
 	}
 
+	return true;
+}
+
+// add (sign == 1) or take back (sign == -1) what the job tallied to the
+// schedd, submitter and owner counters
+void
+add_job_tally(const JobCountTally & tally, int sign)
+{
+	// increment our count of the number of job ads in the queue
+	scheduler.JobsTotalAds += sign;
+	scheduler.JobsRunning += sign * tally.JobsRunning;
+	scheduler.JobsIdle += sign * tally.JobsIdle;
+	scheduler.JobsHeld += sign * tally.JobsHeld;
+	scheduler.JobsRemoved += sign * tally.JobsRemoved;
+	scheduler.SchedUniverseJobsRunning += sign * tally.SchedulerJobsRunning;
+	scheduler.SchedUniverseJobsIdle += sign * tally.SchedulerJobsIdle;
+	scheduler.LocalUniverseJobsRunning += sign * tally.LocalJobsRunning;
+	scheduler.LocalUniverseJobsIdle += sign * tally.LocalJobsIdle;
+
+	// update per-submitter and per-owner counters
+	SubmitterCounters & Counters = tally.submitter->num;
+	RealOwnerCounters & OwnerCounts = tally.owner->num;
+
+	// Hits also counts matchrecs, which aren't jobs. (hits is sort of a reference count)
+	Counters.Hits += sign;
+	Counters.JobsCounted += sign;
+	OwnerCounts.Hits += sign;
+	OwnerCounts.JobsCounted += sign;
+
+	OwnerCounts.SchedulerJobsRunning += sign * tally.SchedulerJobsRunning;
+	OwnerCounts.SchedulerJobsIdle += sign * tally.SchedulerJobsIdle;
+	Counters.SchedulerJobsRunning += sign * tally.SchedulerJobsRunning;
+	Counters.SchedulerJobsIdle += sign * tally.SchedulerJobsIdle;
+	OwnerCounts.LocalJobsRunning += sign * tally.LocalJobsRunning;
+	OwnerCounts.LocalJobsIdle += sign * tally.LocalJobsIdle;
+	Counters.LocalJobsRunning += sign * tally.LocalJobsRunning;
+	Counters.LocalJobsIdle += sign * tally.LocalJobsIdle;
+
+	OwnerCounts.JobsIdle += sign * tally.JobsIdleByOwner;
+	Counters.JobsIdle += sign * tally.JobsIdleByOwner;
+	OwnerCounts.JobsHeld += sign * tally.JobsHeldByOwner;
+	Counters.JobsHeld += sign * tally.JobsHeldByOwner;
+	Counters.WeightedJobsIdle += sign * tally.WeightedJobsIdle;
+
+	if (tally.hasJobPrio) {
+		std::map<int,int> & prios = tally.submitter->PrioSet;
+		if (sign > 0) {
+			prios[tally.JobPrio] += 1;
+		} else {
+			auto it = prios.find(tally.JobPrio);
+			if (it != prios.end() && --it->second <= 0) {
+				prios.erase(it);
+			}
+		}
+	}
+
+	for (auto it = tally.flock.begin(); it != tally.flock.end(); ++it) {
+		SubmitterFlockCounters & flock = tally.submitter->flock[it->first];
+		flock.JobsIdle += sign * it->second * tally.JobsIdleByOwner;
+		flock.WeightedJobsIdle += sign * it->second * tally.WeightedJobsIdle;
+	}
+}
+
+// count the things about a job that count_jobs() clears every time: statistics
+// about running jobs, grid job counts and the idle dedicated job clusters.
+void
+count_a_job_each_cycle(JobQueueJob * job, time_t now)
+{
+	int		status;
+	int		cur_hosts;
+	int		max_hosts;
+	int		universe;
+
+	if ( ! get_job_count_attrs(job, status, cur_hosts, max_hosts, universe)) {
+		return;
+	}
+
+    ScheddOtherStats * other_stats = NULL;
+    if (scheduler.OtherPoolStats.AnyEnabled()) {
+        other_stats = scheduler.OtherPoolStats.Matches(*job, now);
+    }
+    #define OTHER for (ScheddOtherStats * po = other_stats; po; po = po->next) (po->stats)
+
+        // if job is not idle, then update statistics for running jobs
+    if (status == RUNNING || status == TRANSFERRING_OUTPUT) {
+        scheduler.stats.JobsRunning += 1;
+        OTHER.JobsRunning += 1;
+
+        int job_image_size = 0;
+        job->LookupInteger("ImageSize_RAW", job_image_size);
+        scheduler.stats.JobsRunningSizes += (int64_t)job_image_size * 1024;
+        OTHER.JobsRunningSizes += (int64_t)job_image_size * 1024;
+
+        int job_start_date = 0;
+        int job_running_time = 0;
+        if (job->LookupInteger(ATTR_JOB_START_DATE, job_start_date))
+            job_running_time = (now - job_start_date);
+        scheduler.stats.JobsRunningRuntimes += job_running_time;
+        OTHER.JobsRunningRuntimes += job_running_time;
+    }
+    #undef OTHER
+
+	if ( universe != CONDOR_UNIVERSE_GRID ) {
+			// We want to record the cluster id of all idle MPI and parallel
+		    // jobs
+		if ( ! service_this_universe(universe,job) &&
+			 is_idle_dedicated_job(job, status, cur_hosts, max_hosts, universe) ) {
+			int cluster = 0;
+			job->LookupInteger( ATTR_CLUSTER_ID, cluster );
+
+			int proc = 0;
+			job->LookupInteger( ATTR_PROC_ID, proc );
+				// Don't add all the procs in the cluster, just the first
+			if( proc == 0) {
+				dedicated_scheduler.addDedicatedCluster( cluster );
+			}
+		}
+		return;
+	}
+
+		// for Globus, count jobs in UNSUBMITTED state by owner.
+		// later we make certain there is a grid manager daemon
+		// per owner.
+	bool want_service = service_this_universe(universe,job);
+	bool job_managed = jobExternallyManaged(job);
+	bool job_managed_done = jobManagedDone(job);
+		// if job is not already being managed : if we want matchmaking 
+		// for this job, but we have not found a 
+		// match yet, consider it "held" for purposes of the logic here.  we
+		// have no need to tell the gridmanager to deal with it until we've
+		// first found a match.
+	if ( (job_managed == false) && (want_service && cur_hosts == 0) ) {
+		status = HELD;
+	}
+		// if status is REMOVED, but the remote job id is not null,
+		// then consider the job IDLE for purposes of the logic here.  after all,
+		// the gridmanager needs to be around to finish the task of removing the job.
+		// if the gridmanager has set Managed="ScheddDone", then it's done
+		// with the job and doesn't want to see it again.
+	if ( status == REMOVED && job_managed_done == false ) {
+		if ( job->LookupString( ATTR_GRID_JOB_ID, NULL, 0 ) )
+		{
+			// looks like the job's remote job id is still valid,
+			// so there is still a job submitted remotely somewhere.
+			// fire up the gridmanager to try and really clean it up!
+			status = IDLE;
+		}
+	}
+
+	std::string real_owner, domain;
+	job->LookupString(ATTR_OWNER,real_owner); // we can't get here if the job has no ATTR_OWNER
+	job->LookupString(ATTR_NT_DOMAIN, domain);
+
+		// Don't count HELD jobs that aren't externally (gridmanager) managed
+		// Don't count jobs that the gridmanager has said it's completely
+		// done with.
+	UserIdentity userident(real_owner.c_str(),domain.c_str(),job);
+	if ( ( status != HELD || job_managed != false ) &&
+		 job_managed_done == false ) 
+	{
+		GridJobCounts * gridcounts = scheduler.GetGridJobCounts(userident);
+		ASSERT(gridcounts);
+		gridcounts->GridJobs++;
+	}
+	if ( status != HELD && job_managed == 0 && job_managed_done == 0 ) 
+	{
+		GridJobCounts * gridcounts = scheduler.GetGridJobCounts(userident);
+		ASSERT(gridcounts);
+		gridcounts->UnmanagedGridJobs++;
+	}
+}
+
+int
+count_a_job(JobQueueJob* job, const JOB_ID_KEY& /*jid*/, void*)
+{
+		// we may get passed a NULL job ad if, for instance, the job ad was
+		// removed via condor_rm -f when some function didn't expect it.
+		// So check for it here before continuing onward...
+	if ( job == NULL ) {  
+		return 0;
+	}
+
+		// count_jobs() has cleared the counters, so whatever this job
+		// added last time is already gone.
+	delete job->count_tally;
+	job->count_tally = NULL;
+	job->dirty_flags &= ~JQJ_CACHE_DIRTY_COUNTS;
+
+	JobCountTally * tally = new JobCountTally;
+	if ( ! tally_a_job(job, *tally)) {
+		delete tally;
+		return 0;
+	}
+	add_job_tally(*tally, 1);
+
+	time_t now = time(NULL);
+	tally->owner->LastHitTime = now;
+	tally->submitter->LastHitTime = now;
+
+	count_a_job_each_cycle(job, now);
+
+	if (scheduler.m_incrementalJobCounts) {
+		job->count_tally = tally;
+		if (tally->eachCycle) {
+			scheduler.m_jobsCountedEachCycle.insert(job->jid);
+		}
+	} else {
+		delete tally;
+	}
 	return 0;
 }
 
+// take a job that changed out of the counts and put it back in
+void
+recount_a_job(JobQueueJob* job)
+{
+	scheduler.uncountJob(job);
+
+	JobCountTally * tally = new JobCountTally;
+	if ( ! tally_a_job(job, *tally)) {
+		delete tally;
+		return;
+	}
+	add_job_tally(*tally, 1);
+
+	time_t now = time(NULL);
+	tally->owner->LastHitTime = now;
+	tally->submitter->LastHitTime = now;
+
+	job->count_tally = tally;
+	if (tally->eachCycle) {
+		scheduler.m_jobsCountedEachCycle.insert(job->jid);
+	}
+}
+
+void
+Scheduler::jobCountsChanged(JobQueueJob * job)
+{
+	if ( ! m_incrementalJobCounts || (job->dirty_flags & JQJ_CACHE_DIRTY_COUNTS)) {
+		return;
+	}
+	job->dirty_flags |= JQJ_CACHE_DIRTY_COUNTS;
+	m_jobsToRecount.push_back(job->jid);
+}
+
+void
+Scheduler::uncountJob(JobQueueJob * job)
+{
+	if ( ! job->count_tally) {
+		return;
+	}
+	add_job_tally(*job->count_tally, -1);
+	if (job->count_tally->eachCycle) {
+		m_jobsCountedEachCycle.erase(job->jid);
+	}
+	delete job->count_tally;
+	job->count_tally = NULL;
+}
+
+void
+Scheduler::recount_changed_jobs()
+{
+		// recount_a_job() can change the job status of a noop job,
+		// which queues it again for the next time.
+	std::vector<JOB_ID_KEY> jobs;
+	jobs.swap(m_jobsToRecount);
+	for (auto it = jobs.begin(); it != jobs.end(); ++it) {
+		JobQueueJob * job = GetJobAd(it->cluster, it->proc);
+		if ( ! job) {
+			continue; // it left the queue, and uncountJob() took it out then.
+		}
+		job->dirty_flags &= ~JQJ_CACHE_DIRTY_COUNTS;
+		recount_a_job(job);
+	}
+	dprintf(D_FULLDEBUG, "count_jobs: recounted %d changed jobs, %d jobs counted each cycle\n",
+		(int)jobs.size(), (int)m_jobsCountedEachCycle.size());
+}
+
 bool
 service_this_universe(int universe, ClassAd* job)
 {
@@ -3938,7 +4312,11 @@ Scheduler::PeriodicExprHandler( void )
 #ifdef USE_NON_MUTATING_USERPOLICY
 	policy.Init();
 #endif
-	WalkJobQueue2(PeriodicExprEval, &policy);
+	if (m_changeDrivenPeriodicExprs) {
+		EvalChangedPeriodicExprs(policy);
+	} else {
+		WalkJobQueue2(PeriodicExprEval, &policy);
+	}
 
 	PeriodicExprInterval.setFinishTimeNow();
 
@@ -3950,6 +4328,122 @@ Scheduler::PeriodicExprHandler( void )
 	daemonCore->Reset_Timer( periodicid, time_to_next_run );
 }
 
+static int
+CollectPeriodicExprJobs(JobQueueJob * /*job*/, const JOB_ID_KEY & jid, void * pv)
+{
+	((std::set<JOB_ID_KEY>*)pv)->insert(jid);
+	return 1;
+}
+
+/*
+When PERIODIC_EXPR_CHANGE_DRIVEN is true, evaluate the periodic
+expressions of only the jobs that changed since the last time, and of
+the jobs whose expressions could have changed with the passing of time
+since then, and work out when each of them needs to be looked at again.
+Every job is evaluated the first time, after a reconfig, and every
+PERIODIC_EXPR_FULL_WALK_INTERVAL.
+*/
+
+void
+Scheduler::EvalChangedPeriodicExprs(UserPolicy & policy)
+{
+	time_t now = time(NULL);
+	std::set<JOB_ID_KEY> jobs;
+
+	bool full_walk = m_periodicExprsFullWalk ||
+		(m_periodicExprsFullWalkInterval > 0 && now - m_periodicExprsFullWalkTime >= m_periodicExprsFullWalkInterval);
+	if (full_walk) {
+		m_periodicExprsChanged.clear();
+		m_periodicExprsEachTime.clear();
+		m_periodicExprsDue.clear();
+		m_periodicExprsDueTime.clear();
+		WalkJobQueue2(CollectPeriodicExprJobs, &jobs);
+		m_periodicExprsFullWalk = false;
+		m_periodicExprsFullWalkTime = now;
+	} else {
+		// evaluating a job may change it again, which puts it back in the changed set for next time
+		jobs.swap(m_periodicExprsChanged);
+		jobs.insert(m_periodicExprsEachTime.begin(), m_periodicExprsEachTime.end());
+		m_periodicExprsEachTime.clear();
+		while ( ! m_periodicExprsDue.empty() && m_periodicExprsDue.begin()->first <= now) {
+			jobs.insert(m_periodicExprsDue.begin()->second);
+			m_periodicExprsDueTime.erase(m_periodicExprsDue.begin()->second);
+			m_periodicExprsDue.erase(m_periodicExprsDue.begin());
+		}
+	}
+
+	for (auto it = jobs.begin(); it != jobs.end(); ++it) {
+		JobQueueJob * job = GetJobAd(*it);
+		if ( ! job) continue;
+		PeriodicExprEval(job, *it, &policy);
+
+		// the job may have left the queue
+		job = GetJobAd(*it);
+		if (job) {
+			schedulePeriodicExprs(job, policy, now);
+		}
+	}
+
+	dprintf(D_FULLDEBUG, "Evaluated periodic expressions of %d %sjobs, %d jobs waiting for a time, %d evaluated every time\n",
+		(int)jobs.size(), full_walk ? "" : "changed or due ",
+		(int)m_periodicExprsDueTime.size(), (int)m_periodicExprsEachTime.size());
+}
+
+// work out when the periodic expressions of a job that was just evaluated
+// could next have a different result if the job does not change.
+void
+Scheduler::schedulePeriodicExprs(JobQueueJob * job, UserPolicy & policy, time_t now)
+{
+	unschedulePeriodicExprs(job->jid);
+
+	int status = -1;
+	if ( ! ResponsibleForPeriodicExprs(job, status)) {
+			// the shadow of a job exiting is not a change to the job,
+			// so look at these every time until it is gone.
+		if ((status == HELD || status == COMPLETED || status == REMOVED) && FindSrecByProcID(job->jid)) {
+			m_periodicExprsEachTime.insert(job->jid);
+		}
+		return;
+	}
+
+	time_t when = policy.PeriodicPolicyChangeTime(*job, now);
+	if (when == now) {
+		m_periodicExprsEachTime.insert(job->jid);
+	} else if (when > now) {
+		m_periodicExprsDue.insert(std::make_pair(when, job->jid));
+		m_periodicExprsDueTime[job->jid] = when;
+	}
+}
+
+void
+Scheduler::unschedulePeriodicExprs(const JOB_ID_KEY & jid)
+{
+	auto it = m_periodicExprsDueTime.find(jid);
+	if (it != m_periodicExprsDueTime.end()) {
+		m_periodicExprsDue.erase(std::make_pair(it->second, jid));
+		m_periodicExprsDueTime.erase(it);
+	}
+	m_periodicExprsEachTime.erase(jid);
+}
+
+void
+Scheduler::periodicExprsChanged(JobQueueJob * job)
+{
+	if (m_changeDrivenPeriodicExprs && job->IsJob()) {
+		m_periodicExprsChanged.insert(job->jid);
+	}
+}
+
+void
+Scheduler::forgetPeriodicExprs(JobQueueJob * job)
+{
+	if ( ! m_changeDrivenPeriodicExprs) {
+		return;
+	}
+	m_periodicExprsChanged.erase(job->jid);
+	unschedulePeriodicExprs(job->jid);
+}
+
 
 bool
 jobPrepNeedsThread( int /* cluster */, int /* proc */ )
@@ -6402,15 +6896,20 @@ Scheduler::actOnJobs(int, Stream* s)
 	if ( (after - before) > 5 ) {
 		dprintf( D_FULLDEBUG, "actOnJobs(): CommitTransaction() took %ld seconds to run\n", after - before );
 	}
-		
+
 		// If we got this far, we can tell the tool we're happy,
-		// since if that CommitTransaction failed, we'd EXCEPT()
-	rsock->encode();
-	int answer = OK;
-	if (!rsock->code( answer )) {
-		dprintf(D_FULLDEBUG, "actOnJobs(): tool hung up on us\n");
+		// since if that CommitTransaction failed, we'd EXCEPT().
+		// With group commit the transaction may not be on disk yet,
+		// in which case the reply waits for it (see below).
+	bool reply_when_committed = JobQueueCommitPending();
+	if ( ! reply_when_committed) {
+		rsock->encode();
+		int answer = OK;
+		if (!rsock->code( answer )) {
+			dprintf(D_FULLDEBUG, "actOnJobs(): tool hung up on us\n");
+		}
+		rsock->end_of_message();
 	}
-	rsock->end_of_message();
 
 		// Now that we know the events are logged and commited to
 		// the queue, we can do the final actions for these jobs,
@@ -6450,7 +6949,22 @@ Scheduler::actOnJobs(int, Stream* s)
 				 getJobActionString(action), job_ids_string.c_str());
 	}
 
-	return TRUE;
+	if ( ! reply_when_committed) {
+		return TRUE;
+	}
+
+		// The reply waits for the sync rather than the whole schedd.
+	JobQueueWhenCommitted([rsock]() {
+		rsock->encode();
+		int answer = OK;
+		if (!rsock->code( answer )) {
+			dprintf(D_FULLDEBUG, "actOnJobs(): tool hung up on us\n");
+		}
+		rsock->end_of_message();
+		delete rsock;
+	});
+
+	return KEEP_STREAM;
 }
 
 class ActOnJobRec: public ServiceData {
@@ -7180,7 +7694,6 @@ Scheduler::negotiationFinished( char const *owner, char const *remote_pool, bool
 int
 Scheduler::negotiate(int command, Stream* s)
 {
-	int		job_index;
 	int		jobs;						// # of jobs that CAN be negotiated
 	int		which_negotiator = 0; 		// >0 implies flocking
 	MyString remote_pool_buf;
@@ -7458,6 +7971,7 @@ Scheduler::negotiate(int command, Stream* s)
 	}
 
 	BuildPrioRecArray();
+	const PrioRecIndex * prio_recs = GetPrioRecIndex();
 	jobs = N_PrioRecs;
 
 	JobsStarted = 0;
@@ -7487,14 +8001,19 @@ Scheduler::negotiate(int command, Stream* s)
 	int next_cluster = 0;
 	int skipped_auto_cluster = -1;
 
-	for(job_index = 0; job_index < N_PrioRecs && !skip_negotiation; job_index++) {
-		prio_rec *prec = &PrioRec[job_index];
+	auto request_job = [&](const prio_rec * prec) {
 
 		// make sure owner matches what negotiator wants
 		if (strcmp(owner, prec->submitter) != 0)
 		{
 			jobs--;
-			continue;
+			return;
+		}
+
+		// the PrioRec index keeps matched jobs, see FindRunnableJob()
+		if (prio_recs && scheduler.AlreadyMatched(const_cast<PROC_ID*>(&prec->id))) {
+			jobs--;
+			return;
 		}
 
 		// make sure jobprio is in the range the negotiator wants
@@ -7502,7 +8021,7 @@ Scheduler::negotiate(int command, Stream* s)
 			 prec->job_prio > consider_jobprio_max )
 		{
 			jobs--;
-			continue;
+			return;
 		}
 
 		int auto_cluster_id;
@@ -7515,7 +8034,7 @@ Scheduler::negotiate(int command, Stream* s)
 		}
 
 		if ( auto_cluster_id == skipped_auto_cluster ) {
-			continue;
+			return;
 		}
 
 		if( !cluster || cluster->getAutoClusterId() != auto_cluster_id )
@@ -7526,20 +8045,38 @@ Scheduler::negotiate(int command, Stream* s)
 
 				// Determine whether we should flock this cluster with this pool.
 			if (job_ad && !JobCanFlock(*job_ad, submitter_tag)) {
-				continue;
+				return;
 			}
 			if ( neg_constraint ) {
 				if ( job_ad == NULL || EvalExprBool( job_ad, neg_constraint ) == false ) {
 					skipped_auto_cluster = auto_cluster_id;
-					continue;
+					return;
 				}
 			}
 			cluster = new ResourceRequestCluster( auto_cluster_id );
 			resource_requests->push_back( cluster );
 		}
 		cluster->addJob( prec->id );
+	};
+
+	if (skip_negotiation) {
+		// nothing to request
+	} else if (prio_recs) {
+			// only this submitter's jobs, in priority order
+		const PrioRecIndex::Queue * recs = prio_recs->Find(owner);
+		jobs = recs ? (int)recs->size() : 0;
+		if (recs) {
+			for (auto it = recs->begin(); it != recs->end(); ++it) {
+				request_job(&*it);
+			}
+		}
+	} else {
+		for (int job_index = 0; job_index < N_PrioRecs; job_index++) {
+			request_job(&PrioRec[job_index]);
+		}
 	}
 
+
 	classy_counted_ptr<MainScheddNegotiate> sn =
 		new MainScheddNegotiate(
 			command,
@@ -8255,8 +8792,16 @@ updateSchedDInterval( JobQueueJob *job, const JOB_ID_KEY& id, void* /*user*/ )
 void
 PostInitJobQueue()
 {
+	double phase_start = _condor_debug_get_time_double();
 	mark_jobs_idle();
+	double now = _condor_debug_get_time_double();
+	AddJobQueueRecoveryTime("MarkIdle", now - phase_start);
+	phase_start = now;
+
 	load_job_factories();
+	now = _condor_debug_get_time_double();
+	AddJobQueueRecoveryTime("LoadFactories", now - phase_start);
+	phase_start = now;
 
 	daemonCore->Register_Timer( 0,
 						(TimerHandlercpp)&Scheduler::WriteRestartReport,
@@ -8274,6 +8819,7 @@ PostInitJobQueue()
 		// CronTab jobs
 		//
 	WalkJobQueue(updateSchedDInterval);
+	AddJobQueueRecoveryTime("PostLoad", _condor_debug_get_time_double() - phase_start);
 
 	extern int dump_job_q_stats(int cat);
 	dump_job_q_stats(D_FULLDEBUG);
@@ -9494,8 +10040,31 @@ Scheduler::spawnShadow( shadow_rec* srec )
 	want_udp = false;
 #endif
 
-	rval = spawnJobHandlerRaw( srec, shadow_path, args, NULL, "shadow",
-							   sh_is_dc, sh_reads_file, want_udp );
+		// a pooled shadow was started with the same arguments, other than
+		// the job id, which it reads from the job ad instead.
+	PooledShadow pooled;
+	pooled.pid = 0;
+	if( sh_is_dc && sh_reads_file && ! wants_reconnect &&
+		(universe == CONDOR_UNIVERSE_VANILLA ||
+		 universe == CONDOR_UNIVERSE_JAVA ||
+		 universe == CONDOR_UNIVERSE_VM) )
+	{
+		while( ! m_shadowPool.empty() && ! pooled.pid ) {
+			if( m_shadowPool.front().path == shadow_path ) {
+				pooled = m_shadowPool.front();
+			} else {
+				retirePooledShadow( m_shadowPool.front() );
+			}
+			m_shadowPool.pop_front();
+		}
+	}
+
+	if( pooled.pid ) {
+		rval = spawnJobHandlerPooled( srec, pooled );
+	} else {
+		rval = spawnJobHandlerRaw( srec, shadow_path, args, NULL, "shadow",
+								   sh_is_dc, sh_reads_file, want_udp );
+	}
 
 	free( shadow_path );
 
@@ -9518,6 +10087,7 @@ Scheduler::spawnShadow( shadow_rec* srec )
 	dprintf( D_ALWAYS, "Started shadow for job %d.%d on %s, "
 			 "(shadow pid = %d)\n", job_id->cluster, job_id->proc,
 			 mrec->description(), srec->pid );
+	m_shadowPoolStarts += 1;
 
     //time_t now = time(NULL);
     time_t now = stats.Tick();
@@ -9611,6 +10181,51 @@ Scheduler::tryNextJob()
 }
 
 
+static void
+addUseridMapToEnv( Env & env )
+{
+	// Add USERID_MAP to the environment so the child process does
+	// not have to look up stuff we already know.  In some
+	// environments (e.g. where NSS is used), we have observed cases
+	// where about half of the shadow's private memory was consumed by
+	// junk allocated inside of the first call to getpwuid(), so this
+	// is worth optimizing.  This may also reduce load on the ldap
+	// server.
+
+#ifndef WIN32
+	passwd_cache *p = pcache();
+	if( p ) {
+		MyString usermap;
+		p->getUseridMap(usermap);
+		if( !usermap.IsEmpty() ) {
+			MyString envname;
+			envname.formatstr("_%s_USERID_MAP",myDistro->Get());
+			env.SetEnv(envname.Value(),usermap.Value());
+		}
+	}
+#else
+	(void)env;
+#endif
+}
+
+static void
+writeJobAdToPipe( int pipe_fd, ClassAd & job_ad )
+{
+	MyString ad_str;
+	sPrintAdWithSecrets(ad_str, job_ad);
+	const char* ptr = ad_str.Value();
+	int len = ad_str.Length();
+	while (len) {
+		int bytes_written = daemonCore->Write_Pipe(pipe_fd, ptr, len);
+		if (bytes_written == -1) {
+			dprintf(D_ALWAYS, "writeJobAd: Write_Pipe failed\n");
+			break;
+		}
+		ptr += bytes_written;
+		len -= bytes_written;
+	}
+}
+
 bool
 Scheduler::spawnJobHandlerRaw( shadow_rec* srec, const char* path, 
 							   ArgList const &args, Env const *env, 
@@ -9635,26 +10250,7 @@ Scheduler::spawnJobHandlerRaw( shadow_rec* srec, const char* path,
 	}
 	env = &extra_env;
 
-	// Now add USERID_MAP to the environment so the child process does
-	// not have to look up stuff we already know.  In some
-	// environments (e.g. where NSS is used), we have observed cases
-	// where about half of the shadow's private memory was consumed by
-	// junk allocated inside of the first call to getpwuid(), so this
-	// is worth optimizing.  This may also reduce load on the ldap
-	// server.
-
-#ifndef WIN32
-	passwd_cache *p = pcache();
-	if( p ) {
-		MyString usermap;
-		p->getUseridMap(usermap);
-		if( !usermap.IsEmpty() ) {
-			MyString envname;
-			envname.formatstr("_%s_USERID_MAP",myDistro->Get());
-			extra_env.SetEnv(envname.Value(),usermap.Value());
-		}
-	}
-#endif
+	addUseridMapToEnv( extra_env );
 
 		/* Setup the array of fds for stdin, stdout, stderr */
 	int* std_fds_p = NULL;
@@ -9798,19 +10394,7 @@ Scheduler::spawnJobHandlerRaw( shadow_rec* srec, const char* path,
 			// 2) dump out the job ad to the write end, since the
 			// handler is now alive and can read from the pipe.
 		ASSERT( job_ad );
-		MyString ad_str;
-		sPrintAdWithSecrets(ad_str, *job_ad);
-		const char* ptr = ad_str.Value();
-		int len = ad_str.Length();
-		while (len) {
-			int bytes_written = daemonCore->Write_Pipe(pipe_fds[1], ptr, len);
-			if (bytes_written == -1) {
-				dprintf(D_ALWAYS, "writeJobAd: Write_Pipe failed\n");
-				break;
-			}
-			ptr += bytes_written;
-			len -= bytes_written;
-		}
+		writeJobAdToPipe( pipe_fds[1], *job_ad );
 
 			// TODO: if this is an MPI job, we should really write all
 			// the match info (ClaimIds, sinful strings and machine
@@ -9838,6 +10422,217 @@ Scheduler::spawnJobHandlerRaw( shadow_rec* srec, const char* path,
 }
 
 
+/*
+  A pooled shadow is a condor_shadow started with --pool before there is
+  a job for it, so that it has already paid for exec, config and
+  DaemonCore setup when a claim needs a shadow.  It waits to read its job
+  ad from stdin, like any shadow started by spawnJobHandlerRaw(), and
+  takes the job id from the ad.  Closing its stdin with no ad tells it to
+  exit.
+*/
+bool
+Scheduler::spawnPooledShadow( const char* path )
+{
+	ArgList args;
+	args.AppendArg("condor_shadow");
+	args.AppendArg("-f");
+	args.AppendArg("--pool");
+
+	MyString argbuf;
+	argbuf.formatstr("--schedd=%s", daemonCore->publicNetworkIpAddr());
+	args.AppendArg(argbuf.Value());
+	if( m_have_xfer_queue_contact ) {
+		argbuf.formatstr("--xfer-queue=%s", m_xfer_queue_contact.c_str());
+		args.AppendArg(argbuf.Value());
+	}
+	args.AppendArg(MyShadowSockName);
+	args.AppendArg("-");
+
+	Env env;
+	env.Import();
+	addUseridMapToEnv( env );
+
+	int pipe_fds[2] = { -1, -1 };
+	if( ! daemonCore->Create_Pipe(pipe_fds) ) {
+		dprintf( D_ALWAYS, "ERROR: Can't create DC pipe for a pooled shadow\n" );
+		return false;
+	}
+	int std_fds[3] = { pipe_fds[0], -1, -1 };
+
+	int create_process_opts = 0;
+#ifndef WIN32
+	create_process_opts |= DCJOBOPT_NO_UDP;
+#endif
+	int niceness = param_integer( "SHADOW_RENICE_INCREMENT",0 );
+
+	MyString daemon_sock = SharedPortEndpoint::GenerateEndpointName("shadow");
+	int pid = daemonCore->Create_Process( path, args, PRIV_ROOT, shadowReaperId,
+	                                      TRUE, TRUE, &env, NULL, NULL, NULL,
+	                                      std_fds, NULL, niceness,
+	                                      NULL, create_process_opts,
+	                                      NULL, NULL, daemon_sock.c_str());
+	daemonCore->Close_Pipe( pipe_fds[0] );
+	if( pid == FALSE ) {
+		MyString arg_string;
+		args.GetArgsStringForDisplay(&arg_string);
+		dprintf( D_FAILURE|D_ALWAYS, "spawnPooledShadow: "
+				 "CreateProcess(%s, %s) failed\n", path, arg_string.Value() );
+		daemonCore->Close_Pipe( pipe_fds[1] );
+		return false;
+	}
+
+	PooledShadow pooled;
+	pooled.pid = pid;
+	pooled.pipe_fd = pipe_fds[1];
+	pooled.path = path;
+	pooled.started = time(NULL);
+	m_shadowPool.push_back(pooled);
+
+	dprintf( D_FULLDEBUG, "Started pooled shadow (pid %d), %d in the pool\n",
+			 pid, (int)m_shadowPool.size() );
+	return true;
+}
+
+
+bool
+Scheduler::spawnJobHandlerPooled( shadow_rec* srec, PooledShadow & pooled )
+{
+	PROC_ID* job_id = &srec->job_id;
+
+		// as in spawnJobHandlerRaw(), add the srec to our tables before
+		// expanding the job ad, so that a failure leaves nothing to undo
+		// but the srec, which our caller cleans up.
+	srec->pid = 0;
+	add_shadow_rec( srec );
+	time_t now = stats.Tick();
+	stats.ShadowsRunning = numShadows;
+
+	OtherPoolStats.Tick(now);
+
+	ClassAd* job_ad = GetExpandedJobAd( *job_id, true );
+	if( ! job_ad ) {
+		if( ! GetJobAd(*job_id) ) {
+			EXCEPT( "Impossible: GetJobAd() returned NULL for %d.%d "
+					"but that job is already known to exist",
+					job_id->cluster, job_id->proc );
+		}
+		dprintf( D_ALWAYS, "ERROR: Failed to get classad for job "
+				 "%d.%d, can't hand it to a pooled shadow, aborting\n",
+				 job_id->cluster, job_id->proc );
+			// the shadow did not get a job, so it can wait for the next one
+		m_shadowPool.push_front(pooled);
+		return false;
+	}
+
+	srec->pid = pooled.pid;
+	add_shadow_rec_pid( srec );
+
+	writeJobAdToPipe( pooled.pipe_fd, *job_ad );
+	daemonCore->Close_Pipe( pooled.pipe_fd );
+
+	dprintf( D_FULLDEBUG, "Handed job %d.%d to pooled shadow (pid %d), "
+			 "%d left in the pool\n", job_id->cluster, job_id->proc,
+			 pooled.pid, (int)m_shadowPool.size() );
+
+	ClassAd *machine_ad = NULL;
+	if( srec->match ) {
+		machine_ad = srec->match->my_match_ad;
+	}
+	setNextJobDelay( job_ad, machine_ad );
+
+	delete job_ad;
+	return true;
+}
+
+
+void
+Scheduler::retirePooledShadow( const PooledShadow & pooled )
+{
+		// with no job ad on its stdin, the shadow exits on its own
+	daemonCore->Close_Pipe( pooled.pipe_fd );
+	m_shadowPoolRetired.insert( pooled.pid );
+	dprintf( D_FULLDEBUG, "Retiring pooled shadow (pid %d)\n", pooled.pid );
+}
+
+
+void
+Scheduler::drainShadowPool()
+{
+	while( ! m_shadowPool.empty() ) {
+		retirePooledShadow( m_shadowPool.front() );
+		m_shadowPool.pop_front();
+	}
+	m_shadowPoolTarget = 0;
+}
+
+
+	// returns true if pid was a pooled shadow that never got a job
+bool
+Scheduler::reapPooledShadow( int pid, int status )
+{
+	if( m_shadowPoolRetired.erase(pid) ) {
+		dprintf( D_FULLDEBUG, "Pooled shadow (pid %d) exited with status %d\n",
+				 pid, status );
+		return true;
+	}
+	for( auto it = m_shadowPool.begin(); it != m_shadowPool.end(); ++it ) {
+		if( it->pid == pid ) {
+			dprintf( D_ALWAYS, "Pooled shadow (pid %d) exited with status %d "
+					 "before it was given a job\n", pid, status );
+			daemonCore->Close_Pipe( it->pipe_fd );
+			m_shadowPool.erase(it);
+			return true;
+		}
+	}
+	return false;
+}
+
+
+void
+Scheduler::ShadowPoolHandler()
+{
+		// keep about as many idle shadows as were started in the last
+		// interval, decaying slowly when the start rate drops.
+	int target = MAX( m_shadowPoolStarts, m_shadowPoolTarget / 2 );
+	m_shadowPoolStarts = 0;
+	target = MIN( target, m_shadowPoolSize );
+	target = MIN( target, MaxJobsRunning - numShadows );
+	if( ExitWhenDone || target < 0 ) {
+		target = 0;
+	}
+	m_shadowPoolTarget = target;
+
+		// a shadow that sits idle too long would be taken for a hung
+		// child by DaemonCore, so replace it before then.
+	const time_t max_idle = 600;
+	time_t now = time(NULL);
+	while( ! m_shadowPool.empty() &&
+		   ((int)m_shadowPool.size() > target ||
+			now - m_shadowPool.front().started > max_idle) )
+	{
+		retirePooledShadow( m_shadowPool.front() );
+		m_shadowPool.pop_front();
+	}
+
+	if( (int)m_shadowPool.size() >= target ) {
+		return;
+	}
+
+	Shadow* shadow_obj = shadow_mgr.findShadow( ATTR_IS_DAEMON_CORE );
+	if( ! shadow_obj ) {
+		return;
+	}
+	if( shadow_obj->isDC() && shadow_obj->provides(ATTR_HAS_JOB_AD_FROM_FILE) ) {
+		while( (int)m_shadowPool.size() < target ) {
+			if( ! spawnPooledShadow( shadow_obj->path() ) ) {
+				break;
+			}
+		}
+	}
+	delete shadow_obj;
+}
+
+
 void
 Scheduler::noShadowForJob( shadow_rec* srec, NoShadowFailure_t why )
 {
@@ -11721,8 +12516,23 @@ Scheduler::shadow_prio_recs_consistent()
 	BadCluster = -1;
 	BadProc = -1;
 
-	for( i=0; i<N_PrioRecs; i++ ) {
-		if( (srp=FindSrecByProcID(PrioRec[i].id)) ) {
+	std::vector<const prio_rec *> recs;
+	const PrioRecIndex * prio_recs = GetPrioRecIndex();
+	if (prio_recs) {
+		for (auto sub = prio_recs->All().begin(); sub != prio_recs->All().end(); ++sub) {
+			for (auto it = sub->second.begin(); it != sub->second.end(); ++it) {
+					// the index keeps matched jobs, which FindRunnableJob() skips
+				PROC_ID id = it->id;
+				if (AlreadyMatched(&id)) { continue; }
+				recs.push_back(&*it);
+			}
+		}
+	} else {
+		for( i=0; i<N_PrioRecs; i++ ) { recs.push_back(&PrioRec[i]); }
+	}
+
+	for( i=0; i<(int)recs.size(); i++ ) {
+		if( (srp=FindSrecByProcID(recs[i]->id)) ) {
 			BadCluster = srp->job_id.cluster;
 			BadProc = srp->job_id.proc;
 			universe = srp->universe;
@@ -11732,7 +12542,7 @@ Scheduler::shadow_prio_recs_consistent()
 				universe!=CONDOR_UNIVERSE_PARALLEL) {
 				// display_shadow_recs();
 				// dprintf(D_FULLDEBUG,"shadow_prio_recs_consistent(): PrioRec %d - id = %d.%d, owner = %s\n",i,PrioRec[i].id.cluster,PrioRec[i].id.proc,PrioRec[i].owner);
-				dprintf( D_ALWAYS, "ERROR: Found a consistency problem in the PrioRec array for job %d.%d !!!\n", PrioRec[i].id.cluster,PrioRec[i].id.proc );
+				dprintf( D_ALWAYS, "ERROR: Found a consistency problem in the PrioRec array for job %d.%d !!!\n", recs[i]->id.cluster,recs[i]->id.proc );
 				return FALSE;
 			}
 		}
@@ -11891,6 +12701,10 @@ Scheduler::child_exit(int pid, int status)
 	// AsyncXfer: Should this match be held idle waiting for a paired match?
 	bool            paired_match_wait = false;
 
+	if( reapPooledShadow(pid, status) ) {
+		return;
+	}
+
 	srec = FindSrecByPid(pid);
 	ASSERT(srec);
 
@@ -12048,11 +12862,16 @@ Scheduler::child_exit(int pid, int status)
 	//
 	// If the job was a local universe job, we will want to
 	// call count on it so that it can be marked idle again
-	// if need be.
+	// if need be.  When the counts are kept incrementally, just
+	// have the next count_jobs() recount it.
 	//
 	if ( srec_was_local_universe == true ) {
 		JobQueueJob *job_ad = GetJobAd(job_id);
-		count_a_job( job_ad, job_ad->jid, NULL);
+		if ( job_ad && scheduler.incrementalJobCounts() ) {
+			scheduler.jobCountsChanged(job_ad);
+		} else if ( job_ad ) {
+			count_a_job( job_ad, job_ad->jid, NULL);
+		}
 	}
 
 	// If we're not trying to shutdown, now that either an agent
@@ -13007,6 +13826,8 @@ Scheduler::Init()
 
 	MaxNextJobDelay = param_integer( "MAX_NEXT_JOB_START_DELAY", 60*10 );
 
+	RecycleShadowsAcrossClaims = param_boolean( "RECYCLE_SHADOWS_ACROSS_CLAIMS", false );
+
 	JobsThisBurst = -1;
 
 		// Estimate that we can afford to use 80% of memory for shadows
@@ -13330,6 +14151,16 @@ Scheduler::Init()
 
 	PeriodicExprInterval.setTimeslice( param_double("PERIODIC_EXPR_TIMESLICE", 0.01,0,1) );
 
+		// the SYSTEM_PERIODIC_* expressions may have changed, so start over
+		// with an evaluation of every job.
+	m_changeDrivenPeriodicExprs = param_boolean("PERIODIC_EXPR_CHANGE_DRIVEN", false);
+	m_periodicExprsFullWalkInterval = param_integer("PERIODIC_EXPR_FULL_WALK_INTERVAL", 3600, 0);
+	m_periodicExprsFullWalk = true;
+	m_periodicExprsChanged.clear();
+	m_periodicExprsEachTime.clear();
+	m_periodicExprsDue.clear();
+	m_periodicExprsDueTime.clear();
+
 	RequestClaimTimeout = param_integer("REQUEST_CLAIM_TIMEOUT",60*30);
 
 	int int_val = param_integer( "JOB_IS_FINISHED_INTERVAL", 0, 0 );
@@ -13467,6 +14298,18 @@ Scheduler::Init()
 	m_xfer_queue_mgr.InitAndReconfig();
 	m_have_xfer_queue_contact = m_xfer_queue_mgr.GetContactInfo(MyShadowSockName, m_xfer_queue_contact);
 
+		// the pooled shadows were started with the old shadow binary,
+		// arguments and environment, so start over with new ones.
+	drainShadowPool();
+	m_shadowPoolSize = param_integer( "SHADOW_POOL_SIZE", 0, 0 );
+	if( m_shadowPoolSize > 0 && m_shadowPoolTid < 0 ) {
+		m_shadowPoolTid = daemonCore->Register_Timer( 5, 5,
+			(TimerHandlercpp)&Scheduler::ShadowPoolHandler, "ShadowPoolHandler", this );
+	} else if( m_shadowPoolSize <= 0 && m_shadowPoolTid >= 0 ) {
+		daemonCore->Cancel_Timer( m_shadowPoolTid );
+		m_shadowPoolTid = -1;
+	}
+
 		/* Code to handle GRIDMANAGER_SELECTION_EXPR.  If set, we need to (a) restart
 		 * running gridmanagers if the setting changed value, and (b) parse the
 		 * expression and stash the parsed form (so we don't reparse over and over).
@@ -13522,6 +14365,7 @@ Scheduler::Init()
 
 	int max_history_concurrency = param_integer("HISTORY_HELPER_MAX_CONCURRENCY", 50);
 	HistoryQue.setup(1000, max_history_concurrency);
+	HistoryQue.setupTail(param_integer("HISTORY_HELPER_TAIL_SIZE", 0, 0), JobHistoryFileName);
 
     m_userlog_file_cache_max = param_integer("USERLOG_FILE_CACHE_MAX", 0, 0);
     m_userlog_file_cache_clear_interval = param_integer("USERLOG_FILE_CACHE_CLEAR_INTERVAL", 60, 0);
@@ -13537,6 +14381,22 @@ Scheduler::Init()
 	}
 	m_use_slot_weights = param_boolean("SCHEDD_USE_SLOT_WEIGHT", true);
 
+		// the slot weight, flocking and global prio knobs all change what a job
+		// adds to the counts, so start over with a walk of the whole queue.
+	m_incrementalJobCounts = param_boolean("SCHEDD_INCREMENTAL_JOB_COUNTS", false);
+	m_jobCountsAuditInterval = param_integer("SCHEDD_JOB_COUNTS_AUDIT_INTERVAL", 3600, 0);
+	m_rebuildJobCounts = true;
+
+		// and so do the submitter names of the runnable jobs
+	DirtyPrioRecArray();
+
+		// condor_q on query threads reads from copies of the job ads
+	int query_threads = param_integer("SCHEDD_QUERY_THREADS", 0, 0, 64);
+	if (query_threads != m_queryThreads.Size()) {
+		query_threads = m_queryThreads.Start(query_threads);
+	}
+	EnableJobQueueSnapshots(query_threads > 0);
+
 	char *sw = param("SCHEDD_SLOT_WEIGHT");
 	if (sw) {
 		ParseClassAdRvalExpr(sw, slotWeightOfJob);
@@ -13884,7 +14744,7 @@ Scheduler::RegisterTimers()
         }
         cleanid =
             daemonCore->Register_Timer(QueueCleanInterval,QueueCleanInterval,
-            CleanJobQueue,"CleanJobQueue");
+            CleanJobQueueInBackground,"CleanJobQueueInBackground");
     }
     oldQueueCleanInterval = QueueCleanInterval;
 
@@ -13930,78 +14790,6 @@ Scheduler::RegisterTimers()
 }
 
 
-extern "C" {
-int
-prio_compar(prio_rec* a, prio_rec* b)
-{
-	 /* compare submitted job preprio's: higher values have more priority */
-	 /* Typically used to prioritize entire DAG jobs over other DAG jobs */
-	if( a->pre_job_prio1 < b->pre_job_prio1 ) {
-		return 1;
-	}
-	if( a->pre_job_prio1 > b->pre_job_prio1 ) {
-		return -1;
-	}
-
-	if( a->pre_job_prio2 < b->pre_job_prio2 ) {
-		return 1;
-	}
-	if( a->pre_job_prio2 > b->pre_job_prio2 ) {
-		return -1;
-	}
-	 
-	 /* compare job priorities: higher values have more priority */
-	 if( a->job_prio < b->job_prio ) {
-		  return 1;
-	 }
-	 if( a->job_prio > b->job_prio ) {
-		  return -1;
-	 }
-	 
-	 /* compare submitted job postprio's: higher values have more priority */
-	 /* Typically used to prioritize entire DAG jobs over other DAG jobs */
-	if( a->post_job_prio1 < b->post_job_prio1 ) {
-		return 1;
-	}
-	if( a->post_job_prio1 > b->post_job_prio1 ) {
-		return -1;
-	}
-
-	if( a->post_job_prio2 < b->post_job_prio2 ) {
-		return 1;
-	}
-	if( a->post_job_prio2 > b->post_job_prio2 ) {
-		return -1;
-	}
-
-	 /* here,updown priority and job_priority are both equal */
-
-	 /* check for job submit times */
-	 if( a->qdate < b->qdate ) {
-		  return -1;
-	 }
-	 if( a->qdate > b->qdate ) {
-		  return 1;
-	 }
-
-	 /* go in order of cluster id */
-	if ( a->id.cluster < b->id.cluster )
-		return -1;
-	if ( a->id.cluster > b->id.cluster )
-		return 1;
-
-	/* finally, go in order of the proc id */
-	if ( a->id.proc < b->id.proc )
-		return -1;
-	if ( a->id.proc > b->id.proc )
-		return 1;
-
-	/* give up! very unlikely we'd ever get here */
-	return 0;
-}
-} // end of extern
-
-
 void Scheduler::reconfig() {
 	/***********************************
 	 * WARNING!!  WARNING!! WARNING, WILL ROBINSON!!!!
@@ -16928,6 +17716,11 @@ Scheduler::RecycleShadow(int /*cmd*/, Stream *stream)
 		return FALSE;
 	}
 
+		// the owner of the previous job, in case the shadow is handed
+		// a job on another claim below
+	std::string prev_owner;
+	GetAttributeString( prev_job_id.cluster, prev_job_id.proc, ATTR_OWNER, prev_owner );
+
 		// Now handle the exit reason specified for the existing job.
 	if( prev_job_id.cluster != -1 ) {
 		dprintf(D_ALWAYS,
@@ -16950,14 +17743,46 @@ Scheduler::RecycleShadow(int /*cmd*/, Stream *stream)
 		mrec->idle_timer_deadline = time(NULL) + mrec->keep_while_idle;
 	}
 
+	bool paired = mrec->m_paired_mrec != NULL;
 	if( !FindRunnableJobForClaim(mrec,accept_std_univ) ) {
-		dprintf(D_FULLDEBUG,
-			"No runnable jobs for shadow pid %d (was running job %d.%d); shadow will exit.\n",
-			shadow_pid, prev_job_id.cluster, prev_job_id.proc);
-		stream->encode();
-		stream->put((int)0);
-		stream->end_of_message();
-		return TRUE;
+			// FindRunnableJobForClaim() has already released the claim,
+			// or is keeping it idle for a while, so the shadow is free to
+			// run a job that is waiting for a shadow on another claim.
+		shadow_rec *next_srec = NULL;
+		if( RecycleShadowsAcrossClaims && !paired && !prev_owner.empty() ) {
+			next_srec = TakeRunnableJobForShadow( prev_owner.c_str() );
+		}
+		if( !next_srec ) {
+			dprintf(D_FULLDEBUG,
+				"No runnable jobs for shadow pid %d (was running job %d.%d); shadow will exit.\n",
+				shadow_pid, prev_job_id.cluster, prev_job_id.proc);
+			stream->encode();
+			stream->put((int)0);
+			stream->end_of_message();
+			return TRUE;
+		}
+
+		new_job_id = next_srec->job_id;
+		dprintf(D_ALWAYS,
+				"Shadow pid %d switching to job %d.%d on %s.\n",
+				shadow_pid, new_job_id.cluster, new_job_id.proc,
+				next_srec->match->description() );
+
+		time_t now = stats.Tick();
+		stats.ShadowsRecycled += 1;
+		OtherPoolStats.Tick(now);
+
+			// the waiting job was not added to the shadow tables yet,
+			// add_shadow_rec() does that now that it has a shadow.
+		delete_shadow_rec( srec );
+		next_srec->pid = shadow_pid;
+		next_srec->prev_job_id = prev_job_id;
+		next_srec->recycle_shadow_stream = stream;
+		add_shadow_rec( next_srec );
+		stats.ShadowsRunning = numShadows;
+
+		callAboutToSpawnJobHandler(new_job_id.cluster, new_job_id.proc, next_srec);
+		return KEEP_STREAM;
 	}
 
 	new_job_id.cluster = mrec->cluster;
@@ -16993,6 +17818,39 @@ Scheduler::RecycleShadow(int /*cmd*/, Stream *stream)
 	return KEEP_STREAM;
 }
 
+// With RECYCLE_SHADOWS_ACROSS_CLAIMS, a shadow whose claim has no more
+// jobs for it can run the next job that is waiting in the RunnableJobQueue
+// for a shadow to be spawned, rather than exiting while a new shadow is
+// spawned for that job.  This saves the fork and startup of a shadow, but
+// the shadow still runs one job, so it does not cut the shadows per running
+// job.  Returns the shadow record of that job, taken off the queue, or NULL
+// if the next job can't be run by this shadow (see ShadowCanRunWaitingJob()),
+// in which case the shadow exits as it would without the knob.
+shadow_rec*
+Scheduler::TakeRunnableJobForShadow(const char * owner)
+{
+	if( RunnableJobQueue.empty() || ExitWhenDone ) {
+		return NULL;
+	}
+	shadow_rec *srec = RunnableJobQueue.front();
+
+	RecycleCandidate job;
+	job.universe = srec->universe;
+	job.is_reconnect = srec->is_reconnect;
+	job.has_match = srec->match != NULL;
+	job.dedicated = srec->match && srec->match->is_dedicated;
+	job.paired = srec->match && srec->match->m_paired_mrec;
+	int status;
+	job.still_runnable = isStillRunnable(srec->job_id.cluster, srec->job_id.proc, status);
+	GetAttributeString( srec->job_id.cluster, srec->job_id.proc, ATTR_OWNER, job.owner );
+	if( !ShadowCanRunWaitingJob(owner, job) ) {
+		return NULL;
+	}
+
+	RunnableJobQueue.pop();
+	return srec;
+}
+
 void
 Scheduler::finishRecycleShadow(shadow_rec *srec)
 {
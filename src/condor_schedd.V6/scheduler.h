@@ -34,6 +34,7 @@
 #include <unordered_set>
 #include <unordered_map>
 #include <queue>
+#include <deque>
 
 // switch to using User (fully qualified) over Owner as the main job identity
 #define USER_IS_THE_NEW_OWNER 1
@@ -66,6 +67,7 @@
 #include "condor_holdcodes.h"
 #include "job_transforms.h"
 #include "history_queue.h"
+#include "query_thread_pool.h"
 
 extern  int         STARTD_CONTACT_TIMEOUT;
 const	int			NEGOTIATOR_CONTACT_TIMEOUT = 30;
@@ -239,7 +241,7 @@ struct SubmitterData {
   time_t lastUpdateTime; // the last time we sent updates to the collector
   bool isOwnerName; // the name of this submitter record is the same as the name of an owner record.
   bool absentUpdateSent;
-  std::set<int> PrioSet; // Set of job priorities, used for JobPrioArray attr
+  std::map<int,int> PrioSet; // Set of job priorities and the number of jobs at each, used for JobPrioArray attr
   SubmitterData() : LastHitTime(0), FlockLevel(0), OldFlockLevel(0), NegotiationTimestamp(0)
       , lastUpdateTime(0), isOwnerName(false), absentUpdateSent(false)  { }
 };
@@ -295,6 +297,39 @@ struct OwnerInfo {
 
 typedef std::map<std::string, OwnerInfo> OwnerInfoMap;
 
+// What count_a_job added to the schedd, submitter and owner counters for one job.
+// When SCHEDD_INCREMENTAL_JOB_COUNTS is true, each job keeps the last one of these
+// so that count_jobs() can take the job back out of the counters when it changes
+// instead of walking the whole job queue.
+//
+struct JobCountTally {
+  SubmitterData * submitter;
+  OwnerInfo * owner;
+  int JobsRunning;          // the schedd totals
+  int JobsIdle;
+  int JobsHeld;
+  int JobsRemoved;
+  int SchedulerJobsRunning;
+  int SchedulerJobsIdle;
+  int LocalJobsRunning;
+  int LocalJobsIdle;
+  int JobsIdleByOwner;      // added to both the owner and the submitter JobsIdle
+  int JobsHeldByOwner;      // added to both the owner and the submitter JobsHeld
+  int WeightedJobsIdle;
+  int JobPrio;
+  bool hasJobPrio;          // JobPrio is in the submitter PrioSet
+  bool eachCycle;           // count_a_job_each_cycle() must see this job every time
+  std::map<std::string, int> flock; // multiple of the idle counts added to each flock pool
+  JobCountTally()
+	: submitter(NULL), owner(NULL)
+	, JobsRunning(0), JobsIdle(0), JobsHeld(0), JobsRemoved(0)
+	, SchedulerJobsRunning(0), SchedulerJobsIdle(0)
+	, LocalJobsRunning(0), LocalJobsIdle(0)
+	, JobsIdleByOwner(0), JobsHeldByOwner(0), WeightedJobsIdle(0)
+	, JobPrio(0), hasJobPrio(false), eachCycle(false)
+  {}
+};
+
 
 class match_rec: public ClaimIdParser
 {
@@ -506,6 +541,7 @@ private:
 };
 
 class JobSets; // forward reference - declared in jobsets.h
+class UserPolicy; // forward reference - declared in user_job_policy.h
 
 class Scheduler : public Service
 {
@@ -555,6 +591,10 @@ class Scheduler : public Service
 	JobTransforms	jobTransforms;
 	friend	int		NewProc(int cluster_id);
 	friend	int		count_a_job(JobQueueJob*, const JOB_ID_KEY&, void* );
+	friend	bool	tally_a_job(JobQueueJob*, JobCountTally &);
+	friend	void	recount_a_job(JobQueueJob*);
+	friend	void	add_job_tally(const JobCountTally &, int);
+	friend	void	count_a_job_each_cycle(JobQueueJob*, time_t);
 //	friend	void	job_prio(ClassAd *);
 	void			AddRunnableLocalJobs();
 	bool			IsLocalJobEligibleToRun(JobQueueJob* job);
@@ -573,12 +613,16 @@ class Scheduler : public Service
 	int				spoolJobFilesReaper(int,int);	
 	int				transferJobFilesReaper(int,int);
 	void			PeriodicExprHandler( void );
+	void			EvalChangedPeriodicExprs(UserPolicy & policy);
+	void			schedulePeriodicExprs(JobQueueJob * job, UserPolicy & policy, time_t now);
+	void			unschedulePeriodicExprs(const JOB_ID_KEY & jid);
 	void			addCronTabClassAd( JobQueueJob* );
 	void			addCronTabClusterId( int );
 	void			indexAJob(JobQueueJob* job, bool loading_job_queue=false);
 	void			removeJobFromIndexes(const JOB_ID_KEY& job_id, int job_prio=0);
 	int				RecycleShadow(int cmd, Stream *stream);
 	void			finishRecycleShadow(shadow_rec *srec);
+	shadow_rec*		TakeRunnableJobForShadow(const char * owner);
 
 	int				requestSandboxLocation(int mode, Stream* s);
 	int			FindGManagerPid(PROC_ID job_id);
@@ -700,6 +744,8 @@ class Scheduler : public Service
 	int				getJobsTotalAds() const { return JobsTotalAds; };
 	int				getMaxJobsSubmitted() const { return MaxJobsSubmitted; };
 	int				getMaxJobsPerOwner() const { return MaxJobsPerOwner; }
+		// a job ad was written to the history file, see HISTORY_HELPER_TAIL_SIZE
+	void			rememberHistoryAd(const ClassAd & ad) { HistoryQue.rememberAd(ad); }
 	int				getMaxJobsPerSubmission() const { return MaxJobsPerSubmission; }
 
 		// Used by the UserIdentity class and some others
@@ -790,6 +836,21 @@ class Scheduler : public Service
 	// live counters for running/held/idle jobs
 	LiveJobCounters liveJobCounts; // job counts that are always up-to-date with the committed job state
 
+	// when SCHEDD_INCREMENTAL_JOB_COUNTS is true, count_jobs() recounts only the jobs
+	// passed to jobCountsChanged() since the last time, and uncountJob() takes a job
+	// that is leaving the queue out of the counts.
+	bool incrementalJobCounts() const { return m_incrementalJobCounts; }
+	void jobCountsChanged(JobQueueJob * job);
+	void uncountJob(JobQueueJob * job);
+
+	// when PERIODIC_EXPR_CHANGE_DRIVEN is true, PeriodicExprHandler() evaluates the
+	// periodic expressions of the jobs passed to periodicExprsChanged() since the
+	// last time, and of the jobs whose expressions could have changed with the time.
+	// forgetPeriodicExprs() takes a job that is leaving the queue out of the schedule.
+	bool changeDrivenPeriodicExprs() const { return m_changeDrivenPeriodicExprs; }
+	void periodicExprsChanged(JobQueueJob * job);
+	void forgetPeriodicExprs(JobQueueJob * job);
+
 	// the significant attributes that the schedd belives are absolutely required.
 	// This is NOT the effective set of sig attrs we get after we talk to negotiators
 	// it is the basic set needed for correct operation of the Schedd: Requirements,Rank,
@@ -856,6 +917,7 @@ private:
 	int             RequestClaimTimeout;
 	int				JobStartDelay;
 	int				JobStartCount;
+	bool			RecycleShadowsAcrossClaims; // see TakeRunnableJobForShadow()
 	int				JobStopDelay;
 	int				JobStopCount;
 	int             MaxNextJobDelay;
@@ -908,6 +970,21 @@ private:
 	int				jobThrottleNextJobDelay;	// used by jobThrottle()
 
 	int				shadowReaperId; // daemoncore reaper id for shadows
+
+		// idle shadows started ahead of time, each waiting to read the ad
+		// of its job from its stdin pipe, see SHADOW_POOL_SIZE
+	struct PooledShadow {
+		int pid;
+		int pipe_fd;      // the write end of the shadow's stdin
+		std::string path; // the condor_shadow it runs
+		time_t started;
+	};
+	std::deque<PooledShadow> m_shadowPool; // oldest first
+	std::set<int>	m_shadowPoolRetired; // told to exit, but not reaped yet
+	int				m_shadowPoolSize;    // SHADOW_POOL_SIZE, the most idle shadows to keep
+	int				m_shadowPoolTarget;  // how many to keep now, follows the shadow start rate
+	int				m_shadowPoolStarts;  // shadows started since the last ShadowPoolHandler()
+	int				m_shadowPoolTid;
 //	int 				dirtyNoticeId;
 //	int 				dirtyNoticeInterval;
 
@@ -971,8 +1048,27 @@ private:
 	ClassAd * slotWeightGuessAd;
 	bool			m_use_slot_weights;
 
+	bool			m_incrementalJobCounts;
+	bool			m_rebuildJobCounts; // the next count_jobs() must walk the whole queue
+	int				m_jobCountsAuditInterval;
+	time_t			m_jobCountsAuditTime; // when count_jobs() last walked the whole queue
+	std::vector<JOB_ID_KEY> m_jobsToRecount;
+	std::set<JOB_ID_KEY> m_jobsCountedEachCycle;
+
+	bool			m_changeDrivenPeriodicExprs;
+	bool			m_periodicExprsFullWalk; // the next PeriodicExprHandler() must evaluate every job
+	int				m_periodicExprsFullWalkInterval;
+	time_t			m_periodicExprsFullWalkTime; // when PeriodicExprHandler() last evaluated every job
+	std::set<JOB_ID_KEY> m_periodicExprsChanged;  // changed since their expressions were evaluated
+	std::set<JOB_ID_KEY> m_periodicExprsEachTime; // evaluated every time, see schedulePeriodicExprs()
+	std::set<std::pair<time_t, JOB_ID_KEY> > m_periodicExprsDue; // when the expressions of a job could next change
+	std::map<JOB_ID_KEY, time_t> m_periodicExprsDueTime; // the time each job is filed under in m_periodicExprsDue
+
+	QueryThreadPool	m_queryThreads; // answers condor_q from job queue snapshots, see SCHEDD_QUERY_THREADS
+
 	// utility functions
 	int			count_jobs();
+	void		recount_changed_jobs();
 	bool		fill_submitter_ad(ClassAd & pAd, const SubmitterData & Owner, const std::string &pool_name, int flock_level);
 	int			make_ad_list(ClassAdList & ads, ClassAd * pQueryAd=NULL);
 	int			handleMachineAdsQuery( Stream * stream, ClassAd & queryAd );
@@ -1055,6 +1151,12 @@ private:
 										Env const *env, 
 										const char* name, bool is_dc,
 										bool wants_pipe, bool want_udp );
+	bool			spawnJobHandlerPooled( shadow_rec* srec, PooledShadow & pooled );
+	bool			spawnPooledShadow( const char* path );
+	void			retirePooledShadow( const PooledShadow & pooled );
+	bool			reapPooledShadow( int pid, int status );
+	void			drainShadowPool();
+	void			ShadowPoolHandler();
 	void			check_zombie(int, PROC_ID*);
 	void			kill_zombie(int, PROC_ID*);
 	int				is_alive(shadow_rec* srec);
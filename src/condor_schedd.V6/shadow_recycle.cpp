@@ -0,0 +1,46 @@
+/***************************************************************
+ *
+ * Copyright (C) 1990-2020, Condor Team, Computer Sciences Department,
+ * University of Wisconsin-Madison, WI.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You may
+ * obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************/
+
+#include "condor_common.h"
+#include "condor_universe.h"
+#include "shadow_recycle.h"
+
+bool
+ShadowCanRunWaitingJob(const char * shadow_owner, const RecycleCandidate & job)
+{
+	if( !shadow_owner || !shadow_owner[0] ) {
+		return false;
+	}
+		// the same kinds of jobs that RecycleShadow() runs on the
+		// shadow's own claim
+	if( job.is_reconnect || !job.has_match || job.dedicated || job.paired ) {
+		return false;
+	}
+	if( job.universe != CONDOR_UNIVERSE_VANILLA &&
+		job.universe != CONDOR_UNIVERSE_JAVA &&
+		job.universe != CONDOR_UNIVERSE_VM )
+	{
+		return false;
+	}
+		// StartJobHandler() cleans up jobs that are no longer runnable
+	if( !job.still_runnable ) {
+		return false;
+	}
+	return job.owner == shadow_owner;
+}
@@ -0,0 +1,50 @@
+/***************************************************************
+ *
+ * Copyright (C) 1990-2020, Condor Team, Computer Sciences Department,
+ * University of Wisconsin-Madison, WI.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You may
+ * obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************/
+
+#ifndef _SHADOW_RECYCLE_H_
+#define _SHADOW_RECYCLE_H_
+
+#include <string>
+
+/* What the schedd knows about the job at the front of the RunnableJobQueue
+ * when a shadow whose claim has no more jobs asks for another one.  With
+ * RECYCLE_SHADOWS_ACROSS_CLAIMS, that shadow is handed the job instead of
+ * exiting while a new shadow is spawned for it.  This is a hand-off of one
+ * waiting job at a time; the shadow still runs a single job. */
+struct RecycleCandidate {
+	int universe;
+	bool is_reconnect;
+	bool has_match;
+	bool dedicated;
+	bool paired;
+	bool still_runnable;
+	std::string owner;
+
+	RecycleCandidate()
+		: universe(0), is_reconnect(false), has_match(false),
+		  dedicated(false), paired(false), still_runnable(false) {}
+};
+
+/* Returns true if a shadow that ran a job of shadow_owner can run the
+ * waiting job.  It must be a new start of a job that a recycled shadow can
+ * run, on a match of its own, and belong to the same owner, since the
+ * shadow has already switched to that user. */
+bool ShadowCanRunWaitingJob(const char * shadow_owner, const RecycleCandidate & job);
+
+#endif
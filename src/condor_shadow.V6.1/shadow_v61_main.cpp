@@ -39,6 +39,7 @@ static const char* schedd_addr = NULL;
 const char* public_schedd_addr = NULL;
 static const char* job_ad_file = NULL;
 static bool is_reconnect = false;
+static bool is_pooled = false; // started ahead of its job, see SHADOW_POOL_SIZE
 static int cluster = -1;
 static int proc = -1;
 static const char * xfer_queue_contact_info = NULL;
@@ -109,6 +110,11 @@ parseArgs( int argc, char *argv[] )
 			continue;
 		}
 
+		if( !strcmp(opt, "--pool") ) {
+			is_pooled = true;
+			continue;
+		}
+
 		if (strncmp(opt, "--schedd", 8) == 0) {
 			char *ptr = strchr(opt, '<');
 			if (ptr && is_valid_sinful(ptr)) {
@@ -199,6 +205,11 @@ readJobAd( void )
         }
     }
 	if( ! read_something ) {
+		if( is_pooled ) {
+				// the schedd closed our stdin without giving us a job
+			delete ad;
+			return NULL;
+		}
 		EXCEPT( "reading ClassAd from (%s): file is empty",
 				is_stdin ? "STDIN" : job_ad_file );
 	}
@@ -395,6 +406,26 @@ main_init(int argc, char *argv[])
 	daemonCore->Register_Signal( DC_SIGCONTINUE, "DC_SIGCONTINUE", 
 		&handleSignals,"handleSignals");
 
+	parseArgs( argc, argv );
+
+	CheckSpoolVersion(SPOOL_MIN_VERSION_SHADOW_SUPPORTS,SPOOL_CUR_VERSION_SHADOW_SUPPORTS);
+
+	ClassAd* ad = readJobAd();
+	if( ! ad ) {
+		if( is_pooled ) {
+			dprintf( D_FULLDEBUG, "Pooled shadow was not given a job, exiting\n" );
+			DC_Exit( JOB_NOT_STARTED );
+		}
+		EXCEPT( "Failed to read job ad!" );
+	}
+	if( is_pooled ) {
+			// a pooled shadow learns its job id from the job ad
+		ad->LookupInteger(ATTR_CLUSTER_ID,cluster);
+		ad->LookupInteger(ATTR_PROC_ID,proc);
+	}
+
+		// a pooled shadow may have waited a while for its job, so
+		// count its worklife from when it got one.
 	int shadow_worklife = param_integer( "SHADOW_WORKLIFE", 3600 );
 	if( shadow_worklife > 0 ) {
 		shadow_worklife_expires = time(NULL) + shadow_worklife;
@@ -407,15 +438,6 @@ main_init(int argc, char *argv[])
 		shadow_worklife_expires = 0;
 	}
 
-	parseArgs( argc, argv );
-
-	CheckSpoolVersion(SPOOL_MIN_VERSION_SHADOW_SUPPORTS,SPOOL_CUR_VERSION_SHADOW_SUPPORTS);
-
-	ClassAd* ad = readJobAd();
-	if( ! ad ) {
-		EXCEPT( "Failed to read job ad!" );
-	}
-
 	startShadow( ad );
 }
 
@@ -48,6 +48,7 @@ ResMgr::ResMgr() :
 	up_tid = -1;
 	poll_tid = -1;
 	m_cred_sweep_tid = -1;
+	m_bulk_update_tid = -1;
 
 	draining = false;
 	draining_is_graceful = false;
@@ -1109,6 +1110,12 @@ ResMgr::final_update( void )
 {
 	if( ! resources ) {
 		return;
+	}
+		// the slots are about to be invalidated, don't resurrect them
+	m_bulk_updates.clear();
+	if( m_bulk_update_tid != -1 ) {
+		daemonCore->Cancel_Timer( m_bulk_update_tid );
+		m_bulk_update_tid = -1;
 	}
 	walk( &Resource::final_update );
 }
@@ -1118,18 +1125,87 @@ int
 ResMgr::send_update( int cmd, ClassAd* public_ad, ClassAd* private_ad,
 					 bool nonblock )
 {
-	static bool first_time = true;
-
 		// Increment the resmgr's count of updates.
 	num_updates++;
 
 	int res = daemonCore->sendUpdates(cmd, public_ad, private_ad, nonblock, &m_token_requester,
 		DCTokenRequester::default_identity, "ADVERTISE_STARTD");
 
+	update_sent();
+	return res;
+}
+
+
+void
+ResMgr::queue_bulk_update( ClassAd & public_ad, ClassAd & private_ad )
+{
+	std::string name;
+	public_ad.LookupString( ATTR_NAME, name );
+
+		// a newer update of a slot replaces one that has not gone out yet
+	std::pair<ClassAd, ClassAd> & ads = m_bulk_updates[name];
+	ads.first = public_ad;
+	ads.second = private_ad;
+
+	if( m_bulk_update_tid == -1 ) {
+		m_bulk_update_tid = daemonCore->Register_Timer(
+							param_integer( "STARTD_BULK_UPDATE_DELAY", 1, 0 ),
+							(TimerHandlercpp)&ResMgr::send_bulk_updates,
+							"send_bulk_updates",
+							this );
+	}
+}
+
+
+void
+ResMgr::cancel_bulk_update( const char * slot_name )
+{
+	if( slot_name ) {
+		m_bulk_updates.erase( slot_name );
+	}
+}
+
+
+void
+ResMgr::send_bulk_updates( void )
+{
+	m_bulk_update_tid = -1;
+	if( m_bulk_updates.empty() ) {
+		return;
+	}
+
+	DCCollectorAdPairs ads;
+	ads.reserve( m_bulk_updates.size() );
+	for( auto it = m_bulk_updates.begin(); it != m_bulk_updates.end(); ++it ) {
+		ads.push_back( std::make_pair( &it->second.first, &it->second.second ) );
+	}
+
+	num_updates += (int)ads.size();
+
+	int res = daemonCore->sendBulkUpdates( UPDATE_STARTD_AD, ads, true, &m_token_requester,
+		DCTokenRequester::default_identity, "ADVERTISE_STARTD" );
+	if( res ) {
+		dprintf( D_FULLDEBUG, "Sent update of %d slot(s) to %d collector(s)\n",
+				 (int)ads.size(), res );
+	} else {
+		dprintf( D_ALWAYS, "Error sending update of %d slot(s) to collector(s)\n",
+				 (int)ads.size() );
+	}
+	m_bulk_updates.clear();
+
+	update_sent();
+}
+
+
+void
+ResMgr::update_sent( void )
+{
+	static bool first_time = true;
+
 	if (first_time) {
 		first_time = false;
 		dprintf( D_ALWAYS, "Initial update sent to collector(s)\n");
-		if ( ! param_boolean("STARTD_SEND_READY_AFTER_FIRST_UPDATE", true)) return res;
+		if ( ! param_boolean("STARTD_SEND_READY_AFTER_FIRST_UPDATE", true)) return;
 
 		// send a DC_SET_READY message to the master to indicate the STARTD is ready to go
 		MyString master_sinful(daemonCore->InfoCommandSinfulString(-2));
@@ -1144,8 +1220,6 @@ ResMgr::send_update( int cmd, ClassAd* public_ad, ClassAd* private_ad,
 			dmn->sendMsg(msg.get());
 		}
 	}
-
-	return res;
 }
 
 
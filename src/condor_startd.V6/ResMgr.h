@@ -168,6 +168,11 @@ public:
 
 	int		send_update( int, ClassAd*, ClassAd*, bool nonblocking );
 	void	final_update( void );
+
+		// Hold the update ads of a slot so that they go to the
+		// collector(s) in a single bulk update with the other slots
+	void	queue_bulk_update( ClassAd & public_ad, ClassAd & private_ad );
+	void	cancel_bulk_update( const char * slot_name );
 	
 		// Evaluate the state of all resources.
 	void	eval_all( void );
@@ -357,6 +362,11 @@ private:
 	int		up_tid;		// DaemonCore timer id for update timer
 	int		poll_tid;	// DaemonCore timer id for polling timer
 	int		m_cred_sweep_tid;	// DaemonCore timer id for polling timer
+	int		m_bulk_update_tid;	// DaemonCore timer id for sending bulk updates
+	std::map<std::string, std::pair<ClassAd, ClassAd> > m_bulk_updates;
+
+	void	send_bulk_updates( void );
+	void	update_sent( void );
 	time_t	startTime;		// Time that we started
 	time_t	cur_time;		// current time
 
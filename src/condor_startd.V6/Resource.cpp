@@ -1536,13 +1536,18 @@ Resource::do_update( void )
 #endif
 #endif
 
-		// Send class ads to collector(s)
-	rval = resmgr->send_update( UPDATE_STARTD_AD, &public_ad,
-								&private_ad, true );
-	if( rval ) {
-		dprintf( D_FULLDEBUG, "Sent update to %d collector(s)\n", rval );
+		// Send class ads to collector(s), or let the ResMgr send them
+		// together with the ads of the other slots
+	if( param_boolean( "STARTD_SEND_BULK_UPDATES", false ) ) {
+		resmgr->queue_bulk_update( public_ad, private_ad );
 	} else {
-		dprintf( D_ALWAYS, "Error sending update to collector(s)\n" );
+		rval = resmgr->send_update( UPDATE_STARTD_AD, &public_ad,
+									&private_ad, true );
+		if( rval ) {
+			dprintf( D_FULLDEBUG, "Sent update to %d collector(s)\n", rval );
+		} else {
+			dprintf( D_ALWAYS, "Error sending update to collector(s)\n" );
+		}
 	}
 
 	// We _must_ reset update_tid to -1 before we return so
@@ -1625,6 +1630,7 @@ Resource::final_update( void )
 #endif
 #endif
 
+	resmgr->cancel_bulk_update( r_name );
 	resmgr->send_update( INVALIDATE_STARTD_ADS, &invalidate_ad, NULL, false );
 }
 
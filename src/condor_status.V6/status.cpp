@@ -330,6 +330,7 @@ struct _process_ads_info {
    FILE *        hfDiag; // write raw ads to this file for diagnostic purposes
    unsigned int  diag_flags;
    PrettyPrinter * pp;
+   int           summaries; // number of collector summary ads added to totals
 };
 
 static bool store_ads_callback( void * arg, ClassAd * ad ) {
@@ -349,6 +350,13 @@ static bool process_ads_callback(void * pv,  ClassAd* ad)
 	PrettyPrinter &  thePP = * pi->pp;
 	ASSERT( pi->pp != NULL );
 
+	// the collector sent its totals for a group of ads rather than the ads
+	if (totals && ! pi->hfDiag && ad->Lookup(ATTR_SUMMARY_KEY)) {
+		totals->updateFromSummary(ad);
+		pi->summaries++;
+		return true;
+	}
+
 	std::string key;
 	unsigned int ord = pi->ordinal++;
 	sortSpecs.RenderKey(key, ord, ad);
@@ -1047,6 +1055,18 @@ main (int argc, char *argv[])
 		if ( ! diagnostics_ads_file) exit (1);
 	}
 
+	// When only the startd totals of the whole pool are wanted, ask the
+	// collector for the totals it keeps instead of every slot ad.  A
+	// collector that does not keep them ignores this and sends the ads.
+	if (mainPP.wantOnlyTotals && mainPP.ppTotalStyle == PP_STARTD_NORMAL &&
+		! compactMode && ! mergeMode && ! rightFileName && ! direct && ! diagnose)
+	{
+		MyString req;
+		if (query->getRequirements(req) == Q_OK && (req.empty() || req == "TRUE")) {
+			query->addExtraAttribute(ATTR_SUMMARY_ONLY, "true");
+		}
+	}
+
 	if ( ! projList.empty()) {
 		#if 0 // for debugging
 		std::string attrs;
@@ -1128,7 +1148,7 @@ main (int argc, char *argv[])
 	struct _process_ads_info right_ai = {
 		& right,
 		(rpp->pmHeadFoot&HF_NOSUMMARY) ? NULL : & rightTotals,
-		1, rpp->pm.ColCount(), NULL, 0, rpp
+		1, rpp->pm.ColCount(), NULL, 0, rpp, 0
 	};
 
 	bool close_hfdiag = false;
@@ -1166,14 +1186,14 @@ main (int argc, char *argv[])
 	struct _process_ads_info left_ai = {
 		& left,
 		(lpp->pmHeadFoot&HF_NOSUMMARY) ? NULL : & leftTotals,
-		1, lpp->pm.ColCount(), NULL, 0, lpp
+		1, lpp->pm.ColCount(), NULL, 0, lpp, 0
 	};
 
 	ROD_MAP_BY_KEY both;
 	struct _process_ads_info both_ai = {
 		& both,
 		(bpp->pmHeadFoot&HF_NOSUMMARY) ? NULL : & bothTotals,
-		1, bpp->pm.ColCount(), NULL, 0, bpp
+		1, bpp->pm.ColCount(), NULL, 0, bpp, 0
 	};
 
 	// Argument for the merge callback;
@@ -1396,7 +1416,7 @@ doNormalOutput( struct _process_ads_info & ai, AdTypes & adType ) {
 		}
 	}
 
-	bool any_ads = ! admap.empty();
+	bool any_ads = ! admap.empty() || ai.summaries > 0;
 	ppOption pps = mainPP.prettyPrintHeadings( any_ads );
 
 	bool is_piped = false;
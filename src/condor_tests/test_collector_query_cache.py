@@ -0,0 +1,102 @@
+#!/usr/bin/env pytest
+
+#
+# Test that the collector's query cache never answers a query with a result
+# older than the ads, whether the query is answered by the collector itself
+# or by a forked query worker.
+#
+
+import logging
+import time
+
+from ornithology import (
+    config,
+    standup,
+    action,
+    Condor,
+)
+
+logger = logging.getLogger(__name__)
+logger.setLevel(logging.DEBUG)
+
+
+QUERY_POLICIES = {
+    "in_proc": "always",
+    "forked": "never",
+}
+
+
+@config(params=QUERY_POLICIES)
+def query_policy(request):
+    return request.param
+
+
+@standup
+def condor(test_dir, query_policy):
+    with Condor(
+        test_dir / "condor",
+        config={
+            "COLLECTOR_DEBUG": "D_FULLDEBUG",
+            "COLLECTOR_QUERY_CACHE_TTL": "300",
+            "HANDLE_QUERY_IN_PROC_POLICY": query_policy,
+        },
+    ) as condor:
+        yield condor
+
+
+def update_ad(condor, test_dir, value):
+    ad_file = test_dir / "cache-test-{}.ad".format(value)
+    ad_file.write_text(
+        "\n".join(
+            [
+                'MyType = "Generic"',
+                'Name = "cache-test"',
+                "QueryCacheTest = true",
+                "Value = {}".format(value),
+            ]
+        )
+        + "\n"
+    )
+    rv = condor.run_command(["condor_advertise", "UPDATE_AD_GENERIC", ad_file.as_posix()])
+    assert rv.returncode == 0
+
+
+def query_values(condor):
+    ads = condor.status(constraint="QueryCacheTest =?= true", projection=["Name", "Value"])
+    return [ad["Value"] for ad in ads]
+
+
+def wait_for_value(condor, value, timeout=60):
+    deadline = time.time() + timeout
+    while time.time() < deadline:
+        if query_values(condor) == [value]:
+            return True
+        time.sleep(1)
+    return False
+
+
+@action
+def values(condor, test_dir):
+    update_ad(condor, test_dir, 1)
+    assert wait_for_value(condor, 1)
+
+    # the same query again, which may be answered from the cache
+    first = query_values(condor)
+    again = query_values(condor)
+
+    # replacing the ad changes only its attributes, not the set of ads.
+    # the update may take a moment to arrive, but a stale cached result
+    # would last for the whole TTL, much longer than the wait.
+    update_ad(condor, test_dir, 2)
+    updated = wait_for_value(condor, 2)
+
+    return {"first": first, "again": again, "updated": updated}
+
+
+class TestCollectorQueryCache:
+    def test_repeated_query_gets_same_result(self, values):
+        assert values["first"] == [1]
+        assert values["again"] == [1]
+
+    def test_updated_ad_is_seen_by_next_query(self, values):
+        assert values["updated"]
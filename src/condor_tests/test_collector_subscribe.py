@@ -0,0 +1,142 @@
+#!/usr/bin/env pytest
+
+#
+# Test that a client subscribed to the collector's ad changes is sent the
+# ads that match when it subscribes, then an event for each change.
+#
+
+import logging
+import subprocess
+import time
+from pathlib import Path
+
+from ornithology import (
+    config,
+    standup,
+    action,
+    Condor,
+)
+
+logger = logging.getLogger(__name__)
+logger.setLevel(logging.DEBUG)
+
+
+@config
+def condor_config():
+    config = {
+        "COLLECTOR_DEBUG": "D_FULLDEBUG",
+    }
+    raw_config = None
+    return {"config": config, "raw_config": raw_config}
+
+
+@standup
+def condor(condor_config, test_dir):
+    with Condor(test_dir / "condor", **condor_config) as condor:
+        yield condor
+
+
+def advertise(condor, test_dir, command, name, lines):
+    ad_file = test_dir / "{}-{}.ad".format(command, name)
+    ad_file.write_text("\n".join(lines) + "\n")
+    rv = condor.run_command(["condor_advertise", command, ad_file.as_posix()])
+    assert rv.returncode == 0
+
+
+def update_ad(condor, test_dir, name, value):
+    advertise(
+        condor,
+        test_dir,
+        "UPDATE_AD_GENERIC",
+        name,
+        [
+            'MyType = "Generic"',
+            'Name = "{}"'.format(name),
+            "SubscribeTest = true",
+            "Value = {}".format(value),
+        ],
+    )
+
+
+def invalidate_ad(condor, test_dir, name):
+    advertise(
+        condor,
+        test_dir,
+        "INVALIDATE_ADS_GENERIC",
+        name,
+        [
+            'MyType = "Query"',
+            'TargetType = "Generic"',
+            'Name = "{}"'.format(name),
+            'Requirements = Name == "{}"'.format(name),
+        ],
+    )
+
+
+def wait_for_ads(condor, names, timeout=60):
+    deadline = time.time() + timeout
+    while time.time() < deadline:
+        ads = condor.status(constraint="SubscribeTest =?= true", projection=["Name"])
+        if sorted(ad["Name"] for ad in ads) == sorted(names):
+            return True
+        time.sleep(1)
+    return False
+
+
+@action
+def events(condor, test_dir):
+    update_ad(condor, test_dir, "sub-a", 1)
+    update_ad(condor, test_dir, "sub-b", 1)
+    assert wait_for_ads(condor, ["sub-a", "sub-b"])
+
+    helper = Path(__file__).parent / "x_subscribe_ads.exe"
+    with condor.use_config():
+        subscriber = subprocess.Popen(
+            [helper.as_posix(), "SubscribeTest =?= true", "6"],
+            stdout=subprocess.PIPE,
+            universal_newlines=True,
+        )
+
+    received = []
+
+    def next_event():
+        line = subscriber.stdout.readline().strip()
+        logger.debug("subscriber: {}".format(line))
+        received.append(line)
+        return line
+
+    try:
+        # the initial sync
+        sync = [next_event(), next_event(), next_event()]
+
+        # then each change as it happens
+        update_ad(condor, test_dir, "sub-a", 2)
+        modify = next_event()
+        update_ad(condor, test_dir, "sub-c", 1)
+        add = next_event()
+        invalidate_ad(condor, test_dir, "sub-b")
+        remove = next_event()
+
+        assert subscriber.wait(timeout=60) == 0
+    finally:
+        if subscriber.poll() is None:
+            subscriber.kill()
+
+    return {"sync": sync, "modify": modify, "add": add, "remove": remove}
+
+
+class TestCollectorSubscribe:
+    def test_initial_sync_sends_matching_ads(self, events):
+        assert sorted(events["sync"][:2]) == ["ADD sub-a", "ADD sub-b"]
+
+    def test_initial_sync_ends_with_synced(self, events):
+        assert events["sync"][2] == "SYNCED"
+
+    def test_update_is_sent_as_modify(self, events):
+        assert events["modify"] == "MODIFY sub-a"
+
+    def test_new_ad_is_sent_as_add(self, events):
+        assert events["add"] == "ADD sub-c"
+
+    def test_invalidate_is_sent_as_remove(self, events):
+        assert events["remove"] == "REMOVE sub-b"
@@ -0,0 +1,122 @@
+#!/usr/bin/env pytest
+
+#
+# Test that with RECYCLE_SHADOWS_ACROSS_CLAIMS, a shadow whose claim has no
+# more jobs is handed a job of the same owner that is waiting for a shadow
+# on another claim, and that it exits as usual when the waiting job can no
+# longer run.
+#
+# Each test runs a cluster of two jobs on two slots in a pool of its own.
+# JOB_START_COUNT and JOB_START_DELAY start one of the jobs right away and
+# keep the other one waiting in the schedd for a shadow well after the
+# first job has finished.
+#
+
+import logging
+
+from ornithology import (
+    standup,
+    action,
+    Condor,
+    JobStatus,
+)
+
+logger = logging.getLogger(__name__)
+logger.setLevel(logging.DEBUG)
+
+
+RECYCLE_CONFIG = {
+    "NUM_CPUS": "2",
+    "SCHEDD_DEBUG": "D_FULLDEBUG",
+    "RECYCLE_SHADOWS_ACROSS_CLAIMS": "true",
+    "JOB_START_COUNT": "1",
+    "JOB_START_DELAY": "300",
+}
+
+# only printed when the shadow is handed a job on another claim
+HAND_OFF_MESSAGE = "switching to job {} on "
+
+
+@standup
+def hand_off_condor(test_dir):
+    with Condor(test_dir / "hand-off-condor", config=RECYCLE_CONFIG) as condor:
+        yield condor
+
+
+@standup
+def fallback_condor(test_dir):
+    with Condor(test_dir / "fallback-condor", config=RECYCLE_CONFIG) as condor:
+        yield condor
+
+
+def submit_pair(condor, path_to_sleep, seconds):
+    return condor.submit(
+        description={"executable": path_to_sleep, "arguments": str(seconds)},
+        count=2,
+    )
+
+
+def handed_off(lines, jobid):
+    return any(HAND_OFF_MESSAGE.format(jobid) in line for line in lines)
+
+
+@action
+def hand_off(hand_off_condor, path_to_sleep):
+    schedd_log = hand_off_condor.schedd_log.open()
+    handle = submit_pair(hand_off_condor, path_to_sleep, 5)
+
+    # both jobs finish long before JOB_START_DELAY would let the waiting
+    # one have a shadow of its own
+    completed = handle.wait(condition=lambda s: s.all_complete(), timeout=120)
+
+    switched = schedd_log.wait(
+        lambda msg: any(
+            HAND_OFF_MESSAGE.format(jobid) in msg for jobid in handle.job_ids
+        ),
+        timeout=10,
+    )
+    return {"completed": completed, "switched": switched}
+
+
+@action
+def fallback(fallback_condor, path_to_sleep):
+    schedd_log = fallback_condor.schedd_log.open()
+    handle = submit_pair(fallback_condor, path_to_sleep, 30)
+
+    assert handle.wait(
+        condition=lambda s: s.any_status(JobStatus.RUNNING), timeout=120
+    )
+    running, waiting = handle.job_ids
+    if handle.state[waiting.proc] == JobStatus.RUNNING:
+        running, waiting = waiting, running
+
+    # the waiting job is matched and queued for a shadow; once it is held
+    # it is no longer runnable, so the running job's shadow has nothing to
+    # run when that job exits
+    fallback_condor.run_command(["condor_hold", str(waiting)])
+    assert handle.wait(
+        condition=lambda s: s[waiting.proc] == JobStatus.HELD, timeout=60
+    )
+    assert handle.wait(
+        condition=lambda s: s[running.proc] == JobStatus.COMPLETED, timeout=120
+    )
+
+    exited = schedd_log.wait(
+        lambda msg: "No runnable jobs for shadow" in msg, timeout=30
+    )
+    switched = handed_off(schedd_log.lines, waiting)
+    return {"exited": exited, "switched": switched}
+
+
+class TestRecycleShadowAcrossClaims:
+    def test_waiting_job_completes(self, hand_off):
+        assert hand_off["completed"]
+
+    def test_shadow_is_handed_waiting_job(self, hand_off):
+        assert hand_off["switched"]
+
+    def test_shadow_exits_when_waiting_job_not_runnable(self, fallback):
+        assert fallback["exited"]
+
+    def test_held_job_is_not_handed_off(self, fallback):
+        assert not fallback["switched"]
@@ -0,0 +1,159 @@
+#!/usr/bin/env pytest
+
+#
+# Test that with SCHEDD_INCREMENTAL_JOB_COUNTS, the job counts the schedd
+# keeps up to date as jobs change match a count of the queue, and that the
+# schedd's periodic walk of the whole queue finds nothing to correct.
+#
+# The startd never starts a job, so the jobs stay idle until the test holds,
+# releases, edits or removes them.
+#
+
+import logging
+import time
+
+import htcondor
+
+from ornithology import (
+    standup,
+    action,
+    Condor,
+    JobStatus,
+)
+
+logger = logging.getLogger(__name__)
+logger.setLevel(logging.DEBUG)
+
+
+AUDIT_MESSAGE = "count_jobs: audit of the incremental job counts found "
+WRONG_MESSAGE = "count_jobs: the incremental job counts for "
+
+COUNTS = ("TotalJobAds", "TotalIdleJobs", "TotalHeldJobs", "TotalRunningJobs")
+
+
+@standup
+def condor(test_dir):
+    with Condor(
+        test_dir / "condor",
+        config={
+            "START": "false",
+            "SCHEDD_DEBUG": "D_FULLDEBUG",
+            "SCHEDD_INTERVAL": "2",
+            "SCHEDD_INCREMENTAL_JOB_COUNTS": "true",
+            "SCHEDD_JOB_COUNTS_AUDIT_INTERVAL": "4",
+        },
+    ) as condor:
+        yield condor
+
+
+def queue_counts(condor):
+    ads = condor.query(projection=["JobStatus"])
+    return {
+        "TotalJobAds": len(ads),
+        "TotalIdleJobs": sum(1 for ad in ads if ad["JobStatus"] == JobStatus.IDLE),
+        "TotalHeldJobs": sum(1 for ad in ads if ad["JobStatus"] == JobStatus.HELD),
+        "TotalRunningJobs": sum(
+            1 for ad in ads if ad["JobStatus"] == JobStatus.RUNNING
+        ),
+    }
+
+
+def schedd_counts(condor):
+    ads = condor.direct_status(
+        htcondor.DaemonTypes.Schedd,
+        htcondor.AdTypes.Schedd,
+        projection=list(COUNTS),
+    )
+    return {key: ads[0].get(key) for key in COUNTS}
+
+
+def submitter_counts(condor):
+    ads = condor.status(
+        htcondor.AdTypes.Submitter, projection=["IdleJobs", "HeldJobs"]
+    )
+    return {
+        "TotalIdleJobs": sum(ad.get("IdleJobs", 0) for ad in ads),
+        "TotalHeldJobs": sum(ad.get("HeldJobs", 0) for ad in ads),
+    }
+
+
+def wait_for_counts(condor, timeout=60):
+    # the schedd publishes its counts on its next SCHEDD_INTERVAL, and the
+    # submitter ads reach the collector a little after that
+    deadline = time.time() + timeout
+    while time.time() < deadline:
+        expected = queue_counts(condor)
+        schedd = schedd_counts(condor)
+        submitter = submitter_counts(condor)
+        if schedd == expected and all(
+            submitter[key] == expected[key] for key in submitter
+        ):
+            return True
+        logger.debug(
+            "queue {} schedd {} submitters {}".format(expected, schedd, submitter)
+        )
+        time.sleep(1)
+    return False
+
+
+@action
+def counts(condor, path_to_sleep):
+    schedd_log = condor.schedd_log.open()
+
+    first = condor.submit(
+        description={"executable": path_to_sleep, "arguments": "600"}, count=4
+    )
+    second = condor.submit(
+        description={"executable": path_to_sleep, "arguments": "600"}, count=3
+    )
+    checks = {"submitted": wait_for_counts(condor)}
+
+    condor.run_command(["condor_hold", str(first.job_ids[0]), str(second.clusterid)])
+    checks["held"] = wait_for_counts(condor)
+
+    condor.run_command(["condor_release", str(second.job_ids[1])])
+    checks["released"] = wait_for_counts(condor)
+
+    # a cluster-wide edit changes the weight of every idle job of the cluster
+    # and a priority change moves a job to another priority bucket
+    condor.run_command(["condor_qedit", str(first.clusterid), "RequestCpus", "2"])
+    condor.run_command(["condor_prio", "-p", "5", str(first.job_ids[1])])
+    checks["edited"] = wait_for_counts(condor)
+
+    condor.run_command(["condor_rm", str(first.job_ids[2]), str(second.job_ids[0])])
+    checks["removed"] = wait_for_counts(condor)
+
+    # the audit after all of the changes must have found the counts right
+    checks["audited"] = schedd_log.wait(
+        lambda msg: AUDIT_MESSAGE + "0 wrong" in msg, timeout=30
+    )
+    checks["wrong"] = [
+        line
+        for line in schedd_log.lines
+        if WRONG_MESSAGE in line
+        or (AUDIT_MESSAGE in line and AUDIT_MESSAGE + "0 wrong" not in line)
+    ]
+    return checks
+
+
+class TestScheddIncrementalJobCounts:
+    def test_counts_after_submit(self, counts):
+        assert counts["submitted"]
+
+    def test_counts_after_hold(self, counts):
+        assert counts["held"]
+
+    def test_counts_after_release(self, counts):
+        assert counts["released"]
+
+    def test_counts_after_edit(self, counts):
+        assert counts["edited"]
+
+    def test_counts_after_remove(self, counts):
+        assert counts["removed"]
+
+    def test_audit_ran(self, counts):
+        assert counts["audited"]
+
+    def test_audit_found_nothing_wrong(self, counts):
+        assert counts["wrong"] == []
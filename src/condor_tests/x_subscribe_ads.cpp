@@ -0,0 +1,89 @@
+/***************************************************************
+ *
+ * Copyright (C) 1990-2020, Condor Team, Computer Sciences Department,
+ * University of Wisconsin-Madison, WI.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You may
+ * obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************/
+
+// Subscribe to the ad changes of the local collector and print one line
+// per event, "<event> <Name>", until the given number of events have
+// arrived.  Used by test_collector_subscribe.py.
+
+#include "condor_common.h"
+#include "condor_classad.h"
+#include "condor_debug.h"
+#include "condor_config.h"
+#include "condor_attributes.h"
+#include "condor_distribution.h"
+#include "dc_collector.h"
+
+static const char * event_name(int event)
+{
+	switch (event) {
+		case AD_EVENT_ADD: return "ADD";
+		case AD_EVENT_MODIFY: return "MODIFY";
+		case AD_EVENT_REMOVE: return "REMOVE";
+		case AD_EVENT_SYNCED: return "SYNCED";
+	}
+	return "UNKNOWN";
+}
+
+int main(int argc, char * argv[])
+{
+	if (argc != 3) {
+		fprintf(stderr, "Usage: %s <constraint> <num-events>\n", argv[0]);
+		return 1;
+	}
+	int num_events = atoi(argv[2]);
+
+	myDistro->Init(argc, argv);
+	set_priv_initialize();
+	config();
+
+	ClassAd query;
+	query.Assign(ATTR_TARGET_TYPE, "Any");
+	if ( ! query.AssignExpr(ATTR_REQUIREMENTS, argv[1])) {
+		fprintf(stderr, "Invalid constraint: %s\n", argv[1]);
+		return 1;
+	}
+
+	DCCollector collector;
+	CondorError errstack;
+	ReliSock * sock = collector.subscribe(query, &errstack);
+	if ( ! sock) {
+		fprintf(stderr, "Failed to subscribe: %s\n", errstack.getFullText().c_str());
+		return 1;
+	}
+		// don't hang the test if an event never comes
+	sock->timeout(60);
+
+	int rval = 0;
+	for (int i = 0; i < num_events; ++i) {
+		int event = 0;
+		ClassAd ad;
+		if ( ! DCCollector::readAdEvent(sock, event, ad)) {
+			fprintf(stderr, "Failed to read event %d\n", i);
+			rval = 1;
+			break;
+		}
+		std::string name;
+		ad.LookupString(ATTR_NAME, name);
+		printf("%s %s\n", event_name(event), name.c_str());
+		fflush(stdout);
+	}
+
+	delete sock;
+	return rval;
+}
@@ -0,0 +1,99 @@
+/***************************************************************
+ *
+ * Copyright (C) 1990-2020, Condor Team, Computer Sciences Department,
+ * University of Wisconsin-Madison, WI.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You may
+ * obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************/
+
+// Copy a ClassAd log such as job_queue.log record by record, writing it
+// out in text or binary form.  The input may be in either form.
+
+#include "condor_common.h"
+#include "condor_config.h"
+#include "condor_debug.h"
+#include "classad_log.h"
+#include "condor_fsync.h"
+
+static void
+usage(const char * name)
+{
+	fprintf(stderr, "Usage: %s [-help] -text | -binary <input-log> <output-log>\n", name);
+	fprintf(stderr, "    -text      write the output log in text form\n");
+	fprintf(stderr, "    -binary    write the output log in binary form\n");
+}
+
+int
+main(int argc, char* argv[])
+{
+	int want_binary = -1;
+	const char * input = NULL;
+	const char * output = NULL;
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-help") == 0) {
+			usage(argv[0]);
+			exit(0);
+		} else if (strcmp(argv[i], "-text") == 0) {
+			want_binary = 0;
+		} else if (strcmp(argv[i], "-binary") == 0) {
+			want_binary = 1;
+		} else if ( ! input) {
+			input = argv[i];
+		} else if ( ! output) {
+			output = argv[i];
+		} else {
+			usage(argv[0]);
+			exit(1);
+		}
+	}
+	if (want_binary < 0 || ! input || ! output) {
+		usage(argv[0]);
+		exit(1);
+	}
+
+	config();
+
+	FILE * in = safe_fopen_wrapper_follow(input, "rb");
+	if ( ! in) {
+		fprintf(stderr, "Cannot open %s: %s\n", input, strerror(errno));
+		exit(1);
+	}
+	FILE * out = safe_fopen_wrapper_follow(output, "wb", 0600);
+	if ( ! out) {
+		fprintf(stderr, "Cannot create %s: %s\n", output, strerror(errno));
+		exit(1);
+	}
+
+	unsigned long count = 0;
+	bool torn = false;
+	std::string errmsg;
+	if ( ! CopyClassAdLog(in, out, want_binary, DefaultMakeClassAdLogTableEntry, count, torn, errmsg)) {
+		fprintf(stderr, "Cannot copy %s to %s: %s\n", input, output, errmsg.c_str());
+		exit(1);
+	}
+	if (torn) {
+		fprintf(stderr, "Warning: ignoring the incomplete record at the end of %s\n", input);
+	}
+	fclose(in);
+
+	if (fflush(out) != 0 || condor_fsync(fileno(out)) < 0 || fclose(out) != 0) {
+		fprintf(stderr, "Cannot write to %s: %s\n", output, strerror(errno));
+		exit(1);
+	}
+
+	printf("Wrote %lu records from %s to %s in %s form\n",
+		count, input, output, want_binary ? "binary" : "text");
+	return 0;
+}
@@ -47,6 +47,7 @@
 #include "history_utils.h"
 #include "backward_file_reader.h"
 #include <fcntl.h>  // for O_BINARY
+#include <algorithm>
 
 void Usage(const char* name, int iExitCode=1);
 
@@ -145,6 +146,7 @@ static StringList projection;
 static classad::References whitelist;
 static ExprTree *sinceExpr = NULL;
 static bool want_startd_history = false;
+static int scanThreads = 0; // HISTORY_SCAN_THREADS
 
 int getInheritedSocks(Stream* socks[], size_t cMaxSocks, pid_t & ppid)
 {
@@ -193,6 +195,7 @@ main(int argc, const char* argv[])
   config();
 
   readfromfile = ! param_defined("SCHEDD_HOST");
+  scanThreads = param_integer("HISTORY_SCAN_THREADS", 0, 0);
 
   for(i=1; i<argc; i++) {
     if (is_dash_arg_prefix(argv[i],"long",1)) {
@@ -1381,6 +1384,112 @@ static void printJobAds(ClassAdList & jobs)
 	jobs.Close();
 }
 
+// Read the ads of a history file that the constraint and -since might
+// care about, using the index of the file to skip the rest without parsing
+// them.  Returns false if the file has no usable index.
+static bool readHistoryFromIndex(const char *JobHistoryFileName, const char* constraint, ExprTree *constraintExpr, bool read_backwards)
+{
+	if ( ! constraintExpr && ! sinceExpr) {
+		return false; // every ad must be read anyway
+	}
+	std::vector<HistoryIndexRec> recs;
+	if ( ! readHistoryIndex(JobHistoryFileName, recs)) {
+		if (diagnostic) {
+			fprintf(stderr, "No usable history index for %s\n", JobHistoryFileName);
+		}
+		return false;
+	}
+
+	FILE * fp = safe_fopen_wrapper_follow(JobHistoryFileName, "r");
+	if ( ! fp) {
+		fprintf(stderr,"Error opening history file %s: %s\n", JobHistoryFileName,strerror(errno));
+		exit(1);
+	}
+
+	int skipped = 0;
+	std::string buf;
+	std::vector<std::string> exprs;
+	for (size_t ix = 0; ix < recs.size(); ++ix) {
+		if ((specifiedMatch > 0 && matchCount >= specifiedMatch) || (maxAds > 0 && adCount >= maxAds))
+			break;
+		if (abort_transfer)
+			break;
+
+		const HistoryIndexRec & rec = recs[read_backwards ? recs.size() - 1 - ix : ix];
+
+		// an ad we skip still counts as scanned, as it would for -scanlimit
+		int since = sinceExpr ? evalOnHistoryIndex(sinceExpr, rec) : HISTORY_INDEX_FALSE;
+		if (since == HISTORY_INDEX_TRUE) {
+			++adCount;
+			maxAds = adCount; // this will force us to stop scanning
+			break;
+		}
+		if (since == HISTORY_INDEX_FALSE && constraintExpr && evalOnHistoryIndex(constraintExpr, rec) == HISTORY_INDEX_FALSE) {
+			++adCount;
+			++skipped;
+			continue;
+		}
+
+		buf.resize(rec.end - rec.offset);
+		if (fseek(fp, rec.offset, SEEK_SET) < 0 || fread(&buf[0], 1, buf.size(), fp) != buf.size()) {
+			fprintf(stderr, "Error %d: cannot read from history file %s\n", errno, JobHistoryFileName);
+			exit(1);
+		}
+
+		// printJobIfConstraint wants the lines of the ad last line first,
+		// as the backwards reader finds them.
+		exprs.clear();
+		StringTokenIterator lines(buf, 100, "\r\n");
+		for (const char * line = lines.first(); line; line = lines.next()) {
+			const char * psz = line;
+			while (*psz == ' ' || *psz == '\t') ++psz;
+			if ( ! *psz || *psz == '#' || starts_with(psz, "*** ")) continue;
+			exprs.push_back(line);
+		}
+		std::reverse(exprs.begin(), exprs.end());
+		printJobIfConstraint(exprs, constraint, constraintExpr);
+	}
+	fclose(fp);
+
+	if (diagnostic) {
+		fprintf(stderr, "Skipped %d of %d ads in %s using its index\n",
+			skipped, (int)recs.size(), JobHistoryFileName);
+	}
+	return true;
+}
+
+// Read a history file with scanThreads threads parsing ads and evaluating
+// the constraint.  A batch of chunks is scanned at once, then the results
+// are printed in order, so the output and the points at which -limit,
+// -scanlimit and -since stop the scan are the same as for a single thread.
+static void readHistoryFromFileParallel(const char *JobHistoryFileName, ExprTree *constraintExpr, bool read_backwards)
+{
+	FILE * fp = safe_fopen_wrapper_follow(JobHistoryFileName, "r");
+	struct stat st;
+	if ( ! fp || fstat(fileno(fp), &st) < 0) {
+		fprintf(stderr,"Error opening history file %s: %s\n", JobHistoryFileName,strerror(errno));
+		exit(1);
+	}
+
+	scanHistoryFile(fp, (long)st.st_size, read_backwards, scanThreads, constraintExpr, sinceExpr,
+		[](HistoryScanResult & res) -> bool {
+			if (res.malformed) {
+				dprintf(D_ALWAYS,"condor_history: failed to create classad; bad expr = '%s'\n", res.bad_expr.c_str());
+				printf( "\t*** Warning: Bad history file; skipping malformed ad(s)\n" );
+				return true;
+			}
+			++adCount;
+			if (res.since) {
+				maxAds = adCount; // this will force us to stop scanning
+			} else if (res.ad) {
+				printJob(*res.ad);
+				matchCount++;
+			}
+			return ! ((specifiedMatch > 0 && matchCount >= specifiedMatch) || (maxAds > 0 && adCount >= maxAds) || abort_transfer);
+		});
+	fclose(fp);
+}
+
 static void readHistoryFromFileEx(const char *JobHistoryFileName, const char* constraint, ExprTree *constraintExpr, bool read_backwards)
 {
 	// In case of rotated history files, check if we have already reached the number of 
@@ -1389,6 +1498,15 @@ static void readHistoryFromFileEx(const char *JobHistoryFileName, const char* co
 		return;
 	}
 
+	if (readHistoryFromIndex(JobHistoryFileName, constraint, constraintExpr, read_backwards)) {
+		return;
+	}
+
+	if (scanThreads > 1) {
+		readHistoryFromFileParallel(JobHistoryFileName, constraintExpr, read_backwards);
+		return;
+	}
+
 	// the old function doesn't work for backwards, but it does work for forwards so go ahead and call it.
 	//
 	if ( ! read_backwards) {
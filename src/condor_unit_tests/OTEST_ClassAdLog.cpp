@@ -0,0 +1,462 @@
+/***************************************************************
+ *
+ * Copyright (C) 1990-2020, Condor Team, Computer Sciences Department,
+ * University of Wisconsin-Madison, WI.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You may
+ * obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************/
+
+/*
+	Test the text and binary forms of the ClassAdLog, and the copy of a
+	log from one form to the other that condor_convert_job_queue does.
+ */
+
+#include "condor_common.h"
+#include "condor_debug.h"
+#include "condor_config.h"
+#include "function_test_driver.h"
+#include "unit_test_utils.h"
+#include "emit.h"
+#include "classad_collection.h"
+#include "classad_log_binary.h"
+
+static void setup(void);
+static void cleanup(void);
+static bool test_copy_text_to_binary(void);
+static bool test_copy_binary_to_text(void);
+static bool test_load_binary(void);
+static bool test_append_binary(void);
+static bool test_rotate_text_to_binary(void);
+static bool test_rotate_binary_to_text(void);
+static bool test_copy_torn_binary(void);
+static bool test_load_corrupt_binary_tail(void);
+
+//Global variables
+static std::string text_log, binary_log, text_copy, torn_log;
+
+bool OTEST_ClassAdLog(void) {
+	emit_object("ClassAdLog");
+	emit_comment("The log of changes to a table of ClassAds, such as the "
+		"job queue log.  It may be written as text or in a binary form, and "
+		"either form can be read back.");
+
+	FunctionDriver driver;
+	driver.register_function(test_copy_text_to_binary);
+	driver.register_function(test_copy_binary_to_text);
+	driver.register_function(test_load_binary);
+	driver.register_function(test_append_binary);
+	driver.register_function(test_rotate_text_to_binary);
+	driver.register_function(test_rotate_binary_to_text);
+	driver.register_function(test_copy_torn_binary);
+	driver.register_function(test_load_corrupt_binary_tail);
+
+	setup();
+
+	int status = driver.do_all_functions();
+
+	cleanup();
+
+	return status;
+}
+
+/*
+	Writes a text log with every kind of record and every kind of value
+	that the binary form stores differently.
+ */
+static void setup() {
+	formatstr(text_log, "testlog%d.text", getpid());
+	formatstr(binary_log, "testlog%d.binary", getpid());
+	formatstr(text_copy, "testlog%d.copy", getpid());
+	formatstr(torn_log, "testlog%d.torn", getpid());
+
+	ClassAdCollection log(NULL, text_log.c_str(), 0);
+	log.NewClassAd("0.0", "Cluster", "Machine");
+	log.SetAttribute("0.0", "NextClusterNum", "2");
+	log.BeginTransaction();
+	log.NewClassAd("1.0", "Job", "Machine");
+	log.SetAttribute("1.0", "ClusterId", "1");
+	log.SetAttribute("1.0", "ProcId", "0");
+	log.SetAttribute("1.0", "Owner", "\"alice\"");
+	log.SetAttribute("1.0", "Args", "\"a \\\"quoted\\\" arg\"");
+	log.SetAttribute("1.0", "RequestDisk", "-1024");
+	log.SetAttribute("1.0", "Rank", "1.5");
+	log.SetAttribute("1.0", "WantCheckpoint", "false");
+	log.SetAttribute("1.0", "Nothing", "undefined");
+	log.SetAttribute("1.0", "Requirements", "(TARGET.Memory >= RequestMemory) && (Arch == \"X86_64\")");
+	log.SetAttribute("1.0", "Deleted", "true");
+	log.CommitTransaction();
+	log.DeleteAttribute("1.0", "Deleted");
+	log.NewClassAd("1.1", "Job", "Machine");
+	log.SetAttribute("1.1", "ProcId", "1");
+	log.DestroyClassAd("1.1");
+}
+
+static void cleanup() {
+	remove(text_log.c_str());
+	remove(binary_log.c_str());
+	remove(text_copy.c_str());
+	remove(torn_log.c_str());
+}
+
+// Returns true if the two logs hold the same ads with the same attributes.
+static bool same_ads(ClassAdCollection & a, ClassAdCollection & b) {
+	int count_a = 0, count_b = 0;
+	ClassAd *ad_a, *ad_b;
+	std::string key;
+
+	a.StartIterateAllClassAds();
+	while (a.IterateAllClassAds(ad_a, key)) {
+		++count_a;
+		if ( ! b.LookupClassAd(key, ad_b) || ad_a->size() != ad_b->size()) {
+			return false;
+		}
+		for (auto it = ad_a->begin(); it != ad_a->end(); ++it) {
+			ExprTree *expr = ad_b->Lookup(it->first);
+			if ( ! expr) {
+				return false;
+			}
+			std::string str_a, str_b;
+			ExprTreeToString(it->second, str_a);
+			ExprTreeToString(expr, str_b);
+			if (str_a != str_b) {
+				return false;
+			}
+		}
+	}
+	b.StartIterateAllClassAds();
+	while (b.IterateAllClassAds(ad_b)) {
+		++count_b;
+	}
+	return count_a == count_b;
+}
+
+// Returns true if the log file starts with the binary magic.
+static bool is_binary_file(const char * filename) {
+	FILE * fp = safe_fopen_wrapper_follow(filename, "rb");
+	if ( ! fp) {
+		return false;
+	}
+	bool binary = ClassAdLogBinaryFormat::IsBinaryLog(fp);
+	fclose(fp);
+	return binary;
+}
+
+// Copies one log to another, as condor_convert_job_queue does.
+static bool copy_log(const char * from, const char * to, bool binary,
+	unsigned long & count, bool & torn, std::string & errmsg)
+{
+	FILE * in = safe_fopen_wrapper_follow(from, "rb");
+	FILE * out = safe_fopen_wrapper_follow(to, "wb", 0600);
+	bool ok = in && out &&
+		CopyClassAdLog(in, out, binary, DefaultMakeClassAdLogTableEntry, count, torn, errmsg);
+	if (in) { fclose(in); }
+	if (out) { fclose(out); }
+	return ok;
+}
+
+static bool test_copy_text_to_binary() {
+	emit_test("Test that copying a text log to binary form keeps every ad.");
+	emit_input_header();
+	emit_param("Input", "%s", text_log.c_str());
+	emit_param("Binary", "TRUE");
+	emit_output_expected_header();
+	emit_retval("TRUE");
+	emit_param("Binary file", "TRUE");
+	emit_param("Same ads", "TRUE");
+	emit_output_actual_header();
+	unsigned long count = 0;
+	bool torn = false;
+	std::string errmsg;
+	bool ok = copy_log(text_log.c_str(), binary_log.c_str(), true, count, torn, errmsg);
+	bool binary = is_binary_file(binary_log.c_str());
+	bool same = false;
+	if (ok) {
+		ClassAdCollection expected(NULL, text_log.c_str(), 0);
+		ClassAdCollection actual(NULL, binary_log.c_str(), 0);
+		same = same_ads(expected, actual);
+	}
+	emit_retval("%s", tfstr(ok));
+	emit_param("Binary file", "%s", tfstr(binary));
+	emit_param("Same ads", "%s", tfstr(same));
+	emit_param("Records", "%lu", count);
+	if ( ! ok || ! binary || ! same || torn) {
+		emit_param("Error", "%s", errmsg.c_str());
+		FAIL;
+	}
+	PASS;
+}
+
+static bool test_copy_binary_to_text() {
+	emit_test("Test that copying the binary log back to text gives the "
+		"same ads as the original.");
+	emit_input_header();
+	emit_param("Input", "%s", binary_log.c_str());
+	emit_param("Binary", "FALSE");
+	emit_output_expected_header();
+	emit_retval("TRUE");
+	emit_param("Binary file", "FALSE");
+	emit_param("Same ads", "TRUE");
+	emit_output_actual_header();
+	unsigned long count = 0;
+	bool torn = false;
+	std::string errmsg;
+	bool ok = copy_log(binary_log.c_str(), text_copy.c_str(), false, count, torn, errmsg);
+	bool binary = is_binary_file(text_copy.c_str());
+	bool same = false;
+	if (ok) {
+		ClassAdCollection expected(NULL, text_log.c_str(), 0);
+		ClassAdCollection actual(NULL, text_copy.c_str(), 0);
+		same = same_ads(expected, actual);
+	}
+	emit_retval("%s", tfstr(ok));
+	emit_param("Binary file", "%s", tfstr(binary));
+	emit_param("Same ads", "%s", tfstr(same));
+	if ( ! ok || binary || ! same || torn) {
+		emit_param("Error", "%s", errmsg.c_str());
+		FAIL;
+	}
+	PASS;
+}
+
+static bool test_load_binary() {
+	emit_test("Test that a binary log is loaded as binary, and that its "
+		"literal values have the right types.");
+	emit_input_header();
+	emit_param("Log", "%s", binary_log.c_str());
+	emit_output_expected_header();
+	emit_param("IsBinaryFormat", "TRUE");
+	emit_param("RequestDisk", "-1024");
+	emit_param("Rank", "1.5");
+	emit_param("Owner", "alice");
+	emit_param("Deleted", "FALSE");
+	emit_output_actual_header();
+	ClassAdCollection log(NULL, binary_log.c_str(), 0);
+	ClassAd * ad = NULL;
+	long long disk = 0;
+	double rank = 0;
+	std::string owner;
+	bool found = log.LookupClassAd("1.0", ad);
+	found = found && ad->LookupInteger("RequestDisk", disk);
+	found = found && ad->LookupFloat("Rank", rank);
+	found = found && ad->LookupString("Owner", owner);
+	bool deleted = found && ad->Lookup("Deleted") != NULL;
+	emit_param("IsBinaryFormat", "%s", tfstr(log.IsBinaryFormat()));
+	emit_param("RequestDisk", "%lld", disk);
+	emit_param("Rank", "%g", rank);
+	emit_param("Owner", "%s", owner.c_str());
+	emit_param("Deleted", "%s", tfstr(deleted));
+	if ( ! log.IsBinaryFormat() || ! found || disk != -1024 || fabs(rank - 1.5) > 1e-9 ||
+		owner != "alice" || deleted) {
+		FAIL;
+	}
+	PASS;
+}
+
+static bool test_append_binary() {
+	emit_test("Test that records appended to a binary log are binary and "
+		"are read back.");
+	emit_input_header();
+	emit_param("Log", "%s", binary_log.c_str());
+	emit_param("SetAttribute", "1.0 JobStatus 2");
+	emit_param("SetAttribute", "1.0 NewName \"new\"");
+	emit_output_expected_header();
+	emit_param("Binary file", "TRUE");
+	emit_param("JobStatus", "2");
+	emit_param("NewName", "new");
+	emit_output_actual_header();
+	{
+		ClassAdCollection log(NULL, binary_log.c_str(), 0);
+		log.SetAttribute("1.0", "JobStatus", "2");
+		log.SetAttribute("1.0", "NewName", "\"new\"");
+	}
+	ClassAdCollection log(NULL, binary_log.c_str(), 0);
+	ClassAd * ad = NULL;
+	int status = 0;
+	std::string name;
+	bool found = log.LookupClassAd("1.0", ad) &&
+		ad->LookupInteger("JobStatus", status) && ad->LookupString("NewName", name);
+	bool binary = is_binary_file(binary_log.c_str());
+	emit_param("Binary file", "%s", tfstr(binary));
+	emit_param("JobStatus", "%d", status);
+	emit_param("NewName", "%s", name.c_str());
+	if ( ! binary || ! found || status != 2 || name != "new") {
+		FAIL;
+	}
+	PASS;
+}
+
+static bool test_rotate_text_to_binary() {
+	emit_test("Test that a text log rotated with SetBinaryFormat(true) "
+		"becomes binary and keeps its ads, and that records written after "
+		"the rotation are read back.");
+	emit_input_header();
+	emit_param("Log", "%s", text_copy.c_str());
+	emit_output_expected_header();
+	emit_param("Before", "text");
+	emit_param("After", "binary");
+	emit_param("Same ads", "TRUE");
+	emit_output_actual_header();
+	bool before = is_binary_file(text_copy.c_str());
+	{
+		ClassAdCollection log(NULL, text_copy.c_str(), 0);
+		log.SetBinaryFormat(true);
+		log.TruncLog();
+		log.SetAttribute("1.0", "RotatedTo", "\"binary\"");
+	}
+	bool after = is_binary_file(text_copy.c_str());
+	bool same = false;
+	{
+			// the ads of the original log, plus the one set after the rotation
+		ClassAdCollection actual(NULL, text_copy.c_str(), 0);
+		ClassAd * ad = NULL;
+		std::string rotated;
+		if (actual.LookupClassAd("1.0", ad) && ad->LookupString("RotatedTo", rotated) &&
+			rotated == "binary") {
+			actual.DeleteAttribute("1.0", "RotatedTo");
+			ClassAdCollection expected(NULL, text_log.c_str(), 0);
+			same = same_ads(expected, actual);
+		}
+	}
+	emit_param("Before", "%s", before ? "binary" : "text");
+	emit_param("After", "%s", after ? "binary" : "text");
+	emit_param("Same ads", "%s", tfstr(same));
+	if (before || ! after || ! same) {
+		FAIL;
+	}
+	PASS;
+}
+
+static bool test_rotate_binary_to_text() {
+	emit_test("Test that a binary log rotated with SetBinaryFormat(false) "
+		"becomes text and keeps its ads.");
+	emit_input_header();
+	emit_param("Log", "%s", text_copy.c_str());
+	emit_output_expected_header();
+	emit_param("Before", "binary");
+	emit_param("After", "text");
+	emit_param("Same ads", "TRUE");
+	emit_output_actual_header();
+	bool before = is_binary_file(text_copy.c_str());
+	{
+		ClassAdCollection log(NULL, text_copy.c_str(), 0);
+		log.SetBinaryFormat(false);
+		log.TruncLog();
+		log.SetAttribute("1.0", "RotatedTo", "\"text\"");
+	}
+	bool after = is_binary_file(text_copy.c_str());
+	bool same = false;
+	{
+			// the ads of the original log, plus the one set after the rotation
+		ClassAdCollection actual(NULL, text_copy.c_str(), 0);
+		ClassAd * ad = NULL;
+		std::string rotated;
+		if (actual.LookupClassAd("1.0", ad) && ad->LookupString("RotatedTo", rotated) &&
+			rotated == "text") {
+			actual.DeleteAttribute("1.0", "RotatedTo");
+			ClassAdCollection expected(NULL, text_log.c_str(), 0);
+			same = same_ads(expected, actual);
+		}
+	}
+	emit_param("Before", "%s", before ? "binary" : "text");
+	emit_param("After", "%s", after ? "binary" : "text");
+	emit_param("Same ads", "%s", tfstr(same));
+	if ( ! before || after || ! same) {
+		FAIL;
+	}
+	PASS;
+}
+
+static bool test_copy_torn_binary() {
+	emit_test("Test that an incomplete record at the end of a binary log "
+		"is skipped and reported.");
+	emit_input_header();
+	emit_param("Log", "%s plus a partial record", binary_log.c_str());
+	emit_output_expected_header();
+	emit_retval("TRUE");
+	emit_param("Torn", "TRUE");
+	emit_param("Same record count", "TRUE");
+	emit_output_actual_header();
+	unsigned long count = 0, torn_count = 0;
+	bool torn = false;
+	std::string errmsg;
+	bool ok = copy_log(binary_log.c_str(), text_copy.c_str(), false, count, torn, errmsg);
+	if (ok) {
+		// a record that says it is 100 bytes long, followed by only 3
+		ok = copy_log(binary_log.c_str(), torn_log.c_str(), true, torn_count, torn, errmsg);
+		FILE * fp = safe_fopen_wrapper_follow(torn_log.c_str(), "ab");
+		ok = ok && fp && fwrite("\144abc", 1, 4, fp) == 4;
+		if (fp) { fclose(fp); }
+	}
+	if (ok) {
+		ok = copy_log(torn_log.c_str(), text_copy.c_str(), false, torn_count, torn, errmsg);
+	}
+	emit_retval("%s", tfstr(ok));
+	emit_param("Torn", "%s", tfstr(torn));
+	emit_param("Same record count", "%s", tfstr(count == torn_count));
+	if ( ! ok || ! torn || count != torn_count) {
+		emit_param("Error", "%s", errmsg.c_str());
+		FAIL;
+	}
+	PASS;
+}
+
+static bool test_load_corrupt_binary_tail() {
+	emit_test("Test that a binary log that ends in a torn record, or in a "
+		"record with a length of zero, is loaded up to the bad record and "
+		"can be written to and loaded again.");
+	emit_input_header();
+	emit_param("Log", "%s plus a partial record", binary_log.c_str());
+	emit_param("Log", "%s plus a zero length and more bytes", binary_log.c_str());
+	emit_output_expected_header();
+	emit_param("Same ads", "TRUE, TRUE");
+	emit_param("Appended", "TRUE, TRUE");
+	emit_output_actual_header();
+	const char * tails[] = { "\144abc", "\0\3abc" };
+	const size_t tail_lens[] = { 4, 5 };
+	bool all_same = true, all_appended = true;
+	std::string same_str, appended_str;
+	for (int i = 0; i < 2; ++i) {
+		unsigned long count = 0;
+		bool torn = false;
+		std::string errmsg;
+		bool ok = copy_log(binary_log.c_str(), torn_log.c_str(), true, count, torn, errmsg);
+		FILE * fp = safe_fopen_wrapper_follow(torn_log.c_str(), "ab");
+		ok = ok && fp && fwrite(tails[i], 1, tail_lens[i], fp) == tail_lens[i];
+		if (fp) { fclose(fp); }
+
+		bool same = false, appended = false;
+		if (ok) {
+			{
+				ClassAdCollection actual(NULL, torn_log.c_str(), 0);
+				ClassAdCollection expected(NULL, binary_log.c_str(), 0);
+				same = same_ads(expected, actual);
+				actual.SetAttribute("1.0", "AfterTail", "1");
+			}
+			ClassAdCollection reloaded(NULL, torn_log.c_str(), 0);
+			ClassAd * ad = NULL;
+			int after = 0;
+			appended = reloaded.LookupClassAd("1.0", ad) && ad->LookupInteger("AfterTail", after) && after == 1;
+		}
+		all_same = all_same && same;
+		all_appended = all_appended && appended;
+		same_str += (i ? ", " : ""); same_str += tfstr(same);
+		appended_str += (i ? ", " : ""); appended_str += tfstr(appended);
+	}
+	emit_param("Same ads", "%s", same_str.c_str());
+	emit_param("Appended", "%s", appended_str.c_str());
+	if ( ! all_same || ! all_appended) {
+		FAIL;
+	}
+	PASS;
+}
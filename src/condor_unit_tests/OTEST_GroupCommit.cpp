@@ -0,0 +1,262 @@
+/***************************************************************
+ *
+ * Copyright (C) 1990-2020, Condor Team, Computer Sciences Department,
+ * University of Wisconsin-Madison, WI.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You may
+ * obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************/
+
+/*
+	Test ClassAdLogGroupCommit, the writer thread that syncs the commits
+	of a ClassAdLog in groups, and the group commit of a ClassAdLog.
+ */
+
+#include "condor_common.h"
+#include "condor_debug.h"
+#include "condor_config.h"
+#include "function_test_driver.h"
+#include "unit_test_utils.h"
+#include "emit.h"
+#include "classad_collection.h"
+
+static void setup(void);
+static void cleanup(void);
+static bool test_batch(void);
+static bool test_callback_order(void);
+static bool test_notify(void);
+static bool test_error(void);
+static bool test_log_group_commit(void);
+
+//Global variables
+static std::string data_file, log_file;
+static FILE * data_fp = NULL;
+
+bool OTEST_GroupCommit(void) {
+	emit_object("ClassAdLogGroupCommit");
+	emit_comment("The writer thread behind the group commit of a ClassAdLog. "
+		"Commits are numbered as they are queued and become durable once a "
+		"sync that started after them has finished.");
+
+	FunctionDriver driver;
+	driver.register_function(test_batch);
+	driver.register_function(test_callback_order);
+	driver.register_function(test_notify);
+	driver.register_function(test_error);
+	driver.register_function(test_log_group_commit);
+
+	setup();
+
+	int status = driver.do_all_functions();
+
+	cleanup();
+
+	return status;
+}
+
+static void setup() {
+	formatstr(data_file, "testgroupcommit%d.data", getpid());
+	formatstr(log_file, "testgroupcommit%d.log", getpid());
+	data_fp = safe_fopen_wrapper_follow(data_file.c_str(), "w", 0600);
+	if (data_fp) {
+		fputs("some data\n", data_fp);
+		fflush(data_fp);
+	}
+}
+
+static void cleanup() {
+	if (data_fp) {
+		fclose(data_fp);
+		data_fp = NULL;
+	}
+	remove(data_file.c_str());
+	remove(log_file.c_str());
+}
+
+static bool test_batch() {
+	emit_test("Test that waiting for the last of several queued commits "
+		"makes every one of them durable.");
+	emit_input_header();
+	emit_param("Commits", "5");
+	emit_output_expected_header();
+	emit_retval("TRUE");
+	emit_param("All durable", "TRUE");
+	emit_param("Error", "0");
+	emit_output_actual_header();
+	ClassAdLogGroupCommit gc(data_file.c_str(), -1);
+	unsigned long last = 0;
+	for (int i = 0; i < 5; ++i) {
+		last = gc.Queue(fileno(data_fp));
+	}
+	bool ok = gc.Wait(last);
+	bool all = last == 5 && gc.LastQueued() == 5;
+	for (unsigned long seq = 1; seq <= 5; ++seq) {
+		all = all && gc.IsDurable(seq);
+	}
+	int err = gc.Error();
+	emit_retval("%s", tfstr(ok));
+	emit_param("All durable", "%s", tfstr(all));
+	emit_param("Error", "%d", err);
+	if ( ! ok || ! all || err) {
+		FAIL;
+	}
+	PASS;
+}
+
+static bool test_callback_order() {
+	emit_test("Test that callbacks run in commit order, and in the order "
+		"they were added for the same commit, once it is durable.");
+	emit_input_header();
+	emit_param("Callbacks", "3:c, 1:a, 3:d, 2:b");
+	emit_output_expected_header();
+	emit_param("Before", "");
+	emit_param("After", "abcd");
+	emit_output_actual_header();
+	ClassAdLogGroupCommit gc(data_file.c_str(), -1);
+	std::string order;
+	gc.WhenDurable(3, [&order]() { order += "c"; });
+	gc.WhenDurable(1, [&order]() { order += "a"; });
+	gc.WhenDurable(3, [&order]() { order += "d"; });
+	gc.WhenDurable(2, [&order]() { order += "b"; });
+	std::string before = order;
+	unsigned long last = 0;
+	for (int i = 0; i < 3; ++i) {
+		last = gc.Queue(fileno(data_fp));
+	}
+	gc.Wait(last);
+	emit_param("Before", "%s", before.c_str());
+	emit_param("After", "%s", order.c_str());
+	if ( ! before.empty() || order != "abcd") {
+		FAIL;
+	}
+	PASS;
+}
+
+static bool test_notify() {
+	emit_test("Test that the notify pipe is written after a sync and that "
+		"callbacks wait for RunCallbacks().");
+	emit_input_header();
+	emit_param("Callbacks", "2");
+	emit_output_expected_header();
+	emit_param("Run before", "0");
+	emit_param("RunCallbacks", "2");
+	emit_param("Immediate", "TRUE");
+	emit_output_actual_header();
+	int fds[2];
+	if (pipe(fds) < 0) {
+		emit_alert("pipe() failed");
+		FAIL;
+	}
+	int run = 0;
+	int ran = 0;
+	bool immediate = false;
+	{
+		ClassAdLogGroupCommit gc(data_file.c_str(), fds[1]);
+		unsigned long seq = gc.Queue(fileno(data_fp));
+		gc.WhenDurable(seq, [&run]() { ++run; });
+		gc.WhenDurable(seq, [&run]() { ++run; });
+		char c;
+		while ( ! gc.IsDurable(seq)) {
+			if (read(fds[0], &c, 1) < 0 && errno != EINTR) {
+				break;
+			}
+		}
+		int run_before = run;
+		ran = gc.RunCallbacks();
+		emit_param("Run before", "%d", run_before);
+		if (run_before != 0) { ran = -1; }
+			// already durable, so it runs right away
+		gc.WhenDurable(seq, [&immediate]() { immediate = true; });
+	}
+	close(fds[0]);
+	close(fds[1]);
+	emit_param("RunCallbacks", "%d", ran);
+	emit_param("Immediate", "%s", tfstr(immediate));
+	if (ran != 2 || run != 2 || ! immediate) {
+		FAIL;
+	}
+	PASS;
+}
+
+static bool test_error() {
+	emit_test("Test that a failed sync is reported by Error() and Wait() "
+		"and that the callbacks of its commits never run.");
+	emit_input_header();
+	emit_param("fd", "-1");
+	emit_output_expected_header();
+	emit_retval("FALSE");
+	emit_param("Error", "%d", EBADF);
+	emit_param("Callback run", "FALSE");
+	emit_param("Later commit durable", "FALSE");
+	emit_output_actual_header();
+	ClassAdLogGroupCommit gc(data_file.c_str(), -1);
+	bool run = false;
+	unsigned long seq = gc.Queue(-1);
+	gc.WhenDurable(seq, [&run]() { run = true; });
+	bool ok = gc.Wait(seq);
+	int err = gc.Error();
+	unsigned long later = gc.Queue(fileno(data_fp));
+	bool later_ok = gc.Wait(later);
+	gc.RunCallbacks();
+	emit_retval("%s", tfstr(ok));
+	emit_param("Error", "%d", err);
+	emit_param("Callback run", "%s", tfstr(run));
+	emit_param("Later commit durable", "%s", tfstr(later_ok || gc.IsDurable(later)));
+	if (ok || err != EBADF || run || later_ok || gc.IsDurable(later)) {
+		FAIL;
+	}
+	PASS;
+}
+
+static bool test_log_group_commit() {
+	emit_test("Test that transactions committed with group commit on are "
+		"on disk after WaitForCommit() and that WhenCommitted() callbacks run.");
+	emit_input_header();
+	emit_param("Transactions", "3");
+	emit_output_expected_header();
+	emit_param("Callbacks", "3");
+	emit_param("Pending", "FALSE");
+	emit_param("Reloaded ads", "3");
+	emit_output_actual_header();
+	int callbacks = 0;
+	bool pending = true;
+	{
+		ClassAdCollection log(NULL, log_file.c_str(), 0);
+		log.SetGroupCommit(true);
+		for (int i = 1; i <= 3; ++i) {
+			std::string key;
+			formatstr(key, "%d.0", i);
+			log.BeginTransaction();
+			log.NewClassAd(key.c_str(), "Job", "Machine");
+			log.SetAttribute(key.c_str(), "ClusterId", std::to_string(i).c_str());
+			log.CommitTransaction();
+			log.WhenCommitted([&callbacks]() { ++callbacks; });
+		}
+		log.WaitForCommit();
+		pending = log.CommitPending();
+	}
+	ClassAdCollection reloaded(NULL, log_file.c_str(), 0);
+	int count = 0;
+	ClassAd *ad;
+	reloaded.StartIterateAllClassAds();
+	while (reloaded.IterateAllClassAds(ad)) {
+		++count;
+	}
+	emit_param("Callbacks", "%d", callbacks);
+	emit_param("Pending", "%s", tfstr(pending));
+	emit_param("Reloaded ads", "%d", count);
+	if (callbacks != 3 || pending || count != 3) {
+		FAIL;
+	}
+	PASS;
+}
@@ -44,6 +44,8 @@ static bool insertlookup_normal(void);
 static bool insertlookup_collision(void);
 static bool test_walk_normal(void);
 static bool test_walk_failed(void);
+static bool test_walk_callable_all(void);
+static bool test_walk_callable_stop(void);
 static bool test_iterate_first(void);
 static bool test_get_current_key(void);
 static bool test_iterate_other(void);
@@ -76,6 +78,8 @@ bool OTEST_HashTable(void) {
 	driver.register_function(insertlookup_collision);
 	driver.register_function(test_walk_normal);
 	driver.register_function(test_walk_failed);
+	driver.register_function(test_walk_callable_all);
+	driver.register_function(test_walk_callable_stop);
 	driver.register_function(test_iterate_first);
 	driver.register_function(test_get_current_key);
 	driver.register_function(test_iterate_other);
@@ -176,6 +180,52 @@ static bool test_walk_failed() {
 	PASS;
 }
 
+static bool test_walk_callable_all() {
+	emit_test("Test walk() with a callable that visits every value");
+	emit_input_header();
+	emit_param("walkFunc", "lambda that sums the values and returns true");
+	emit_output_expected_header();
+	emit_retval("%s", tfstr(1));
+	emit_param("Visited", "%d", 3);
+	emit_param("Sum", "%d", 37 + 197 + 42);
+	emit_output_actual_header();
+	int visited = 0;
+	int sum = 0;
+	int result = table->walk([&](int value) {
+		visited++;
+		sum += value;
+		return true;
+	});
+	emit_retval("%s", tfstr(result));
+	emit_param("Visited", "%d", visited);
+	emit_param("Sum", "%d", sum);
+	if(result != 1 || visited != 3 || sum != 37 + 197 + 42) {
+		FAIL;
+	}
+	PASS;
+}
+
+static bool test_walk_callable_stop() {
+	emit_test("Test walk() with a callable that stops the walk early");
+	emit_input_header();
+	emit_param("walkFunc", "lambda that returns false on the first value");
+	emit_output_expected_header();
+	emit_retval("%s", tfstr(0));
+	emit_param("Visited", "%d", 1);
+	emit_output_actual_header();
+	int visited = 0;
+	int result = table->walk([&](int /*value*/) {
+		visited++;
+		return false;
+	});
+	emit_retval("%s", tfstr(result));
+	emit_param("Visited", "%d", visited);
+	if(result != 0 || visited != 1) {
+		FAIL;
+	}
+	PASS;
+}
+
 static bool test_iterate_first() {
 	emit_test("Test iterate() and make sure its first Index/Value are correct");
 	table->startIterations();
@@ -0,0 +1,381 @@
+/***************************************************************
+ *
+ * Copyright (C) 1990-2020, Condor Team, Computer Sciences Department,
+ * University of Wisconsin-Madison, WI.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You may
+ * obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************/
+
+/*
+	Test reading a history file in chunks of whole ads, and scanning them
+	on several threads, against a scan of the whole file on one thread.
+ */
+
+#include "condor_common.h"
+#include "condor_debug.h"
+#include "condor_config.h"
+#include "condor_attributes.h"
+#include "condor_classad.h"
+#include "function_test_driver.h"
+#include "unit_test_utils.h"
+#include "emit.h"
+#include "historyFileFinder.h"
+
+static void setup(void);
+static void cleanup(void);
+static bool test_chunks_forward(void);
+static bool test_chunks_backward(void);
+static bool test_chunks_smaller_than_ads(void);
+static bool test_scan_forward(void);
+static bool test_scan_backward(void);
+static bool test_scan_since(void);
+static bool test_scan_match_limit(void);
+
+//Global variables
+static std::string history_file, history_text;
+static const int num_ads = 30;
+static const int malformed_ad = 17;
+static const long small_chunk = 64;
+
+bool OTEST_HistoryChunkReader(void) {
+	emit_object("HistoryChunkReader");
+	emit_comment("The reader that splits a history file into chunks of whole "
+		"ads for condor_history to scan on HISTORY_SCAN_THREADS threads, and "
+		"scanHistoryFile(), which hands back the scanned ads in file order.");
+
+	FunctionDriver driver;
+	driver.register_function(test_chunks_forward);
+	driver.register_function(test_chunks_backward);
+	driver.register_function(test_chunks_smaller_than_ads);
+	driver.register_function(test_scan_forward);
+	driver.register_function(test_scan_backward);
+	driver.register_function(test_scan_since);
+	driver.register_function(test_scan_match_limit);
+
+	setup();
+
+	int status = driver.do_all_functions();
+
+	cleanup();
+
+	return status;
+}
+
+/*
+	Writes a history file of ads of different sizes, all of them bigger
+	than small_chunk, with one malformed ad, followed by an ad that has no
+	banner yet, as when the schedd is still writing it.
+ */
+static void setup() {
+	formatstr(history_file, "testhistorychunks%d", getpid());
+	history_text.clear();
+	for (int i = 1; i <= num_ads; ++i) {
+		formatstr_cat(history_text, "ClusterId = %d\nProcId = 0\nOwner = \"user%d\"\n", i, i % 4);
+		if (i == malformed_ad) {
+			history_text += "Bad = = 1\n";
+		}
+		formatstr_cat(history_text, "Blob = \"%s\"\n", std::string(i * 7, 'x').c_str());
+		formatstr_cat(history_text, "*** ClusterId=%d ProcId=0 Owner=\"user%d\"\n", i, i % 4);
+	}
+	FILE * fp = safe_fopen_wrapper_follow(history_file.c_str(), "w");
+	if (fp) {
+		fputs(history_text.c_str(), fp);
+		fputs("ClusterId = 99\nProcId = 0\n", fp);
+		fclose(fp);
+	}
+}
+
+static void cleanup() {
+	remove(history_file.c_str());
+}
+
+static long file_size() {
+	struct stat st;
+	if (stat(history_file.c_str(), &st) < 0) {
+		return -1;
+	}
+	return (long)st.st_size;
+}
+
+// Read all of the chunks of the history file, in the order they are read.
+static void read_chunks(bool backwards, long chunk_size, std::vector<std::string> & chunks) {
+	chunks.clear();
+	FILE * fp = safe_fopen_wrapper_follow(history_file.c_str(), "r");
+	if ( ! fp) {
+		return;
+	}
+	HistoryChunkReader reader(fp, file_size(), backwards, chunk_size);
+	std::string text;
+	while (reader.Next(text)) {
+		chunks.push_back(text);
+	}
+	fclose(fp);
+}
+
+// Returns true if each chunk ends with a whole banner line.
+static bool chunks_end_with_banner(const std::vector<std::string> & chunks) {
+	for (auto it = chunks.begin(); it != chunks.end(); ++it) {
+		if (it->empty() || (*it)[it->size() - 1] != '\n') {
+			return false;
+		}
+		size_t pos = it->rfind('\n', it->size() - 2);
+		pos = (pos == std::string::npos) ? 0 : pos + 1;
+		if (it->compare(pos, 4, "*** ") != 0) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// One word per ad scanned: its ClusterId if it matched, - if it did not,
+// S if the since expression was true for it, and ! if it was malformed.
+static void append_result(std::string & out, const HistoryScanResult & res) {
+	if ( ! out.empty()) {
+		out += " ";
+	}
+	if (res.malformed) {
+		out += "!";
+	} else if (res.since) {
+		out += "S";
+	} else if (res.ad) {
+		int cluster = -1;
+		res.ad->EvaluateAttrInt(ATTR_CLUSTER_ID, cluster);
+		formatstr_cat(out, "%d", cluster);
+	} else {
+		out += "-";
+	}
+}
+
+// Counts matches as condor_history does for -match.
+static bool take_result(std::string & out, int & matches, int match_limit, const HistoryScanResult & res) {
+	append_result(out, res);
+	if (res.ad && ! res.malformed && ! res.since) {
+		++matches;
+	}
+	return ! (match_limit > 0 && matches >= match_limit);
+}
+
+// Scan all of the history file as one chunk on this thread.
+static std::string scan_sequential(bool backwards, const char * constraint, const char * since, int match_limit) {
+	classad::ExprTree * cons = NULL;
+	classad::ExprTree * since_expr = NULL;
+	if (constraint) ParseClassAdRvalExpr(constraint, cons);
+	if (since) ParseClassAdRvalExpr(since, since_expr);
+	HistoryChunk whole;
+	whole.text = history_text;
+	scanHistoryChunk(&whole, cons, since_expr);
+	delete cons;
+	delete since_expr;
+
+	std::string out;
+	int matches = 0;
+	size_t count = whole.results.size();
+	for (size_t i = 0; i < count; ++i) {
+		const HistoryScanResult & res = whole.results[backwards ? count - 1 - i : i];
+		if ( ! take_result(out, matches, match_limit, res)) {
+			break;
+		}
+	}
+	return out;
+}
+
+// Scan the history file in small chunks on several threads.
+static std::string scan_threaded(bool backwards, const char * constraint, const char * since, int match_limit, int & calls_after_stop) {
+	classad::ExprTree * cons = NULL;
+	classad::ExprTree * since_expr = NULL;
+	if (constraint) ParseClassAdRvalExpr(constraint, cons);
+	if (since) ParseClassAdRvalExpr(since, since_expr);
+	std::string out;
+	int matches = 0;
+	bool stopped = false;
+	calls_after_stop = 0;
+	FILE * fp = safe_fopen_wrapper_follow(history_file.c_str(), "r");
+	if (fp) {
+		scanHistoryFile(fp, file_size(), backwards, 4, cons, since_expr,
+			[&](HistoryScanResult & res) -> bool {
+				if (stopped) {
+					++calls_after_stop;
+					return false;
+				}
+				stopped = ! take_result(out, matches, match_limit, res);
+				return ! stopped;
+			}, small_chunk);
+		fclose(fp);
+	}
+	delete cons;
+	delete since_expr;
+	return out;
+}
+
+static bool test_chunks_forward() {
+	emit_test("Test that reading forwards gives chunks of whole ads that "
+		"make up the file up to the last banner line.");
+	emit_input_header();
+	emit_param("Chunk size", "%ld", small_chunk);
+	emit_output_expected_header();
+	emit_param("Chunks", "more than 1");
+	emit_param("Same text", "TRUE");
+	emit_param("End with banner", "TRUE");
+	std::vector<std::string> chunks;
+	read_chunks(false, small_chunk, chunks);
+	std::string text;
+	for (auto it = chunks.begin(); it != chunks.end(); ++it) {
+		text += *it;
+	}
+	bool same = text == history_text;
+	bool banners = chunks_end_with_banner(chunks);
+	emit_output_actual_header();
+	emit_param("Chunks", "%d", (int)chunks.size());
+	emit_param("Same text", "%s", tfstr(same));
+	emit_param("End with banner", "%s", tfstr(banners));
+	if (chunks.size() < 2 || ! same || ! banners) {
+		FAIL;
+	}
+	PASS;
+}
+
+static bool test_chunks_backward() {
+	emit_test("Test that reading backwards gives the same chunks of whole "
+		"ads, the last one first, leaving out the ad with no banner.");
+	emit_input_header();
+	emit_param("Chunk size", "%ld", small_chunk);
+	emit_output_expected_header();
+	emit_param("Chunks", "more than 1");
+	emit_param("Same text", "TRUE");
+	emit_param("End with banner", "TRUE");
+	std::vector<std::string> chunks;
+	read_chunks(true, small_chunk, chunks);
+	std::string text;
+	for (auto it = chunks.rbegin(); it != chunks.rend(); ++it) {
+		text += *it;
+	}
+	bool same = text == history_text;
+	bool banners = chunks_end_with_banner(chunks);
+	emit_output_actual_header();
+	emit_param("Chunks", "%d", (int)chunks.size());
+	emit_param("Same text", "%s", tfstr(same));
+	emit_param("End with banner", "%s", tfstr(banners));
+	if (chunks.size() < 2 || ! same || ! banners) {
+		FAIL;
+	}
+	PASS;
+}
+
+static bool test_chunks_smaller_than_ads() {
+	emit_test("Test that an ad that straddles the chunk size is not split, "
+		"so scanning each chunk finds every ad once.");
+	emit_input_header();
+	emit_param("Chunk size", "8");
+	emit_output_expected_header();
+	emit_param("Forward ads", "%d", num_ads);
+	emit_param("Backward ads", "%d", num_ads);
+	int found[2] = { 0, 0 };
+	for (int backwards = 0; backwards < 2; ++backwards) {
+		std::vector<std::string> chunks;
+		read_chunks(backwards != 0, 8, chunks);
+		for (auto it = chunks.begin(); it != chunks.end(); ++it) {
+			HistoryChunk chunk;
+			chunk.text = *it;
+			scanHistoryChunk(&chunk, NULL, NULL);
+			found[backwards] += (int)chunk.results.size();
+		}
+	}
+	emit_output_actual_header();
+	emit_param("Forward ads", "%d", found[0]);
+	emit_param("Backward ads", "%d", found[1]);
+	if (found[0] != num_ads || found[1] != num_ads) {
+		FAIL;
+	}
+	PASS;
+}
+
+static bool test_scan_forward() {
+	emit_test("Test that scanning forwards on several threads finds the same "
+		"ads in the same order as scanning the whole file on one thread.");
+	const char * constraint = "ClusterId % 3 == 0";
+	std::string expected = scan_sequential(false, constraint, NULL, 0);
+	emit_input_header();
+	emit_param("Constraint", "%s", constraint);
+	emit_output_expected_header();
+	emit_param("Ads", "%s", expected.c_str());
+	int calls_after_stop = 0;
+	std::string actual = scan_threaded(false, constraint, NULL, 0, calls_after_stop);
+	emit_output_actual_header();
+	emit_param("Ads", "%s", actual.c_str());
+	if (actual != expected || expected.find('!') == std::string::npos) {
+		FAIL;
+	}
+	PASS;
+}
+
+static bool test_scan_backward() {
+	emit_test("Test that scanning backwards on several threads finds the same "
+		"ads in the same order as scanning the whole file on one thread.");
+	const char * constraint = "Owner == \"user1\"";
+	std::string expected = scan_sequential(true, constraint, NULL, 0);
+	emit_input_header();
+	emit_param("Constraint", "%s", constraint);
+	emit_output_expected_header();
+	emit_param("Ads", "%s", expected.c_str());
+	int calls_after_stop = 0;
+	std::string actual = scan_threaded(true, constraint, NULL, 0, calls_after_stop);
+	emit_output_actual_header();
+	emit_param("Ads", "%s", actual.c_str());
+	if (actual != expected || expected.compare(0, 4, "- 29") != 0) {
+		FAIL;
+	}
+	PASS;
+}
+
+static bool test_scan_since() {
+	emit_test("Test that the since expression is true for the same ad when "
+		"scanning backwards on several threads.");
+	const char * since = "ClusterId == 12";
+	std::string expected = scan_sequential(true, NULL, since, 0);
+	emit_input_header();
+	emit_param("Since", "%s", since);
+	emit_output_expected_header();
+	emit_param("Ads", "%s", expected.c_str());
+	int calls_after_stop = 0;
+	std::string actual = scan_threaded(true, NULL, since, 0, calls_after_stop);
+	emit_output_actual_header();
+	emit_param("Ads", "%s", actual.c_str());
+	if (actual != expected || expected.find("13 S 11") == std::string::npos) {
+		FAIL;
+	}
+	PASS;
+}
+
+static bool test_scan_match_limit() {
+	emit_test("Test that a scan on several threads stops at the same ad as "
+		"one on one thread when the callback stops it, as -match does.");
+	const char * constraint = "ClusterId % 2 == 0";
+	int limit = 5;
+	std::string expected = scan_sequential(true, constraint, NULL, limit);
+	emit_input_header();
+	emit_param("Constraint", "%s", constraint);
+	emit_param("Match", "%d", limit);
+	emit_output_expected_header();
+	emit_param("Ads", "%s", expected.c_str());
+	emit_param("Calls after stop", "0");
+	int calls_after_stop = 0;
+	std::string actual = scan_threaded(true, constraint, NULL, limit, calls_after_stop);
+	emit_output_actual_header();
+	emit_param("Ads", "%s", actual.c_str());
+	emit_param("Calls after stop", "%d", calls_after_stop);
+	if (actual != expected || calls_after_stop != 0 || expected.find("22") == std::string::npos) {
+		FAIL;
+	}
+	PASS;
+}
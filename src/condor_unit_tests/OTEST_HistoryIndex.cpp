@@ -0,0 +1,456 @@
+/***************************************************************
+ *
+ * Copyright (C) 1990-2020, Condor Team, Computer Sciences Department,
+ * University of Wisconsin-Madison, WI.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You may
+ * obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************/
+
+/*
+	Test reading the index that is kept beside a history file, and the
+	evaluation of condor_history constraints against it.
+ */
+
+#include "condor_common.h"
+#include "condor_debug.h"
+#include "condor_config.h"
+#include "condor_classad.h"
+#include "function_test_driver.h"
+#include "unit_test_utils.h"
+#include "emit.h"
+#include "historyFileFinder.h"
+
+static void setup(void);
+static void cleanup(void);
+static bool test_read_index(void);
+static bool test_read_index_missing(void);
+static bool test_read_index_gap(void);
+static bool test_read_index_stale(void);
+static bool test_read_index_not_from_top(void);
+static bool test_read_index_malformed(void);
+static bool test_eval_cluster_id(void);
+static bool test_eval_proc_id(void);
+static bool test_eval_completion_date(void);
+static bool test_eval_literal_on_left(void);
+static bool test_eval_owner_equal(void);
+static bool test_eval_owner_meta_equal(void);
+static bool test_eval_owner_not_equal(void);
+static bool test_eval_owner_unknown(void);
+static bool test_eval_unknown_value(void);
+static bool test_eval_other_attr(void);
+static bool test_eval_and(void);
+static bool test_eval_or(void);
+
+//Global variables
+static std::string history_file, history_text;
+static std::vector<HistoryIndexRec> index_recs;
+
+bool OTEST_HistoryIndex(void) {
+	emit_object("HistoryIndex");
+	emit_comment("The index kept beside a history file when "
+		"ENABLE_HISTORY_INDEX is true, that condor_history uses to skip ads "
+		"that cannot match its constraint.");
+
+	FunctionDriver driver;
+	driver.register_function(test_read_index);
+	driver.register_function(test_read_index_missing);
+	driver.register_function(test_read_index_gap);
+	driver.register_function(test_read_index_stale);
+	driver.register_function(test_read_index_not_from_top);
+	driver.register_function(test_read_index_malformed);
+	driver.register_function(test_eval_cluster_id);
+	driver.register_function(test_eval_proc_id);
+	driver.register_function(test_eval_completion_date);
+	driver.register_function(test_eval_literal_on_left);
+	driver.register_function(test_eval_owner_equal);
+	driver.register_function(test_eval_owner_meta_equal);
+	driver.register_function(test_eval_owner_not_equal);
+	driver.register_function(test_eval_owner_unknown);
+	driver.register_function(test_eval_unknown_value);
+	driver.register_function(test_eval_other_attr);
+	driver.register_function(test_eval_and);
+	driver.register_function(test_eval_or);
+
+	setup();
+
+	int status = driver.do_all_functions();
+
+	cleanup();
+
+	return status;
+}
+
+static void write_file(const std::string & name, const std::string & text) {
+	FILE * fp = safe_fopen_wrapper_follow(name.c_str(), "w");
+	if (fp) {
+		fputs(text.c_str(), fp);
+		fclose(fp);
+	}
+}
+
+static void write_index(const std::vector<HistoryIndexRec> & recs) {
+	std::string index_file, text;
+	historyIndexFileName(history_file.c_str(), index_file);
+	for (auto it = recs.begin(); it != recs.end(); ++it) {
+		formatstr_cat(text, "%ld %ld %d %d %d %s\n", it->offset, it->end,
+			it->cluster, it->proc, it->completion, it->owner.c_str());
+	}
+	write_file(index_file, text);
+}
+
+static void append_ad(int cluster, int proc, int completion, const char * owner) {
+	HistoryIndexRec rec;
+	rec.offset = (long)history_text.size();
+	formatstr_cat(history_text, "ClusterId = %d\nProcId = %d\nCompletionDate = %d\nOwner = \"%s\"\n",
+		cluster, proc, completion, owner);
+	formatstr_cat(history_text, "*** ClusterId=%d ProcId=%d Owner=\"%s\" CompletionDate=%d\n",
+		cluster, proc, owner, completion);
+	rec.end = (long)history_text.size();
+	rec.cluster = cluster;
+	rec.proc = proc;
+	rec.completion = completion;
+	rec.owner = owner;
+	index_recs.push_back(rec);
+}
+
+/*
+	Writes a history file of three ads and an index that matches it.
+ */
+static void setup() {
+	formatstr(history_file, "testhistory%d", getpid());
+	history_text.clear();
+	index_recs.clear();
+	append_ad(100, 0, 1600000000, "alice");
+	append_ad(100, 1, 1600000100, "Alice");
+	append_ad(101, 0, 1600000200, "bob");
+	write_file(history_file, history_text);
+	write_index(index_recs);
+}
+
+static void cleanup() {
+	std::string index_file;
+	historyIndexFileName(history_file.c_str(), index_file);
+	remove(history_file.c_str());
+	remove(index_file.c_str());
+}
+
+static bool test_read_index() {
+	emit_test("Test that readHistoryIndex() reads an index that describes "
+		"every ad in the history file.");
+	emit_input_header();
+	emit_param("Ads", "%d", (int)index_recs.size());
+	emit_output_expected_header();
+	emit_retval("true, 3 ads, the second is 100.1 of Alice");
+	std::vector<HistoryIndexRec> recs;
+	bool ok = readHistoryIndex(history_file.c_str(), recs);
+	emit_output_actual_header();
+	emit_retval("%s, %d ads", tfstr(ok), (int)recs.size());
+	if ( ! ok || recs.size() != 3) {
+		FAIL;
+	}
+	emit_retval("the second is %d.%d of %s", recs[1].cluster, recs[1].proc, recs[1].owner.c_str());
+	if (recs[1].offset != index_recs[1].offset || recs[1].end != index_recs[1].end ||
+		recs[1].cluster != 100 || recs[1].proc != 1 || recs[1].completion != 1600000100 ||
+		recs[1].owner != "Alice") {
+		FAIL;
+	}
+	PASS;
+}
+
+// Returns the result of readHistoryIndex() after writing recs as the index,
+// then puts back the index that matches the history file.
+static bool read_modified_index(const std::vector<HistoryIndexRec> & recs, size_t & count) {
+	write_index(recs);
+	std::vector<HistoryIndexRec> read;
+	bool ok = readHistoryIndex(history_file.c_str(), read);
+	count = read.size();
+	write_index(index_recs);
+	return ok;
+}
+
+static bool test_read_index_missing() {
+	emit_test("Test that readHistoryIndex() returns false when the history "
+		"file has no index.");
+	std::string index_file;
+	historyIndexFileName(history_file.c_str(), index_file);
+	emit_input_header();
+	emit_param("Index", "%s (removed)", index_file.c_str());
+	emit_output_expected_header();
+	emit_retval("false");
+	remove(index_file.c_str());
+	std::vector<HistoryIndexRec> recs;
+	bool ok = readHistoryIndex(history_file.c_str(), recs);
+	write_index(index_recs);
+	emit_output_actual_header();
+	emit_retval("%s", tfstr(ok));
+	if (ok) {
+		FAIL;
+	}
+	PASS;
+}
+
+static bool test_read_index_gap() {
+	emit_test("Test that readHistoryIndex() returns false and no ads when the "
+		"index skips an ad.");
+	std::vector<HistoryIndexRec> recs(index_recs);
+	recs.erase(recs.begin() + 1);
+	emit_input_header();
+	emit_param("Index", "the first and third ads");
+	emit_output_expected_header();
+	emit_retval("false, 0 ads");
+	size_t count = 0;
+	bool ok = read_modified_index(recs, count);
+	emit_output_actual_header();
+	emit_retval("%s, %d ads", tfstr(ok), (int)count);
+	if (ok || count) {
+		FAIL;
+	}
+	PASS;
+}
+
+static bool test_read_index_stale() {
+	emit_test("Test that readHistoryIndex() returns false when the index stops "
+		"short of the end of the history file.");
+	std::vector<HistoryIndexRec> recs(index_recs);
+	recs.pop_back();
+	emit_input_header();
+	emit_param("Index", "the first two of three ads");
+	emit_output_expected_header();
+	emit_retval("false, 0 ads");
+	size_t count = 0;
+	bool ok = read_modified_index(recs, count);
+	emit_output_actual_header();
+	emit_retval("%s, %d ads", tfstr(ok), (int)count);
+	if (ok || count) {
+		FAIL;
+	}
+	PASS;
+}
+
+static bool test_read_index_not_from_top() {
+	emit_test("Test that readHistoryIndex() returns false when the index does "
+		"not start at the top of the history file.");
+	std::vector<HistoryIndexRec> recs(index_recs);
+	recs.erase(recs.begin());
+	emit_input_header();
+	emit_param("Index", "the last two of three ads");
+	emit_output_expected_header();
+	emit_retval("false, 0 ads");
+	size_t count = 0;
+	bool ok = read_modified_index(recs, count);
+	emit_output_actual_header();
+	emit_retval("%s, %d ads", tfstr(ok), (int)count);
+	if (ok || count) {
+		FAIL;
+	}
+	PASS;
+}
+
+static bool test_read_index_malformed() {
+	emit_test("Test that readHistoryIndex() returns false when a line of the "
+		"index is missing a field.");
+	std::string index_file, text;
+	historyIndexFileName(history_file.c_str(), index_file);
+	formatstr(text, "%ld %ld 100 0 alice\n", index_recs[0].offset, index_recs[0].end);
+	emit_input_header();
+	emit_param("Index", "%s", text.c_str());
+	emit_output_expected_header();
+	emit_retval("false");
+	write_file(index_file, text);
+	std::vector<HistoryIndexRec> recs;
+	bool ok = readHistoryIndex(history_file.c_str(), recs);
+	write_index(index_recs);
+	emit_output_actual_header();
+	emit_retval("%s", tfstr(ok));
+	if (ok) {
+		FAIL;
+	}
+	PASS;
+}
+
+static const char * index_result_name(int result) {
+	switch (result) {
+	case HISTORY_INDEX_FALSE: return "HISTORY_INDEX_FALSE";
+	case HISTORY_INDEX_TRUE: return "HISTORY_INDEX_TRUE";
+	case HISTORY_INDEX_UNKNOWN: return "HISTORY_INDEX_UNKNOWN";
+	}
+	return "?";
+}
+
+// Returns true if each of the constraints evaluates to the expected result
+// for the given ad of the index.
+static bool check_eval(const HistoryIndexRec & rec, const char * const constraints[], const int expected[], int count) {
+	emit_input_header();
+	emit_param("Ad", "%d.%d CompletionDate=%d Owner=%s", rec.cluster, rec.proc, rec.completion, rec.owner.c_str());
+	bool ok = true;
+	for (int ii = 0; ii < count; ++ii) {
+		classad::ExprTree * tree = NULL;
+		int result = -1;
+		if (ParseClassAdRvalExpr(constraints[ii], tree) == 0) {
+			result = evalOnHistoryIndex(tree, rec);
+		}
+		delete tree;
+		emit_param("Constraint", "%s", constraints[ii]);
+		emit_retval("expected %s, got %s", index_result_name(expected[ii]), index_result_name(result));
+		if (result != expected[ii]) {
+			ok = false;
+		}
+	}
+	return ok;
+}
+
+static bool test_eval_cluster_id() {
+	emit_test("Test that evalOnHistoryIndex() compares ClusterId to a number.");
+	const char * const constraints[] = { "ClusterId == 100", "ClusterId == 101", "ClusterId != 101",
+		"ClusterId < 101", "ClusterId <= 99", "ClusterId > 99", "ClusterId >= 101", "clusterid =?= 100" };
+	const int expected[] = { HISTORY_INDEX_TRUE, HISTORY_INDEX_FALSE, HISTORY_INDEX_TRUE,
+		HISTORY_INDEX_TRUE, HISTORY_INDEX_FALSE, HISTORY_INDEX_TRUE, HISTORY_INDEX_FALSE, HISTORY_INDEX_TRUE };
+	if ( ! check_eval(index_recs[1], constraints, expected, (int)COUNTOF(expected))) {
+		FAIL;
+	}
+	PASS;
+}
+
+static bool test_eval_proc_id() {
+	emit_test("Test that evalOnHistoryIndex() compares ProcId to a number.");
+	const char * const constraints[] = { "ProcId == 1", "ProcId == 0", "ProcId > 0", "ProcId =!= 1" };
+	const int expected[] = { HISTORY_INDEX_TRUE, HISTORY_INDEX_FALSE, HISTORY_INDEX_TRUE, HISTORY_INDEX_FALSE };
+	if ( ! check_eval(index_recs[1], constraints, expected, (int)COUNTOF(expected))) {
+		FAIL;
+	}
+	PASS;
+}
+
+static bool test_eval_completion_date() {
+	emit_test("Test that evalOnHistoryIndex() compares CompletionDate to a number.");
+	const char * const constraints[] = { "CompletionDate > 1600000000", "CompletionDate > 1600000100",
+		"CompletionDate >= 1600000100", "CompletionDate < 1600000000" };
+	const int expected[] = { HISTORY_INDEX_TRUE, HISTORY_INDEX_FALSE, HISTORY_INDEX_TRUE, HISTORY_INDEX_FALSE };
+	if ( ! check_eval(index_recs[1], constraints, expected, (int)COUNTOF(expected))) {
+		FAIL;
+	}
+	PASS;
+}
+
+static bool test_eval_literal_on_left() {
+	emit_test("Test that evalOnHistoryIndex() turns a comparison around when "
+		"the number is on the left.");
+	const char * const constraints[] = { "99 < ClusterId", "101 < ClusterId", "100 >= ClusterId", "(1600000200 > CompletionDate)" };
+	const int expected[] = { HISTORY_INDEX_TRUE, HISTORY_INDEX_FALSE, HISTORY_INDEX_TRUE, HISTORY_INDEX_TRUE };
+	if ( ! check_eval(index_recs[1], constraints, expected, (int)COUNTOF(expected))) {
+		FAIL;
+	}
+	PASS;
+}
+
+static bool test_eval_owner_equal() {
+	emit_test("Test that evalOnHistoryIndex() ignores case when comparing "
+		"Owner with ==, as the ClassAd would.");
+	const char * const constraints[] = { "Owner == \"alice\"", "Owner == \"ALICE\"", "Owner == \"bob\"", "\"alice\" == Owner" };
+	const int expected[] = { HISTORY_INDEX_TRUE, HISTORY_INDEX_TRUE, HISTORY_INDEX_FALSE, HISTORY_INDEX_TRUE };
+	if ( ! check_eval(index_recs[1], constraints, expected, (int)COUNTOF(expected))) {
+		FAIL;
+	}
+	PASS;
+}
+
+static bool test_eval_owner_meta_equal() {
+	emit_test("Test that evalOnHistoryIndex() does not ignore case when "
+		"comparing Owner with =?=, as the ClassAd would.");
+	const char * const constraints[] = { "Owner =?= \"Alice\"", "Owner =?= \"alice\"", "Owner =!= \"alice\"" };
+	const int expected[] = { HISTORY_INDEX_TRUE, HISTORY_INDEX_FALSE, HISTORY_INDEX_TRUE };
+	if ( ! check_eval(index_recs[1], constraints, expected, (int)COUNTOF(expected))) {
+		FAIL;
+	}
+	PASS;
+}
+
+static bool test_eval_owner_not_equal() {
+	emit_test("Test that evalOnHistoryIndex() ignores case when comparing "
+		"Owner with !=, and does not try to order owners.");
+	const char * const constraints[] = { "Owner != \"ALICE\"", "Owner != \"bob\"", "Owner < \"bob\"" };
+	const int expected[] = { HISTORY_INDEX_FALSE, HISTORY_INDEX_TRUE, HISTORY_INDEX_UNKNOWN };
+	if ( ! check_eval(index_recs[1], constraints, expected, (int)COUNTOF(expected))) {
+		FAIL;
+	}
+	PASS;
+}
+
+static bool test_eval_owner_unknown() {
+	emit_test("Test that evalOnHistoryIndex() returns HISTORY_INDEX_UNKNOWN "
+		"for an Owner comparison when the index does not know the owner.");
+	HistoryIndexRec rec = index_recs[0];
+	rec.owner = "?";
+	const char * const constraints[] = { "Owner == \"alice\"", "Owner =?= \"?\"" };
+	const int expected[] = { HISTORY_INDEX_UNKNOWN, HISTORY_INDEX_UNKNOWN };
+	if ( ! check_eval(rec, constraints, expected, (int)COUNTOF(expected))) {
+		FAIL;
+	}
+	PASS;
+}
+
+static bool test_eval_unknown_value() {
+	emit_test("Test that evalOnHistoryIndex() returns HISTORY_INDEX_UNKNOWN "
+		"for a comparison of a number the index does not know.");
+	HistoryIndexRec rec = index_recs[0];
+	rec.completion = -1;
+	rec.proc = -1;
+	const char * const constraints[] = { "CompletionDate > 0", "ProcId == 0", "ClusterId == 100" };
+	const int expected[] = { HISTORY_INDEX_UNKNOWN, HISTORY_INDEX_UNKNOWN, HISTORY_INDEX_TRUE };
+	if ( ! check_eval(rec, constraints, expected, (int)COUNTOF(expected))) {
+		FAIL;
+	}
+	PASS;
+}
+
+static bool test_eval_other_attr() {
+	emit_test("Test that evalOnHistoryIndex() returns HISTORY_INDEX_UNKNOWN "
+		"for anything other than a comparison of an indexed attribute with a literal.");
+	const char * const constraints[] = { "JobStatus == 4", "ClusterId == ProcId", "ClusterId + 1 == 101",
+		"Owner == 100", "true", "regexp(\"ali\", Owner)" };
+	const int expected[] = { HISTORY_INDEX_UNKNOWN, HISTORY_INDEX_UNKNOWN, HISTORY_INDEX_UNKNOWN,
+		HISTORY_INDEX_UNKNOWN, HISTORY_INDEX_UNKNOWN, HISTORY_INDEX_UNKNOWN };
+	if ( ! check_eval(index_recs[0], constraints, expected, (int)COUNTOF(expected))) {
+		FAIL;
+	}
+	PASS;
+}
+
+static bool test_eval_and() {
+	emit_test("Test that evalOnHistoryIndex() is false for && when either side "
+		"is false, and only true when both sides are.");
+	const char * const constraints[] = { "ClusterId == 101 && ProcId == 0", "ClusterId == 100 && ProcId == 0",
+		"ClusterId == 101 && JobStatus == 4", "JobStatus == 4 && ClusterId == 101",
+		"ClusterId == 100 && JobStatus == 4" };
+	const int expected[] = { HISTORY_INDEX_TRUE, HISTORY_INDEX_FALSE,
+		HISTORY_INDEX_UNKNOWN, HISTORY_INDEX_UNKNOWN, HISTORY_INDEX_FALSE };
+	if ( ! check_eval(index_recs[2], constraints, expected, (int)COUNTOF(expected))) {
+		FAIL;
+	}
+	PASS;
+}
+
+static bool test_eval_or() {
+	emit_test("Test that evalOnHistoryIndex() is true for || when either side "
+		"is true, and only false when both sides are.");
+	const char * const constraints[] = { "ClusterId == 100 || Owner == \"bob\"", "ClusterId == 100 || Owner == \"alice\"",
+		"ClusterId == 100 || JobStatus == 4", "JobStatus == 4 || Owner == \"BOB\"",
+		"(ClusterId == 100 || ProcId == 1) && Owner == \"bob\"" };
+	const int expected[] = { HISTORY_INDEX_TRUE, HISTORY_INDEX_FALSE,
+		HISTORY_INDEX_UNKNOWN, HISTORY_INDEX_TRUE, HISTORY_INDEX_FALSE };
+	if ( ! check_eval(index_recs[2], constraints, expected, (int)COUNTOF(expected))) {
+		FAIL;
+	}
+	PASS;
+}
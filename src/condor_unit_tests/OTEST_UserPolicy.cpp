@@ -159,6 +159,24 @@ static bool test_hold_macro_analyze_policy(void);
 static bool test_hold_macro_firing_expression(void);
 static bool test_hold_macro_firing_expression_value(void);
 static bool test_hold_macro_firing_reason(void);
+static bool test_change_time_no_time_ref(void);
+static bool test_change_time_greater(void);
+static bool test_change_time_less(void);
+static bool test_change_time_less_equal(void);
+static bool test_change_time_equal(void);
+static bool test_change_time_already_past(void);
+static bool test_change_time_and(void);
+static bool test_change_time_or(void);
+static bool test_change_time_time_offset(void);
+static bool test_change_time_divided(void);
+static bool test_change_time_current_time_attr(void);
+static bool test_change_time_attr_ref(void);
+static bool test_change_time_held(void);
+static bool test_change_time_timer_remove(void);
+static bool test_change_time_system_remove(void);
+static bool test_change_time_random(void);
+static bool test_change_time_time_squared(void);
+static bool test_change_time_modulus(void);
 
 //global variables
 static ClassAdParser parser;
@@ -321,6 +339,24 @@ bool OTEST_UserPolicy(void) {
 	driver.register_function(test_hold_macro_firing_expression);
 	driver.register_function(test_hold_macro_firing_expression_value);
 	driver.register_function(test_hold_macro_firing_reason);
+	driver.register_function(test_change_time_no_time_ref);
+	driver.register_function(test_change_time_greater);
+	driver.register_function(test_change_time_less);
+	driver.register_function(test_change_time_less_equal);
+	driver.register_function(test_change_time_equal);
+	driver.register_function(test_change_time_already_past);
+	driver.register_function(test_change_time_and);
+	driver.register_function(test_change_time_or);
+	driver.register_function(test_change_time_time_offset);
+	driver.register_function(test_change_time_divided);
+	driver.register_function(test_change_time_current_time_attr);
+	driver.register_function(test_change_time_attr_ref);
+	driver.register_function(test_change_time_held);
+	driver.register_function(test_change_time_timer_remove);
+	driver.register_function(test_change_time_system_remove);
+	driver.register_function(test_change_time_random);
+	driver.register_function(test_change_time_time_squared);
+	driver.register_function(test_change_time_modulus);
 	
 	return driver.do_all_functions();
 }
@@ -3325,3 +3361,238 @@ static bool test_hold_macro_firing_reason() {
 	}
 	PASS;
 }
+
+// The job in the PeriodicPolicyChangeTime() tests entered its current status
+// this many seconds before now.
+#define CHANGE_TIME_ELAPSED 1000
+
+// Returns PeriodicPolicyChangeTime() for the job, as seconds after now, or
+// -1 if it says the policy does not change with time.  The ClassAd evaluates
+// time() itself, so a result can be a second early if the clock ticks
+// between the two.
+static long long policy_change_offset(const char * job_str) {
+	time_t now = time(NULL);
+	ClassAd job;
+	initAdFromString(job_str, job);
+	job.Assign(ATTR_ENTERED_CURRENT_STATUS, (long long)(now - CHANGE_TIME_ELAPSED));
+	param_insert("SYSTEM_PERIODIC_HOLD", "false");
+	param_insert("SYSTEM_PERIODIC_RELEASE", "false");
+	UserPolicy policy;
+	policy.Init();
+	time_t when = policy.PeriodicPolicyChangeTime(job, now);
+	if ( ! when) {
+		return -1;
+	}
+	return (long long)(when - now);
+}
+
+static bool check_change_offset(const char * job_str, long long lo, long long hi) {
+	emit_input_header();
+	emit_param("ClassAd", "%s", job_str);
+	emit_param("EnteredCurrentStatus", "now - %d", CHANGE_TIME_ELAPSED);
+	emit_output_expected_header();
+	if (lo == hi) {
+		emit_retval("%lld", lo);
+	} else {
+		emit_retval("%lld to %lld", lo, hi);
+	}
+	param_insert("SYSTEM_PERIODIC_REMOVE", "false");
+	long long offset = policy_change_offset(job_str);
+	emit_output_actual_header();
+	emit_retval("%lld", offset);
+	return offset >= lo && offset <= hi;
+}
+
+static bool test_change_time_no_time_ref() {
+	emit_test("Test that PeriodicPolicyChangeTime() returns 0 for policy "
+		"expressions that do not refer to the current time.");
+	if ( ! check_change_offset("JobStatus = 2\nPeriodicHold = JobStatus == 5\n"
+		"PeriodicRemove = NumJobStarts > 3", -1, -1)) {
+		FAIL;
+	}
+	PASS;
+}
+
+static bool test_change_time_greater() {
+	emit_test("Test that PeriodicPolicyChangeTime() returns the time at which "
+		"an elapsed time passes a limit with >.");
+	if ( ! check_change_offset("JobStatus = 2\n"
+		"PeriodicHold = time() - EnteredCurrentStatus > 3600", 2599, 2600)) {
+		FAIL;
+	}
+	PASS;
+}
+
+static bool test_change_time_less() {
+	emit_test("Test that PeriodicPolicyChangeTime() returns the time at which "
+		"the current time passes a deadline with <.");
+	if ( ! check_change_offset("JobStatus = 2\n"
+		"PeriodicHold = time() < EnteredCurrentStatus + 3600", 2599, 2600)) {
+		FAIL;
+	}
+	PASS;
+}
+
+static bool test_change_time_less_equal() {
+	emit_test("Test that PeriodicPolicyChangeTime() returns the time at which "
+		"a limit is passed with <= and the limit on the left.");
+	if ( ! check_change_offset("JobStatus = 2\n"
+		"PeriodicHold = 3600 <= time() - EnteredCurrentStatus", 2599, 2600)) {
+		FAIL;
+	}
+	PASS;
+}
+
+static bool test_change_time_equal() {
+	emit_test("Test that PeriodicPolicyChangeTime() returns the time at which "
+		"the two sides of == are equal.");
+	if ( ! check_change_offset("JobStatus = 2\n"
+		"PeriodicHold = time() - EnteredCurrentStatus == 3600", 2599, 2600)) {
+		FAIL;
+	}
+	PASS;
+}
+
+static bool test_change_time_already_past() {
+	emit_test("Test that PeriodicPolicyChangeTime() returns 0 when the only "
+		"limit was passed before now.");
+	if ( ! check_change_offset("JobStatus = 2\n"
+		"PeriodicHold = time() - EnteredCurrentStatus > 600", -1, -1)) {
+		FAIL;
+	}
+	PASS;
+}
+
+static bool test_change_time_and() {
+	emit_test("Test that PeriodicPolicyChangeTime() looks at both sides of && "
+		"and ignores the side whose limit is already past.");
+	if ( ! check_change_offset("JobStatus = 2\n"
+		"PeriodicHold = time() - EnteredCurrentStatus > 600 && "
+		"time() - EnteredCurrentStatus > 3600", 2599, 2600)) {
+		FAIL;
+	}
+	PASS;
+}
+
+static bool test_change_time_or() {
+	emit_test("Test that PeriodicPolicyChangeTime() returns the earlier of the "
+		"two limits on either side of ||.");
+	if ( ! check_change_offset("JobStatus = 2\n"
+		"PeriodicHold = time() - EnteredCurrentStatus > 7200 || "
+		"time() - EnteredCurrentStatus > 3600", 2599, 2600)) {
+		FAIL;
+	}
+	PASS;
+}
+
+static bool test_change_time_time_offset() {
+	emit_test("Test that PeriodicPolicyChangeTime() handles a constant added to "
+		"time().");
+	if ( ! check_change_offset("JobStatus = 2\n"
+		"PeriodicHold = time() + 600 > EnteredCurrentStatus + 3600", 1999, 2000)) {
+		FAIL;
+	}
+	PASS;
+}
+
+static bool test_change_time_divided() {
+	emit_test("Test that PeriodicPolicyChangeTime() returns a time no later than "
+		"the change when the elapsed time is divided by a constant.");
+	emit_comment("(time() - EnteredCurrentStatus) / 60 > 60 changes at 3660 "
+		"seconds elapsed, the answer may be early by the rounding of the division.");
+	if ( ! check_change_offset("JobStatus = 2\n"
+		"PeriodicHold = (time() - EnteredCurrentStatus) / 60 > 60", 1, 2660)) {
+		FAIL;
+	}
+	PASS;
+}
+
+static bool test_change_time_current_time_attr() {
+	emit_test("Test that PeriodicPolicyChangeTime() treats CurrentTime as the "
+		"current time.");
+	if ( ! check_change_offset("JobStatus = 2\n"
+		"PeriodicHold = CurrentTime - EnteredCurrentStatus > 3600", 2599, 2600)) {
+		FAIL;
+	}
+	PASS;
+}
+
+static bool test_change_time_attr_ref() {
+	emit_test("Test that PeriodicPolicyChangeTime() follows references to other "
+		"attributes of the job.");
+	if ( ! check_change_offset("JobStatus = 2\nMaxRunTime = 3600\n"
+		"RunTime = time() - EnteredCurrentStatus\n"
+		"TooLong = RunTime > MaxRunTime\nPeriodicRemove = TooLong", 2599, 2600)) {
+		FAIL;
+	}
+	PASS;
+}
+
+static bool test_change_time_held() {
+	emit_test("Test that PeriodicPolicyChangeTime() uses PeriodicRelease and "
+		"not PeriodicHold for a held job.");
+	if ( ! check_change_offset("JobStatus = 5\n"
+		"PeriodicHold = time() - EnteredCurrentStatus > 1600\n"
+		"PeriodicRelease = time() - EnteredCurrentStatus > 3600", 2599, 2600)) {
+		FAIL;
+	}
+	PASS;
+}
+
+static bool test_change_time_timer_remove() {
+	emit_test("Test that PeriodicPolicyChangeTime() returns the second after "
+		"TimerRemove.");
+	std::string job_str;
+	formatstr(job_str, "JobStatus = 2\nTimerRemove = %lld", (long long)time(NULL) + 100);
+	if ( ! check_change_offset(job_str.c_str(), 100, 101)) {
+		FAIL;
+	}
+	PASS;
+}
+
+static bool test_change_time_system_remove() {
+	emit_test("Test that PeriodicPolicyChangeTime() looks at "
+		"SYSTEM_PERIODIC_REMOVE as well as the job's own expressions.");
+	emit_param("SYSTEM_PERIODIC_REMOVE", "time() - EnteredCurrentStatus > 3600");
+	param_insert("SYSTEM_PERIODIC_REMOVE", "time() - EnteredCurrentStatus > 3600");
+	long long offset = policy_change_offset("JobStatus = 2\n"
+		"PeriodicHold = time() - EnteredCurrentStatus > 7200");
+	param_insert("SYSTEM_PERIODIC_REMOVE", "false");
+	emit_output_expected_header();
+	emit_retval("2599 to 2600");
+	emit_output_actual_header();
+	emit_retval("%lld", offset);
+	if (offset < 2599 || offset > 2600) {
+		FAIL;
+	}
+	PASS;
+}
+
+static bool test_change_time_random() {
+	emit_test("Test that PeriodicPolicyChangeTime() returns now for an "
+		"expression that uses random().");
+	if ( ! check_change_offset("JobStatus = 2\nPeriodicHold = random(100) > 98", 0, 0)) {
+		FAIL;
+	}
+	PASS;
+}
+
+static bool test_change_time_time_squared() {
+	emit_test("Test that PeriodicPolicyChangeTime() returns now when the current "
+		"time is multiplied by itself.");
+	if ( ! check_change_offset("JobStatus = 2\n"
+		"PeriodicHold = (time() - EnteredCurrentStatus) * (time() - EnteredCurrentStatus) > 3600", 0, 0)) {
+		FAIL;
+	}
+	PASS;
+}
+
+static bool test_change_time_modulus() {
+	emit_test("Test that PeriodicPolicyChangeTime() returns now when the current "
+		"time is used in an operation it cannot solve for.");
+	if ( ! check_change_offset("JobStatus = 2\n"
+		"PeriodicHold = (time() - EnteredCurrentStatus) % 60 == 0", 0, 0)) {
+		FAIL;
+	}
+	PASS;
+}
@@ -63,6 +63,10 @@ bool OTEST_TmpDir(void);
 bool OTEST_StatInfo(void);
 bool OTEST_condor_sockaddr();
 bool OTEST_ranger();
+bool OTEST_ClassAdLog(void);
+bool OTEST_HistoryIndex(void);
+bool OTEST_HistoryChunkReader(void);
+bool OTEST_GroupCommit(void);
 
 	// function map that maps testing function names to testing functions
 const static struct {
@@ -98,6 +102,10 @@ const static struct {
 	map(OTEST_StatInfo),
 	map(OTEST_condor_sockaddr),
 	map(OTEST_ranger),
+	map(OTEST_ClassAdLog),
+	map(OTEST_HistoryIndex),
+	map(OTEST_HistoryChunkReader),
+	map(OTEST_GroupCommit),
 };
 int function_map_num_elems = sizeof(function_map) / sizeof(function_map[0]);
 
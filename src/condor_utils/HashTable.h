@@ -171,6 +171,19 @@ class HashTable {
   */
   int walk( int (*walkfunc) ( Value value ) );
 
+  /*
+  Same as above, but walkfunc may be any callable, so that it can
+  carry its own state instead of using globals.
+  */
+  template <class Func> int walk( Func walkfunc ) {
+	for( int i=0; i<tableSize; i++ ) {
+		for( HashBucket<Index,Value> *current=ht[i]; current; current=current->next ) {
+			if(!walkfunc( current->value )) return 0;
+		}
+	}
+	return 1;
+  }
+
 
  private:
   void register_iterator(iterator* it);
@@ -29,15 +29,19 @@
 #include "condor_email.h"
 
 #include "classadHistory.h"
+#include "historyFileFinder.h" // for historyIndexFileName
 
 static FILE *HistoryFile_fp = NULL;
 static int HistoryFile_RefCount = 0;
+static FILE *HistoryIndex_fp = NULL;
+static bool HistoryIndex_skip = false; // the history file has ads that are not in its index
 
 char* JobHistoryFileName = NULL;
 char* JobHistoryParamName = NULL;
 bool        DoHistoryRotation = true;
 bool        DoDailyHistoryRotation = true;
 bool        DoMonthlyHistoryRotation = true;
+bool        DoHistoryIndex = false;
 filesize_t  MaxHistoryFileSize = 20 * 1024 * 1024; // 20MB;
 int         NumberBackupHistoryFiles = 2;
 char*       PerJobHistoryDir = NULL;
@@ -51,6 +55,7 @@ static int findHistoryOffset(FILE *LogFile);
 static FILE* OpenHistoryFile();
 static void CloseJobHistoryFile();
 static void RelinquishHistoryFile(FILE *fp);
+static void AppendHistoryIndex(long ad_offset, long end_offset, int cluster, int proc, int completion, const std::string & owner);
 
 // --------------------------------------------------------------------------
 // --------- PUBLIC FUNCTIONS (called by schedd, startd, etc) ---------------
@@ -74,6 +79,7 @@ InitJobHistoryFile(const char *history_param, const char *per_job_history_param)
     DoHistoryRotation = param_boolean("ENABLE_HISTORY_ROTATION", true);
     DoDailyHistoryRotation = param_boolean("ROTATE_HISTORY_DAILY", false);
     DoMonthlyHistoryRotation = param_boolean("ROTATE_HISTORY_MONTHLY", false);
+    DoHistoryIndex = param_boolean("ENABLE_HISTORY_INDEX", false);
 
 	long long default_history = 20 * 1024 * 1024;
 	long long history_filesize = 0;
@@ -118,13 +124,14 @@ InitJobHistoryFile(const char *history_param, const char *per_job_history_param)
 // Write job ads to history file when they're destroyed
 // --------------------------------------------------------------------------
 
-void
+// returns true if the ad was written to the history file
+bool
 AppendHistory(ClassAd* ad)
 {
   bool failed = false;
   static bool sent_mail_about_bad_history = false;
 
-  if (!JobHistoryFileName) return;
+  if (!JobHistoryFileName) return false;
   dprintf(D_FULLDEBUG, "Saving classad to history file\n");
 
   // First we serialize the ad. If history file rotation is on,
@@ -144,6 +151,7 @@ AppendHistory(ClassAd* ad)
 	  failed = true;
   } else {
 	  int offset = findHistoryOffset(LogFile);
+	  long ad_offset = ftell(LogFile);
 	  if (!fPrintAd(LogFile, *ad)) {
 		  dprintf(D_ALWAYS, 
 				  "ERROR: failed to write job class ad to history file %s\n",
@@ -169,6 +177,10 @@ AppendHistory(ClassAd* ad)
                       "*** Offset = %d ClusterId = %d ProcId = %d Owner = \"%s\" CompletionDate = %d\n",
 				  offset, cluster, proc, owner.c_str(), completion);
 		  fflush( LogFile );
+
+		  if (DoHistoryIndex) {
+			  AppendHistoryIndex(ad_offset, ftell(LogFile), cluster, proc, completion, owner);
+		  }
       }
   }
 
@@ -208,7 +220,7 @@ AppendHistory(ClassAd* ad)
 	  sent_mail_about_bad_history = false;
   }
   
-  return;
+  return ! failed;
 }
 
 void
@@ -333,6 +345,62 @@ CloseJobHistoryFile() {
 		fclose( HistoryFile_fp );
 		HistoryFile_fp = NULL;
 	}
+	if( HistoryIndex_fp ) {
+		fclose( HistoryIndex_fp );
+		HistoryIndex_fp = NULL;
+	}
+	HistoryIndex_skip = false;
+}
+
+// --------------------------------------------------------------------------
+// Add the ad that was just written to the history file to its index, see
+// historyIndexFileName().  condor_history only trusts an index that covers
+// the whole of its history file, so a failure here costs speed, not answers.
+// --------------------------------------------------------------------------
+static void
+AppendHistoryIndex(long ad_offset, long end_offset, int cluster, int proc, int completion, const std::string & owner)
+{
+	if (HistoryIndex_skip || ad_offset < 0 || end_offset <= ad_offset) {
+		return;
+	}
+	if ( ! HistoryIndex_fp) {
+		std::string index_name;
+		historyIndexFileName(JobHistoryFileName, index_name);
+		int fd = safe_open_wrapper_follow(index_name.c_str(),
+				O_WRONLY|O_CREAT|O_APPEND|O_LARGEFILE|_O_NOINHERIT, 0644);
+		if (fd < 0) {
+			dprintf(D_ALWAYS, "ERROR opening history index (%s): %s\n",
+					index_name.c_str(), strerror(errno));
+			HistoryIndex_skip = true;
+			return;
+		}
+		StatInfo si(fd);
+		if (si.GetFileSize() == 0 && ad_offset > 0) {
+				// the history file was started before the index was turned
+				// on, so an index would never cover it.  wait for rotation.
+			dprintf(D_FULLDEBUG, "Not indexing history file %s until it is rotated\n",
+					JobHistoryFileName);
+			close(fd);
+			HistoryIndex_skip = true;
+			return;
+		}
+		HistoryIndex_fp = fdopen(fd, "a");
+		if ( ! HistoryIndex_fp) {
+			close(fd);
+			HistoryIndex_skip = true;
+			return;
+		}
+	}
+	if (fprintf(HistoryIndex_fp, "%ld %ld %d %d %d %s\n", ad_offset, end_offset,
+				cluster, proc, completion, owner.empty() ? "?" : owner.c_str()) < 0 ||
+		fflush(HistoryIndex_fp) != 0)
+	{
+		dprintf(D_ALWAYS, "ERROR writing history index for %s: %s\n",
+				JobHistoryFileName, strerror(errno));
+		fclose(HistoryIndex_fp);
+		HistoryIndex_fp = NULL;
+		HistoryIndex_skip = true;
+	}
 }
 
 // --------------------------------------------------------------------------
@@ -490,6 +558,11 @@ MaybeDeleteOneHistoryBackup(void)
                 if (!dir.Remove_Current_File()) {
                     dprintf(D_ALWAYS, "Failed to delete %s\n", oldest_history_filename);
                     num_backups = 0; // prevent looping forever
+                } else {
+                    std::string oldest_path, index_name;
+                    formatstr(oldest_path, "%s%c%s", history_dir, DIR_DELIM_CHAR, oldest_history_filename);
+                    historyIndexFileName(oldest_path.c_str(), index_name);
+                    unlink(index_name.c_str());
                 }
             } else {
                 dprintf(D_ALWAYS, "Failed to find/delete %s\n", oldest_history_filename);
@@ -571,6 +644,17 @@ RotateHistory(void)
         dprintf(D_ALWAYS, "Failed to rotate history file to %s\n",
                 rotated_history_name.Value());
         dprintf(D_ALWAYS, "Because rotation failed, the history file may get very large.\n");
+    } else {
+        // the index goes with its history file.  if it can't, it would
+        // not match the new history file, so throw it away.
+        std::string index_name, rotated_index_name;
+        historyIndexFileName(JobHistoryFileName, index_name);
+        historyIndexFileName(rotated_history_name.Value(), rotated_index_name);
+        StatInfo index_stat_info(index_name.c_str());
+        if (index_stat_info.Error() == SIGood &&
+            rotate_file(index_name.c_str(), rotated_index_name.c_str())) {
+            unlink(index_name.c_str());
+        }
     }
 
     return;
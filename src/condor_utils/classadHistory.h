@@ -25,13 +25,14 @@
 extern bool        DoHistoryRotation;
 extern bool        DoDailyHistoryRotation;
 extern bool        DoMonthlyHistoryRotation;
+extern bool        DoHistoryIndex;
 extern filesize_t  MaxHistoryFileSize;
 extern int         NumberBackupHistoryFiles;
 extern char*       PerJobHistoryDir;
 extern char* JobHistoryFileName;
 
 void WritePerJobHistoryFile(ClassAd*, bool);
-void AppendHistory(ClassAd*);
+bool AppendHistory(ClassAd*);
 void InitJobHistoryFile(const char *, const char *);
 
 #endif
@@ -127,6 +127,13 @@ public:
 	return ClassAdLog<K,AD>::GetTransactionKeys( keys );
   }
 
+  /** Remember the keys of the class-ads that committed changes touch,
+      see ClassAdLog::TrackChangedKeys
+   */
+  void TrackChangedKeys(bool track) { ClassAdLog<K,AD>::TrackChangedKeys(track); }
+  void TakeChangedKeys(std::set<std::string> &keys) { ClassAdLog<K,AD>::TakeChangedKeys(keys); }
+  void MarkKeyChanged(const std::string &key) { ClassAdLog<K,AD>::MarkKeyChanged(key); }
+
   int SetTransactionTriggers(int mask) { return ClassAdLog<K,AD>::SetTransactionTriggers(mask); }
   int GetTransactionTriggers() { return ClassAdLog<K,AD>::GetTransactionTriggers(); }
 
@@ -150,6 +157,15 @@ public:
 		// This means doing both a flush and fsync.
   void ForceLog() { ClassAdLog<K,AD>::ForceLog(); }
 
+		// Let a writer thread do the fsync of durable commits, see
+		// ClassAdLog::SetGroupCommit.
+  void SetGroupCommit(bool enable, int notify_fd = -1) { ClassAdLog<K,AD>::SetGroupCommit(enable, notify_fd); }
+  bool GroupCommit() const { return ClassAdLog<K,AD>::GroupCommit(); }
+  bool CommitPending() { return ClassAdLog<K,AD>::CommitPending(); }
+  void WaitForCommit() { ClassAdLog<K,AD>::WaitForCommit(); }
+  void WhenCommitted(const std::function<void()> & fn) { ClassAdLog<K,AD>::WhenCommitted(fn); }
+  int RunCommitCallbacks() { return ClassAdLog<K,AD>::RunCommitCallbacks(); }
+
   ///
   Transaction* getActiveTransaction() { return ClassAdLog<K,AD>::getActiveTransaction(); }
   ///
@@ -169,12 +185,19 @@ public:
 	case we are continuing to use the old log file)
   */
   bool TruncLog() { return ClassAdLog<K,AD>::TruncLog(); }
+  bool BeginBackgroundTruncLog() { return ClassAdLog<K,AD>::BeginBackgroundTruncLog(); }
+  bool WriteBackgroundTruncLog() { return ClassAdLog<K,AD>::WriteBackgroundTruncLog(); }
+  bool FinishBackgroundTruncLog(bool written) { return ClassAdLog<K,AD>::FinishBackgroundTruncLog(written); }
 
   void SetMaxHistoricalLogs(int max) { ClassAdLog<K,AD>::SetMaxHistoricalLogs(max); }
   int GetMaxHistoricalLogs() { return ClassAdLog<K,AD>::GetMaxHistoricalLogs(); }
 
   time_t GetOrigLogBirthdate() { return ClassAdLog<K,AD>::GetOrigLogBirthdate(); }
 
+  void SetBinaryFormat(bool binary) { ClassAdLog<K,AD>::SetBinaryFormat(binary); }
+  bool IsBinaryFormat() const { return ClassAdLog<K,AD>::IsBinaryFormat(); }
+  const ClassAdLogLoadStats & GetLoadStats() const { return ClassAdLog<K,AD>::GetLoadStats(); }
+
   //@}
   //------------------------------------------------------------------------
   /**@name Method to control the class-ads in the repository
@@ -312,6 +335,16 @@ public:
 	return true;
   }
 
+  /** Call fn for every class-ad in the repository and its key, without
+      disturbing an iteration begun with StartIterateAllClassAds().
+  */
+  void WalkAllClassAds(const std::function<void(const K&, AD)> & fn) {
+	HashIterator<K,AD> end = this->table.end();
+	for (HashIterator<K,AD> it = this->table.begin(); !(it == end); it.advance()) {
+		fn((*it).first, (*it).second);
+	}
+  }
+
   // this is for DEBUG PURPOSES ONLY!!!
   HashTable<K,AD>* Table() { return &this->table; }
 };
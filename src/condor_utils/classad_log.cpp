@@ -30,6 +30,8 @@
 #include "classad_merge.h"
 #include "condor_fsync.h"
 #include "condor_attributes.h"
+#include "classad_log_binary.h"
+#include "classad/classadCache.h" // for CachedExprEnvelope
 
 #if defined(HAVE_DLOPEN)
 #include "ClassAdLogPlugin.h"
@@ -64,6 +66,72 @@ const ConstructClassAdLogTableEntry<ClassAd*> DefaultMakeClassAdLogTableEntry;
 #endif
 
 
+// number of records read before their values are parsed when loading a
+// log with more than one thread
+#define CLASSAD_LOG_LOAD_BATCH 65536
+
+// set while LoadClassAdLog() is going to parse attribute values itself,
+// so that LogSetAttribute::ReadBody() leaves them as text
+static bool defer_value_parsing = false;
+
+static void RecoverFromCorruptLogRecord(FILE *fp, LogRecord *log_rec, unsigned long recnum, long long pos);
+
+// Parse the SetAttribute values of a batch of log records on the given
+// number of threads, this one included.  Returns the index of the first
+// record whose value did not parse if that should be treated as a corrupt
+// record, otherwise batch.size()
+static size_t
+ParseLogRecordValues(std::vector<LogRecord*> & batch, int threads, bool strict)
+{
+	// the classad function table is built the first time a function call
+	// is parsed, make sure that happens here rather than in a worker.
+	static bool warmed_up = false;
+	if ( ! warmed_up) {
+		ExprTree * tree = NULL;
+		if (ParseClassAdRvalExpr("isUndefined(x)", tree) == 0) {
+			delete tree;
+		}
+		warmed_up = true;
+	}
+
+	// a value that does not parse only sets the classad error of the
+	// thread that parsed it (CondorErrMsg is thread_local), and is dealt
+	// with here after the join.
+	std::vector<char> failed(batch.size(), 0);
+	auto parse_range = [&batch, &failed](size_t first, size_t last) {
+		for (size_t i = first; i < last; ++i) {
+			if (batch[i]->get_op_type() == CondorLogOp_SetAttribute) {
+				failed[i] = ! ((LogSetAttribute *)batch[i])->ParseValue();
+			}
+		}
+	};
+
+	std::vector<std::thread> workers;
+	size_t per_thread = (batch.size() + threads - 1) / threads;
+	for (int t = 1; t < threads; ++t) {
+		size_t first = t * per_thread;
+		if (first >= batch.size()) break;
+		workers.emplace_back(parse_range, first, std::min(first + per_thread, batch.size()));
+	}
+	parse_range(0, std::min(per_thread, batch.size()));
+	for (auto & worker : workers) {
+		worker.join();
+	}
+
+	strict = strict && param_boolean("CLASSAD_LOG_STRICT_PARSING", true);
+	for (size_t i = 0; i < batch.size(); ++i) {
+		if ( ! failed[i]) continue;
+		if (strict) {
+			return i;
+		}
+		// the record is played from the text, just as it would have been
+		// without the parallel parse
+		dprintf(D_ALWAYS, "WARNING: strict classad parsing failed for expression: %s\n",
+			((LogSetAttribute *)batch[i])->get_value());
+	}
+	return batch.size();
+}
+
 // non-templatized worker function that implements the log loading functionality of ClassAdLog
 //
 FILE* LoadClassAdLog(
@@ -74,10 +142,13 @@ FILE* LoadClassAdLog(
 	time_t & m_original_log_birthdate,
 	bool & is_clean,
 	bool & requires_successful_cleaning,
-	MyString & errmsg)
+	MyString & errmsg,
+	ClassAdLogBinaryFormat * & binary,
+	ClassAdLogLoadStats & stats)
 {
 	FILE* log_fp = NULL;
 	Transaction * active_transaction = NULL;
+	binary = NULL;
 
 	historical_sequence_number = 1;
 	m_original_log_birthdate = time(NULL);
@@ -98,62 +169,124 @@ FILE* LoadClassAdLog(
 	is_clean = true; // was cleanly closed (until we find out otherwise)
 	requires_successful_cleaning = false;
 
-	// Read all of the log records
+	if (ClassAdLogBinaryFormat::IsBinaryLog(log_fp)) {
+		binary = new ClassAdLogBinaryFormat();
+	}
+
+	// Read all of the log records.  When loading with more than one
+	// thread they are read a batch at a time, the attribute values in the
+	// batch are parsed in parallel, and then the batch is played into the
+	// table in order on this thread.
+	int threads = param_integer("CLASSAD_LOG_LOAD_THREADS", 1, 1, 64);
+	size_t batch_size = (threads > 1) ? CLASSAD_LOG_LOAD_BATCH : 1;
+	defer_value_parsing = threads > 1;
+	stats = ClassAdLogLoadStats();
+	stats.threads = threads;
+
+	std::vector<LogRecord*> batch;
+	std::vector<long long> batch_end; // file offset just past each record
 	LogRecord		*log_rec;
 	unsigned long count = 0;
-	long long next_log_entry_pos = 0;
+	long long next_log_entry_pos = ftell(log_fp);
     long long curr_log_entry_pos = 0;
-	while ((log_rec = ReadLogEntry(log_fp, 1+count, InstantiateLogEntry, maker)) != 0) {
-        curr_log_entry_pos = next_log_entry_pos;
-		next_log_entry_pos = ftell(log_fp);
-		count++;
-		switch (log_rec->get_op_type()) {
-		case CondorLogOp_Error:
-			// this is defensive, ought to be caught in InstantiateLogEntry()
-			errmsg.formatstr("ERROR: in log %s transaction record %lu was bad (byte offset %lld)\n", filename, count, curr_log_entry_pos);
-			fclose(log_fp);
-
-			delete active_transaction;
-			return NULL;
-			break;
-		case CondorLogOp_BeginTransaction:
-			// this file contains transactions, so it must not
-			// have been cleanly shut down
-			is_clean = false;
-			if (active_transaction) {
-				errmsg.formatstr_cat("Warning: Encountered nested transactions, log may be bogus...\n");
-			} else {
-				active_transaction = new Transaction();
+	bool at_end = false;
+	while ( ! at_end) {
+		double begin = _condor_debug_get_time_double();
+		batch.clear();
+		batch_end.clear();
+		while (batch.size() < batch_size) {
+			log_rec = binary ? binary->Read(log_fp, maker)
+			                 : ReadLogEntry(log_fp, 1+count+batch.size(), InstantiateLogEntry, maker);
+			if ( ! log_rec) {
+				at_end = true;
+				break;
 			}
-			delete log_rec;
-			break;
-		case CondorLogOp_EndTransaction:
-			if (!active_transaction) {
-				errmsg.formatstr_cat("Warning: Encountered unmatched end transaction, log may be bogus...\n");
-			} else {
-				active_transaction->Commit(NULL, NULL, &la); // commit in memory only
+			batch.push_back(log_rec);
+			batch_end.push_back(ftell(log_fp));
+		}
+		double read_done = _condor_debug_get_time_double();
+		stats.read_time += read_done - begin;
+
+		size_t good = batch.size();
+		if (threads > 1) {
+			good = ParseLogRecordValues(batch, threads, binary == NULL);
+		}
+		double parse_done = _condor_debug_get_time_double();
+		stats.parse_time += parse_done - read_done;
+
+		for (size_t i = 0; i < good; ++i) {
+			log_rec = batch[i];
+			curr_log_entry_pos = next_log_entry_pos;
+			next_log_entry_pos = batch_end[i];
+			count++;
+			switch (log_rec->get_op_type()) {
+			case CondorLogOp_Error:
+				// this is defensive, ought to be caught in InstantiateLogEntry()
+				errmsg.formatstr("ERROR: in log %s transaction record %lu was bad (byte offset %lld)\n", filename, count, curr_log_entry_pos);
+				fclose(log_fp);
+
 				delete active_transaction;
-				active_transaction = NULL;
-			}
-			delete log_rec;
-			break;
-		case CondorLogOp_LogHistoricalSequenceNumber:
-			if(count != 1) {
-				errmsg.formatstr_cat("Warning: Encountered historical sequence number after first log entry (entry number = %ld)\n",count);
-			}
-			historical_sequence_number = ((LogHistoricalSequenceNumber *)log_rec)->get_historical_sequence_number();
-			m_original_log_birthdate = ((LogHistoricalSequenceNumber *)log_rec)->get_timestamp();
-			delete log_rec;
-			break;
-		default:
-			if (active_transaction) {
-				active_transaction->AppendLog(log_rec);
-			} else {
-				log_rec->Play((void *)&la);
+				delete binary;
+				binary = NULL;
+				for (size_t j = i; j < batch.size(); ++j) {
+					delete batch[j];
+				}
+				return NULL;
+				break;
+			case CondorLogOp_BeginTransaction:
+				// this file contains transactions, so it must not
+				// have been cleanly shut down
+				is_clean = false;
+				if (active_transaction) {
+					errmsg.formatstr_cat("Warning: Encountered nested transactions, log may be bogus...\n");
+				} else {
+					active_transaction = new Transaction();
+				}
+				delete log_rec;
+				break;
+			case CondorLogOp_EndTransaction:
+				if (!active_transaction) {
+					errmsg.formatstr_cat("Warning: Encountered unmatched end transaction, log may be bogus...\n");
+				} else {
+					active_transaction->Commit(NULL, NULL, &la); // commit in memory only
+					delete active_transaction;
+					active_transaction = NULL;
+				}
 				delete log_rec;
+				break;
+			case CondorLogOp_LogHistoricalSequenceNumber:
+				if(count != 1) {
+					errmsg.formatstr_cat("Warning: Encountered historical sequence number after first log entry (entry number = %ld)\n",count);
+				}
+				historical_sequence_number = ((LogHistoricalSequenceNumber *)log_rec)->get_historical_sequence_number();
+				m_original_log_birthdate = ((LogHistoricalSequenceNumber *)log_rec)->get_timestamp();
+				delete log_rec;
+				break;
+			default:
+				if (active_transaction) {
+					active_transaction->AppendLog(log_rec);
+				} else {
+					log_rec->Play((void *)&la);
+					delete log_rec;
+				}
 			}
 		}
+
+		if (good < batch.size()) {
+			// a value that would not parse makes the record corrupt, just
+			// as if ReadBody() had failed on it.  go back to the end of that
+			// record, drop the rest of the batch, and recover the same way
+			for (size_t j = good+1; j < batch.size(); ++j) {
+				delete batch[j];
+			}
+			fseek(log_fp, batch_end[good], SEEK_SET);
+			RecoverFromCorruptLogRecord(log_fp, batch[good], count+1, next_log_entry_pos);
+			at_end = true;
+		}
+		stats.play_time += _condor_debug_get_time_double() - parse_done;
 	}
+	defer_value_parsing = false;
+	stats.records = count;
 	long long final_log_entry_pos = ftell(log_fp);
 	if( next_log_entry_pos != final_log_entry_pos ) {
 		// The log file has a broken line at the end so we _must_
@@ -179,10 +312,12 @@ FILE* LoadClassAdLog(
 	}
 	if(!count) {
 		log_rec = new LogHistoricalSequenceNumber( historical_sequence_number, m_original_log_birthdate );
-		if (log_rec->Write(log_fp) < 0) {
+		if (WriteLogRecord(log_fp, log_rec, binary) < 0) {
 			errmsg.formatstr("write to %s failed, errno = %d\n", filename, errno);
 			fclose(log_fp);
 			delete log_rec;
+			delete binary;
+			binary = NULL;
 			return NULL;
 		}
 		delete log_rec;
@@ -209,6 +344,150 @@ int FlushClassAdLog(FILE* fp, bool force)
 }
 
 
+ClassAdLogGroupCommit::ClassAdLogGroupCommit(const char * filename, int notify_fd)
+	: m_filename(filename ? filename : "<null>")
+	, m_notify_fd(notify_fd)
+	, m_fd(-1)
+	, m_queued(0)
+	, m_durable(0)
+	, m_error(0)
+	, m_exit(false)
+{
+	m_thread = std::thread(&ClassAdLogGroupCommit::WriterThread, this);
+}
+
+ClassAdLogGroupCommit::~ClassAdLogGroupCommit()
+{
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_exit = true;
+		m_work.notify_one();
+	}
+	m_thread.join();
+	if ( ! m_callbacks.empty()) {
+		dprintf(D_FULLDEBUG, "ClassAdLog %s: dropping %d commit callbacks\n",
+			m_filename.c_str(), (int)m_callbacks.size());
+	}
+}
+
+unsigned long
+ClassAdLogGroupCommit::Queue(int fd)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_fd = fd;
+	++m_queued;
+	m_work.notify_one();
+	return m_queued;
+}
+
+int
+ClassAdLogGroupCommit::Error()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	return m_error;
+}
+
+bool
+ClassAdLogGroupCommit::IsDurable(unsigned long seq)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	return m_durable >= seq;
+}
+
+bool
+ClassAdLogGroupCommit::Wait(unsigned long seq)
+{
+	bool durable;
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		while (m_durable < seq && ! m_error) {
+			m_done.wait(lock);
+		}
+		durable = m_durable >= seq;
+	}
+	RunCallbacks();
+	return durable;
+}
+
+void
+ClassAdLogGroupCommit::WhenDurable(unsigned long seq, const std::function<void()> & fn)
+{
+	if (IsDurable(seq)) {
+		fn();
+		return;
+	}
+	m_callbacks.insert(std::make_pair(seq, fn));
+}
+
+int
+ClassAdLogGroupCommit::RunCallbacks()
+{
+	unsigned long durable;
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		durable = m_durable;
+	}
+
+	// take the callbacks out of the map first, they may well queue
+	// more commits and callbacks of their own.
+	std::vector<std::function<void()> > ready;
+	auto last = m_callbacks.upper_bound(durable);
+	for (auto it = m_callbacks.begin(); it != last; ++it) {
+		ready.push_back(it->second);
+	}
+	m_callbacks.erase(m_callbacks.begin(), last);
+
+	for (auto it = ready.begin(); it != ready.end(); ++it) {
+		(*it)();
+	}
+	return (int)ready.size();
+}
+
+void
+ClassAdLogGroupCommit::WriterThread()
+{
+#ifndef WIN32
+	// signals belong to the main thread
+	sigset_t mask;
+	sigfillset(&mask);
+	sigprocmask(SIG_BLOCK, &mask, NULL);
+#endif
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	for (;;) {
+		while ((m_durable == m_queued || m_error) && ! m_exit) {
+			m_work.wait(lock);
+		}
+		if (m_durable == m_queued || m_error) {
+			break;
+		}
+
+		// everything queued up to now goes out with this one sync,
+		// later commits wait for the next.
+		unsigned long target = m_queued;
+		int fd = m_fd;
+		lock.unlock();
+		int rval = condor_fdatasync(fd);
+		int err = errno;
+		lock.lock();
+
+		// a failed sync leaves its commits, and every later one, not durable
+		if (rval < 0) {
+			m_error = err ? err : -1;
+		} else {
+			m_durable = target;
+		}
+		m_done.notify_all();
+
+		if (m_notify_fd >= 0) {
+			char c = 0;
+			if (write(m_notify_fd, &c, 1) < 0) {
+				// the pipe is full, so the owner has a wakeup pending already
+			}
+		}
+	}
+}
+
 bool SaveHistoricalClassAdLogs(
 	const char * filename,
 	const unsigned long max_historical_logs,
@@ -253,6 +532,8 @@ bool SaveHistoricalClassAdLogs(
 }
 
 
+static bool ReplaceClassAdLog(const char * tmp_log_filename, const char * filename, FILE* &log_fp, MyString & errmsg);
+
 bool TruncateClassAdLog(
 	const char * filename,	        // in
 	LoggableClassAdTable & la,      // in
@@ -260,7 +541,9 @@ bool TruncateClassAdLog(
 	FILE* &log_fp,                  // in,out
 	unsigned long & historical_sequence_number, // in,out
 	time_t & m_original_log_birthdate, // in,out
-	MyString & errmsg) // out
+	MyString & errmsg, // out
+	ClassAdLogBinaryFormat * & binary, // in,out
+	bool want_binary) // in: the format of the new log
 {
 	MyString	tmp_log_filename;
 	int new_log_fd;
@@ -287,11 +570,21 @@ bool TruncateClassAdLog(
 	// Now it is time to move courageously into the future.
 	unsigned long future_sequence_number = historical_sequence_number + 1;
 
+	ClassAdLogBinaryFormat * new_binary = NULL;
+	bool success = true;
+	if (want_binary) {
+		new_binary = new ClassAdLogBinaryFormat();
+		if (new_binary->WriteHeader(new_log_fp) < 0) {
+			errmsg.formatstr("write to %s failed, errno = %d", tmp_log_filename.Value(), errno);
+			success = false;
+		}
+	}
+
 	// flush our current state into the temp file,
 	// with a future value for sequence number
-	bool success = WriteClassAdLogState(new_log_fp, tmp_log_filename.Value(),
+	success = success && WriteClassAdLogState(new_log_fp, tmp_log_filename.Value(),
 		future_sequence_number, m_original_log_birthdate,
-		la, maker, errmsg);
+		la, maker, errmsg, new_binary);
 
 	fclose(log_fp);
 	log_fp = NULL;
@@ -303,14 +596,38 @@ bool TruncateClassAdLog(
 	if ( ! success) {
 		fclose(new_log_fp);
 		unlink(tmp_log_filename.Value());
+		delete new_binary;
 		return false;
 	}
 
 	fclose(new_log_fp);	// avoid sharing violation on move
-	if (rotate_file(tmp_log_filename.Value(), filename) < 0) {
+	if ( ! ReplaceClassAdLog(tmp_log_filename.Value(), filename, log_fp, errmsg)) {
+		delete new_binary;
+		return false;
+	}
+
+	// we successfully wrote and rotated, so we can update our sequence number
+	// and the format we append in
+	historical_sequence_number = future_sequence_number;
+	delete binary;
+	binary = new_binary;
+	return true;
+}
+
+
+// Move a newly written log into place and reopen it for appending.  If it
+// cannot be moved, the old log is reopened instead and false is returned.
+// log_fp must already be closed.
+static bool ReplaceClassAdLog(
+	const char * tmp_log_filename,
+	const char * filename,
+	FILE* &log_fp,
+	MyString & errmsg)
+{
+	if (rotate_file(tmp_log_filename, filename) < 0) {
 		errmsg.formatstr("failed to rotate job queue log!\n");
 
-		unlink(tmp_log_filename.Value());
+		unlink(tmp_log_filename);
 
 		int log_fd = safe_open_wrapper_follow(filename, O_RDWR | O_APPEND | O_LARGEFILE | _O_NOINHERIT, 0600);
 		if (log_fd < 0) {
@@ -326,9 +643,6 @@ bool TruncateClassAdLog(
 		return false;
 	}
 
-	// we successfully wrote and rotated, so we can update our sequence number
-	historical_sequence_number = future_sequence_number;
-
 #ifndef WIN32
 	// POSIX does not provide any durability guarantees for rename().  Instead, we must
 	// open the parent directory and invoke fsync there.
@@ -373,6 +687,151 @@ bool TruncateClassAdLog(
 }
 
 
+// Write the current state of the table to filename.compact, to become
+// the next log, for the background rotation in ClassAdLog.  If the log is
+// binary, names is a copy of its format as it was when the rotation
+// started, and the new log uses the same name ids.
+bool WriteBackgroundClassAdLog(
+	const char * filename,
+	LoggableClassAdTable & la,
+	const ConstructLogEntry& maker,
+	unsigned long historical_sequence_number,
+	time_t m_original_log_birthdate,
+	const ClassAdLogBinaryFormat * names,
+	MyString & errmsg)
+{
+	MyString tmp_log_filename;
+	tmp_log_filename.formatstr("%s.compact", filename);
+	FILE * fp = safe_fcreate_replace_if_exists(tmp_log_filename.Value(), "w", 0600);
+	if ( ! fp) {
+		errmsg.formatstr("failed to create %s, errno = %d (%s)\n", tmp_log_filename.Value(), errno, strerror(errno));
+		return false;
+	}
+
+	ClassAdLogBinaryFormat * binary = NULL;
+	bool success = true;
+	if (names) {
+		binary = new ClassAdLogBinaryFormat(*names);
+		if (binary->WriteHeader(fp) < 0 || binary->WriteNames(fp) < 0) {
+			errmsg.formatstr("write to %s failed, errno = %d", tmp_log_filename.Value(), errno);
+			success = false;
+		}
+	}
+
+	success = success && WriteClassAdLogState(fp, tmp_log_filename.Value(),
+		historical_sequence_number + 1, m_original_log_birthdate,
+		la, maker, errmsg, binary);
+
+	// every attribute in the table was written to the current log at some
+	// point, so it should have a name id already.  if not, the records
+	// appended since the rotation started cannot be copied as they are.
+	if (success && binary && binary->NameCount() != names->NameCount()) {
+		errmsg.formatstr("%s has attributes not named in %s\n", tmp_log_filename.Value(), filename);
+		success = false;
+	}
+	delete binary;
+
+	if (success && (fflush(fp) != 0 || condor_fsync(fileno(fp)) < 0)) {
+		errmsg.formatstr("failed to sync %s, errno = %d\n", tmp_log_filename.Value(), errno);
+		success = false;
+	}
+	fclose(fp);
+	if ( ! success) {
+		unlink(tmp_log_filename.Value());
+	}
+	return success;
+}
+
+// Finish a background rotation: copy the records appended to the log
+// since offset onto the end of filename.compact, and make that the log.
+// names is as it was passed to WriteBackgroundClassAdLog.  On failure the
+// log is left as it was.
+bool FinishBackgroundClassAdLog(
+	const char * filename,
+	const ConstructLogEntry& maker,
+	FILE* &log_fp,
+	long long offset,
+	unsigned long & historical_sequence_number,
+	ClassAdLogBinaryFormat * & binary,
+	const ClassAdLogBinaryFormat * names,
+	MyString & errmsg)
+{
+	MyString tmp_log_filename;
+	tmp_log_filename.formatstr("%s.compact", filename);
+
+	FILE * new_log_fp = safe_fopen_wrapper_follow(tmp_log_filename.Value(), "ab");
+	if ( ! new_log_fp) {
+		errmsg.formatstr("failed to open %s, errno = %d (%s)\n", tmp_log_filename.Value(), errno, strerror(errno));
+		unlink(tmp_log_filename.Value());
+		return false;
+	}
+	FILE * old_log_fp = safe_fopen_wrapper_follow(filename, "rb");
+	if ( ! old_log_fp || fseek(old_log_fp, offset, SEEK_SET) < 0) {
+		errmsg.formatstr("failed to read %s, errno = %d (%s)\n", filename, errno, strerror(errno));
+		if (old_log_fp) fclose(old_log_fp);
+		fclose(new_log_fp);
+		unlink(tmp_log_filename.Value());
+		return false;
+	}
+
+	bool success = true;
+	ClassAdLogBinaryFormat * new_binary = NULL;
+	if (binary) {
+		// binary records refer to names by id, so they have to be read
+		// and written again rather than copied
+		ClassAdLogBinaryFormat reader(*names);
+		new_binary = new ClassAdLogBinaryFormat(*names);
+		LogRecord * rec;
+		while (success && (rec = reader.Read(old_log_fp, maker)) != NULL) {
+			if (rec->get_op_type() == CondorLogOp_Error ||
+				WriteLogRecord(new_log_fp, rec, new_binary) < 0)
+			{
+				errmsg.formatstr("failed to copy the end of %s to %s\n", filename, tmp_log_filename.Value());
+				success = false;
+			}
+			delete rec;
+		}
+	} else {
+		char buf[64*1024];
+		size_t cb;
+		while (success && (cb = fread(buf, 1, sizeof(buf), old_log_fp)) > 0) {
+			if (fwrite(buf, 1, cb, new_log_fp) != cb) {
+				errmsg.formatstr("write to %s failed, errno = %d\n", tmp_log_filename.Value(), errno);
+				success = false;
+			}
+		}
+		if (ferror(old_log_fp)) {
+			errmsg.formatstr("failed to read %s, errno = %d\n", filename, errno);
+			success = false;
+		}
+	}
+	fclose(old_log_fp);
+
+	if (success && (fflush(new_log_fp) != 0 || condor_fsync(fileno(new_log_fp)) < 0)) {
+		errmsg.formatstr("failed to sync %s, errno = %d\n", tmp_log_filename.Value(), errno);
+		success = false;
+	}
+	fclose(new_log_fp);
+	if ( ! success) {
+		unlink(tmp_log_filename.Value());
+		delete new_binary;
+		return false;
+	}
+
+	fclose(log_fp);
+	log_fp = NULL;
+	if ( ! ReplaceClassAdLog(tmp_log_filename.Value(), filename, log_fp, errmsg)) {
+		delete new_binary;
+		return false;
+	}
+
+	historical_sequence_number += 1;
+	delete binary;
+	binary = new_binary;
+	return true;
+}
+
+
 bool AddAttrNamesFromLogTransaction(
 	Transaction* active_transaction,
 	const char * key,
@@ -543,14 +1002,15 @@ bool WriteClassAdLogState(
 	time_t m_original_log_birthdate, // in
 	LoggableClassAdTable & la,
 	const ConstructLogEntry& maker,
-	MyString & errmsg)
+	MyString & errmsg,
+	ClassAdLogBinaryFormat * binary)
 {
 	LogRecord	*log=NULL;
 	ExprTree	*expr=NULL;
 
 	// This must always be the first entry in the log.
 	log = new LogHistoricalSequenceNumber( historical_sequence_number, m_original_log_birthdate );
-	if (log->Write(fp) < 0) {
+	if (WriteLogRecord(fp, log, binary) < 0) {
 		errmsg.formatstr("write to %s failed, errno = %d", filename, errno);
 		delete log;
 		return false;
@@ -563,7 +1023,7 @@ bool WriteClassAdLogState(
 	la.startIterations();
 	while(la.nextIteration(key, ad)) {
 		log = new LogNewClassAd(key, GetMyTypeName(*ad), GetTargetTypeName(*ad), maker);
-		if (log->Write(fp) < 0) {
+		if (WriteLogRecord(fp, log, binary) < 0) {
 			errmsg.formatstr("write to %s failed, errno = %d", filename, errno);
 			delete log;
 			return false;
@@ -582,7 +1042,7 @@ bool WriteClassAdLogState(
 			if (expr) {
 				log = new LogSetAttribute(key, itr->first.c_str(),
 										  ExprTreeToString(expr));
-				if (log->Write(fp) < 0) {
+				if (WriteLogRecord(fp, log, binary) < 0) {
 					errmsg.formatstr("write to %s failed, errno = %d", filename, errno);
 					delete log;
 					return false;
@@ -804,6 +1264,34 @@ LogSetAttribute::LogSetAttribute(const char *k, const char *n, const char *val,
 		value = strdup("UNDEFINED");
 	}
 	is_dirty = dirty;
+	play_expr = false;
+}
+
+void
+LogSetAttribute::set_value(const char *val, ExprTree *expr)
+{
+	free(value);
+	value = strdup(val);
+	if (value_expr) delete value_expr;
+	value_expr = expr;
+	play_expr = expr != NULL;
+}
+
+bool
+LogSetAttribute::ParseValue()
+{
+	if (play_expr) {
+		return true;
+	}
+	if (value_expr) delete value_expr;
+	value_expr = NULL;
+	if (ParseClassAdRvalExpr(value, value_expr)) {
+		if (value_expr) delete value_expr;
+		value_expr = NULL;
+		return false;
+	}
+	play_expr = true;
+	return true;
 }
 
 
@@ -826,7 +1314,23 @@ LogSetAttribute::Play(void *data_structure)
 		return -1;
 
 	std::string attr(name);
-	if (ad->InsertViaCache(attr, value)) {
+	if (play_expr) {
+		// the value was already parsed, either when it was read from a
+		// binary log or by ParseValue(), so only look in the expression
+		// cache, and add a copy of it on a miss
+		ExprTree * tree = NULL;
+		bool use_cache = classad::ClassAdGetExpressionCaching() && attr[0] != '\'';
+		if (use_cache) {
+			tree = classad::CachedExprEnvelope::check_hit(attr, value);
+		}
+		if ( ! tree) {
+			tree = value_expr->Copy();
+			if (use_cache) {
+				tree = classad::CachedExprEnvelope::cache(attr, tree, value);
+			}
+		}
+		rval = ad->Insert(attr, tree) ? TRUE : FALSE;
+	} else if (ad->InsertViaCache(attr, value)) {
 		rval = TRUE;
 	} else {
 		rval = FALSE;
@@ -910,6 +1414,10 @@ LogSetAttribute::ReadBody(FILE* fp)
 
 	if (value_expr) delete value_expr;
 	value_expr = NULL;
+	if (defer_value_parsing) {
+		// LoadClassAdLog() will call ParseValue() on a worker thread
+		return rval + rval1;
+	}
 	if (ParseClassAdRvalExpr(value, value_expr)) {
 		if (value_expr) delete value_expr;
 		value_expr = NULL;
@@ -1059,6 +1567,67 @@ LogDeleteAttribute::ReadBody(FILE* fp)
 	return rval + rval1;
 }
 
+// Deal with a corrupt log record that has just been read, leaving fp
+// just past it.  There are two basic failure modes.  The first mode is
+// some kind of parse failure that occurs at the end of the log, not
+// followed by an end-of-transaction operation.  In this case, the
+// incomplete transaction at the end is skipped and ignored with a warning
+// and fp is left at the end of the file.  The second mode is a failure
+// that occurs inside a complete transaction (one with an end-of-
+// transaction op).  A complete transaction with corruption is
+// unrecoverable, and causes a fatal exception.  Deletes log_rec.
+static void
+RecoverFromCorruptLogRecord(FILE *fp, LogRecord *log_rec, unsigned long recnum, long long pos)
+{
+	dprintf(D_ALWAYS | D_ERROR, "WARNING: Encountered corrupt log record %lu (byte offset %lld)\n", recnum, pos);
+	// TODO: this ugly code attempts to reconstruct the corrupted line, fix it to just show the actual line.
+	const char *key, *name="", *value="";
+	key = log_rec->get_key(); if ( ! key) key = "";
+	if (log_rec->get_op_type() == CondorLogOp_SetAttribute) {
+		LogSetAttribute * log = (LogSetAttribute *)log_rec;
+		name = log->get_name(); if ( ! name) name = "";
+		value = log->get_value(); if ( ! value) value = "";
+	}
+	dprintf(D_ALWAYS | D_ERROR, "    %d %s %s %s\n", log_rec->get_op_type(), key, name, value);
+
+	char	line[ATTRLIST_MAX_EXPRESSION + 64];
+	int		op;
+
+	delete log_rec;
+
+	// check if this bogus record is in the midst of a transaction
+	// (try to find a CloseTransaction log record)
+	const unsigned long maxfollow = 3;
+	dprintf(D_ALWAYS, "Lines following corrupt log record %lu (up to %lu):\n", recnum, maxfollow);
+	unsigned long nlines = 0;
+	while( fgets( line, ATTRLIST_MAX_EXPRESSION+64, fp ) ) {
+		nlines += 1;
+		if (nlines <= maxfollow) {
+			dprintf(D_ALWAYS, "    %s", line);
+			int ll = strlen(line);
+			if (ll <= 0  ||  line[ll-1] != '\n') dprintf(D_ALWAYS, "\n");
+		}
+		if (sscanf( line, "%d ", &op ) != 1  ||  !valid_record_optype(op)) {
+			// no op field in line; more bad log records...
+			continue;
+		}
+		if( op == CondorLogOp_EndTransaction ) {
+				// aargh!  bad record in transaction.  abort!
+			EXCEPT("Error: corrupt log record %lu (byte offset %lld) occurred inside closed transaction, recovery failed", recnum, pos);
+		}
+	}
+
+	if( !feof( fp ) ) {
+		EXCEPT("Error: failed recovering from corrupt log record %lu, errno=%d", recnum, errno);
+	}
+
+		// there wasn't an error in reading the file, and the bad log 
+		// record wasn't bracketed by a CloseTransaction; ignore all
+		// records starting from the bad record to the end-of-file, and
+		// pretend that we hit the end-of-file.
+	fseek( fp , 0, SEEK_END);
+}
+
 LogRecord	*
 InstantiateLogEntry(FILE *fp, unsigned long recnum, int type, const ConstructLogEntry & ctor)
 {
@@ -1096,66 +1665,58 @@ InstantiateLogEntry(FILE *fp, unsigned long recnum, int type, const ConstructLog
 
 	long long pos = ftell(fp);
 
-	// Check if we got a bogus record indicating a bad log file.  There are two basic
-    // failure modes.  The first mode is some kind of parse failure that occurs at the
-    // end of the log, not followed by an end-of-transaction operation.  In this case, the
-    // incomplete transaction at the end is skipped and ignored with a warning.  The second
-    // mode is a failure that occurs inside a complete transaction (one with an end-of-
-    // transaction op).  A complete transaction with corruption is unrecoverable, and 
-    // causes a fatal exception.
+	// Check if we got a bogus record indicating a bad log file.
 	if (log_rec->ReadBody(fp) < 0  ||  log_rec->get_op_type() == CondorLogOp_Error) {
-        dprintf(D_ALWAYS | D_ERROR, "WARNING: Encountered corrupt log record %lu (byte offset %lld)\n", recnum, pos);
-		// TODO: this ugly code attempts to reconstruct the corrupted line, fix it to just show the actual line.
-		const char *key, *name="", *value="";
-		key = log_rec->get_key(); if ( ! key) key = "";
-		if (log_rec->get_op_type() == CondorLogOp_SetAttribute) {
-			LogSetAttribute * log = (LogSetAttribute *)log_rec;
-			name = log->get_name(); if ( ! name) name = "";
-			value = log->get_value(); if ( ! value) value = "";
-		}
-		dprintf(D_ALWAYS | D_ERROR, "    %d %s %s %s\n", log_rec->get_op_type(), key, name, value);
-
-		char	line[ATTRLIST_MAX_EXPRESSION + 64];
-		int		op;
+		RecoverFromCorruptLogRecord(fp, log_rec, recnum, pos);
+		return( NULL );
+	}
 
-		delete log_rec;
+		// record was good
+	return log_rec;
+}
 
-        // check if this bogus record is in the midst of a transaction
-	    // (try to find a CloseTransaction log record)
-        const unsigned long maxfollow = 3;
-        dprintf(D_ALWAYS, "Lines following corrupt log record %lu (up to %lu):\n", recnum, maxfollow);
-        unsigned long nlines = 0;
-		while( fgets( line, ATTRLIST_MAX_EXPRESSION+64, fp ) ) {
-            nlines += 1;
-            if (nlines <= maxfollow) {
-                dprintf(D_ALWAYS, "    %s", line);
-                int ll = strlen(line);
-                if (ll <= 0  ||  line[ll-1] != '\n') dprintf(D_ALWAYS, "\n");
-            }
-			if (sscanf( line, "%d ", &op ) != 1  ||  !valid_record_optype(op)) {
-				// no op field in line; more bad log records...
-				continue;
-			}
-			if( op == CondorLogOp_EndTransaction ) {
-					// aargh!  bad record in transaction.  abort!
-				EXCEPT("Error: corrupt log record %lu (byte offset %lld) occurred inside closed transaction, recovery failed", recnum, pos);
-			}
+bool
+CopyClassAdLog(FILE *in, FILE *out, bool binary, const ConstructLogEntry & maker,
+	unsigned long & count, bool & torn, std::string & errmsg)
+{
+	count = 0;
+	torn = false;
+
+	ClassAdLogBinaryFormat reader;
+	bool in_binary = ClassAdLogBinaryFormat::IsBinaryLog(in);
+
+	ClassAdLogBinaryFormat writer;
+	ClassAdLogBinaryFormat * format = NULL;
+	if (binary) {
+		format = &writer;
+		if (format->WriteHeader(out) < 0) {
+			formatstr(errmsg, "cannot write the log header: %s", strerror(errno));
+			return false;
 		}
+	}
 
-		if( !feof( fp ) ) {
-			EXCEPT("Error: failed recovering from corrupt log record %lu, errno=%d", recnum, errno);
+	long long pos = ftell(in);
+	LogRecord * rec;
+	while ((rec = in_binary ? reader.Read(in, maker)
+	                        : ReadLogEntry(in, count+1, InstantiateLogEntry, maker)) != NULL) {
+		if (rec->get_op_type() == CondorLogOp_Error) {
+			formatstr(errmsg, "record %lu (byte offset %lld) is corrupt", count+1, pos);
+			delete rec;
+			return false;
 		}
-
-			// there wasn't an error in reading the file, and the bad log 
-			// record wasn't bracketed by a CloseTransaction; ignore all
-			// records starting from the bad record to the end-of-file, and
-			// pretend that we hit the end-of-file.
-		fseek( fp , 0, SEEK_END);
-		return( NULL );
+		if (WriteLogRecord(out, rec, format) < 0) {
+			formatstr(errmsg, "cannot write record %lu: %s", count+1, strerror(errno));
+			delete rec;
+			return false;
+		}
+		delete rec;
+		count++;
+		pos = ftell(in);
 	}
 
-		// record was good
-	return log_rec;
+	fseek(in, 0, SEEK_END);
+	torn = (ftell(in) != pos);
+	return true;
 }
 
 // Force instantiation of the simple form of ClassAdLog, used the the Accountant
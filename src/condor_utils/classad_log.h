@@ -46,9 +46,34 @@
 #include "log.h"
 #include "log_transaction.h"
 #include "stopwatch.h"
+#include "classad_log_binary.h"
+
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 extern const char *EMPTY_CLASSAD_TYPE_NAME;
 
+class ClassAdLogGroupCommit;
+
+// How long LoadClassAdLog() took, split into reading the records,
+// parsing their attribute values and playing them into the table.
+// With CLASSAD_LOG_LOAD_THREADS > 1 the values are parsed a batch at a
+// time on that many threads, otherwise they are parsed as they are read
+// and parse_time is 0.
+struct ClassAdLogLoadStats {
+	ClassAdLogLoadStats() : records(0), threads(1), read_time(0), parse_time(0), play_time(0) {}
+	unsigned long records;
+	int threads;
+	double read_time;
+	double parse_time;
+	double play_time;
+};
+
 // This class is used to abstract creation and destruction of 
 // members of he ClassAdLog hashtable so that types derived from ClassAd
 // but that that are not known to this header file can be used. 
@@ -97,6 +122,9 @@ public:
 			int m_timeslice_ms;
 			int m_done;
 			int m_options;
+			std::shared_ptr<std::vector<K> > m_keys;
+			size_t m_key_pos;
+			AD m_key_ad;
 
 		public:
 			filter_iterator(ClassAdLog<K,AD> &log, const classad::ExprTree *requirements, int timeslice_ms, bool at_end=false)
@@ -106,11 +134,17 @@ public:
 				, m_requirements(requirements)
 				, m_timeslice_ms(timeslice_ms)
 				, m_done(at_end)
-				, m_options(0) {}
+				, m_options(0)
+				, m_key_pos(0)
+				, m_key_ad(NULL) {}
 
 			~filter_iterator() {}
 			AD operator *() const {
-				if (m_done || (m_cur == m_table->end()) || !m_found_ad)
+				if (m_done || !m_found_ad)
+					return NULL;
+				if (m_keys)
+					return m_key_ad;
+				if (m_cur == m_table->end())
 					return NULL;
 				return (*m_cur).second;
 			}
@@ -121,12 +155,16 @@ public:
 				if (m_table != rhs.m_table) return false;
 				if (m_done && rhs.m_done) return true;
 				if (m_done != rhs.m_done) return false;
+				if (m_keys || rhs.m_keys) return m_keys == rhs.m_keys && m_key_pos == rhs.m_key_pos;
 				if (!(m_cur == rhs.m_cur) ) return false;
 				return true;
 			}
 			bool operator!=(const filter_iterator &rhs) {return !(*this == rhs);}
 			int set_options(int options) { int opts = m_options; m_options = options; return opts; }
 			int get_options() { return m_options; }
+				// visit only the ads with these keys, in this order, rather than
+				// the whole table.  keys that are no longer in the table are skipped.
+			void set_keys(const std::shared_ptr<std::vector<K> > & keys) { m_keys = keys; m_key_pos = 0; }
 	};
 
 
@@ -151,6 +189,15 @@ public:
 	*/
 	bool GetTransactionKeys( std::set<std::string> &keys );
 
+		// when enabled, remember the keys of the ads that are created,
+		// changed or destroyed by committed log records, so that a copy
+		// of the table can be brought up to date without comparing it all.
+	void TrackChangedKeys(bool track) { m_track_changed_keys = track; m_changed_keys.clear(); }
+		// the keys changed since tracking was enabled or the last call
+	void TakeChangedKeys(std::set<std::string> &keys) { keys.clear(); keys.swap(m_changed_keys); }
+		// for callers that change an ad in place without a log record
+	void MarkKeyChanged(const std::string &key) { if (m_track_changed_keys) m_changed_keys.insert(key); }
+
 		// increase non-durable commit level
 		// if > 0, begin non-durable commits
 		// return old level
@@ -204,6 +251,48 @@ public:
 
 	time_t GetOrigLogBirthdate() {return m_original_log_birthdate;}
 
+		// The log is read in whatever format it is in, see
+		// classad_log_binary.h.  Changing the format takes effect the
+		// next time the log is rotated.
+	void SetBinaryFormat(bool binary) { m_want_binary = binary; }
+	bool IsBinaryFormat() const { return m_binary != NULL; }
+
+		// Rotate the log without stopping to write it out.  When
+		// BeginBackgroundTruncLog() returns true, the caller forks, calls
+		// WriteBackgroundTruncLog() in the child to write the current
+		// state to a new log, and passes its result to
+		// FinishBackgroundTruncLog() in the parent.  Records appended to
+		// the log in the meantime are copied onto the end of the new log
+		// before it replaces the old one.  Returns false if the log must
+		// be rotated with TruncLog() instead.  A TruncLog() while a
+		// background rotation is in progress abandons it.
+	bool BeginBackgroundTruncLog();
+	bool WriteBackgroundTruncLog();
+	bool FinishBackgroundTruncLog(bool written);
+
+		// How long it took to load the log when it was opened
+	const ClassAdLogLoadStats & GetLoadStats() const { return m_load_stats; }
+
+		// Group commit: durable commits are written and flushed by the
+		// caller, but the fdatasync is left to a writer thread that syncs
+		// once for every commit that arrived while it was busy.  The
+		// caller learns that its commit is on disk from WaitForCommit()
+		// or a WhenCommitted() callback.  If notify_fd is valid, a byte is
+		// written to it after each sync so that the owner knows to call
+		// RunCommitCallbacks().
+	void SetGroupCommit(bool enable, int notify_fd = -1);
+	bool GroupCommit() const { return m_group_commit != NULL; }
+		// true if some commit so far is not yet on disk
+	bool CommitPending();
+		// block until every commit so far is on disk, EXCEPTs if the
+		// sync failed
+	void WaitForCommit();
+		// call fn once every commit so far is on disk, which is right now
+		// if group commit is off.
+	void WhenCommitted(const std::function<void()> & fn);
+		// returns the number of callbacks run
+	int RunCommitCallbacks();
+
 protected:
 	/** Returns handle to active transaction.  Upon return of this
 		method, any active transaction is forgotten.  It is the caller's
@@ -239,8 +328,18 @@ private:
 	unsigned long historical_sequence_number;
 	time_t m_original_log_birthdate;
 	int m_nondurable_level;
+	ClassAdLogGroupCommit * m_group_commit;
+	void CheckGroupCommit(); // EXCEPT if a group commit sync failed
+	ClassAdLogBinaryFormat * m_binary; // NULL if the log is text
+	bool m_want_binary;
+	ClassAdLogLoadStats m_load_stats;
+	long long m_background_offset; // end of the log when a background rotation began, or -1
+	ClassAdLogBinaryFormat * m_background_names; // name ids of a binary log at that point
+	bool m_track_changed_keys;
+	std::set<std::string> m_changed_keys;
 
 	bool SaveHistoricalLogs();
+	void QueueDurableCommit();
 };
 
 
@@ -364,6 +463,15 @@ public:
 	char const *get_name() { return name; }
 	char const *get_value() { return value; }
     ExprTree* get_expr() { return value_expr; }
+		// parse the value so that Play() does not have to.  Records may
+		// be parsed on several threads at once, but the classad function
+		// table must already have been initialized.  returns false if
+		// the value does not parse.
+	bool ParseValue();
+		// set a value that needs no parsing, as read from a binary log.
+		// the record takes ownership of expr, which may be NULL if all
+		// there is is the text.
+	void set_value(const char *val, ExprTree *expr);
 
 private:
 	virtual int WriteBody(FILE* fp);
@@ -373,6 +481,7 @@ private:
 	char *name;
 	char *value;
 	bool is_dirty;
+	bool play_expr; // Play() inserts value_expr rather than parsing value
     ExprTree* value_expr;    
 };
 
@@ -440,7 +549,9 @@ bool TruncateClassAdLog(
 	FILE* &log_fp,                  // in,out
 	unsigned long & historical_sequence_number, // in,out
 	time_t & m_original_log_birthdate, // in,out
-	MyString & errmsg);             // out
+	MyString & errmsg,              // out
+	ClassAdLogBinaryFormat * & binary, // in,out: format of the log, NULL for text
+	bool want_binary);              // in: format of the new log
 
 bool WriteClassAdLogState(
 	FILE *fp,                       // in
@@ -449,7 +560,8 @@ bool WriteClassAdLogState(
 	time_t original_log_birthdate,  // in
 	LoggableClassAdTable & la,      // in
 	const ConstructLogEntry& maker, // in
-	MyString & errmsg);             // out
+	MyString & errmsg,              // out
+	ClassAdLogBinaryFormat * binary = NULL); // in: write in this format rather than text
 
 FILE* LoadClassAdLog(
 	const char *filename,           // in
@@ -459,7 +571,28 @@ FILE* LoadClassAdLog(
 	time_t & m_original_log_birthdate, // in,out
 	bool & is_clean,  // out: true if log was shutdown cleanly
 	bool & requires_successful_cleaning, // out: true if log must be cleaned (i.e rotated) before it can be written to again.
-	MyString & errmsg);             // out, contains error or warning messages
+	MyString & errmsg,              // out, contains error or warning messages
+	ClassAdLogBinaryFormat * & binary, // out: format of the log, NULL for text
+	ClassAdLogLoadStats & stats);   // out: time spent loading the log
+
+bool WriteBackgroundClassAdLog(
+	const char * filename,          // in: the log, the new log is written to filename.compact
+	LoggableClassAdTable & la,      // in
+	const ConstructLogEntry& maker, // in
+	unsigned long historical_sequence_number, // in
+	time_t m_original_log_birthdate, // in
+	const ClassAdLogBinaryFormat * names, // in: name ids of a binary log, NULL for text
+	MyString & errmsg);             // out
+
+bool FinishBackgroundClassAdLog(
+	const char * filename,          // in
+	const ConstructLogEntry& maker, // in
+	FILE* &log_fp,                  // in,out
+	long long offset,               // in: end of the log when the new log was written
+	unsigned long & historical_sequence_number, // in,out
+	ClassAdLogBinaryFormat * & binary, // in,out: format of the log, NULL for text
+	const ClassAdLogBinaryFormat * names, // in: as passed to WriteBackgroundClassAdLog
+	MyString & errmsg);             // out
 
 int FlushClassAdLog(FILE* fp, bool force);
 
@@ -493,6 +626,64 @@ LogRecord* InstantiateLogEntry(
 	int type,
 	const ConstructLogEntry & ctor);
 
+// Copy the records of the log in to out, writing them in binary form if
+// binary is true and as text otherwise.  in may be in either form.  count
+// is set to the number of records copied, and torn is set if an incomplete
+// record at the end of in was skipped.  returns false with a message in
+// errmsg if a record is corrupt or cannot be written.
+bool CopyClassAdLog(
+	FILE *in,
+	FILE *out,
+	bool binary,
+	const ConstructLogEntry & maker,
+	unsigned long & count,
+	bool & torn,
+	std::string & errmsg);
+
+// The writer thread behind ClassAdLog::SetGroupCommit().  Commits are
+// numbered in the order they are queued, and a commit is durable once
+// an fdatasync that started after it was queued has finished.
+//
+// Everything but the writer thread itself runs on the thread that owns
+// the log; callbacks are only ever run from Wait() and RunCallbacks() on
+// that thread.  Once an fdatasync fails nothing more is synced, no later
+// commit becomes durable and Error() returns the errno; ClassAdLog makes
+// that fatal on the owner thread, as it is for a synchronous commit.
+class ClassAdLogGroupCommit {
+public:
+	ClassAdLogGroupCommit(const char * filename, int notify_fd);
+	// waits for every queued commit to be synced
+	~ClassAdLogGroupCommit();
+
+	// queue a sync of fd, returns the commit number
+	unsigned long Queue(int fd);
+	unsigned long LastQueued() const { return m_queued; }
+	bool IsDurable(unsigned long seq);
+	// returns false if a sync failed before seq was durable
+	bool Wait(unsigned long seq);
+	bool WaitAll() { return Wait(m_queued); }
+	void WhenDurable(unsigned long seq, const std::function<void()> & fn);
+	int RunCallbacks();
+	// errno of the failed fdatasync, 0 if none has failed
+	int Error();
+
+private:
+	void WriterThread();
+
+	std::string m_filename;
+	int m_notify_fd;
+	std::mutex m_mutex;
+	std::condition_variable m_work;  // signalled when a commit is queued
+	std::condition_variable m_done;  // signalled when a sync finishes
+	int m_fd;
+	unsigned long m_queued;
+	unsigned long m_durable;
+	int m_error;
+	bool m_exit;
+	std::multimap<unsigned long, std::function<void()> > m_callbacks;
+	std::thread m_thread;
+};
+
 // Templated member functions that call the helper functions with the correct arguments.
 //
 
@@ -504,6 +695,12 @@ ClassAdLog<K,AD>::ClassAdLog(const char *filename,int max_historical_logs_arg,co
 	log_filename_buf = filename;
 	active_transaction = NULL;
 	m_nondurable_level = 0;
+	m_group_commit = NULL;
+	m_binary = NULL;
+	m_want_binary = false;
+	m_background_offset = -1;
+	m_track_changed_keys = false;
+	m_background_names = NULL;
 
 	bool open_read_only = max_historical_logs_arg < 0;
 	if (open_read_only) { max_historical_logs_arg = -max_historical_logs_arg; }
@@ -518,7 +715,7 @@ ClassAdLog<K,AD>::ClassAdLog(const char *filename,int max_historical_logs_arg,co
 	log_fp = LoadClassAdLog(filename,
 		la, this->GetTableEntryMaker(),
 		historical_sequence_number, m_original_log_birthdate,
-		is_clean, requires_successful_cleaning, errmsg);
+		is_clean, requires_successful_cleaning, errmsg, m_binary, m_load_stats);
 
 	if ( ! log_fp) {
 		EXCEPT("%s", errmsg.Value());
@@ -543,6 +740,12 @@ ClassAdLog<K,AD>::ClassAdLog(const ConstructLogEntry* maker)
 	active_transaction = NULL;
 	log_fp = NULL;
 	m_nondurable_level = 0;
+	m_group_commit = NULL;
+	m_binary = NULL;
+	m_want_binary = false;
+	m_background_offset = -1;
+	m_track_changed_keys = false;
+	m_background_names = NULL;
 	max_historical_logs = 0;
 	historical_sequence_number = 0;
 }
@@ -551,6 +754,11 @@ template <typename K, typename AD>
 ClassAdLog<K,AD>::~ClassAdLog()
 {
 	if (active_transaction) delete active_transaction;
+	// waits for the writer thread to sync everything that was committed
+	WaitForCommit();
+	delete m_group_commit;
+	delete m_binary;
+	delete m_background_names;
 
 	// cache the effective table entry maker for use in the loop.
 	const ConstructLogEntry & dtor = this->GetTableEntryMaker();
@@ -584,13 +792,20 @@ ClassAdLog<K,AD>::AppendLog(LogRecord *log)
 	} else {
 			//MD: using file pointer
 		if (log_fp!=NULL) {
-			if (log->Write(log_fp) < 0) {
+			if (WriteLogRecord(log_fp, log, m_binary) < 0) {
 				EXCEPT("write to %s failed, errno = %d", logFilename(), errno);
 			}
 			if( m_nondurable_level == 0 ) {
-				ForceLog();  // flush and fsync
+				if (m_group_commit) {
+					QueueDurableCommit();
+				} else {
+					ForceLog();  // flush and fsync
+				}
 			}
 		}
+		if (m_track_changed_keys && log->get_key()) {
+			m_changed_keys.insert(log->get_key());
+		}
 		ClassAdLogTable<K,AD> la(table);
 		log->Play((void *)&la);
 		delete log;
@@ -619,6 +834,78 @@ ClassAdLog<K,AD>::ForceLog()
 	}
 }
 
+template <typename K, typename AD>
+void
+ClassAdLog<K,AD>::QueueDurableCommit()
+{
+	// flush here so the writer thread never touches the FILE buffer
+	FlushLog();
+	m_group_commit->Queue(fileno(log_fp));
+}
+
+template <typename K, typename AD>
+void
+ClassAdLog<K,AD>::SetGroupCommit(bool enable, int notify_fd)
+{
+	if (enable && ! m_group_commit && log_fp) {
+		m_group_commit = new ClassAdLogGroupCommit(logFilename(), notify_fd);
+	} else if ( ! enable && m_group_commit) {
+		WaitForCommit();  // runs the callbacks
+		delete m_group_commit;
+		m_group_commit = NULL;
+	}
+}
+
+template <typename K, typename AD>
+void
+ClassAdLog<K,AD>::CheckGroupCommit()
+{
+	int err = m_group_commit ? m_group_commit->Error() : 0;
+	if (err) {
+		EXCEPT("fdatasync of %s failed, errno = %d", logFilename(), err);
+	}
+}
+
+template <typename K, typename AD>
+bool
+ClassAdLog<K,AD>::CommitPending()
+{
+	CheckGroupCommit();
+	return m_group_commit && ! m_group_commit->IsDurable(m_group_commit->LastQueued());
+}
+
+template <typename K, typename AD>
+void
+ClassAdLog<K,AD>::WaitForCommit()
+{
+	if (m_group_commit && ! m_group_commit->WaitAll()) {
+		CheckGroupCommit();
+	}
+}
+
+template <typename K, typename AD>
+void
+ClassAdLog<K,AD>::WhenCommitted(const std::function<void()> & fn)
+{
+	if (m_group_commit) {
+		CheckGroupCommit();
+		m_group_commit->WhenDurable(m_group_commit->LastQueued(), fn);
+	} else {
+		fn();
+	}
+}
+
+template <typename K, typename AD>
+int
+ClassAdLog<K,AD>::RunCommitCallbacks()
+{
+	if ( ! m_group_commit) {
+		return 0;
+	}
+	CheckGroupCommit();
+	return m_group_commit->RunCallbacks();
+}
+
 template <typename K, typename AD>
 bool
 ClassAdLog<K,AD>::SaveHistoricalLogs()
@@ -637,12 +924,19 @@ ClassAdLog<K,AD>::TruncLog()
 		return false;
 	}
 
+	// the writer thread may still be syncing the log we are about to close
+	WaitForCommit();
+
+	// a background rotation in progress would copy the end of the log
+	// this one replaces, so it is abandoned
+	m_background_offset = -1;
+
 	MyString errmsg;
 	ClassAdLogTable<K,AD> la(table); // this gives the ability to add & remove table items.
 	bool rotated = TruncateClassAdLog(logFilename(),
 		la, this->GetTableEntryMaker(),
 		log_fp, historical_sequence_number, m_original_log_birthdate,
-		errmsg);
+		errmsg, m_binary, m_want_binary);
 	if ( ! log_fp) {
 		// if after rotation, the log is no longer open, the the failure is fatal, and we must except
 		EXCEPT("%s", errmsg.Value());
@@ -654,6 +948,83 @@ ClassAdLog<K,AD>::TruncLog()
 	return rotated;
 }
 
+template <typename K, typename AD>
+bool
+ClassAdLog<K,AD>::BeginBackgroundTruncLog()
+{
+	if (m_background_offset >= 0 || ! log_fp || (m_binary != NULL) != m_want_binary) {
+		return false;
+	}
+
+	// everything up to here goes into the new log from the table, the
+	// rest is copied from the old log when the rotation finishes
+	if (fflush(log_fp) != 0) {
+		return false;
+	}
+	fseek(log_fp, 0, SEEK_END);
+	m_background_offset = ftell(log_fp);
+	if (m_binary) {
+		m_background_names = new ClassAdLogBinaryFormat(*m_binary);
+	}
+	dprintf(D_ALWAYS, "About to rotate ClassAd log %s in the background\n", logFilename());
+	return true;
+}
+
+template <typename K, typename AD>
+bool
+ClassAdLog<K,AD>::WriteBackgroundTruncLog()
+{
+	MyString errmsg;
+	ClassAdLogTable<K,AD> la(table);
+	if ( ! WriteBackgroundClassAdLog(logFilename(), la, this->GetTableEntryMaker(),
+			historical_sequence_number, m_original_log_birthdate,
+			m_background_names, errmsg)) {
+		dprintf(D_ALWAYS, "Failed to write new ClassAd log %s: %s", logFilename(), errmsg.Value());
+		return false;
+	}
+	return true;
+}
+
+template <typename K, typename AD>
+bool
+ClassAdLog<K,AD>::FinishBackgroundTruncLog(bool written)
+{
+	bool rotated = false;
+	if (m_background_offset < 0) {
+		// abandoned by TruncLog(), throw the new log away
+		if (written) {
+			MyString tmp_log_filename;
+			tmp_log_filename.formatstr("%s.compact", logFilename());
+			unlink(tmp_log_filename.Value());
+		}
+	} else if ( ! written) {
+		dprintf(D_ALWAYS, "Background rotation of ClassAd log %s failed\n", logFilename());
+	} else if ( ! SaveHistoricalLogs()) {
+		dprintf(D_ALWAYS,"Skipping log rotation, because saving of historical log failed for %s.\n",logFilename());
+	} else {
+		WaitForCommit();
+		fflush(log_fp);
+		MyString errmsg;
+		rotated = FinishBackgroundClassAdLog(logFilename(), this->GetTableEntryMaker(),
+			log_fp, m_background_offset, historical_sequence_number,
+			m_binary, m_background_names, errmsg);
+		if ( ! log_fp) {
+			EXCEPT("%s", errmsg.Value());
+		}
+		if ( ! errmsg.empty()) {
+			dprintf(D_ALWAYS, "%s", errmsg.Value());
+		}
+		if (rotated) {
+			dprintf(D_ALWAYS, "Rotated ClassAd log %s in the background\n", logFilename());
+		}
+	}
+
+	m_background_offset = -1;
+	delete m_background_names;
+	m_background_names = NULL;
+	return rotated;
+}
+
 template <typename K, typename AD>
 void
 ClassAdLog<K,AD>::LogState(FILE *fp)
@@ -720,9 +1091,15 @@ ClassAdLog<K,AD>::CommitTransaction(const char * comment /*=NULL*/)
 		LogEndTransaction *log = new LogEndTransaction;
 		log->set_comment(comment);
 		active_transaction->AppendLog(log);
+		if (m_track_changed_keys) {
+			active_transaction->KeysInTransaction(m_changed_keys, true);
+		}
 		bool nondurable = m_nondurable_level > 0;
 		ClassAdLogTable<K,AD> la(table);
-		active_transaction->Commit(log_fp, logFilename(), &la, nondurable );
+		active_transaction->Commit(log_fp, logFilename(), &la, nondurable || m_group_commit, m_binary);
+		if ( ! nondurable && m_group_commit && log_fp) {
+			QueueDurableCommit();
+		}
 	}
 	delete active_transaction;
 	active_transaction = NULL;
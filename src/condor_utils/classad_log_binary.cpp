@@ -0,0 +1,545 @@
+/***************************************************************
+ *
+ * Copyright (C) 1990-2020, Condor Team, Computer Sciences Department,
+ * University of Wisconsin-Madison, WI.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You may
+ * obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************/
+
+#include "condor_common.h"
+#include "condor_debug.h"
+#include "classad_log.h"
+#include "classad_log_binary.h"
+
+// op type of the record that defines an attribute name, only binary logs
+// have these.  the other op types are the CondorLogOp_* ones from log.h
+#define BinaryLogOp_AttributeName 1
+
+// how a SetAttribute value is stored
+enum {
+	BinaryValue_Expr = 'E',
+	BinaryValue_Undefined = 'U',
+	BinaryValue_True = 'T',
+	BinaryValue_False = 'F',
+	BinaryValue_Integer = 'I',
+	BinaryValue_Real = 'R',
+	BinaryValue_String = 'S',
+};
+
+// no record is anywhere near this big, so a length beyond it is garbage
+#define BINARY_LOG_MAX_RECORD (256*1024*1024)
+
+static void
+putVarint(std::string & buf, unsigned long long val)
+{
+	while (val >= 0x80) {
+		buf += (char)((val & 0x7f) | 0x80);
+		val >>= 7;
+	}
+	buf += (char)val;
+}
+
+static void
+putSigned(std::string & buf, long long val)
+{
+	putVarint(buf, ((unsigned long long)val << 1) ^ (unsigned long long)(val >> 63));
+}
+
+static void
+putString(std::string & buf, const char * str, size_t len)
+{
+	putVarint(buf, len);
+	buf.append(str, len);
+}
+
+static void
+putString(std::string & buf, const char * str)
+{
+	putString(buf, str ? str : "", str ? strlen(str) : 0);
+}
+
+static bool
+getVarint(const std::string & buf, size_t & pos, unsigned long long & val)
+{
+	val = 0;
+	for (int shift = 0; shift < 64; shift += 7) {
+		if (pos >= buf.size()) {
+			return false;
+		}
+		unsigned char ch = (unsigned char)buf[pos++];
+		val |= (unsigned long long)(ch & 0x7f) << shift;
+		if ( ! (ch & 0x80)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static bool
+getSigned(const std::string & buf, size_t & pos, long long & val)
+{
+	unsigned long long uval;
+	if ( ! getVarint(buf, pos, uval)) {
+		return false;
+	}
+	val = (long long)(uval >> 1) ^ -(long long)(uval & 1);
+	return true;
+}
+
+static bool
+getString(const std::string & buf, size_t & pos, std::string & str)
+{
+	unsigned long long len;
+	if ( ! getVarint(buf, pos, len) || len > buf.size() - pos) {
+		return false;
+	}
+	str.assign(buf, pos, (size_t)len);
+	pos += (size_t)len;
+	return true;
+}
+
+// write one record, the length followed by the payload
+static int
+writeRecord(FILE *fp, const std::string & payload)
+{
+	std::string len;
+	putVarint(len, payload.size());
+	if (fwrite(len.data(), 1, len.size(), fp) < len.size() ||
+		fwrite(payload.data(), 1, payload.size(), fp) < payload.size())
+	{
+		return -1;
+	}
+	return (int)(len.size() + payload.size());
+}
+
+// append the value of a SetAttribute, as a literal if it is one
+static void
+putValue(std::string & buf, LogSetAttribute * log)
+{
+	classad::ExprTree * expr = log->get_expr();
+	if ( ! expr) {
+		// the constructor turns values that don't parse into UNDEFINED
+		buf += (char)BinaryValue_Undefined;
+		return;
+	}
+	if (expr->GetKind() == classad::ExprTree::LITERAL_NODE) {
+		classad::Value val;
+		((classad::Literal *)expr)->GetValue(val);
+		bool bval;
+		long long ival;
+		double rval;
+		const char * sval;
+		switch (val.GetType()) {
+		case classad::Value::UNDEFINED_VALUE:
+			buf += (char)BinaryValue_Undefined;
+			return;
+		case classad::Value::BOOLEAN_VALUE:
+			val.IsBooleanValue(bval);
+			buf += (char)(bval ? BinaryValue_True : BinaryValue_False);
+			return;
+		case classad::Value::INTEGER_VALUE:
+			val.IsIntegerValue(ival);
+			buf += (char)BinaryValue_Integer;
+			putSigned(buf, ival);
+			return;
+		case classad::Value::REAL_VALUE:
+			val.IsRealValue(rval);
+			buf += (char)BinaryValue_Real;
+			buf.append((const char *)&rval, sizeof(rval));
+			return;
+		case classad::Value::STRING_VALUE:
+			val.IsStringValue(sval);
+			buf += (char)BinaryValue_String;
+			putString(buf, sval);
+			return;
+		default:
+			// error, time and the rest are rare enough to keep as text
+			break;
+		}
+	}
+	buf += (char)BinaryValue_Expr;
+	putString(buf, log->get_value());
+}
+
+// read the value of a SetAttribute into the record
+static bool
+getValue(const std::string & buf, size_t & pos, LogSetAttribute * log)
+{
+	if (pos >= buf.size()) {
+		return false;
+	}
+	char kind = buf[pos++];
+	classad::ExprTree * expr = NULL;
+	std::string str;
+	switch (kind) {
+	case BinaryValue_Expr:
+		if ( ! getString(buf, pos, str)) {
+			return false;
+		}
+		log->set_value(str.c_str(), NULL);
+		return true;
+	case BinaryValue_Undefined:
+		expr = classad::Literal::MakeUndefined();
+		break;
+	case BinaryValue_True:
+	case BinaryValue_False:
+		expr = classad::Literal::MakeBool(kind == BinaryValue_True);
+		break;
+	case BinaryValue_Integer: {
+		long long ival;
+		if ( ! getSigned(buf, pos, ival)) {
+			return false;
+		}
+		expr = classad::Literal::MakeLong(ival);
+		break;
+	}
+	case BinaryValue_Real: {
+		double rval;
+		if (buf.size() - pos < sizeof(rval)) {
+			return false;
+		}
+		memcpy(&rval, buf.data() + pos, sizeof(rval));
+		pos += sizeof(rval);
+		expr = classad::Literal::MakeReal(rval);
+		break;
+	}
+	case BinaryValue_String:
+		if ( ! getString(buf, pos, str)) {
+			return false;
+		}
+		expr = classad::Literal::MakeString(str);
+		break;
+	default:
+		return false;
+	}
+
+	// the text form is still needed by whoever examines the transaction
+	ExprTreeToString(expr, str);
+	log->set_value(str.c_str(), expr);
+	return true;
+}
+
+
+ClassAdLogBinaryFormat::ClassAdLogBinaryFormat()
+	: m_pos(0)
+{
+}
+
+bool
+ClassAdLogBinaryFormat::IsBinaryLog(FILE *fp)
+{
+	long pos = ftell(fp);
+	char magic[CLASSAD_LOG_BINARY_MAGIC_LEN];
+	if (fread(magic, 1, sizeof(magic), fp) == sizeof(magic) &&
+		memcmp(magic, CLASSAD_LOG_BINARY_MAGIC, sizeof(magic)) == 0)
+	{
+		return true;
+	}
+	fseek(fp, pos, SEEK_SET);
+	return false;
+}
+
+int
+ClassAdLogBinaryFormat::WriteHeader(FILE *fp)
+{
+	if (fwrite(CLASSAD_LOG_BINARY_MAGIC, 1, CLASSAD_LOG_BINARY_MAGIC_LEN, fp) < CLASSAD_LOG_BINARY_MAGIC_LEN) {
+		return -1;
+	}
+	return CLASSAD_LOG_BINARY_MAGIC_LEN;
+}
+
+int
+ClassAdLogBinaryFormat::WriteNames(FILE *fp)
+{
+	int written = 0;
+	std::string payload;
+	for (size_t id = 0; id < m_names.size(); ++id) {
+		payload.clear();
+		putVarint(payload, BinaryLogOp_AttributeName);
+		putVarint(payload, id);
+		putString(payload, m_names[id].c_str(), m_names[id].size());
+		int rval = writeRecord(fp, payload);
+		if (rval < 0) {
+			return -1;
+		}
+		written += rval;
+	}
+	return written;
+}
+
+// returns the id of the attribute name, writing a name record first if
+// this is the first time the name is used in this file.
+unsigned int
+ClassAdLogBinaryFormat::NameId(FILE *fp, const char *name, int & written)
+{
+	std::string attr(name ? name : "");
+	auto it = m_ids.find(attr);
+	if (it != m_ids.end()) {
+		return it->second;
+	}
+
+	unsigned int id = (unsigned int)m_names.size();
+	std::string payload;
+	putVarint(payload, BinaryLogOp_AttributeName);
+	putVarint(payload, id);
+	putString(payload, attr.c_str(), attr.size());
+	int rval = writeRecord(fp, payload);
+	if (rval < 0) {
+		written = -1;
+		return 0;
+	}
+	written += rval;
+
+	m_names.push_back(attr);
+	m_ids[attr] = id;
+	return id;
+}
+
+int
+ClassAdLogBinaryFormat::Write(FILE *fp, LogRecord *rec)
+{
+	int written = 0;
+	std::string & payload = m_buf;
+	payload.clear();
+	putVarint(payload, rec->get_op_type());
+
+	switch (rec->get_op_type()) {
+	case CondorLogOp_NewClassAd: {
+		LogNewClassAd * log = (LogNewClassAd *)rec;
+		putString(payload, log->get_key());
+		putString(payload, log->get_mytype());
+		putString(payload, log->get_targettype());
+		break;
+	}
+	case CondorLogOp_DestroyClassAd:
+		putString(payload, rec->get_key());
+		break;
+	case CondorLogOp_SetAttribute: {
+		LogSetAttribute * log = (LogSetAttribute *)rec;
+		unsigned int id = NameId(fp, log->get_name(), written);
+		if (written < 0) {
+			return -1;
+		}
+		putString(payload, log->get_key());
+		putVarint(payload, id);
+		putValue(payload, log);
+		break;
+	}
+	case CondorLogOp_DeleteAttribute: {
+		LogDeleteAttribute * log = (LogDeleteAttribute *)rec;
+		unsigned int id = NameId(fp, log->get_name(), written);
+		if (written < 0) {
+			return -1;
+		}
+		putString(payload, log->get_key());
+		putVarint(payload, id);
+		break;
+	}
+	case CondorLogOp_BeginTransaction:
+		break;
+	case CondorLogOp_EndTransaction:
+		putString(payload, ((LogEndTransaction *)rec)->get_comment());
+		break;
+	case CondorLogOp_LogHistoricalSequenceNumber: {
+		LogHistoricalSequenceNumber * log = (LogHistoricalSequenceNumber *)rec;
+		putVarint(payload, log->get_historical_sequence_number());
+		putSigned(payload, log->get_timestamp());
+		break;
+	}
+	default:
+		dprintf(D_ALWAYS, "Cannot write log record of type %d in binary\n", rec->get_op_type());
+		return -1;
+	}
+
+	int rval = writeRecord(fp, payload);
+	if (rval < 0) {
+		return -1;
+	}
+	return written + rval;
+}
+
+// read the next whole record into m_buf.  returns 1 if it did, 0 at the
+// end of the file or if the record there is cut short, and -1 if the
+// length of the record is corrupt.
+int
+ClassAdLogBinaryFormat::ReadRecord(FILE *fp)
+{
+	unsigned long long len = 0;
+	for (int shift = 0; ; shift += 7) {
+		int ch = fgetc(fp);
+		if (ch == EOF) {
+			return 0;
+		}
+		if (shift >= 64) {
+			return -1;
+		}
+		len |= (unsigned long long)(ch & 0x7f) << shift;
+		if ( ! (ch & 0x80)) {
+			break;
+		}
+	}
+	if (len == 0 || len > BINARY_LOG_MAX_RECORD) {
+		return -1;
+	}
+
+	m_buf.resize((size_t)len);
+	if (fread(&m_buf[0], 1, m_buf.size(), fp) < m_buf.size()) {
+		return 0;
+	}
+	m_pos = 0;
+	return 1;
+}
+
+// The same recovery as RecoverFromCorruptLogRecord() for a text log.  If
+// no later record ends a transaction, the corrupt record and everything
+// after it are dropped as if they were a torn write at the end of the log,
+// and fp is left at the end of the file so the caller sees an unterminated
+// record.  A corrupt record inside a committed transaction is fatal.  When
+// the length of the record is what is corrupt the records after it cannot
+// be found, so they are dropped.
+void
+ClassAdLogBinaryFormat::RecoverFromCorruptRecord(FILE *fp, long long pos, bool framed)
+{
+	dprintf(D_ALWAYS | D_ERROR, "WARNING: Encountered corrupt %s in binary log (byte offset %lld)\n",
+		framed ? "log record" : "log record length", pos);
+
+	if (framed) {
+		int got;
+		while ((got = ReadRecord(fp)) > 0) {
+			unsigned long long op;
+			if (getVarint(m_buf, m_pos, op) && op == CondorLogOp_EndTransaction) {
+				EXCEPT("Error: corrupt log record (byte offset %lld) occurred inside closed transaction, recovery failed", pos);
+			}
+		}
+		if (got < 0) {
+			dprintf(D_ALWAYS | D_ERROR, "WARNING: binary log has a corrupt record length after byte offset %lld\n", pos);
+		}
+	}
+	m_buf.clear();
+	m_pos = 0;
+	fseek(fp, 0, SEEK_END);
+}
+
+LogRecord *
+ClassAdLogBinaryFormat::Read(FILE *fp, const ConstructLogEntry & ctor)
+{
+	for (;;) {
+		long long pos = ftell(fp);
+		int got = ReadRecord(fp);
+		if (got == 0) {
+			return NULL;
+		}
+		if (got < 0) {
+			RecoverFromCorruptRecord(fp, pos, false);
+			return NULL;
+		}
+
+		unsigned long long op;
+		if ( ! getVarint(m_buf, m_pos, op)) {
+			RecoverFromCorruptRecord(fp, pos, true);
+			return NULL;
+		}
+		if (op != BinaryLogOp_AttributeName) {
+			LogRecord * rec = Decode((int)op, ctor);
+			if ( ! rec) {
+				RecoverFromCorruptRecord(fp, pos, true);
+			}
+			return rec;
+		}
+
+		// name records are ours, keep going until there is a real record
+		unsigned long long id;
+		std::string name;
+		if ( ! getVarint(m_buf, m_pos, id) || id != m_names.size() ||
+			 ! getString(m_buf, m_pos, name))
+		{
+			RecoverFromCorruptRecord(fp, pos, true);
+			return NULL;
+		}
+		m_names.push_back(name);
+		m_ids[name] = (unsigned int)id;
+	}
+}
+
+LogRecord *
+ClassAdLogBinaryFormat::Decode(int op, const ConstructLogEntry & ctor)
+{
+	std::string key, str1, str2;
+	unsigned long long id;
+	LogRecord * rec = NULL;
+
+	switch (op) {
+	case CondorLogOp_NewClassAd:
+		if (getString(m_buf, m_pos, key) && getString(m_buf, m_pos, str1) && getString(m_buf, m_pos, str2)) {
+			rec = new LogNewClassAd(key.c_str(), str1.c_str(), str2.c_str(), ctor);
+		}
+		break;
+	case CondorLogOp_DestroyClassAd:
+		if (getString(m_buf, m_pos, key)) {
+			rec = new LogDestroyClassAd(key.c_str(), ctor);
+		}
+		break;
+	case CondorLogOp_SetAttribute:
+		if (getString(m_buf, m_pos, key) && getVarint(m_buf, m_pos, id) && id < m_names.size()) {
+			// an empty value makes the constructor skip the parse, the
+			// real value is filled in below.
+			LogSetAttribute * log = new LogSetAttribute(key.c_str(), m_names[id].c_str(), "");
+			if (getValue(m_buf, m_pos, log)) {
+				rec = log;
+			} else {
+				delete log;
+			}
+		}
+		break;
+	case CondorLogOp_DeleteAttribute:
+		if (getString(m_buf, m_pos, key) && getVarint(m_buf, m_pos, id) && id < m_names.size()) {
+			rec = new LogDeleteAttribute(key.c_str(), m_names[id].c_str());
+		}
+		break;
+	case CondorLogOp_BeginTransaction:
+		rec = new LogBeginTransaction();
+		break;
+	case CondorLogOp_EndTransaction:
+		if (getString(m_buf, m_pos, str1)) {
+			LogEndTransaction * log = new LogEndTransaction();
+			log->set_comment(str1.c_str());
+			rec = log;
+		}
+		break;
+	case CondorLogOp_LogHistoricalSequenceNumber: {
+		long long timestamp;
+		if (getVarint(m_buf, m_pos, id) && getSigned(m_buf, m_pos, timestamp)) {
+			rec = new LogHistoricalSequenceNumber((unsigned long)id, (time_t)timestamp);
+		}
+		break;
+	}
+	default:
+		break;
+	}
+
+	if (rec && m_pos != m_buf.size()) {
+		delete rec;
+		rec = NULL;
+	}
+	return rec;
+}
+
+int
+WriteLogRecord(FILE *fp, LogRecord *rec, ClassAdLogBinaryFormat *format)
+{
+	if (format) {
+		return format->Write(fp, rec);
+	}
+	return rec->Write(fp);
+}
@@ -0,0 +1,99 @@
+/***************************************************************
+ *
+ * Copyright (C) 1990-2020, Condor Team, Computer Sciences Department,
+ * University of Wisconsin-Madison, WI.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You may
+ * obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************/
+
+#ifndef _CLASSAD_LOG_BINARY_H
+#define _CLASSAD_LOG_BINARY_H
+
+/*
+   The binary form of a ClassAdLog.  It holds the same records as the
+   text form (see log.h), but is much cheaper to read back:
+
+   The file starts with CLASSAD_LOG_BINARY_MAGIC, which can never start
+   a text log.  Each record after that is a varint length followed by
+   that many bytes: a varint op type and the record body.  Strings are
+   a varint length and the bytes, with no terminator and no escaping.
+
+   Attribute names are interned.  The first time a name is written to
+   the file a name record gives it the next id, and SetAttribute and
+   DeleteAttribute records refer to the id after that.
+
+   SetAttribute values that are literals (undefined, boolean, integer,
+   real and string) are stored as typed values and are turned straight
+   into classad literals when read, without running the parser.  Other
+   values are stored as expression text, which was already checked when
+   it was first parsed and so is only parsed once, when it is played.
+
+   A record is only ever appended whole, so a short record at the end of
+   the file is a torn write and is treated like an unterminated line in
+   a text log.  A record that is corrupt, including one with a zero or
+   impossibly large length, is recovered from the way a corrupt record in
+   a text log is.
+*/
+
+#include "log.h"
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#define CLASSAD_LOG_BINARY_MAGIC "\177CAL1\n"
+#define CLASSAD_LOG_BINARY_MAGIC_LEN 6
+
+class ClassAdLogBinaryFormat {
+public:
+	ClassAdLogBinaryFormat();
+
+		// returns true and leaves fp after the magic if it is a binary
+		// log, otherwise leaves fp where it was.
+	static bool IsBinaryLog(FILE *fp);
+		// start a new, empty binary log
+	int WriteHeader(FILE *fp);
+
+		// returns the number of bytes written or -1 on error
+	int Write(FILE *fp, LogRecord *rec);
+
+		// A copy of a format object reads and writes the rest of the same
+		// log.  To start a new log that uses the same name ids, write the
+		// header and then WriteNames().  returns the number of bytes
+		// written or -1 on error
+	int WriteNames(FILE *fp);
+	size_t NameCount() const { return m_names.size(); }
+
+		// returns NULL at the end of the file or at a torn record at the
+		// end.  A record that is corrupt, or has a corrupt length, is
+		// dropped along with the rest of the file and fp is left at the
+		// end, as a corrupt record at the end of a text log is.
+	LogRecord *Read(FILE *fp, const ConstructLogEntry & ctor);
+
+private:
+	int ReadRecord(FILE *fp);
+	void RecoverFromCorruptRecord(FILE *fp, long long pos, bool framed);
+	LogRecord *Decode(int op, const ConstructLogEntry & ctor);
+	unsigned int NameId(FILE *fp, const char *name, int & written);
+
+	std::vector<std::string> m_names;
+	std::unordered_map<std::string, unsigned int> m_ids;
+	std::string m_buf;
+	size_t m_pos;
+};
+
+// write the record to fp in the given format, or as text if format is NULL
+int WriteLogRecord(FILE *fp, LogRecord *rec, ClassAdLogBinaryFormat *format);
+
+#endif
@@ -222,7 +222,10 @@ static long long myatoll(const char *s, const char* &end) {
 }
 
 
-bool getClassAdEx( Stream *sock, classad::ClassAd& ad, int options)
+// Insert numExprs attribute lines into the ad.  next_line(strptr, cb, its_a_secret)
+// fetches each line; it returns 0 on failure, or -1 to stop early.
+template <class LineReader>
+static bool insertClassAdExLines( classad::ClassAd& ad, int numExprs, int options, LineReader & next_line )
 {
 	int cb;
 	const char *strptr;
@@ -240,17 +243,6 @@ bool getClassAdEx( Stream *sock, classad::ClassAd& ad, int options)
 	classad::ClassAdParser parser;
 	parser.SetOldClassAd(true);
 
-	if ( ! (options & GET_CLASSAD_NO_CLEAR)) {
-		ad.Clear( );
-	}
-
-	sock->decode( );
-
-	int numExprs;
-	if( !sock->code( numExprs ) ) {
-		return false;
-	}
-
 	// at least numExprs are coming, but we may add
 	// my, target, and a couple extra right away
 	// Auth (id,method) update(total,seq,lost,history)
@@ -262,25 +254,12 @@ bool getClassAdEx( Stream *sock, classad::ClassAd& ad, int options)
 		// pack exprs into classad
 	for (int ii = 0 ; ii < numExprs ; ++ii) {
 		strptr = NULL;
-		if ( ! sock->get_string_ptr(strptr, cb) || ! strptr) {
-			return false;
-		}
-
 		bool its_a_secret = false;
-		if ((*strptr=='Z') && strptr[1] == 'K' && strptr[2] == 'M' && strptr[3] == 0) {
-			its_a_secret = true;
-			if ( ! sock->get_secret(strptr, cb) || ! strptr) {
-				dprintf(D_FULLDEBUG, "getClassAd Failed to read encrypted ClassAd expression.\n");
-				break;
-			}
-			// cb includes the terminating NUL character.
-			// TODO This strlen() should be unnecessary. Once we're confident
-			//   that is form of get_secret() isn't buggy, the strlen()
-			//   and size check should be removed.
-			int cch = strlen(strptr);
-			if (cch != cb-1) {
-				dprintf(D_FULLDEBUG, "getClassAd get_secret returned %d for string with 0 at %d\n", cb, cch);
-			}
+		int rc = next_line(strptr, cb, its_a_secret);
+		if (rc < 0) {
+			break;
+		} else if ( ! rc || ! strptr) {
+			return false;
 		}
 
 		// this splits at the =, puts the attribute name into attr
@@ -366,6 +345,49 @@ bool getClassAdEx( Stream *sock, classad::ClassAd& ad, int options)
 			return false;
 		}
 	}
+	return true;
+}
+
+bool getClassAdEx( Stream *sock, classad::ClassAd& ad, int options)
+{
+	int cb;
+	const char *strptr;
+
+	if ( ! (options & GET_CLASSAD_NO_CLEAR)) {
+		ad.Clear( );
+	}
+
+	sock->decode( );
+
+	int numExprs;
+	if( !sock->code( numExprs ) ) {
+		return false;
+	}
+
+	auto next_line = [sock](const char *& strptr, int & cb, bool & its_a_secret) -> int {
+		if ( ! sock->get_string_ptr(strptr, cb) || ! strptr) {
+			return 0;
+		}
+		if ((*strptr=='Z') && strptr[1] == 'K' && strptr[2] == 'M' && strptr[3] == 0) {
+			its_a_secret = true;
+			if ( ! sock->get_secret(strptr, cb) || ! strptr) {
+				dprintf(D_FULLDEBUG, "getClassAd Failed to read encrypted ClassAd expression.\n");
+				return -1;
+			}
+			// cb includes the terminating NUL character.
+			// TODO This strlen() should be unnecessary. Once we're confident
+			//   that is form of get_secret() isn't buggy, the strlen()
+			//   and size check should be removed.
+			int cch = strlen(strptr);
+			if (cch != cb-1) {
+				dprintf(D_FULLDEBUG, "getClassAd get_secret returned %d for string with 0 at %d\n", cb, cch);
+			}
+		}
+		return 1;
+	};
+	if ( ! insertClassAdExLines(ad, numExprs, options, next_line)) {
+		return false;
+	}
 
 	if (options & GET_CLASSAD_NO_TYPES) {
 		return true;
@@ -402,6 +424,65 @@ bool getClassAdEx( Stream *sock, classad::ClassAd& ad, int options)
 }
 
 
+bool getClassAdLines( Stream *sock, std::string & lines, int & num_lines, int options )
+{
+	lines.clear();
+
+	sock->decode( );
+	if ( ! sock->code(num_lines) || num_lines < 0) {
+		return false;
+	}
+
+	for (int ii = 0; ii < num_lines; ++ii) {
+		const char *strptr = NULL;
+		int cb;
+		if ( ! sock->get_string_ptr(strptr, cb) || ! strptr) {
+			return false;
+		}
+		if ((*strptr=='Z') && strptr[1] == 'K' && strptr[2] == 'M' && strptr[3] == 0) {
+			if ( ! sock->get_secret(strptr, cb) || ! strptr) {
+					// as getClassAdEx does, keep the lines read so far
+					// and go on to the types
+				dprintf(D_FULLDEBUG, "getClassAd Failed to read encrypted ClassAd expression.\n");
+				num_lines = ii;
+				break;
+			}
+		}
+		lines += strptr;
+		lines += '\0';
+	}
+
+	if ( ! (options & GET_CLASSAD_NO_TYPES)) {
+			// we fetch but ignore MyType and TargetType
+		const char *strptr = NULL;
+		if ( ! sock->get_string_ptr(strptr) || ! sock->get_string_ptr(strptr)) {
+			dprintf(D_FULLDEBUG, "getClassAd FAILED to get MyType or TargetType\n" );
+			return false;
+		}
+	}
+	return true;
+}
+
+bool parseClassAdLines( const char * lines, size_t len, int num_lines, classad::ClassAd& ad, int options )
+{
+	if ( ! (options & GET_CLASSAD_NO_CLEAR)) {
+		ad.Clear( );
+	}
+
+	const char * end = lines + len;
+	auto next_line = [&lines, end](const char *& strptr, int & cb, bool & /*its_a_secret*/) -> int {
+		if (lines >= end) {
+			return 0;
+		}
+		strptr = lines;
+		cb = (int)strlen(lines) + 1;
+		lines += cb;
+		return 1;
+	};
+	return insertClassAdExLines(ad, num_lines, options, next_line);
+}
+
+
 int getClassAdNonblocking( ReliSock *sock, classad::ClassAd& ad )
 {
 	int retval;
@@ -592,6 +673,81 @@ int putClassAd (Stream *sock, const classad::ClassAd& ad, int options, const cla
 	return retval;
 }
 
+int unparseClassAdForPut (const classad::ClassAd& ad, int options,
+	const classad::References * whitelist, std::string & lines)
+{
+	classad::References expanded_whitelist;
+	if (whitelist && ! (options & PUT_CLASSAD_NO_EXPAND_WHITELIST)) {
+		for (classad::References::const_iterator attr = whitelist->begin(); attr != whitelist->end(); ++attr) {
+			ExprTree * tree = ad.Lookup(*attr);
+			if (tree) {
+				expanded_whitelist.insert(*attr);
+				if (tree->GetKind() != ExprTree::LITERAL_NODE) {
+					ad.GetInternalReferences(tree, expanded_whitelist, false);
+				}
+			}
+		}
+		whitelist = &expanded_whitelist;
+	}
+
+	classad::ClassAdUnParser unp;
+	unp.SetOldClassAd( true, true );
+
+	int num_lines = 0;
+	auto add_line = [&](const std::string & attr, classad::ExprTree const * expr) {
+		if (ClassAdAttributeIsPrivate(attr)) {
+			return;
+		}
+		lines += attr;
+		lines += " = ";
+		unp.Unparse(lines, expr);
+		lines += '\0';
+		++num_lines;
+	};
+
+	if (whitelist) {
+		for (classad::References::const_iterator attr = whitelist->begin(); attr != whitelist->end(); ++attr) {
+			classad::ExprTree const * expr = ad.Lookup(*attr);
+			if (expr) { add_line(*attr, expr); }
+		}
+	} else {
+			// chained attributes first, as _putClassAd does, so that
+			// the attributes of the ad itself override them
+		const classad::ClassAd *chainedAd = ad.GetChainedParentAd();
+		if (chainedAd) {
+			for (auto itor = chainedAd->begin(); itor != chainedAd->end(); ++itor) {
+				add_line(itor->first, itor->second);
+			}
+		}
+		for (auto itor = ad.begin(); itor != ad.end(); ++itor) {
+			add_line(itor->first, itor->second);
+		}
+	}
+
+	return num_lines;
+}
+
+int putUnparsedClassAd (Stream *sock, int num_lines, const char * lines, size_t len, int options)
+{
+	sock->encode();
+	if ( ! sock->code(num_lines)) {
+		return false;
+	}
+	const char * end = lines + len;
+	while (lines < end) {
+		if ( ! sock->put(lines)) {
+			return false;
+		}
+		lines += strlen(lines) + 1;
+	}
+	if ( ! (options & PUT_CLASSAD_NO_TYPES)) {
+		if ( ! sock->put("") || ! sock->put("")) {
+			return false;
+		}
+	}
+	return true;
+}
+
 // helper function for _putClassAd
 static int _putClassAdTrailingInfo(Stream *sock, const classad::ClassAd& /* ad */, bool send_server_time, bool excludeTypes)
 {
@@ -44,6 +44,17 @@ bool getClassAdEx( Stream *sock, classad::ClassAd& ad, int options);
 #define GET_CLASSAD_FAST                0x10 // use tricks to quickly parse the ad.
 #define GET_CLASSAD_LAZY_PARSE          0x20 // parse only when evaluating the first time. (ignored if GET_CLASSAD_NO_CACHE is set)
 
+/** Read the attribute lines of a ClassAd from the stream without parsing
+ * them, so that the parsing can be done later (or elsewhere) with
+ * parseClassAdLines.  Encrypted attributes are decrypted.  Each line is
+ * NUL terminated.  Takes the same GET_CLASSAD_NO_TYPES option as getClassAdEx.
+ */
+bool getClassAdLines( Stream *sock, std::string & lines, int & num_lines, int options );
+/** Parse lines read by getClassAdLines into the ad, the same as getClassAdEx
+ * would have, using the same options.
+ */
+bool parseClassAdLines( const char * lines, size_t len, int num_lines, classad::ClassAd& ad, int options );
+
 class StatisticsPool;
 void getClassAdEx_addProfileStatsToPool(StatisticsPool * pool, int publevel);
 void getClassAdEx_clearProfileStats();
@@ -82,6 +93,28 @@ int putClassAd (Stream *sock, const classad::ClassAd& ad, int options,
 #define PUT_CLASSAD_NON_BLOCKING        0x04 // use non-blocking sematics. returns 2 of this would have blocked.
 #define PUT_CLASSAD_NO_EXPAND_WHITELIST 0x08 // use the whitelist argument as-is, (default is to expand internal references before using it)
 
+/** Unparse the ClassAd into the attribute lines that putClassAd would send,
+ * so that the same ad can be sent many times by putUnparsedClassAd without
+ * unparsing it again.  Private attributes are always left out, since those
+ * must be encrypted separately for each connection.
+ * @param ad the ClassAd to be unparsed
+ * @param options one or more of PUT_CLASSAD_* flags, as for putClassAd
+ * @param whitelist list of attributes to unparse (default is all)
+ * @param lines the lines are appended here, each terminated by a '\0'
+ * @returns the number of lines appended
+ */
+int unparseClassAdForPut (const classad::ClassAd& ad, int options,
+	const classad::References * whitelist, std::string & lines);
+
+/** Send a ClassAd that was unparsed by unparseClassAdForPut
+ * @param sock the stream
+ * @param num_lines the number of lines returned by unparseClassAdForPut
+ * @param lines the lines produced by unparseClassAdForPut
+ * @param len the length of lines
+ * @param options the PUT_CLASSAD_NO_TYPES flag is honored
+ */
+int putUnparsedClassAd (Stream *sock, int num_lines, const char * lines, size_t len, int options);
+
 // fetch the given attribute from the queryAd and convert it into a set of attributes
 //   the attribute should be a string value containing a comma and/or space separated list of attributes (like StringList)
 //   if allow_list is true, then attribute is permitted to be a classad list of strings each of which is an attribute of the projection.
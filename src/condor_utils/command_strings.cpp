@@ -248,6 +248,9 @@ const struct Translation DCTranslation[] = {
 const struct Translation CollectorTranslation[] = {
 	{ "UPDATE_STARTD_AD", UPDATE_STARTD_AD },
     { "UPDATE_STARTD_AD_WITH_ACK", UPDATE_STARTD_AD_WITH_ACK },
+	{ "UPDATE_STARTD_AD_DELTA", UPDATE_STARTD_AD_DELTA },
+	{ "UPDATE_STARTD_AD_BULK", UPDATE_STARTD_AD_BULK },
+	{ "SUBSCRIBE_ADS", SUBSCRIBE_ADS },
 	{ "UPDATE_SCHEDD_AD", UPDATE_SCHEDD_AD },
 	{ "UPDATE_MASTER_AD", UPDATE_MASTER_AD },
 //	{ "UPDATE_GATEWAY_AD", UPDATE_GATEWAY_AD },		/* Not used */
@@ -35,6 +35,7 @@
 #include "subsystem_info.h"
 
 #include "historyFileFinder.h"
+#include <thread>
 
 static bool isHistoryBackup(const char *fullFilename, time_t *backup_time);
 static int compareHistoryFilenames(const void *item1, const void *item2);
@@ -134,6 +135,332 @@ const char **findHistoryFiles(const char *paramName, int *pnumHistoryFiles)
     return const_cast<const char**>(historyFiles);
 }
 
+void historyIndexFileName(const char * history_file, std::string & index_file)
+{
+    char * dir = condor_dirname(history_file);
+    formatstr(index_file, "%s%c.%s.idx", dir, DIR_DELIM_CHAR, condor_basename(history_file));
+    free(dir);
+}
+
+bool readHistoryIndex(const char * history_file, std::vector<HistoryIndexRec> & recs)
+{
+    std::string index_name;
+    historyIndexFileName(history_file, index_name);
+    FILE * fp = safe_fopen_wrapper_follow(index_name.c_str(), "r");
+    if ( ! fp) {
+        return false;
+    }
+
+    bool ok = true;
+    MyString line;
+    while (ok && line.readLine(fp)) {
+        line.chomp();
+        HistoryIndexRec rec;
+        int owner_pos = 0;
+        if (sscanf(line.c_str(), "%ld %ld %d %d %d %n", &rec.offset, &rec.end,
+                &rec.cluster, &rec.proc, &rec.completion, &owner_pos) != 5 || ! owner_pos) {
+            ok = false;
+            break;
+        }
+        rec.owner = line.c_str() + owner_pos;
+        long expected = recs.empty() ? 0 : recs.back().end;
+        if (rec.offset != expected || rec.end <= rec.offset) {
+            ok = false;
+            break;
+        }
+        recs.push_back(rec);
+    }
+    fclose(fp);
+
+    struct stat st;
+    if ( ! ok || recs.empty() || stat(history_file, &st) < 0 || recs.back().end != st.st_size) {
+        recs.clear();
+        return false;
+    }
+    return true;
+}
+
+template <typename T> static int
+compareForIndex(classad::Operation::OpKind op, const T & lhs, const T & rhs)
+{
+    switch (op) {
+    case classad::Operation::LESS_THAN_OP:        return lhs < rhs ? HISTORY_INDEX_TRUE : HISTORY_INDEX_FALSE;
+    case classad::Operation::LESS_OR_EQUAL_OP:    return lhs <= rhs ? HISTORY_INDEX_TRUE : HISTORY_INDEX_FALSE;
+    case classad::Operation::GREATER_THAN_OP:     return lhs > rhs ? HISTORY_INDEX_TRUE : HISTORY_INDEX_FALSE;
+    case classad::Operation::GREATER_OR_EQUAL_OP: return lhs >= rhs ? HISTORY_INDEX_TRUE : HISTORY_INDEX_FALSE;
+    case classad::Operation::EQUAL_OP:
+    case classad::Operation::META_EQUAL_OP:       return lhs == rhs ? HISTORY_INDEX_TRUE : HISTORY_INDEX_FALSE;
+    case classad::Operation::NOT_EQUAL_OP:
+    case classad::Operation::META_NOT_EQUAL_OP:   return lhs != rhs ? HISTORY_INDEX_TRUE : HISTORY_INDEX_FALSE;
+    default: return HISTORY_INDEX_UNKNOWN;
+    }
+}
+
+int evalOnHistoryIndex(classad::ExprTree * tree, const HistoryIndexRec & rec)
+{
+    tree = SkipExprParens(tree);
+    if ( ! tree || tree->GetKind() != classad::ExprTree::OP_NODE) {
+        return HISTORY_INDEX_UNKNOWN;
+    }
+
+    classad::Operation::OpKind op;
+    classad::ExprTree *t1, *t2, *t3;
+    ((const classad::Operation*)tree)->GetComponents(op, t1, t2, t3);
+    if (op == classad::Operation::LOGICAL_AND_OP) {
+        int left = evalOnHistoryIndex(t1, rec);
+        if (left == HISTORY_INDEX_FALSE) return HISTORY_INDEX_FALSE;
+        int right = evalOnHistoryIndex(t2, rec);
+        if (right == HISTORY_INDEX_FALSE) return HISTORY_INDEX_FALSE;
+        return (left == HISTORY_INDEX_TRUE && right == HISTORY_INDEX_TRUE) ? HISTORY_INDEX_TRUE : HISTORY_INDEX_UNKNOWN;
+    }
+    if (op == classad::Operation::LOGICAL_OR_OP) {
+        int left = evalOnHistoryIndex(t1, rec);
+        if (left == HISTORY_INDEX_TRUE) return HISTORY_INDEX_TRUE;
+        int right = evalOnHistoryIndex(t2, rec);
+        if (right == HISTORY_INDEX_TRUE) return HISTORY_INDEX_TRUE;
+        return (left == HISTORY_INDEX_FALSE && right == HISTORY_INDEX_FALSE) ? HISTORY_INDEX_FALSE : HISTORY_INDEX_UNKNOWN;
+    }
+
+    std::string attr;
+    classad::Value value;
+    if (ExprTreeIsAttrRef(SkipExprParens(t1), attr) && ExprTreeIsLiteral(SkipExprParens(t2), value)) {
+        // attr <op> literal
+    } else if (ExprTreeIsLiteral(SkipExprParens(t1), value) && ExprTreeIsAttrRef(SkipExprParens(t2), attr)) {
+        // literal <op> attr, turn it around
+        switch (op) {
+        case classad::Operation::LESS_THAN_OP:        op = classad::Operation::GREATER_THAN_OP; break;
+        case classad::Operation::LESS_OR_EQUAL_OP:    op = classad::Operation::GREATER_OR_EQUAL_OP; break;
+        case classad::Operation::GREATER_THAN_OP:     op = classad::Operation::LESS_THAN_OP; break;
+        case classad::Operation::GREATER_OR_EQUAL_OP: op = classad::Operation::LESS_OR_EQUAL_OP; break;
+        default: break;
+        }
+    } else {
+        return HISTORY_INDEX_UNKNOWN;
+    }
+
+    long long ival;
+    std::string sval;
+    if (value.IsIntegerValue(ival)) {
+        long long known = -1;
+        if (MATCH == strcasecmp(attr.c_str(), ATTR_CLUSTER_ID)) {
+            known = rec.cluster;
+        } else if (MATCH == strcasecmp(attr.c_str(), ATTR_PROC_ID)) {
+            known = rec.proc;
+        } else if (MATCH == strcasecmp(attr.c_str(), ATTR_COMPLETION_DATE)) {
+            known = rec.completion;
+        }
+        if (known < 0) {
+            return HISTORY_INDEX_UNKNOWN;
+        }
+        return compareForIndex(op, known, ival);
+    }
+    if (value.IsStringValue(sval) && MATCH == strcasecmp(attr.c_str(), ATTR_OWNER) && rec.owner != "?") {
+        // == and != ignore case for strings, =?= and =!= do not
+        int cmp;
+        if (op == classad::Operation::META_EQUAL_OP || op == classad::Operation::META_NOT_EQUAL_OP) {
+            cmp = strcmp(rec.owner.c_str(), sval.c_str());
+        } else if (op == classad::Operation::EQUAL_OP || op == classad::Operation::NOT_EQUAL_OP) {
+            cmp = strcasecmp(rec.owner.c_str(), sval.c_str());
+        } else {
+            return HISTORY_INDEX_UNKNOWN;
+        }
+        return compareForIndex(op, cmp, 0);
+    }
+    return HISTORY_INDEX_UNKNOWN;
+}
+
+HistoryChunk::~HistoryChunk()
+{
+    for (auto it = results.begin(); it != results.end(); ++it) { delete it->ad; }
+}
+
+void scanHistoryChunk(HistoryChunk * chunk, classad::ExprTree * constraint, classad::ExprTree * since)
+{
+    ClassAd * ad = NULL;
+    bool malformed = false;
+    std::string bad_expr;
+
+    StringTokenIterator lines(chunk->text, 100, "\r\n");
+    for (const char * line = lines.first(); line; line = lines.next()) {
+        if (strncmp(line, "*** ", 4) == 0) {
+            if (ad || malformed) {
+                HistoryScanResult res;
+                res.ad = NULL;
+                res.since = false;
+                res.malformed = malformed;
+                res.bad_expr = bad_expr;
+                if ( ! malformed) {
+                    res.since = since && EvalExprBool(ad, since);
+                    if ( ! res.since && ( ! constraint || EvalExprBool(ad, constraint))) {
+                        res.ad = ad;
+                        ad = NULL;
+                    }
+                }
+                chunk->results.push_back(res);
+            }
+            delete ad;
+            ad = NULL;
+            malformed = false;
+            bad_expr.clear();
+            continue;
+        }
+
+        const char * psz = line;
+        while (*psz == ' ' || *psz == '\t') ++psz;
+        if ( ! *psz || *psz == '#' || malformed) continue;
+        if ( ! ad) {
+            ad = new ClassAd;
+            ad->rehash(521); // big enough to prevent regrowing hash table
+        }
+        if ( ! ad->Insert(line)) {
+            malformed = true;
+            bad_expr = line;
+            delete ad;
+            ad = NULL;
+        }
+    }
+    delete ad; // the chunk ends with a banner, so this is only ever blank lines
+}
+
+// returns the offset just past the last whole *** banner line in the text.
+// the text must start at the start of a line
+static size_t lastBannerEnd(const std::string & text)
+{
+    size_t end = text.size();
+    while (end > 0) {
+        size_t pos = text.rfind("*** ", end - 1);
+        if (pos == std::string::npos) break;
+        if (pos == 0 || text[pos-1] == '\n') {
+            size_t nl = text.find('\n', pos);
+            if (nl != std::string::npos) return nl + 1;
+        }
+        if (pos == 0) break;
+        end = pos;
+    }
+    return std::string::npos;
+}
+
+bool HistoryChunkReader::Next(std::string & text)
+{
+    if (m_backwards && ! m_trimmed) {
+        // find the end of the last whole ad
+        m_trimmed = true;
+        for (long len = m_chunk_size; ; len *= 2) {
+            long lo = std::max(0L, m_end - len);
+            if ( ! Read(lo, m_end, text)) return false;
+            size_t cut = lastBannerEnd(text);
+            if (cut != std::string::npos) { m_end = lo + (long)cut; break; }
+            if (lo == 0) { m_end = 0; break; }
+        }
+    }
+    for (long len = m_chunk_size; m_begin < m_end; len *= 2) {
+        if (m_backwards) {
+            long lo = std::max(m_begin, m_end - len);
+            if ( ! Read(lo, m_end, text)) return false;
+            if (lo == m_begin) {
+                m_end = m_begin;
+                return true;
+            }
+            // the chunk starts after the first banner line that is
+            // whole, but not at the end, since that would leave no ads.
+            size_t pos = text.find("\n*** ");
+            size_t cut = (pos == std::string::npos) ? pos : text.find('\n', pos + 1);
+            if (cut != std::string::npos && cut + 1 < text.size()) {
+                text.erase(0, cut + 1);
+                m_end = lo + (long)cut + 1;
+                return true;
+            }
+        } else {
+            long hi = std::min(m_end, m_begin + len);
+            if ( ! Read(m_begin, hi, text)) return false;
+            size_t cut = lastBannerEnd(text);
+            if (cut != std::string::npos) {
+                text.resize(cut);
+                m_begin += (long)cut;
+                return true;
+            }
+            if (hi == m_end) {
+                m_begin = m_end; // no banner after the last ad yet
+            }
+        }
+    }
+    return false;
+}
+
+bool HistoryChunkReader::Read(long lo, long hi, std::string & text)
+{
+    text.resize(hi - lo);
+    if (fseek(m_fp, lo, SEEK_SET) < 0 || fread(&text[0], 1, text.size(), m_fp) != text.size()) {
+        return false;
+    }
+    return true;
+}
+
+void scanHistoryFile(FILE * fp, long size, bool backwards, int num_threads,
+    classad::ExprTree * constraint, classad::ExprTree * since,
+    const std::function<bool(HistoryScanResult &)> & callback,
+    long chunk_size)
+{
+    // the classad function table is built the first time a function call
+    // is parsed, make sure that happens here rather than in a worker.
+    static bool warmed_up = false;
+    if ( ! warmed_up) {
+        classad::ExprTree * tree = NULL;
+        if (ParseClassAdRvalExpr("isUndefined(x)", tree) == 0) {
+            delete tree;
+        }
+        warmed_up = true;
+    }
+    if (num_threads < 1) {
+        num_threads = 1;
+    }
+
+    HistoryChunkReader reader(fp, size, backwards, chunk_size);
+    bool done = false;
+    while ( ! done) {
+        std::vector<HistoryChunk*> batch;
+        for (int i = 0; i < num_threads; ++i) {
+            HistoryChunk * chunk = new HistoryChunk;
+            if ( ! reader.Next(chunk->text)) {
+                delete chunk;
+                break;
+            }
+            batch.push_back(chunk);
+        }
+        if (batch.empty()) {
+            break;
+        }
+
+        std::vector<std::thread> workers;
+        for (size_t i = 0; i < batch.size(); ++i) {
+            workers.emplace_back([](HistoryChunk * chunk, classad::ExprTree * cons, classad::ExprTree * since_copy) {
+                    scanHistoryChunk(chunk, cons, since_copy);
+                    delete cons;
+                    delete since_copy;
+                }, batch[i],
+                constraint ? constraint->Copy() : NULL,
+                since ? since->Copy() : NULL);
+        }
+        for (auto & worker : workers) {
+            worker.join();
+        }
+
+        for (size_t i = 0; i < batch.size() && ! done; ++i) {
+            std::vector<HistoryScanResult> & results = batch[i]->results;
+            for (size_t j = 0; j < results.size(); ++j) {
+                HistoryScanResult & res = results[backwards ? results.size() - 1 - j : j];
+                if ( ! callback(res)) {
+                    done = true;
+                    break;
+                }
+            }
+        }
+        for (size_t i = 0; i < batch.size(); ++i) {
+            delete batch[i];
+        }
+    }
+}
+
 // Returns true if the filename is a history file, false otherwise.
 // If backup_time is not NULL, returns the time from the timestamp in
 // the file.
@@ -20,6 +20,8 @@
 #ifndef _HISTORYFILEFINDER_H_
 #define _HISTORYFILEFINDER_H_
 
+#include <functional>
+
 // Find all of the history files that the schedd created, and put them
 // in order by time that they were created, so the current file is always last
 // For instance, if there is a current file and 2 rotated older files we would have
@@ -36,4 +38,100 @@ extern const char **findHistoryFiles(const char *paramName, int *numHistoryFiles
 // Free the array of history files returned by the above function.
 extern void freeHistoryFilesList(const char **);
 
+// The name of the index that AppendHistory() keeps beside a history file
+// when ENABLE_HISTORY_INDEX is true.  For "/spool/history.20151019T161810"
+// it is "/spool/.history.20151019T161810.idx", which findHistoryFiles()
+// and history rotation do not mistake for a history file.
+// Each line of the index describes one ad in the history file:
+//    <offset of ad> <offset after banner> <ClusterId> <ProcId> <CompletionDate> <Owner>
+// where a missing ClusterId, ProcId or CompletionDate is -1 and a missing Owner is ?
+extern void historyIndexFileName(const char * history_file, std::string & index_file);
+
+namespace classad { class ExprTree; class ClassAd; }
+
+// one line of a history index
+struct HistoryIndexRec {
+	long offset;     // start of the ad in the history file
+	long end;        // just past its *** banner line
+	int cluster;     // -1 if unknown
+	int proc;        // -1 if unknown
+	int completion;  // -1 if unknown
+	std::string owner; // ? if unknown
+};
+
+// Read the index of a history file, if it has one that describes every ad
+// in the file.  An index that does not start at the top of the file, has a
+// gap, or stops short of the end of the file (the schedd is writing to it,
+// or the index was turned off for a while) is not used, and false is returned.
+extern bool readHistoryIndex(const char * history_file, std::vector<HistoryIndexRec> & recs);
+
+enum { HISTORY_INDEX_FALSE, HISTORY_INDEX_TRUE, HISTORY_INDEX_UNKNOWN };
+
+// Evaluate an expression against what the index knows about an ad.  This
+// only understands && and || of comparisons between ClusterId, ProcId,
+// CompletionDate or Owner and a literal, everything else is HISTORY_INDEX_UNKNOWN,
+// in which case the ad itself must be read to find out.
+extern int evalOnHistoryIndex(classad::ExprTree * tree, const HistoryIndexRec & rec);
+
+// The scan of one ad of a history file by scanHistoryChunk()
+struct HistoryScanResult {
+	classad::ClassAd * ad; // the ad, if it matched the constraint
+	bool since;       // the -since expression is true for the ad
+	bool malformed;
+	std::string bad_expr;
+};
+
+struct HistoryChunk {
+	std::string text; // whole ads, each followed by its *** banner line
+	std::vector<HistoryScanResult> results; // in file order
+	~HistoryChunk();
+};
+
+// Parse the ads in a chunk of a history file and check them against the
+// constraint and the since expression, in the same way that condor_history
+// does, but without printing or counting them.  This is safe to run on a
+// worker thread if the expressions are copies that no other thread uses,
+// since evaluating one sets its parent scope.  A line that does not parse
+// marks the ad as malformed and sets only this thread's classad error.
+extern void scanHistoryChunk(HistoryChunk * chunk, classad::ExprTree * constraint, classad::ExprTree * since);
+
+// Reads a history file in chunks of whole ads, the last chunk first when
+// reading backwards.  Each chunk starts at the top of the file or just after
+// a *** banner line and ends just after one, so an ad that is still being
+// written at the end of the file is left out, as the other readers do.
+// A chunk is about chunk_size bytes, or as much more as it takes to hold
+// a whole ad.
+class HistoryChunkReader {
+public:
+	static const long CHUNK_SIZE = 1024*1024;
+
+	HistoryChunkReader(FILE * fp, long size, bool backwards, long chunk_size = CHUNK_SIZE)
+		: m_fp(fp), m_backwards(backwards), m_chunk_size(chunk_size),
+		  m_begin(0), m_end(size), m_trimmed(false) {}
+
+	// the next chunk, false when there are no more
+	bool Next(std::string & text);
+
+private:
+	bool Read(long lo, long hi, std::string & text);
+
+	FILE * m_fp;
+	bool m_backwards;
+	long m_chunk_size;
+	long m_begin; // the part of the file not yet read
+	long m_end;
+	bool m_trimmed;
+};
+
+// Scan a history file with num_threads threads parsing ads and evaluating
+// the constraint and since expressions.  A batch of chunks is scanned at
+// once, then the result for each ad is passed to the callback in the order
+// the file is read, forwards or backwards, so the ads seen, and the point
+// at which the callback stops the scan by returning false, are the same
+// as for a single thread.
+extern void scanHistoryFile(FILE * fp, long size, bool backwards, int num_threads,
+	classad::ExprTree * constraint, classad::ExprTree * since,
+	const std::function<bool(HistoryScanResult &)> & callback,
+	long chunk_size = HistoryChunkReader::CHUNK_SIZE);
+
 #endif
@@ -53,6 +53,125 @@ void HistoryHelperQueue::setup(int request_max, int concurrency_max) {
 }
 
 
+void HistoryHelperQueue::setupTail(int max_ads, const char * history_file)
+{
+	// ads in the tail that were written to another history file are
+	// not the newest ads in the current one.
+	if ( ! history_file || m_tail_file != history_file) {
+		clearTail();
+		m_tail_file = history_file ? history_file : "";
+	}
+	m_tail_max = (max_ads > 0 && history_file) ? max_ads : 0;
+	while (m_tail.size() > m_tail_max) {
+		delete m_tail.front();
+		m_tail.pop_front();
+	}
+}
+
+void HistoryHelperQueue::clearTail()
+{
+	for (auto it = m_tail.begin(); it != m_tail.end(); ++it) {
+		delete *it;
+	}
+	m_tail.clear();
+}
+
+void HistoryHelperQueue::rememberAd(const ClassAd & ad)
+{
+	if ( ! m_tail_max) {
+		return;
+	}
+
+	// copy what AppendHistory() wrote, that is the attributes of the
+	// ad and the ad it is chained to, other than the private ones.
+	ClassAd * copy = new ClassAd();
+	const classad::ClassAd * parent = ad.GetChainedParentAd();
+	if (parent) {
+		for (auto itr = parent->begin(); itr != parent->end(); ++itr) {
+			if ( ! ClassAdAttributeIsPrivate(itr->first)) {
+				copy->Insert(itr->first, itr->second->Copy());
+			}
+		}
+	}
+	for (auto itr = ad.begin(); itr != ad.end(); ++itr) {
+		if ( ! ClassAdAttributeIsPrivate(itr->first)) {
+			copy->Insert(itr->first, itr->second->Copy());
+		}
+	}
+
+	m_tail.push_back(copy);
+	while (m_tail.size() > m_tail_max) {
+		delete m_tail.front();
+		m_tail.pop_front();
+	}
+}
+
+// Answer a query from the newest history ads that we keep, as the helper
+// would answer it, if the helper would stop scanning before it ran out of
+// them: because of the match limit, -since or HISTORY_HELPER_MAX_HISTORY.
+// The answer is written on the schedd's main thread, so a query that matches
+// more than HISTORY_HELPER_TAIL_MAX_MATCHES ads is left to the helper as well.
+// Returns false, having sent nothing, if the helper must answer instead.
+bool HistoryHelperQueue::answerFromTail(Stream * stream, classad::ExprTree * requirements, classad::ExprTree * since,
+	const classad::References & projection, long long match_limit, bool streamresults)
+{
+	int scan_limit = param_integer("HISTORY_HELPER_MAX_HISTORY", 10000);
+	size_t max_matches = (size_t)param_integer("HISTORY_HELPER_TAIL_MAX_MATCHES", 100, 0);
+	std::vector<ClassAd*> matches;
+	int scanned = 0;
+	bool complete = false;
+	for (auto it = m_tail.rbegin(); it != m_tail.rend(); ++it) {
+		++scanned;
+		if (since && EvalExprBool(*it, since)) {
+			complete = true;
+			break;
+		}
+		if ( ! requirements || EvalExprBool(*it, requirements)) {
+			if (matches.size() >= max_matches) {
+				return false;
+			}
+			matches.push_back(*it);
+		}
+		if ((match_limit > 0 && (long long)matches.size() >= match_limit) || (scan_limit > 0 && scanned >= scan_limit)) {
+			complete = true;
+			break;
+		}
+	}
+	if ( ! complete) {
+		return false;
+	}
+	dprintf(D_FULLDEBUG, "Answering history query from the %d newest history ads\n", scanned);
+
+	stream->encode();
+	if (streamresults) {
+		ClassAd ad;
+		ad.InsertAttr(ATTR_OWNER, 1);
+		ad.InsertAttr("StreamResults", true);
+		if ( ! putClassAd(stream, ad) || ! stream->end_of_message()) {
+			dprintf(D_ALWAYS, "Failed to write streaming history header, the client went away\n");
+			return true;
+		}
+	}
+	for (auto it = matches.begin(); it != matches.end(); ++it) {
+		if ( ! putClassAd(stream, **it, 0, projection.empty() ? NULL : &projection) ||
+			(streamresults && ! stream->end_of_message())) {
+			// don't bother sending the rest to a client that is gone
+			dprintf(D_ALWAYS, "Failed to write history ad, the client went away\n");
+			return true;
+		}
+	}
+	ClassAd ad;
+	ad.InsertAttr(ATTR_OWNER, 0);
+	ad.InsertAttr(ATTR_NUM_MATCHES, (int)matches.size());
+	ad.InsertAttr("MalformedAds", 0);
+	ad.InsertAttr("AdCount", scanned);
+	if ( ! putClassAd(stream, ad) || ! stream->end_of_message()) {
+		dprintf(D_ALWAYS, "Failed to write final history ad\n");
+	}
+	return true;
+}
+
+
 int HistoryHelperQueue::command_handler(int cmd, Stream* stream)
 {
 	bool is_startd = (cmd == GET_HISTORY);
@@ -108,6 +227,16 @@ int HistoryHelperQueue::command_handler(int cmd, Stream* stream)
 		streamresults = false;
 	}
 
+	// the helper treats a literal -since as a job id or a time, so leave that to it.
+	classad::Value since_val;
+	if ( ! m_tail.empty() && ! (since_expr && ExprTreeIsLiteral(since_expr, since_val))) {
+		long long limit = 0;
+		if ( ! match_limit.empty()) { queryAd.EvaluateAttrInt(ATTR_NUM_MATCHES, limit); }
+		if (answerFromTail(stream, requirements, since_expr, projection, limit, streamresults)) {
+			return TRUE;
+		}
+	}
+
 	if (m_requests >= m_max_requests) {
 		if (m_queue.size() > 1000) {
 			return sendHistoryErrorAd(stream, 9, "Cowardly refusing to queue more than 1000 requests.");
@@ -63,19 +63,30 @@ public:
 		, m_rid(-1)            // reaper id
 		, m_allow_legacy_helper(legacy) // when true, the Schedd's old history helper is allowed
 		, m_want_startd(false)
+		, m_tail_max(0)
 		{
 	}
-	~HistoryHelperQueue() {};
+	~HistoryHelperQueue() { clearTail(); };
 
 	// establish limits and register the reaper
 	void setup(int request_max, int concurrency_max);
 	void want_startd_history(bool want) { m_want_startd = want; }
 
+	// keep copies of the last max_ads ads written to history_file, and
+	// answer the queries that need no others from them without a helper.
+	// 0 turns this off.
+	void setupTail(int max_ads, const char * history_file);
+	// call with each ad after it was written to the history file
+	void rememberAd(const ClassAd & ad);
+
 	int command_handler(int cmd, Stream* stream);
 
 protected:
 	int launcher(const HistoryHelperState &state);
 	int reaper(int, int);
+	bool answerFromTail(Stream * stream, classad::ExprTree * requirements, classad::ExprTree * since,
+		const classad::References & projection, long long match_limit, bool streamresults);
+	void clearTail();
 
 	std::deque<HistoryHelperState> m_queue;
 	int m_requests;         // number of incomplete requests (queued + concurrent)
@@ -84,6 +95,9 @@ protected:
 	int m_rid;              // reaper id
 	bool m_allow_legacy_helper;
 	bool m_want_startd;
+	std::deque<ClassAd*> m_tail; // the newest history ads, oldest first
+	size_t m_tail_max;
+	std::string m_tail_file;     // the history file they were written to
 };
 
 
@@ -22,6 +22,7 @@
 #include "log_transaction.h"
 #include "condor_debug.h"
 #include "condor_fsync.h"
+#include "classad_log_binary.h"
 
 Transaction::Transaction()
 	: op_log(hashFunction)
@@ -52,7 +53,7 @@ Transaction::~Transaction()
 }
 
 void
-Transaction::Commit(FILE* fp, const char *filename, LoggableClassAdTable *data_structure, bool nondurable)
+Transaction::Commit(FILE* fp, const char *filename, LoggableClassAdTable *data_structure, bool nondurable, ClassAdLogBinaryFormat *binary)
 {
 	LogRecord *log;
 	int fd;
@@ -71,7 +72,7 @@ Transaction::Commit(FILE* fp, const char *filename, LoggableClassAdTable *data_s
 
 	while( (log = ordered_op_log.Next()) ) {
 		if ( fp != NULL ) {
-			if ( log->Write( fp ) < 0 ) {
+			if ( WriteLogRecord( fp, log, binary ) < 0 ) {
 				EXCEPT( "write to %s failed, errno = %d", filename, errno );
 			}
 		}
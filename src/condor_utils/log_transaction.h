@@ -43,12 +43,13 @@
 typedef List<LogRecord> LogRecordList;
 
 class LoggableClassAdTable;
+class ClassAdLogBinaryFormat;
 
 class Transaction {
 public:
 	Transaction();
 	~Transaction();
-	void Commit(FILE* fp, const char *filename, LoggableClassAdTable *data_structure, bool nondurable=false);
+	void Commit(FILE* fp, const char *filename, LoggableClassAdTable *data_structure, bool nondurable=false, ClassAdLogBinaryFormat *binary=NULL);
 	void AppendLog(LogRecord *);
 	LogRecord *FirstEntry(char const *key);
 	LogRecord *NextEntry();
@@ -82,6 +82,38 @@ update (ClassAd *ad, int options, const char * _key /*=NULL*/)
 	return rval;
 }
 
+int TrackTotals::
+updateFromSummary (ClassAd *ad)
+{
+	ClassTotal *ct;
+	std::string	summary_key;
+	int			bad = 0;
+
+	if (!ad->LookupString(ATTR_SUMMARY_KEY, summary_key)) return 0;
+
+	// ads that could not be totaled by the collector
+	if (ad->LookupInteger(ATTR_NUM_HOSTS_MALFORMED, bad)) malformed += bad;
+
+	// the summary of the ads that have no key only has a malformed count
+	if (summary_key.empty()) return 1;
+
+	MyString key(summary_key);
+	if (allTotals.lookup (key, ct) < 0)
+	{
+		ct = ClassTotal::makeTotalObject (ppo);
+		if (!ct) return 0;
+		if (allTotals.insert (key, ct) < 0)
+		{
+			delete ct;
+			return 0;
+		}
+	}
+
+	if ( ! ct->updateFromSummary(ad)) return 0;
+	topLevelTotal->updateFromSummary(ad);
+	return 1;
+}
+
 bool TrackTotals::haveTotals()
 {
 	// display totals only for meaningful modes
@@ -223,20 +255,76 @@ update (ClassAd *ad, int options)
 int StartdNormalTotal::
 update (const char * state)
 {
-	switch (string_to_state (state))
+	return count (string_to_state (state), 1);
+}
+
+
+int StartdNormalTotal::
+count (State state, int n)
+{
+	switch (state)
 	{
-		case owner_state: 		owner++; 		break;
-		case unclaimed_state: 	unclaimed++; 	break;
-		case claimed_state:		claimed++;		break;
-		case matched_state:		matched++;		break;
-		case preempting_state:	preempting++;	break;
+		case owner_state: 		owner += n; 		break;
+		case unclaimed_state: 	unclaimed += n; 	break;
+		case claimed_state:		claimed += n;		break;
+		case matched_state:		matched += n;		break;
+		case preempting_state:	preempting += n;	break;
 #if HAVE_BACKFILL
-		case backfill_state:	backfill++;		break;
+		case backfill_state:	backfill += n;		break;
 #endif
-		case drained_state:		drained++;	break;
+		case drained_state:		drained += n;	break;
 		default: return 0;
 	}
-	machines++;
+	machines += n;
+	return 1;
+}
+
+
+void StartdNormalTotal::
+publishSummary (ClassAd &ad) const
+{
+	ad.Assign(ATTR_NUM_HOSTS_TOTAL, machines);
+	ad.Assign(ATTR_NUM_HOSTS_OWNER, owner);
+	ad.Assign(ATTR_NUM_HOSTS_UNCLAIMED, unclaimed);
+	ad.Assign(ATTR_NUM_HOSTS_CLAIMED, claimed);
+	ad.Assign(ATTR_NUM_HOSTS_MATCHED, matched);
+	ad.Assign(ATTR_NUM_HOSTS_PREEMPTING, preempting);
+#if HAVE_BACKFILL
+	ad.Assign(ATTR_NUM_HOSTS_BACKFILL, backfill);
+#endif
+	ad.Assign(ATTR_NUM_HOSTS_DRAINED, drained);
+}
+
+
+int StartdNormalTotal::
+updateFromSummary (ClassAd *ad)
+{
+	int attrMachines = 0;
+	if (!ad->LookupInteger(ATTR_NUM_HOSTS_TOTAL, attrMachines)) return 0;
+
+	int attrOwner = 0, attrUnclaimed = 0, attrClaimed = 0, attrMatched = 0;
+	int attrPreempting = 0, attrBackfill = 0, attrDrained = 0;
+	ad->LookupInteger(ATTR_NUM_HOSTS_OWNER, attrOwner);
+	ad->LookupInteger(ATTR_NUM_HOSTS_UNCLAIMED, attrUnclaimed);
+	ad->LookupInteger(ATTR_NUM_HOSTS_CLAIMED, attrClaimed);
+	ad->LookupInteger(ATTR_NUM_HOSTS_MATCHED, attrMatched);
+	ad->LookupInteger(ATTR_NUM_HOSTS_PREEMPTING, attrPreempting);
+	ad->LookupInteger(ATTR_NUM_HOSTS_BACKFILL, attrBackfill);
+	ad->LookupInteger(ATTR_NUM_HOSTS_DRAINED, attrDrained);
+
+	machines += attrMachines;
+	owner += attrOwner;
+	unclaimed += attrUnclaimed;
+	claimed += attrClaimed;
+	matched += attrMatched;
+	preempting += attrPreempting;
+#if HAVE_BACKFILL
+	backfill += attrBackfill;
+#else
+	// slots in a state we do not display are not counted as machines
+	machines -= attrBackfill;
+#endif
+	drained += attrDrained;
 	return 1;
 }
 
@@ -25,6 +25,7 @@
 #include "HashTable.h"
 #include "MyString.h"
 #include "status_types.h"
+#include "condor_state.h"
 
 // object keeps track of totals within a single class (same key)
 // (i.e., "OpSys/Arch" for a startd, "Name" for schedd, etc.)
@@ -40,6 +41,11 @@ class ClassTotal
 		virtual int update(ClassAd*, int options) 	= 0;
 		virtual void displayHeader(FILE*)= 0;
 
+		// the collector can keep totals for some modes and send them as
+		// one summary ad per key instead of sending every ad.
+		virtual void publishSummary(ClassAd &) const { }
+		virtual int updateFromSummary(ClassAd *) { return 0; }
+
 		// param is zero for non-final totals
 		virtual void displayInfo(FILE*, int=0)	= 0;
 
@@ -61,6 +67,8 @@ class TrackTotals
 		~TrackTotals();
 
 		int  update(ClassAd *, int options = 0, const char * key=NULL);
+		// add the totals of a summary ad sent by the collector
+		int  updateFromSummary(ClassAd *);
 		void displayTotals(FILE *, int keyLength);
 		bool haveTotals();
 
@@ -81,6 +89,12 @@ class StartdNormalTotal : public ClassTotal
 		virtual int update (ClassAd *, int options);
 		virtual void displayHeader(FILE *);
 		virtual void displayInfo(FILE *, int);
+		virtual void publishSummary(ClassAd &) const;
+		virtual int updateFromSummary(ClassAd *);
+
+		// add n slots in the given state, n may be negative
+		int count(State state, int n);
+		int numMachines() const { return machines; }
 
   	protected:
 		int machines;
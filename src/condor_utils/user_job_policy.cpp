@@ -822,6 +822,312 @@ bool UserPolicy::AnalyzeSinglePeriodicPolicy(ClassAd & ad, const char * attrname
 
 	return false;
 }
+
+// Works out when the periodic policy expressions of an ad could next change
+// value on their own, for UserPolicy::PeriodicPolicyChangeTime().
+//
+// The current time enters an expression through time() or CurrentTime, and
+// usually only in a comparison of an elapsed time against a limit, such as
+// time() - EnteredCurrentStatus > 3600.  When both sides of a comparison are
+// a constant plus or minus the current time (times or divided by constants),
+// the comparison can only change at the time the two sides cross, which is
+// worked out from their values now.  Anything else that depends on the time,
+// such as random(), makes the answer unknown.  References to attributes of
+// the ad are followed, up to a fixed depth.
+class PolicyTimeScan {
+public:
+	PolicyTimeScan(ClassAd & ad, time_t now) : m_ad(ad), m_now(now), m_next(0), m_unknown(false) {}
+
+	void Scan(classad::ExprTree * tree) { Scan(tree, 0); }
+	bool HasTimeRef(classad::ExprTree * tree) { return HasTimeRef(tree, 0); }
+	void Unknown() { m_unknown = true; }
+	void Candidate(time_t when) {
+		if (when > m_now && ( ! m_next || when < m_next)) { m_next = when; }
+	}
+		// 0 if the expressions do not change with time, now if there is no telling
+	time_t Next() const { return m_unknown ? m_now : m_next; }
+
+private:
+	enum { MAX_DEPTH = 8 };
+
+	// returns the expression an attribute reference refers to in the ad, or NULL
+	// if it is not an attribute of the ad.  is_time is set for CurrentTime, and
+	// other_scope for references into some other ad.
+	classad::ExprTree * Deref(classad::ExprTree * tree, bool & is_time, classad::ExprTree *& other_scope) {
+		classad::ExprTree * scope = NULL;
+		std::string attr, scope_name;
+		bool absolute = false;
+		is_time = false;
+		other_scope = NULL;
+		((classad::AttributeReference*)tree)->GetComponents(scope, attr, absolute);
+		if (scope && ! (ExprTreeIsAttrRef(scope, scope_name) && YourStringNoCase("MY") == scope_name.c_str())) {
+			other_scope = scope;
+			return NULL;
+		}
+		if (absolute) {
+			return NULL;
+		}
+		classad::ExprTree * expr = m_ad.Lookup(attr);
+		if ( ! expr) {
+			is_time = YourStringNoCase(ATTR_CURRENT_TIME) == attr.c_str();
+		}
+		return expr;
+	}
+
+	static bool IsTimeFunction(const std::string & name, size_t num_args) {
+		YourStringNoCase fn(name.c_str());
+		return fn == "time" || fn == "random" || fn == "eval" || (fn == "formatTime" && num_args == 0);
+	}
+
+	bool HasTimeRef(classad::ExprTree * tree, int depth) {
+		if ( ! tree) return false;
+		if (depth > MAX_DEPTH) return true;
+		switch (tree->GetKind()) {
+			case classad::ExprTree::LITERAL_NODE:
+				return false;
+
+			case classad::ExprTree::ATTRREF_NODE: {
+				bool is_time;
+				classad::ExprTree * other_scope;
+				classad::ExprTree * expr = Deref(tree, is_time, other_scope);
+				if (other_scope) return HasTimeRef(other_scope, depth);
+				return is_time || HasTimeRef(expr, depth + 1);
+			}
+
+			case classad::ExprTree::OP_NODE: {
+				classad::Operation::OpKind op;
+				classad::ExprTree *t1, *t2, *t3;
+				((classad::Operation*)tree)->GetComponents(op, t1, t2, t3);
+				return HasTimeRef(t1, depth) || HasTimeRef(t2, depth) || HasTimeRef(t3, depth);
+			}
+
+			case classad::ExprTree::FN_CALL_NODE: {
+				std::string name;
+				std::vector<classad::ExprTree*> args;
+				((classad::FunctionCall*)tree)->GetComponents(name, args);
+				if (IsTimeFunction(name, args.size())) return true;
+				for (auto it = args.begin(); it != args.end(); ++it) {
+					if (HasTimeRef(*it, depth)) return true;
+				}
+				return false;
+			}
+
+			case classad::ExprTree::CLASSAD_NODE: {
+				std::vector< std::pair<std::string, classad::ExprTree*> > attrs;
+				((classad::ClassAd*)tree)->GetComponents(attrs);
+				for (auto it = attrs.begin(); it != attrs.end(); ++it) {
+					if (HasTimeRef(it->second, depth)) return true;
+				}
+				return false;
+			}
+
+			case classad::ExprTree::EXPR_LIST_NODE: {
+				std::vector<classad::ExprTree*> exprs;
+				((classad::ExprList*)tree)->GetComponents(exprs);
+				for (auto it = exprs.begin(); it != exprs.end(); ++it) {
+					if (HasTimeRef(*it, depth)) return true;
+				}
+				return false;
+			}
+
+			case classad::ExprTree::EXPR_ENVELOPE:
+				return HasTimeRef(SkipExprEnvelope(tree), depth);
+
+			default:
+				return true;
+		}
+	}
+
+	// true if the value of the expression is slope * time() plus a constant.
+	// err is how many seconds integer division can move the time it has a given value.
+	bool Linear(classad::ExprTree * tree, int depth, double & slope, double & err) {
+		slope = 0; err = 0;
+		if ( ! HasTimeRef(tree, depth)) return true;
+		if (depth > MAX_DEPTH) return false;
+		switch (tree->GetKind()) {
+			case classad::ExprTree::ATTRREF_NODE: {
+				bool is_time;
+				classad::ExprTree * other_scope;
+				classad::ExprTree * expr = Deref(tree, is_time, other_scope);
+				if (is_time) { slope = 1; return true; }
+				return expr && Linear(expr, depth + 1, slope, err);
+			}
+
+			case classad::ExprTree::FN_CALL_NODE: {
+				std::string name;
+				std::vector<classad::ExprTree*> args;
+				((classad::FunctionCall*)tree)->GetComponents(name, args);
+				if (YourStringNoCase("time") == name.c_str() && args.empty()) { slope = 1; return true; }
+				return false;
+			}
+
+			case classad::ExprTree::EXPR_ENVELOPE:
+				return Linear(SkipExprEnvelope(tree), depth, slope, err);
+
+			case classad::ExprTree::OP_NODE: {
+				classad::Operation::OpKind op;
+				classad::ExprTree *t1, *t2, *t3;
+				((classad::Operation*)tree)->GetComponents(op, t1, t2, t3);
+				double s1, e1, s2, e2;
+				switch (op) {
+					case classad::Operation::PARENTHESES_OP:
+					case classad::Operation::UNARY_PLUS_OP:
+						return Linear(t1, depth, slope, err);
+					case classad::Operation::UNARY_MINUS_OP:
+						if ( ! Linear(t1, depth, slope, err)) return false;
+						slope = -slope;
+						return true;
+					case classad::Operation::ADDITION_OP:
+					case classad::Operation::SUBTRACTION_OP:
+						if ( ! Linear(t1, depth, s1, e1) || ! Linear(t2, depth, s2, e2)) return false;
+						slope = (op == classad::Operation::ADDITION_OP) ? s1 + s2 : s1 - s2;
+						err = e1 + e2;
+						return true;
+					case classad::Operation::MULTIPLICATION_OP:
+					case classad::Operation::DIVISION_OP: {
+						// one side must be a constant, and not the divisor of the other
+						classad::ExprTree * scale = t2;
+						if (HasTimeRef(t2, depth)) {
+							if (op == classad::Operation::DIVISION_OP || HasTimeRef(t1, depth)) return false;
+							scale = t1; t1 = t2;
+						}
+						classad::Value val;
+						double factor = 0;
+						if ( ! m_ad.EvaluateExpr(scale, val) || ! val.IsNumber(factor) || fabs(factor) < 1e-9) return false;
+						if ( ! Linear(t1, depth, slope, err)) return false;
+						if (op == classad::Operation::MULTIPLICATION_OP) {
+							slope *= factor;
+						} else {
+							slope /= factor;
+							if (fabs(slope) >= 1e-9) { err += fabs(1 / slope); }
+						}
+						return true;
+					}
+					default:
+						return false;
+				}
+			}
+
+			default:
+				return false;
+		}
+	}
+
+	void Compare(classad::ExprTree * t1, classad::ExprTree * t2, int depth) {
+		double s1, e1, s2, e2;
+		if ( ! Linear(t1, depth, s1, e1) || ! Linear(t2, depth, s2, e2)) {
+			Unknown();
+			return;
+		}
+		double slope = s1 - s2;
+		if (fabs(slope) < 1e-9) {
+			return;
+		}
+		// if either side is not a number now, it won't be one later either
+		classad::Value v1, v2;
+		double d1, d2;
+		if ( ! m_ad.EvaluateExpr(t1, v1) || ! v1.IsNumber(d1) ||
+			 ! m_ad.EvaluateExpr(t2, v2) || ! v2.IsNumber(d2)) {
+			return;
+		}
+		// the sides are equal at cross, give or take the rounding of integer division,
+		// and a strict comparison of whole seconds changes one second after that.
+		double cross = (double)m_now - (d1 - d2) / slope;
+		double err = e1 + e2;
+		if (cross + err + 1 <= (double)m_now) {
+			return;
+		}
+		time_t when = (time_t)ceil(cross - err);
+		Candidate(std::max(when, m_now + 1));
+	}
+
+	void Scan(classad::ExprTree * tree, int depth) {
+		if ( ! HasTimeRef(tree, depth)) return;
+		if (depth > MAX_DEPTH) { Unknown(); return; }
+		switch (tree->GetKind()) {
+			case classad::ExprTree::ATTRREF_NODE: {
+				bool is_time;
+				classad::ExprTree * other_scope;
+				classad::ExprTree * expr = Deref(tree, is_time, other_scope);
+				if (expr) { Scan(expr, depth + 1); } else { Unknown(); }
+				return;
+			}
+
+			case classad::ExprTree::EXPR_ENVELOPE:
+				Scan(SkipExprEnvelope(tree), depth);
+				return;
+
+			case classad::ExprTree::OP_NODE: {
+				classad::Operation::OpKind op;
+				classad::ExprTree *t1, *t2, *t3;
+				((classad::Operation*)tree)->GetComponents(op, t1, t2, t3);
+				if (op >= classad::Operation::__COMPARISON_START__ && op <= classad::Operation::__COMPARISON_END__) {
+					Compare(t1, t2, depth);
+				} else if (op == classad::Operation::PARENTHESES_OP || op == classad::Operation::TERNARY_OP ||
+						(op >= classad::Operation::__LOGIC_START__ && op <= classad::Operation::__LOGIC_END__)) {
+					Scan(t1, depth); Scan(t2, depth); Scan(t3, depth);
+				} else {
+					Unknown();
+				}
+				return;
+			}
+
+			case classad::ExprTree::FN_CALL_NODE: {
+				std::string name;
+				std::vector<classad::ExprTree*> args;
+				((classad::FunctionCall*)tree)->GetComponents(name, args);
+				if (YourStringNoCase("ifThenElse") == name.c_str()) {
+					for (auto it = args.begin(); it != args.end(); ++it) { Scan(*it, depth); }
+				} else {
+					Unknown();
+				}
+				return;
+			}
+
+			default:
+				Unknown();
+				return;
+		}
+	}
+
+	ClassAd & m_ad;
+	time_t m_now;
+	time_t m_next;
+	bool m_unknown;
+};
+
+time_t UserPolicy::PeriodicPolicyChangeTime(ClassAd & ad, time_t now)
+{
+	PolicyTimeScan scan(ad, now);
+
+	// TimerRemove fires once it is in the past
+	ExprTree * expr = ad.Lookup(ATTR_TIMER_REMOVE_CHECK);
+	if (expr) {
+		long long timer_remove = -1;
+		if (scan.HasTimeRef(expr)) {
+			scan.Unknown();
+		} else if (ad.EvaluateAttrNumber(ATTR_TIMER_REMOVE_CHECK, timer_remove) && timer_remove >= 0) {
+			scan.Candidate((time_t)timer_remove + 1);
+		}
+	}
+
+	int state = -1;
+	if ( ! ad.LookupInteger(ATTR_JOB_STATUS, state)) {
+		return 0;
+	}
+	if (state != HELD) {
+		scan.Scan(ad.Lookup(ATTR_PERIODIC_HOLD_CHECK));
+		scan.Scan(m_sys_periodic_hold);
+	} else {
+		scan.Scan(ad.Lookup(ATTR_PERIODIC_RELEASE_CHECK));
+		scan.Scan(m_sys_periodic_release);
+	}
+	scan.Scan(ad.Lookup(ATTR_PERIODIC_REMOVE_CHECK));
+	scan.Scan(m_sys_periodic_remove);
+
+	return scan.Next();
+}
+
 #else
 
 bool UserPolicy::AnalyzeSinglePeriodicPolicy(ClassAd & /*ad*/, const char * attrname, const char * macroname, int on_true_return, int & retval)
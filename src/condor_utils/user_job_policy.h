@@ -232,6 +232,14 @@ class UserPolicy
 		   occurred, then false is returned. */
 		bool FiringReason(MyString &reason,int &reason_code,int &reason_subcode);
 
+	#ifdef USE_NON_MUTATING_USERPOLICY
+		/* Returns the earliest time after now at which AnalyzePolicy(ad, PERIODIC_ONLY)
+			could give a different answer while the ad stays the same, 0 if
+			only a change to the ad can change the answer, or now if there is
+			no telling. */
+		time_t PeriodicPolicyChangeTime(ClassAd &ad, time_t now);
+	#endif
+
 	private: /* functions */
 		/* This function inserts the five of the six (all but TimerRemove) user
 			job policy expressions with default values into the classad if they